@@ -11,7 +11,8 @@ String: replicate, charindex, leftstr, rightstr, ltrim, rtrim, trim,
 replace, reverse, proper, padl, padr, padc, strfilter.
 
 Aggregate: stdev, variance, mode, median, lower_quartile,
-upper_quartile.
+upper_quartile, stdev_state, stdev_merge, variance_merge,
+stdev_state_merge.
 
 The string functions ltrim, rtrim, trim, replace are included in
 recent versions of SQLite and so by default do not build.
@@ -312,6 +313,80 @@ static int sqlite3ReadUtf8(const unsigned char *z){
 #define sqliteNextChar(X)  while( (0xc0&*++(X))==0x80 ){}
 #define sqliteCharVal(X)   sqlite3ReadUtf8(X)
 
+/*
+** The UTF-8 helpers below process the text a machine word at a time.
+** UTF8_ONES has the low bit of every byte set, UTF8_HIGH the high bit.
+** A word with none of the UTF8_HIGH bits set holds only ASCII bytes,
+** i.e. eight complete characters.
+*/
+#define UTF8_ONES  0x0101010101010101ULL
+#define UTF8_HIGH  0x8080808080808080ULL
+
+/*
+** Returns non-zero if the n bytes at z are all ASCII characters.  Two
+** words (16 bytes) are checked per iteration.
+*/
+static int _utf8IsAscii(const unsigned char *z, int n){
+  uint64_t w1, w2;
+  int i = 0;
+
+  for(; i+16<=n; i+=16){
+    memcpy(&w1, z+i, 8);
+    memcpy(&w2, z+i+8, 8);
+    if( (w1|w2) & UTF8_HIGH ) return 0;
+  }
+  for(; i<n; i++){
+    if( z[i]&0x80 ) return 0;
+  }
+  return 1;
+}
+
+/*
+** Returns the number of UTF-8 characters in the n bytes at z, i.e. the
+** number of bytes that are not continuation bytes.  Eight bytes at a
+** time are checked for the 10xxxxxx pattern using plain integer math.
+*/
+static int _utf8Count(const unsigned char *z, int n){
+  uint64_t w;
+  int nCont = 0;
+  int i = 0;
+
+  for(; i+8<=n; i+=8){
+    memcpy(&w, z+i, 8);
+    w = (w >> 7) & ~(w >> 6) & UTF8_ONES;
+    nCont += (int)((w * UTF8_ONES) >> 56);
+  }
+  for(; i<n; i++){
+    if( (z[i]&0xc0)==0x80 ) nCont++;
+  }
+  return n - nCont;
+}
+
+/*
+** Returns the number of bytes taken by the first nChar UTF-8 characters
+** of the n bytes at z, or n if there are fewer characters than that.
+** Runs of ASCII characters are skipped a word at a time.
+*/
+static int _utf8Skip(const unsigned char *z, int n, i64 nChar){
+  uint64_t w;
+  int i = 0;
+
+  while( nChar>0 && i<n ){
+    if( nChar>=8 && i+8<=n ){
+      memcpy(&w, z+i, 8);
+      if( (w & UTF8_HIGH)==0 ){
+        i += 8;
+        nChar -= 8;
+        continue;
+      }
+    }
+    i++;
+    while( i<n && (z[i]&0xc0)==0x80 ) i++;
+    nChar--;
+  }
+  return i;
+}
+
 /*
 ** This is a macro that facilitates writting wrappers for math.h functions
 ** it creates code for a function to use in SQlite that gets one numeric input
@@ -642,17 +717,131 @@ static void floorFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
   }
 }
 
+/*
+** A string being built as the result of a function call.  The buffer is
+** obtained from sqlite3_malloc() and handed over to SQLite by
+** strBufResult(), so the finished result is never copied again.  When the
+** final size is known it should be passed to strBufInit(); otherwise the
+** buffer grows geometrically as text is appended.  The total length is
+** bounded by the SQLITE_LIMIT_LENGTH of the connection.
+*/
+typedef struct StrBuf StrBuf;
+struct StrBuf {
+  sqlite3_context *context;  /* function call the result belongs to */
+  char *z;                   /* text built so far, NUL terminated */
+  i64 n;                     /* bytes used, not including the terminator */
+  i64 nAlloc;                /* bytes allocated for z */
+  i64 mxAlloc;               /* maximum bytes z may use */
+  int rc;                    /* SQLITE_OK, SQLITE_NOMEM or SQLITE_TOOBIG */
+};
+
+/*
+** Makes sure there is room for nNeed more bytes (plus the terminator).
+** Returns non-zero on success.
+*/
+static int strBufGrow(StrBuf *p, i64 nNeed){
+  i64 nNew;
+  char *zNew;
+
+  if( p->rc!=SQLITE_OK ){
+    return 0;
+  }
+  if( nNeed<0 || nNeed>p->mxAlloc-p->n-1 ){
+    p->rc = SQLITE_TOOBIG;
+    return 0;
+  }
+  nNew = p->n + nNeed + 1;
+  if( nNew<=p->nAlloc ){
+    return 1;
+  }
+  if( nNew<2*p->nAlloc ){
+    nNew = 2*p->nAlloc;
+  }
+  if( nNew>p->mxAlloc ){
+    nNew = p->mxAlloc;
+  }
+  zNew = sqlite3_realloc(p->z, (int)nNew);
+  if( !zNew ){
+    p->rc = SQLITE_NOMEM;
+    return 0;
+  }
+  p->z = zNew;
+  p->nAlloc = nNew;
+  return 1;
+}
+
+/*
+** Prepares an empty string with room for nAlloc bytes of text.
+** Returns non-zero on success.
+*/
+static int strBufInit(StrBuf *p, sqlite3_context *context, i64 nAlloc){
+  p->context = context;
+  p->z = 0;
+  p->n = 0;
+  p->nAlloc = 0;
+  p->mxAlloc = (i64)sqlite3_limit(sqlite3_context_db_handle(context),
+      SQLITE_LIMIT_LENGTH, -1) + 1;
+  if( p->mxAlloc>0x7fffffff ){
+    p->mxAlloc = 0x7fffffff;
+  }
+  p->rc = SQLITE_OK;
+  if( !strBufGrow(p, nAlloc) ){
+    return 0;
+  }
+  p->z[0] = '\0';
+  return 1;
+}
+
+/*
+** Appends n bytes of z to the string.
+*/
+static void strBufAppend(StrBuf *p, const char *z, i64 n){
+  if( n>0 && strBufGrow(p, n) ){
+    memcpy(p->z+p->n, z, (size_t)n);
+    p->n += n;
+    p->z[p->n] = '\0';
+  }
+}
+
+/*
+** Appends nCount copies of the byte c to the string.
+*/
+static void strBufAppendChar(StrBuf *p, char c, i64 nCount){
+  if( nCount>0 && strBufGrow(p, nCount) ){
+    memset(p->z+p->n, c, (size_t)nCount);
+    p->n += nCount;
+    p->z[p->n] = '\0';
+  }
+}
+
+/*
+** Sets the string as the result of the function call, or reports the
+** error encountered while building it.  Either way, the buffer is no
+** longer owned by the caller.
+*/
+static void strBufResult(StrBuf *p){
+  if( p->rc==SQLITE_NOMEM ){
+    sqlite3_result_error_nomem(p->context);
+  }else if( p->rc==SQLITE_TOOBIG ){
+    sqlite3_result_error_toobig(p->context);
+  }else{
+    sqlite3_result_text(p->context, p->z, (int)p->n, sqlite3_free);
+    p->z = 0;
+  }
+  sqlite3_free(p->z);
+}
+
 /*
 ** Given a string (s) in the first argument and an integer (n) in the second returns the
 ** string that constains s contatenated n times
 */
 static void replicateFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
-  unsigned char *z;        /* input string */
-  unsigned char *zo;       /* result string */
+  const char *z;           /* input string */
   i64 iCount;              /* times to repeat */
   i64 nLen;                /* length of the input string (no multibyte considerations) */
   i64 nTLen;               /* length of the result string (no multibyte considerations) */
-  i64 i=0;
+  i64 n;
+  StrBuf b;
 
   if( argc!=2 || SQLITE_NULL==sqlite3_value_type(argv[0]) )
     return;
@@ -663,25 +852,23 @@ static void replicateFunc(sqlite3_context *context, int argc, sqlite3_value **ar
     sqlite3_result_error(context, "domain error", -1);
   }else{
 
+    z     = (const char *)sqlite3_value_text(argv[0]);
     nLen  = sqlite3_value_bytes(argv[0]);
-    nTLen = nLen*iCount;
-    z=sqlite3_malloc(nTLen+1);
-    zo=sqlite3_malloc(nLen+1);
-    if (!z || !zo){
-      sqlite3_result_error_nomem(context);
-      if (z) sqlite3_free(z);
-      if (zo) sqlite3_free(zo);
+    if( nLen>0 && iCount>SQLITE_MAX_LENGTH/nLen ){
+      sqlite3_result_error_toobig(context);
       return;
     }
-    strcpy((char*)zo, (char*)sqlite3_value_text(argv[0]));
-
-    for(i=0; i<iCount; ++i){
-      strcpy((char*)(z+i*nLen), (char*)zo);
+    nTLen = nLen*iCount;
+    if( strBufInit(&b, context, nTLen) && nTLen>0 ){
+      /* copy the input once, then keep doubling what is already there */
+      strBufAppend(&b, z, nLen);
+      while( b.n<nTLen ){
+        n = nTLen-b.n;
+        if( n>b.n ) n = b.n;
+        strBufAppend(&b, b.z, n);
+      }
     }
-
-    sqlite3_result_text(context, (char*)z, -1, SQLITE_TRANSIENT);
-    sqlite3_free(z);
-    sqlite3_free(zo);
+    strBufResult(&b);
   }
 }
 
@@ -697,42 +884,49 @@ int isblank(char c){
 
 static void properFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
   const unsigned char *z;     /* input string */
-  unsigned char *zo;          /* output string */
   unsigned char *zt;          /* iterator */
-  char r;
+  unsigned char r;
   int c=1;
+  int i, n;
+  StrBuf b;
 
-  assert( argc!=1);
+  assert( argc==1);
   if( SQLITE_NULL==sqlite3_value_type(argv[0]) ){
     sqlite3_result_null(context);
     return;
   }
 
   z = sqlite3_value_text(argv[0]);
-  zo = (unsigned char *)sqlite3StrDup((char *) z);
-  if (!zo) {
-    sqlite3_result_error_nomem(context);
+  n = sqlite3_value_bytes(argv[0]);
+  if( !strBufInit(&b, context, n) ){
+    strBufResult(&b);
     return;
   }
-  zt = zo;
-
-  while( (r = *(z++))!=0 ){
+  zt = (unsigned char *)b.z;
+
+  /*
+  ** only ASCII letters change case, so the text is handled one byte at a
+  ** time, without decoding UTF-8 or calling the locale dependent toupper()
+  ** and tolower() on bytes of multibyte characters
+  */
+  for(i=0; i<n; i++){
+    r = z[i];
     if( isblank(r) ){
       c=1;
     }else{
       if( c==1 ){
-        r = toupper(r);
+        if( r>='a' && r<='z' ) r -= 'a'-'A';
       }else{
-        r = tolower(r);
+        if( r>='A' && r<='Z' ) r += 'a'-'A';
       }
       c=0;
     }
-    *(zt++) = r;
+    zt[i] = r;
   }
-  *zt = '\0';
+  zt[n] = '\0';
+  b.n = n;
 
-  sqlite3_result_text(context, (char*)zo, -1, SQLITE_TRANSIENT);
-  sqlite3_free(zo);
+  strBufResult(&b);
 }
 
 /*
@@ -744,10 +938,9 @@ static void properFunc(sqlite3_context *context, int argc, sqlite3_value **argv)
 static void padlFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
   i64 ilen;          /* length to pad to */
   i64 zl;            /* length of the input string (UTF-8 chars) */
-  int i = 0;
+  i64 zll;           /* length of the input string (bytes) */
   const char *zi;    /* input string */
-  char *zo;          /* output string */
-  char *zt;
+  StrBuf b;
 
   assert( argc==2 );
 
@@ -755,36 +948,25 @@ static void padlFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
     sqlite3_result_null(context);
   }else{
     zi = (char *)sqlite3_value_text(argv[0]);
+    zll = sqlite3_value_bytes(argv[0]);
     ilen = sqlite3_value_int64(argv[1]);
     /* check domain */
     if(ilen<0){
       sqlite3_result_error(context, "domain error", -1);
       return;
     }
-    zl = sqlite3Utf8CharLen(zi, -1);
+    zl = _utf8Count((const unsigned char *)zi, (int)zll);
     if( zl>=ilen ){
-      /* string is longer than the requested pad length, return the same string (dup it) */
-      zo = sqlite3StrDup(zi);
-      if (!zo){
-        sqlite3_result_error_nomem(context);
-        return;
-      }
-      sqlite3_result_text(context, zo, -1, SQLITE_TRANSIENT);
+      /* string is longer than the requested pad length, return the same string */
+      sqlite3_result_text(context, zi, (int)zll, SQLITE_TRANSIENT);
     }else{
-      zo = sqlite3_malloc(strlen(zi)+ilen-zl+1);
-      if (!zo){
-        sqlite3_result_error_nomem(context);
-        return;
+      if( strBufInit(&b, context, zll+ilen-zl) ){
+        strBufAppendChar(&b, ' ', ilen-zl);
+        /* no need to take UTF-8 into consideration here */
+        strBufAppend(&b, zi, zll);
       }
-      zt = zo;
-      for(i=1; i+zl<=ilen; ++i){
-        *(zt++)=' ';
-      }
-      /* no need to take UTF-8 into consideration here */
-      strcpy(zt,zi);
+      strBufResult(&b);
     }
-    sqlite3_result_text(context, zo, -1, SQLITE_TRANSIENT);
-    sqlite3_free(zo);
   }
 }
 
@@ -798,10 +980,8 @@ static void padrFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
   i64 ilen;          /* length to pad to */
   i64 zl;            /* length of the input string (UTF-8 chars) */
   i64 zll;           /* length of the input string (bytes) */
-  int i = 0;
   const char *zi;    /* input string */
-  char *zo;          /* output string */
-  char *zt;
+  StrBuf b;
 
   assert( argc==2 );
 
@@ -809,36 +989,24 @@ static void padrFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
     sqlite3_result_null(context);
   }else{
     zi = (char *)sqlite3_value_text(argv[0]);
+    zll = sqlite3_value_bytes(argv[0]);
     ilen = sqlite3_value_int64(argv[1]);
     /* check domain */
     if(ilen<0){
       sqlite3_result_error(context, "domain error", -1);
       return;
     }
-    zl = sqlite3Utf8CharLen(zi, -1);
+    zl = _utf8Count((const unsigned char *)zi, (int)zll);
     if( zl>=ilen ){
-      /* string is longer than the requested pad length, return the same string (dup it) */
-      zo = sqlite3StrDup(zi);
-      if (!zo){
-        sqlite3_result_error_nomem(context);
-        return;
-      }
-      sqlite3_result_text(context, zo, -1, SQLITE_TRANSIENT);
+      /* string is longer than the requested pad length, return the same string */
+      sqlite3_result_text(context, zi, (int)zll, SQLITE_TRANSIENT);
     }else{
-      zll = strlen(zi);
-      zo = sqlite3_malloc(zll+ilen-zl+1);
-      if (!zo){
-        sqlite3_result_error_nomem(context);
-        return;
-      }
-      zt = strcpy(zo,zi)+zll;
-      for(i=1; i+zl<=ilen; ++i){
-        *(zt++) = ' ';
+      if( strBufInit(&b, context, zll+ilen-zl) ){
+        strBufAppend(&b, zi, zll);
+        strBufAppendChar(&b, ' ', ilen-zl);
       }
-      *zt = '\0';
+      strBufResult(&b);
     }
-    sqlite3_result_text(context, zo, -1, SQLITE_TRANSIENT);
-    sqlite3_free(zo);
   }
 }
 
@@ -850,13 +1018,11 @@ static void padrFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
 ** padl(NULL) = NULL
 */
 static void padcFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
-  i64 ilen;           /* length to pad to */
-  i64 zl;             /* length of the input string (UTF-8 chars) */
-  i64 zll;            /* length of the input string (bytes) */
-  int i = 0;
-  const char *zi;     /* input string */
-  char *zo;           /* output string */
-  char *zt;
+  i64 ilen;          /* length to pad to */
+  i64 zl;            /* length of the input string (UTF-8 chars) */
+  i64 zll;           /* length of the input string (bytes) */
+  const char *zi;    /* input string */
+  StrBuf b;
 
   assert( argc==2 );
 
@@ -864,41 +1030,26 @@ static void padcFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
     sqlite3_result_null(context);
   }else{
     zi = (char *)sqlite3_value_text(argv[0]);
+    zll = sqlite3_value_bytes(argv[0]);
     ilen = sqlite3_value_int64(argv[1]);
     /* check domain */
     if(ilen<0){
       sqlite3_result_error(context, "domain error", -1);
       return;
     }
-    zl = sqlite3Utf8CharLen(zi, -1);
+    zl = _utf8Count((const unsigned char *)zi, (int)zll);
     if( zl>=ilen ){
-      /* string is longer than the requested pad length, return the same string (dup it) */
-      zo = sqlite3StrDup(zi);
-      if (!zo){
-        sqlite3_result_error_nomem(context);
-        return;
-      }
-      sqlite3_result_text(context, zo, -1, SQLITE_TRANSIENT);
+      /* string is longer than the requested pad length, return the same string */
+      sqlite3_result_text(context, zi, (int)zll, SQLITE_TRANSIENT);
     }else{
-      zll = strlen(zi);
-      zo = sqlite3_malloc(zll+ilen-zl+1);
-      if (!zo){
-        sqlite3_result_error_nomem(context);
-        return;
+      /* padded on the left, as many spaces as on the right (or one less) */
+      if( strBufInit(&b, context, zll+ilen-zl) ){
+        strBufAppendChar(&b, ' ', (ilen-zl)/2);
+        strBufAppend(&b, zi, zll);
+        strBufAppendChar(&b, ' ', ilen-zl-(ilen-zl)/2);
       }
-      zt = zo;
-      for(i=1; 2*i+zl<=ilen; ++i){
-        *(zt++) = ' ';
-      }
-      strcpy(zt, zi);
-      zt+=zll;
-      for(; i+zl<=ilen; ++i){
-        *(zt++) = ' ';
-      }
-      *zt = '\0';
+      strBufResult(&b);
     }
-    sqlite3_result_text(context, zo, -1, SQLITE_TRANSIENT);
-    sqlite3_free(zo);
   }
 }
 
@@ -912,8 +1063,8 @@ static void strfilterFunc(sqlite3_context *context, int argc, sqlite3_value **ar
   const char *z1;
   const char *z21;
   const char *z22;
-  char *zo;               /* output string */
-  char *zot;
+  char *zot;              /* output string iterator */
+  StrBuf b;               /* output string */
   int c1 = 0;
   int c2 = 0;
 
@@ -928,12 +1079,11 @@ static void strfilterFunc(sqlite3_context *context, int argc, sqlite3_value **ar
     ** maybe I could allocate less, but that would imply 2 passes, rather waste
     ** (possibly) some memory
     */
-    zo = sqlite3_malloc(strlen(zi1)+1);
-    if (!zo){
-      sqlite3_result_error_nomem(context);
+    if( !strBufInit(&b, context, sqlite3_value_bytes(argv[0])) ){
+      strBufResult(&b);
       return;
     }
-    zot = zo;
+    zot = b.z;
     z1 = zi1;
     while( (c1=sqliteCharVal((unsigned char *)z1))!=0 ){
       z21=zi2;
@@ -943,15 +1093,15 @@ static void strfilterFunc(sqlite3_context *context, int argc, sqlite3_value **ar
       if( c2!=0){
         z22=z21;
         sqliteNextChar(z22);
-        strncpy(zot, z21, z22-z21);
+        memcpy(zot, z21, z22-z21);
         zot+=z22-z21;
       }
       sqliteNextChar(z1);
     }
     *zot = '\0';
+    b.n = zot-b.z;
 
-    sqlite3_result_text(context, zo, -1, SQLITE_TRANSIENT);
-    sqlite3_free(zo);
+    strBufResult(&b);
   }
 }
 
@@ -1013,6 +1163,102 @@ static int _substr(const char* z1, const char* z2, int s, CollSeq *pColl, const
   return rVal >=0 ? rVal+s : rVal;
 }
 
+/*
+** The kinds of comparison supported by _substrFast().  Collating
+** sequences other than these two are searched using _substr().
+*/
+#define SUBSTR_BINARY  0
+#define SUBSTR_NOCASE  1
+
+#define substrFold(c)  ((((c)>='A') && ((c)<='Z')) ? (c)+32 : (c))
+
+/*
+** Returns the byte offset of the first occurence of the n1 bytes at z1 in
+** the n2 bytes at z2 or -1 when there isn't a match.  Candidate positions
+** are located using memchr() (BINARY) or a case-folded scan of the first
+** byte (NOCASE) and verified with memcmp() or sqlite3_strnicmp().
+** This is an auxiliary function.
+*/
+static int _findFast(
+  const unsigned char *z1, int n1,
+  const unsigned char *z2, int n2,
+  int eKind
+){
+  const unsigned char *zLast;
+  const unsigned char *z;
+  int c1;
+
+  if( n1<=0 || n2<n1 ){
+    return -1;
+  }
+
+  zLast = z2 + n2 - n1;
+  if( eKind==SUBSTR_BINARY ){
+    for(z=z2; z<=zLast; z++){
+      z = (const unsigned char *)memchr(z, z1[0], (zLast-z)+1);
+      if( z==0 ) return -1;
+      if( memcmp(z, z1, n1)==0 ) return (int)(z - z2);
+    }
+  }else{
+    c1 = substrFold(z1[0]);
+    for(z=z2; z<=zLast; z++){
+      if( substrFold(*z)==c1
+       && sqlite3_strnicmp((const char *)z, (const char *)z1, n1)==0 ){
+        return (int)(z - z2);
+      }
+    }
+  }
+  return -1;
+}
+
+/*
+** Same as _substr() for the BINARY and NOCASE collating sequences, with
+** the string lengths (in bytes) already known.  The match is located by
+** _findFast(), instead of invoking the collating function once per
+** character, and its character index is then computed using _utf8Count().
+** This is an auxiliary function.
+*/
+static int _substrFast(
+  const unsigned char *z1, int n1,
+  const unsigned char *z2, int n2,
+  int s, int eKind
+){
+  int i;
+
+  if( n1<=0 ){
+    return -1;
+  }
+
+  i = _utf8Skip(z2, n2, s);
+  z2 += i;
+  n2 -= i;
+
+  i = _findFast(z1, n1, z2, n2, eKind);
+  if( i<0 ){
+    return -1;
+  }
+  return s + _utf8Count(z2, i);
+}
+
+/*
+** Returns the _substrFast() comparison kind to use for the collating
+** sequence of a function call or -1 if _substr() must be used instead.
+** Like _substr(), characters are compared exactly when the collating
+** sequence is missing or does not use UTF-8.
+*/
+static int _substrKind(CollSeq *pColl){
+  if( pColl==0 || pColl->enc!=SQLITE_UTF8 ){
+    return SUBSTR_BINARY;
+  }
+  if( sqlite3_stricmp(pColl->zName, "BINARY")==0 ){
+    return SUBSTR_BINARY;
+  }
+  if( sqlite3_stricmp(pColl->zName, "NOCASE")==0 ){
+    return SUBSTR_NOCASE;
+  }
+  return -1;
+}
+
 /*
 ** given 2 input strings (s1,s2) and an integer (n) searches from the nth character
 ** for the string s1. Returns the position where the match occured.
@@ -1023,8 +1269,10 @@ static int _substr(const char* z1, const char* z2, int s, CollSeq *pColl, const
 static void charindexFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
   const u8 *z1;          /* s1 string */
   u8 *z2;                /* s2 string */
+  int n1, n2;            /* s1 and s2 lengths, in bytes */
   int s=0;
   int rVal=0;
+  int eKind;
 #if SQLITE_VERSION_NUMBER >= 3008007
   CollSeq *pColl = sqlite3GetFuncCollSeq(context);
 #else
@@ -1040,7 +1288,10 @@ static void charindexFunc(sqlite3_context *context, int argc, sqlite3_value **ar
 
   z1 = sqlite3_value_text(argv[0]);
   if( z1==0 ) return;
+  n1 = sqlite3_value_bytes(argv[0]);
   z2 = (u8*) sqlite3_value_text(argv[1]);
+  if( z2==0 ) return;
+  n2 = sqlite3_value_bytes(argv[1]);
   if(argc==3){
     s = sqlite3_value_int(argv[2])-1;
     if(s<0){
@@ -1050,7 +1301,12 @@ static void charindexFunc(sqlite3_context *context, int argc, sqlite3_value **ar
     s = 0;
   }
 
-  rVal = _substr((char *)z1,(char *)z2,s,pColl,NULL);
+  eKind = _substrKind(pColl);
+  if( eKind>=0 ){
+    rVal = _substrFast(z1,n1,z2,n2,s,eKind);
+  }else{
+    rVal = _substr((char *)z1,(char *)z2,s,pColl,NULL);
+  }
   sqlite3_result_int(context, rVal+1);
 }
 
@@ -1059,12 +1315,9 @@ static void charindexFunc(sqlite3_context *context, int argc, sqlite3_value **ar
 ** if the string has a length<=n or is NULL this function is NOP
 */
 static void leftFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
-  int c=0;
-  int cc=0;
-  int l=0;
+  i64 l=0;
+  int n;
   const unsigned char *z;       /* input string */
-  const unsigned char *zt;
-  unsigned char *rz;            /* output string */
 
   assert( argc==2);
 
@@ -1074,23 +1327,11 @@ static void leftFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
   }
 
   z  = sqlite3_value_text(argv[0]);
-  l  = sqlite3_value_int(argv[1]);
-  zt = z;
-
-  while( sqliteCharVal(zt) && c++<l)
-    sqliteNextChar(zt);
-
-  cc=zt-z;
+  n  = sqlite3_value_bytes(argv[0]);
+  l  = sqlite3_value_int64(argv[1]);
 
-  rz = sqlite3_malloc(zt-z+1);
-  if (!rz){
-    sqlite3_result_error_nomem(context);
-    return;
-  }
-  strncpy((char*) rz, (char*) z, zt-z);
-  *(rz+cc) = '\0';
-  sqlite3_result_text(context, (char*)rz, -1, SQLITE_TRANSIENT);
-  sqlite3_free(rz);
+  /* the result is a prefix of the input, let SQLite copy it */
+  sqlite3_result_text(context, (char*)z, _utf8Skip(z, n, l), SQLITE_TRANSIENT);
 }
 
 /*
@@ -1098,13 +1339,11 @@ static void leftFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
 ** if the string has a length<=n or is NULL this function is NOP
 */
 static void rightFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
-  int l=0;
-  int c=0;
-  int cc=0;
-  const char *z;
-  const char *zt;
-  const char *ze;
-  char *rz;
+  i64 l=0;
+  i64 cc=0;
+  int n;
+  int i;
+  const unsigned char *z;       /* input string */
 
   assert( argc==2);
 
@@ -1113,34 +1352,15 @@ static void rightFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
     return;
   }
 
-  z  = (char *)sqlite3_value_text(argv[0]);
-  l  = sqlite3_value_int(argv[1]);
-  zt = z;
-
-  while( sqliteCharVal((unsigned char *)zt)!=0){
-    sqliteNextChar(zt);
-    ++c;
-  }
-
-  ze = zt;
-  zt = z;
-
-  cc=c-l;
-  if(cc<0)
-    cc=0;
+  z  = sqlite3_value_text(argv[0]);
+  n  = sqlite3_value_bytes(argv[0]);
+  l  = sqlite3_value_int64(argv[1]);
 
-  while( cc-- > 0 ){
-    sqliteNextChar(zt);
-  }
+  cc = _utf8Count(z, n) - l;
+  i = cc>0 ? _utf8Skip(z, n, cc) : 0;
 
-  rz = sqlite3_malloc(ze-zt+1);
-  if (!rz){
-    sqlite3_result_error_nomem(context);
-    return;
-  }
-  strcpy((char*) rz, (char*) (zt));
-  sqlite3_result_text(context, (char*)rz, -1, SQLITE_TRANSIENT);
-  sqlite3_free(rz);
+  /* the result is a suffix of the input, let SQLite copy it */
+  sqlite3_result_text(context, (char*)z+i, n-i, SQLITE_TRANSIENT);
 }
 
 #ifndef HAVE_TRIM
@@ -1223,20 +1443,6 @@ static void trimFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
 }
 #endif
 
-/*
-** given a pointer to a string s1, the length of that string (l1), a new string (s2)
-** and it's length (l2) appends s2 to s1.
-** All lengths in bytes.
-** This is just an auxiliary function
-*/
-/*
-   static void _append(char **s1, int l1, const char *s2, int l2){
-     *s1 = realloc(*s1, (l1+l2+1)*sizeof(char));
-     strncpy((*s1)+l1, s2, l2);
-     *(*(s1)+l1+l2) = '\0';
-   }
-*/
-
 #ifndef HAVE_TRIM
 
 /*
@@ -1249,11 +1455,9 @@ static void replaceFunc(sqlite3_context *context, int argc, sqlite3_value **argv
   int lz1;
   int lz2;
   int lz3;
-  int lzo=0;
-  char *zo=0;
   int ret=0;
   const char *zt1;
-  const char *zt2;
+  StrBuf b;
 
   assert( 3==argc );
 
@@ -1262,48 +1466,48 @@ static void replaceFunc(sqlite3_context *context, int argc, sqlite3_value **argv
     return;
   }
 
-  z1 = sqlite3_value_text(argv[0]);
-  z2 = sqlite3_value_text(argv[1]);
-  z3 = sqlite3_value_text(argv[2]);
+  z1 = (const char *)sqlite3_value_text(argv[0]);
+  lz1 = sqlite3_value_bytes(argv[0]);
+  z2 = (const char *)sqlite3_value_text(argv[1]);
+  lz2 = sqlite3_value_bytes(argv[1]);
+  z3 = (const char *)sqlite3_value_text(argv[2]);
+  lz3 = sqlite3_value_bytes(argv[2]);
   /* handle possible null values */
   if( 0==z2 ){
     z2="";
+    lz2=0;
   }
   if( 0==z3 ){
     z3="";
+    lz3=0;
   }
 
-  lz1 = strlen(z1);
-  lz2 = strlen(z2);
-  lz3 = strlen(z3);
-
-#if 0
   /* special case when z2 is empty (or null) nothing will be changed */
   if( 0==lz2 ){
-    sqlite3_result_text(context, z1, -1, SQLITE_TRANSIENT);
+    sqlite3_result_text(context, z1, lz1, SQLITE_TRANSIENT);
     return;
   }
-#endif
 
   zt1=z1;
-  zt2=z1;
+  if( !strBufInit(&b, context, lz1) ){
+    strBufResult(&b);
+    return;
+  }
 
   while(1){
-    ret=_substr(z2,zt1 , 0, &zt2);
+    ret=_findFast((const unsigned char *)z2, lz2,
+        (const unsigned char *)zt1, lz1-(int)(zt1-z1), SUBSTR_BINARY);
 
     if( ret<0 )
       break;
 
-    _append(&zo, lzo, zt1, zt2-zt1);
-    lzo+=zt2-zt1;
-    _append(&zo, lzo, z3, lz3);
-    lzo+=lz3;
+    strBufAppend(&b, zt1, ret);
+    strBufAppend(&b, z3, lz3);
 
-    zt1=zt2+lz2;
+    zt1+=ret+lz2;
   }
-  _append(&zo, lzo, zt1, lz1-(zt1-z1));
-  sqlite3_result_text(context, zo, -1, SQLITE_TRANSIENT);
-  sqlite3_free(zo);
+  strBufAppend(&b, zt1, lz1-(zt1-z1));
+  strBufResult(&b);
 }
 #endif
 
@@ -1311,12 +1515,12 @@ static void replaceFunc(sqlite3_context *context, int argc, sqlite3_value **argv
 ** given a string returns the same string but with the characters in reverse order
 */
 static void reverseFunc(sqlite3_context *context, int argc, sqlite3_value **argv){
-  const char *z;
-  const char *zt;
-  char *rz;
+  const unsigned char *z;
   char *rzt;
   int l = 0;
   int i = 0;
+  int j;
+  StrBuf b;
 
   assert( 1==argc );
 
@@ -1324,27 +1528,33 @@ static void reverseFunc(sqlite3_context *context, int argc, sqlite3_value **argv
     sqlite3_result_null(context);
     return;
   }
-  z = (char *)sqlite3_value_text(argv[0]);
-  l = strlen(z);
-  rz = sqlite3_malloc(l+1);
-  if (!rz){
-    sqlite3_result_error_nomem(context);
+  z = sqlite3_value_text(argv[0]);
+  l = sqlite3_value_bytes(argv[0]);
+  if( !strBufInit(&b, context, l) ){
+    strBufResult(&b);
     return;
   }
-  rzt = rz+l;
-  *(rzt--) = '\0';
-
-  zt=z;
-  while( sqliteCharVal((unsigned char *)zt)!=0 ){
-    z=zt;
-    sqliteNextChar(zt);
-    for(i=1; zt-i>=z; ++i){
-      *(rzt--)=*(zt-i);
+  b.n = l;
+  rzt = b.z+l;
+  *rzt = '\0';
+
+  if( _utf8IsAscii(z, l) ){
+    /* every byte is a character */
+    for(i=0; i<l; i++){
+      *(--rzt) = z[i];
+    }
+  }else{
+    /* copy each character, keeping the order of its bytes */
+    while( i<l ){
+      j = i+1;
+      while( j<l && (z[j]&0xc0)==0x80 ) j++;
+      rzt -= j-i;
+      memcpy(rzt, z+i, j-i);
+      i = j;
     }
   }
 
-  sqlite3_result_text(context, rz, -1, SQLITE_TRANSIENT);
-  sqlite3_free(rz);
+  strBufResult(&b);
 }
 
 /*
@@ -1624,6 +1834,109 @@ static void varianceFinalize(sqlite3_context *context){
   }
 }
 
+/*
+** The partial state of a stdev() or variance() computation can be saved
+** using the stdev_state(X) aggregate, e.g. into hourly rollup tables, and
+** combined later using the stdev_merge(S), variance_merge(S) and
+** stdev_state_merge(S) aggregates, without rescanning the original rows.
+** The states are combined using the parallel algorithm of Chan et al.
+**
+** A state is a blob of STDEV_STATE_SIZE bytes: the 4-byte STDEV_STATE_MAGIC,
+** followed by the count, the mean and the sum of squared differences from
+** the mean (StdevCtx.cnt, rM and rS), each stored as 8 little-endian bytes.
+*/
+#define STDEV_STATE_MAGIC "SDV1"
+#define STDEV_STATE_SIZE  28
+
+static void stdevPutU64(unsigned char *z, uint64_t v){
+  int i;
+  for(i=0; i<8; i++){
+    z[i] = (unsigned char)(v & 0xff);
+    v >>= 8;
+  }
+}
+
+static uint64_t stdevGetU64(const unsigned char *z){
+  uint64_t v = 0;
+  int i;
+  for(i=7; i>=0; i--){
+    v = (v<<8) | z[i];
+  }
+  return v;
+}
+
+static void stdevPutDouble(unsigned char *z, double r){
+  uint64_t v;
+  assert( sizeof(v)==sizeof(r) );
+  memcpy(&v, &r, sizeof(v));
+  stdevPutU64(z, v);
+}
+
+static double stdevGetDouble(const unsigned char *z){
+  uint64_t v = stdevGetU64(z);
+  double r;
+  memcpy(&r, &v, sizeof(r));
+  return r;
+}
+
+/*
+** Returns the state of a stdev() or variance() computation as a blob
+*/
+static void stdevStateFinalize(sqlite3_context *context){
+  StdevCtx *p;
+  StdevCtx empty;
+  unsigned char z[STDEV_STATE_SIZE];
+
+  p = sqlite3_aggregate_context(context, 0);
+  if( p==0 ){
+    memset(&empty, 0, sizeof(empty));
+    p = &empty;
+  }
+  memcpy(z, STDEV_STATE_MAGIC, 4);
+  stdevPutU64(z+4, (uint64_t)p->cnt);
+  stdevPutDouble(z+12, p->rM);
+  stdevPutDouble(z+20, p->rS);
+  sqlite3_result_blob(context, z, sizeof(z), SQLITE_TRANSIENT);
+}
+
+/*
+** called for each state received during a stdev_merge(), variance_merge()
+** or stdev_state_merge() computation
+*/
+static void stdevMergeStep(sqlite3_context *context, int argc, sqlite3_value **argv){
+  StdevCtx *p;
+  const unsigned char *z;
+  i64 cnt;
+  double rM;
+  double rS;
+  double delta;
+  i64 total;
+
+  assert( argc==1 );
+  /* only consider non-null states */
+  if( sqlite3_value_type(argv[0])==SQLITE_NULL ){
+    return;
+  }
+  z = sqlite3_value_blob(argv[0]);
+  if( sqlite3_value_bytes(argv[0])!=STDEV_STATE_SIZE || memcmp(z, STDEV_STATE_MAGIC, 4)!=0 ){
+    sqlite3_result_error(context, "argument is not a stdev_state() value", -1);
+    return;
+  }
+  cnt = (i64)stdevGetU64(z+4);
+  rM = stdevGetDouble(z+12);
+  rS = stdevGetDouble(z+20);
+
+  p = sqlite3_aggregate_context(context, sizeof(*p));
+  if( p==0 || cnt<=0 ){
+    return;
+  }
+  total = p->cnt + cnt;
+  delta = rM - p->rM;
+  p->rM += delta*cnt/total;
+  p->rS += rS + delta*delta*((double)p->cnt*cnt/total);
+  p->cnt = total;
+}
+
 #ifdef SQLITE_SOUNDEX
 
 /* relicoder factored code */
@@ -1787,6 +2100,10 @@ int RegisterExtensionFunctions(sqlite3 *db){
   } aAggs[] = {
     { "stdev",            1, 0, 0, varianceStep, stdevFinalize  },
     { "variance",         1, 0, 0, varianceStep, varianceFinalize  },
+    { "stdev_state",      1, 0, 0, varianceStep, stdevStateFinalize  },
+    { "stdev_merge",      1, 0, 0, stdevMergeStep, stdevFinalize  },
+    { "variance_merge",   1, 0, 0, stdevMergeStep, varianceFinalize  },
+    { "stdev_state_merge", 1, 0, 0, stdevMergeStep, stdevStateFinalize  },
     { "mode",             1, 0, 0, modeStep,     modeFinalize  },
     { "median",           1, 0, 0, modeStep,     medianFinalize  },
     { "lower_quartile",   1, 0, 0, modeStep,     lower_quartileFinalize  },
@@ -0,0 +1,1328 @@
+/*
+** 2014-12-09
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+******************************************************************************
+**
+** This SQLite extension implements a read-only virtual table, named "csv",
+** over a file of comma-separated values (RFC 4180).  It is meant for bulk
+** imports:
+**
+**     CREATE VIRTUAL TABLE temp.t1 USING csv(filename='data.csv', header=1);
+**     INSERT INTO main.t2 SELECT * FROM temp.t1;
+**     DROP TABLE temp.t1;
+**
+** The arguments are:
+**
+**     filename=FILE     The file to read.  Required.
+**
+**     header=BOOLEAN    If true, the first record holds the column names.
+**                       Otherwise, the columns are named c1, c2, c3...
+**                       The default is false.
+**
+**     columns=N         The number of columns.  The default is the number
+**                       of fields in the first record.
+**
+**     separator=C       The field separator, a single character.  The
+**                       default is a comma.
+**
+**     threads=N         The number of worker threads.  The default, 0,
+**                       uses one per processor, up to CSV_MAX_THREADS.
+**                       With 1, or if the database connection has no
+**                       mutex (e.g. in single-thread mode), the file is
+**                       parsed on the calling thread.
+**
+**     chunksize=N       The approximate number of bytes of the file parsed
+**                       by a worker thread at a time.
+**
+** Unquoted fields that are integers or real numbers are returned as INTEGER
+** or REAL values, using the converters of the totype.c extension, and empty
+** unquoted fields are returned as NULL.  All other fields, including all
+** quoted fields, are returned as TEXT.  Missing fields are NULL, extra
+** fields are ignored, and empty lines are skipped.
+**
+** The file is memory-mapped and cut into chunks that begin just after a
+** newline.  While the rows of one chunk are being returned, worker threads
+** parse and convert the fields of the following ones.  The worker threads
+** are started once per scan and take the pending chunks in turn; a chunk
+** that no worker thread has taken yet when its rows are needed is parsed
+** by the calling thread instead.  The rows are always
+** returned in the order of the file.  A newline that starts a chunk may be
+** within a quoted field, which can only be known once the preceding chunk
+** has been parsed.  When that happens, the chunk is parsed again, from the
+** end of the last record of the preceding chunk, before its rows are
+** returned.
+**
+** This file uses the number converters of totype.c and must be compiled
+** after it, in the same translation unit, which also supplies the
+** SQLITE_EXTENSION_INIT1 declaration.
+*/
+#include "sqlite3ext.h"
+#include <string.h>
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <pthread.h>
+#endif
+
+/*
+** The maximum number of worker threads used by one cursor.
+*/
+#ifndef CSV_MAX_THREADS
+# define CSV_MAX_THREADS 8
+#endif
+
+/*
+** The default number of bytes in a chunk.
+*/
+#ifndef CSV_CHUNK_SIZE
+# define CSV_CHUNK_SIZE (1024*1024)
+#endif
+
+/*
+** The types of the parsed field values.
+*/
+#define CSV_NULL     0    /* Empty unquoted field */
+#define CSV_INTEGER  1    /* Value in CsvValue.u.i */
+#define CSV_FLOAT    2    /* Value in CsvValue.u.r */
+#define CSV_TEXT     3    /* Text in the file, at CsvValue.u.z */
+#define CSV_ESCAPED  4    /* Text in CsvChunk.aBuf[], at offset CsvValue.u.i */
+
+/*
+** The states of a chunk.
+*/
+#define CSV_CHUNK_DONE     0    /* Parsed, or not used */
+#define CSV_CHUNK_PENDING  1    /* To be parsed by whichever thread is first */
+#define CSV_CHUNK_RUNNING  2    /* Being parsed */
+
+typedef struct CsvValue CsvValue;
+typedef struct CsvChunk CsvChunk;
+typedef struct CsvPool CsvPool;
+typedef struct CsvMap CsvMap;
+typedef struct CsvTable CsvTable;
+typedef struct CsvCursor CsvCursor;
+
+/*
+** The value of one field.
+*/
+struct CsvValue {
+  union {
+    sqlite3_int64 i;            /* CSV_INTEGER value or CSV_ESCAPED offset */
+    double r;                   /* CSV_FLOAT value */
+    const char *z;              /* CSV_TEXT text */
+  } u;
+  int n;                        /* Bytes of CSV_TEXT or CSV_ESCAPED text */
+  int eType;                    /* One of the CSV_* types above */
+};
+
+/*
+** A chunk of the file.  The records that start at or after iStart and
+** before iEnd are parsed into aValue[], either by a worker thread or by
+** the cursor itself.  The eState field is protected by the mutex of the
+** CsvPool, if any.  Nothing else touches a chunk while it is being parsed.
+*/
+struct CsvChunk {
+  const char *zData;            /* The whole file */
+  sqlite3_int64 nData;          /* Size of the file in bytes */
+  int nCol;                     /* Number of columns */
+  char cSep;                    /* Field separator */
+  int eState;                   /* One of the CSV_CHUNK_* states above */
+  int rc;                       /* SQLITE_OK, SQLITE_NOMEM or SQLITE_TOOBIG */
+  sqlite3_int64 iStart;         /* Offset of the first record */
+  sqlite3_int64 iEnd;           /* Records here or later are not parsed */
+  sqlite3_int64 iStop;          /* Offset just past the last record parsed */
+  int nRow;                     /* Number of rows in aValue[] */
+  int nRowAlloc;                /* Number of rows allocated in aValue[] */
+  CsvValue *aValue;             /* nCol values for each row */
+  int nBuf;                     /* Bytes used in aBuf[] */
+  int nBufAlloc;                /* Bytes allocated for aBuf[] */
+  char *aBuf;                   /* Text of quoted fields with doubled quotes */
+};
+
+/*
+** The worker threads of a cursor.  They wait for the chunks of the cursor
+** to become CSV_CHUNK_PENDING and parse them.  If bMutex is false, there
+** are no worker threads and the mutex is not used.
+*/
+struct CsvPool {
+  int bMutex;                   /* True if the mutex and signals below exist */
+  int nThread;                  /* Number of worker threads */
+  int bStop;                    /* True to make the worker threads exit */
+#if defined(_WIN32)
+  CRITICAL_SECTION mutex;       /* Protects bStop and CsvChunk.eState */
+  HANDLE hWork;                 /* Semaphore released for each pending chunk */
+  HANDLE hDone;                 /* Event set whenever a chunk is parsed */
+  HANDLE aThread[CSV_MAX_THREADS];
+#else
+  pthread_mutex_t mutex;        /* Protects bStop and CsvChunk.eState */
+  pthread_cond_t work;          /* Signaled for each pending chunk */
+  pthread_cond_t done;          /* Signaled whenever a chunk is parsed */
+  pthread_t aThread[CSV_MAX_THREADS];
+#endif
+};
+
+/*
+** A read-only memory mapping of a file.
+*/
+struct CsvMap {
+  const char *zData;            /* Content of the file */
+  sqlite3_int64 nData;          /* Size of the file in bytes */
+#if defined(_WIN32)
+  HANDLE hFile;                 /* The open file */
+  HANDLE hMap;                  /* The file mapping object */
+#endif
+};
+
+/*
+** An instance of the csv virtual table.
+*/
+struct CsvTable {
+  sqlite3_vtab base;            /* Base class.  Must be first */
+  char *zFilename;              /* Name of the file */
+  int bHeader;                  /* True if the first record is a header */
+  int nCol;                     /* Number of columns */
+  char cSep;                    /* Field separator */
+  int nThread;                  /* Number of threads, 0 for the default */
+  int szChunk;                  /* Approximate bytes in a chunk */
+  sqlite3 *db;                  /* The database connection */
+};
+
+/*
+** A cursor for the csv virtual table.  Chunk number j is kept in
+** aChunk[j % nChunk].  While the rows of chunk iChunk are returned, the
+** chunks up to iChunk+nChunk-1 are being parsed.
+*/
+struct CsvCursor {
+  sqlite3_vtab_cursor base;     /* Base class.  Must be first */
+  CsvMap map;                   /* The file */
+  sqlite3_int64 iBody;          /* Offset of the first record after header */
+  CsvPool pool;                 /* The worker threads */
+  int nChunk;                   /* Number of entries in aChunk[] */
+  CsvChunk *aChunk;             /* Ring of chunks */
+  sqlite3_int64 iChunk;         /* Number of the chunk being returned */
+  int iRow;                     /* Row within the chunk being returned */
+  int bEof;                     /* True at the end of the file */
+  sqlite3_int64 iRowid;         /* The rowid of the current row */
+};
+
+/*
+** Open and map the file zFilename.  Return SQLITE_OK on success or
+** SQLITE_CANTOPEN if the file cannot be mapped.
+*/
+static int csvMapOpen(CsvMap *p, const char *zFilename){
+#if defined(_WIN32)
+  LARGE_INTEGER size;
+  LPWSTR zWide;
+  int nWide;
+#else
+  struct stat buf;
+  void *pData;
+  int fd;
+#endif
+
+  memset(p, 0, sizeof(*p));
+  p->zData = "";
+#if defined(_WIN32)
+  p->hFile = INVALID_HANDLE_VALUE;
+  nWide = MultiByteToWideChar(CP_UTF8, 0, zFilename, -1, NULL, 0);
+  if( nWide<=0 ) return SQLITE_CANTOPEN;
+  zWide = sqlite3_malloc( nWide*sizeof(WCHAR) );
+  if( zWide==0 ) return SQLITE_NOMEM;
+  MultiByteToWideChar(CP_UTF8, 0, zFilename, -1, zWide, nWide);
+#if defined(_WIN32_WCE)
+  p->hFile = CreateFileForMappingW(zWide, GENERIC_READ, FILE_SHARE_READ,
+                                   NULL, OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+  p->hFile = CreateFileW(zWide, GENERIC_READ, FILE_SHARE_READ, NULL,
+                         OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+#endif
+  sqlite3_free(zWide);
+  if( p->hFile==INVALID_HANDLE_VALUE ) return SQLITE_CANTOPEN;
+  size.LowPart = GetFileSize(p->hFile, (LPDWORD)&size.HighPart);
+  if( size.LowPart==INVALID_FILE_SIZE && GetLastError()!=NO_ERROR ){
+    CloseHandle(p->hFile);
+    p->hFile = INVALID_HANDLE_VALUE;
+    return SQLITE_CANTOPEN;
+  }
+  if( size.QuadPart==0 ) return SQLITE_OK;
+  if( (sqlite3_uint64)size.QuadPart>(SIZE_T)-1 ){
+    CloseHandle(p->hFile);
+    p->hFile = INVALID_HANDLE_VALUE;
+    return SQLITE_TOOBIG;
+  }
+  p->hMap = CreateFileMappingW(p->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+  if( p->hMap!=NULL ){
+    p->zData = (const char *)MapViewOfFile(p->hMap, FILE_MAP_READ, 0, 0, 0);
+  }
+  if( p->zData==0 ){
+    if( p->hMap!=NULL ) CloseHandle(p->hMap);
+    CloseHandle(p->hFile);
+    memset(p, 0, sizeof(*p));
+    p->zData = "";
+    p->hFile = INVALID_HANDLE_VALUE;
+    return SQLITE_CANTOPEN;
+  }
+  p->nData = size.QuadPart;
+#else
+  fd = open(zFilename, O_RDONLY);
+  if( fd<0 ) return SQLITE_CANTOPEN;
+  if( fstat(fd, &buf)!=0 ){
+    close(fd);
+    return SQLITE_CANTOPEN;
+  }
+  if( buf.st_size==0 ){
+    close(fd);
+    return SQLITE_OK;
+  }
+  if( (sqlite3_uint64)buf.st_size>(size_t)-1 ){
+    close(fd);
+    return SQLITE_TOOBIG;
+  }
+  pData = mmap(0, (size_t)buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if( pData==MAP_FAILED ) return SQLITE_CANTOPEN;
+#if defined(MADV_SEQUENTIAL)
+  madvise(pData, (size_t)buf.st_size, MADV_SEQUENTIAL);
+#endif
+  p->zData = (const char *)pData;
+  p->nData = buf.st_size;
+#endif
+  return SQLITE_OK;
+}
+
+/*
+** Unmap and close a file opened by csvMapOpen().  It is harmless to call
+** this more than once.
+*/
+static void csvMapClose(CsvMap *p){
+#if defined(_WIN32)
+  if( p->nData>0 ) UnmapViewOfFile((LPCVOID)p->zData);
+  if( p->hMap!=NULL ) CloseHandle(p->hMap);
+  if( p->hFile!=INVALID_HANDLE_VALUE ) CloseHandle(p->hFile);
+  p->hMap = NULL;
+  p->hFile = INVALID_HANDLE_VALUE;
+#else
+  if( p->nData>0 ) munmap((void *)p->zData, (size_t)p->nData);
+#endif
+  p->zData = "";
+  p->nData = 0;
+}
+
+/*
+** Return the offset of the first record of the file, after any UTF-8
+** byte-order mark and empty lines.
+*/
+static sqlite3_int64 csvFirstRecord(const CsvMap *p){
+  const unsigned char *z = (const unsigned char *)p->zData;
+  sqlite3_int64 i = 0;
+  if( p->nData>=3 && z[0]==0xEF && z[1]==0xBB && z[2]==0xBF ) i = 3;
+  while( i<p->nData && (z[i]=='\n' || z[i]=='\r') ) i++;
+  return i;
+}
+
+/*
+** Make sure aBuf[] of chunk p has room for n more bytes.  Return
+** SQLITE_OK, or set p->rc and return an error code.
+*/
+static int csvGrowBuf(CsvChunk *p, sqlite3_int64 n){
+  sqlite3_int64 nNew;
+  char *aNew;
+  if( p->nBuf+n<=p->nBufAlloc ) return SQLITE_OK;
+  nNew = p->nBufAlloc ? 2*(sqlite3_int64)p->nBufAlloc : 4096;
+  while( nNew<p->nBuf+n ) nNew *= 2;
+  if( nNew>0x7fffffff ) return p->rc = SQLITE_TOOBIG;
+  aNew = sqlite3_realloc(p->aBuf, (int)nNew);
+  if( aNew==0 ) return p->rc = SQLITE_NOMEM;
+  p->aBuf = aNew;
+  p->nBufAlloc = (int)nNew;
+  return SQLITE_OK;
+}
+
+/*
+** Make sure aValue[] of chunk p has room for one more row.  Return
+** SQLITE_OK, or set p->rc and return an error code.
+*/
+static int csvGrowRows(CsvChunk *p){
+  sqlite3_int64 nNew;
+  CsvValue *aNew;
+  if( p->nRow<p->nRowAlloc ) return SQLITE_OK;
+  nNew = p->nRowAlloc ? 2*(sqlite3_int64)p->nRowAlloc : 256;
+  if( nNew*p->nCol*sizeof(CsvValue)>0x7fffffff ) return p->rc = SQLITE_TOOBIG;
+  aNew = sqlite3_realloc(p->aValue, (int)(nNew*p->nCol*sizeof(CsvValue)));
+  if( aNew==0 ) return p->rc = SQLITE_NOMEM;
+  p->aValue = aNew;
+  p->nRowAlloc = (int)nNew;
+  return SQLITE_OK;
+}
+
+/*
+** Read the field that starts at offset *piOff of the file.  Set *pz and
+** *pn to its text, without the quotes.  If a quoted field contains doubled
+** quotes, the text is unescaped at the end of p->aBuf[] and *pz is set to
+** NULL.  Set *pbQuoted if the field was quoted.  Move *piOff past the
+** separator or the end of the line that follows the field and return
+** true if it was the last field of the record.
+**
+** Text between the closing quote of a field and the next separator is
+** ignored.  A quoted field without a closing quote runs to the end of the
+** file.  On an error, p->rc is set and the field is empty.
+*/
+static int csvReadField(
+  CsvChunk *p,
+  sqlite3_int64 *piOff,
+  const char **pz,
+  sqlite3_int64 *pn,
+  int *pbQuoted
+){
+  const char *z = p->zData;
+  sqlite3_int64 n = p->nData;
+  sqlite3_int64 i = *piOff;
+  sqlite3_int64 j;
+  char cSep = p->cSep;
+
+  *pbQuoted = 0;
+  if( i<n && z[i]=='"' ){
+    int nEscape = 0;
+    const char *zQuote;
+    *pbQuoted = 1;
+    i++;
+    for(j=i; j<n; j+=2){
+      zQuote = (const char *)memchr(&z[j], '"', (size_t)(n-j));
+      if( zQuote==0 ){
+        j = n;
+        break;
+      }
+      j = zQuote - z;
+      if( j+1>=n || z[j+1]!='"' ) break;
+      nEscape++;
+    }
+    *pz = &z[i];
+    *pn = j-i;
+    if( nEscape>0 ){
+      sqlite3_int64 k;
+      char *zOut;
+      if( csvGrowBuf(p, j-i-nEscape) ){
+        *pn = 0;
+      }else{
+        zOut = &p->aBuf[p->nBuf];
+        for(k=i; k<j; k++){
+          *(zOut++) = z[k];
+          if( z[k]=='"' ) k++;
+        }
+        *pz = 0;
+        *pn = j-i-nEscape;
+        p->nBuf += (int)*pn;
+      }
+    }
+    while( j<n && z[j]!=cSep && z[j]!='\n' ) j++;
+  }else{
+    sqlite3_int64 e;
+    for(j=i; j<n && z[j]!=cSep && z[j]!='\n'; j++){}
+    e = j;
+    if( e>i && z[e-1]=='\r' && (j>=n || z[j]=='\n') ) e--;
+    *pz = &z[i];
+    *pn = e-i;
+  }
+  if( *pn>0x7fffffff ){
+    p->rc = SQLITE_TOOBIG;
+    *pn = 0;
+  }
+  if( j<n && z[j]==cSep ){
+    *piOff = j+1;
+    return 0;
+  }
+  *piOff = j<n ? j+1 : n;
+  return 1;
+}
+
+/*
+** Return CSV_INTEGER if the n bytes at z are an integer, CSV_FLOAT if
+** they are a real number, and CSV_TEXT otherwise.  Only the canonical
+** forms are numbers, so that text such as " 1", "+1", "1." or "007" is
+** kept as it is.
+*/
+static int csvNumberType(const char *z, sqlite3_int64 n){
+  sqlite3_int64 i = 0;
+  int eType = CSV_INTEGER;
+  if( z[0]=='-' ) i++;
+  if( i>=n || !totypeIsdigit(z[i]) ) return CSV_TEXT;
+  if( z[i]=='0' && i+1<n && totypeIsdigit(z[i+1]) ) return CSV_TEXT;
+  while( i<n && totypeIsdigit(z[i]) ) i++;
+  if( i<n && z[i]=='.' ){
+    i++;
+    if( i>=n || !totypeIsdigit(z[i]) ) return CSV_TEXT;
+    while( i<n && totypeIsdigit(z[i]) ) i++;
+    eType = CSV_FLOAT;
+  }
+  if( i<n && (z[i]=='e' || z[i]=='E') ){
+    i++;
+    if( i<n && (z[i]=='-' || z[i]=='+') ) i++;
+    if( i>=n || !totypeIsdigit(z[i]) ) return CSV_TEXT;
+    while( i<n && totypeIsdigit(z[i]) ) i++;
+    eType = CSV_FLOAT;
+  }
+  return i==n ? eType : CSV_TEXT;
+}
+
+/*
+** Set *pVal to the value of a field read by csvReadField().
+*/
+static void csvSetValue(
+  CsvChunk *p,
+  CsvValue *pVal,
+  const char *z,
+  sqlite3_int64 n,
+  int bQuoted
+){
+  if( z==0 ){
+    pVal->eType = CSV_ESCAPED;
+    pVal->u.i = p->nBuf - n;
+    pVal->n = (int)n;
+    return;
+  }
+  if( !bQuoted ){
+    if( n==0 ){
+      pVal->eType = CSV_NULL;
+      return;
+    }
+    switch( csvNumberType(z, n) ){
+      case CSV_INTEGER: {
+        if( totypeAtoi64(z, &pVal->u.i, (int)n)==0 ){
+          pVal->eType = CSV_INTEGER;
+          return;
+        }
+        /* Too large for an integer */
+      }
+      /* fall through */
+      case CSV_FLOAT: {
+        if( totypeAtoF(z, &pVal->u.r, (int)n) ){
+          pVal->eType = CSV_FLOAT;
+          return;
+        }
+        break;
+      }
+    }
+  }
+  pVal->eType = CSV_TEXT;
+  pVal->u.z = z;
+  pVal->n = (int)n;
+}
+
+/*
+** Parse the records of chunk p that start before p->iEnd and set p->iStop
+** to the offset just past the last one.
+*/
+static void csvParseChunk(CsvChunk *p){
+  const char *z = p->zData;
+  sqlite3_int64 i = p->iStart;
+
+  p->nRow = 0;
+  p->nBuf = 0;
+  p->rc = SQLITE_OK;
+  while( i<p->iEnd && p->rc==SQLITE_OK ){
+    CsvValue *aRow;
+    const char *zField;
+    sqlite3_int64 nField;
+    int bQuoted;
+    int bLast = 0;
+    int iCol = 0;
+
+    if( z[i]=='\n' ){
+      i++;
+      continue;
+    }
+    if( z[i]=='\r' && (i+1>=p->nData || z[i+1]=='\n') ){
+      i += 2;
+      continue;
+    }
+    if( csvGrowRows(p) ) break;
+    aRow = &p->aValue[p->nRow*p->nCol];
+    while( !bLast ){
+      bLast = csvReadField(p, &i, &zField, &nField, &bQuoted);
+      if( iCol<p->nCol ){
+        csvSetValue(p, &aRow[iCol], zField, nField, bQuoted);
+      }else if( zField==0 ){
+        p->nBuf -= (int)nField;
+      }
+      iCol++;
+    }
+    for(; iCol<p->nCol; iCol++) aRow[iCol].eType = CSV_NULL;
+    p->nRow++;
+  }
+  if( i>p->nData ) i = p->nData;
+  p->iStop = i;
+}
+
+/*
+** Enter and leave the mutex of pool p, if it has worker threads.
+*/
+static void csvPoolEnter(CsvPool *p){
+  if( !p->bMutex ) return;
+#if defined(_WIN32)
+  EnterCriticalSection(&p->mutex);
+#else
+  pthread_mutex_lock(&p->mutex);
+#endif
+}
+static void csvPoolLeave(CsvPool *p){
+  if( !p->bMutex ) return;
+#if defined(_WIN32)
+  LeaveCriticalSection(&p->mutex);
+#else
+  pthread_mutex_unlock(&p->mutex);
+#endif
+}
+
+/*
+** Wait, with the mutex of pool p held, until a chunk may have become
+** pending (csvPoolWaitWork) or may have been parsed (csvPoolWaitDone).
+** Only the cursor thread waits for a chunk to be parsed.
+*/
+static void csvPoolWaitWork(CsvPool *p){
+#if defined(_WIN32)
+  LeaveCriticalSection(&p->mutex);
+  WaitForSingleObject(p->hWork, INFINITE);
+  EnterCriticalSection(&p->mutex);
+#else
+  pthread_cond_wait(&p->work, &p->mutex);
+#endif
+}
+static void csvPoolWaitDone(CsvPool *p){
+#if defined(_WIN32)
+  ResetEvent(p->hDone);
+  LeaveCriticalSection(&p->mutex);
+  WaitForSingleObject(p->hDone, INFINITE);
+  EnterCriticalSection(&p->mutex);
+#else
+  pthread_cond_wait(&p->done, &p->mutex);
+#endif
+}
+
+/*
+** Return the pending chunk of cursor pCur that starts first, or NULL if
+** there is none.  The mutex of its pool must be held.
+*/
+static CsvChunk *csvPoolNext(CsvCursor *pCur){
+  CsvChunk *pBest = 0;
+  int i;
+  for(i=0; i<pCur->nChunk; i++){
+    CsvChunk *p = &pCur->aChunk[i];
+    if( p->eState==CSV_CHUNK_PENDING && (pBest==0 || p->iStart<pBest->iStart) ){
+      pBest = p;
+    }
+  }
+  return pBest;
+}
+
+/*
+** The body of a worker thread of cursor pCur.  Parse the pending chunks
+** until told to stop.
+*/
+static void csvPoolWork(CsvCursor *pCur){
+  CsvPool *pPool = &pCur->pool;
+  csvPoolEnter(pPool);
+  while( !pPool->bStop ){
+    CsvChunk *p = csvPoolNext(pCur);
+    if( p==0 ){
+      csvPoolWaitWork(pPool);
+      continue;
+    }
+    p->eState = CSV_CHUNK_RUNNING;
+    csvPoolLeave(pPool);
+    csvParseChunk(p);
+    csvPoolEnter(pPool);
+    p->eState = CSV_CHUNK_DONE;
+#if defined(_WIN32)
+    SetEvent(pPool->hDone);
+#else
+    pthread_cond_signal(&pPool->done);
+#endif
+  }
+  csvPoolLeave(pPool);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI csvThreadMain(LPVOID pArg){
+  csvPoolWork((CsvCursor *)pArg);
+  return 0;
+}
+#else
+static void *csvThreadMain(void *pArg){
+  csvPoolWork((CsvCursor *)pArg);
+  return 0;
+}
+#endif
+
+/*
+** Start up to nThread worker threads for cursor pCur, which must not have
+** any yet.  If none can be started, the chunks are parsed by the cursor
+** thread.
+*/
+static void csvPoolStart(CsvCursor *pCur, int nThread){
+  CsvPool *p = &pCur->pool;
+  int i;
+
+  memset(p, 0, sizeof(*p));
+  if( nThread<=0 ) return;
+#if defined(_WIN32)
+  p->hWork = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+  p->hDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+  if( p->hWork==NULL || p->hDone==NULL ){
+    if( p->hWork!=NULL ) CloseHandle(p->hWork);
+    if( p->hDone!=NULL ) CloseHandle(p->hDone);
+    return;
+  }
+  InitializeCriticalSection(&p->mutex);
+  p->bMutex = 1;
+  for(i=0; i<nThread; i++){
+    p->aThread[p->nThread] = CreateThread(NULL, 0, csvThreadMain, pCur, 0,
+                                          NULL);
+    if( p->aThread[p->nThread]!=NULL ) p->nThread++;
+  }
+  if( p->nThread==0 ){
+    DeleteCriticalSection(&p->mutex);
+    CloseHandle(p->hWork);
+    CloseHandle(p->hDone);
+    p->bMutex = 0;
+  }
+#else
+  if( pthread_mutex_init(&p->mutex, 0)!=0 ) return;
+  if( pthread_cond_init(&p->work, 0)!=0 ){
+    pthread_mutex_destroy(&p->mutex);
+    return;
+  }
+  if( pthread_cond_init(&p->done, 0)!=0 ){
+    pthread_cond_destroy(&p->work);
+    pthread_mutex_destroy(&p->mutex);
+    return;
+  }
+  p->bMutex = 1;
+  for(i=0; i<nThread; i++){
+    if( pthread_create(&p->aThread[p->nThread], 0, csvThreadMain, pCur)==0 ){
+      p->nThread++;
+    }
+  }
+  if( p->nThread==0 ){
+    pthread_cond_destroy(&p->done);
+    pthread_cond_destroy(&p->work);
+    pthread_mutex_destroy(&p->mutex);
+    p->bMutex = 0;
+  }
+#endif
+}
+
+/*
+** Stop the worker threads of cursor pCur, if any, and wait for them to
+** exit.  A worker thread finishes the chunk it is parsing first.
+*/
+static void csvPoolStop(CsvCursor *pCur){
+  CsvPool *p = &pCur->pool;
+  int i;
+
+  if( p->nThread==0 ) return;
+  csvPoolEnter(p);
+  p->bStop = 1;
+#if defined(_WIN32)
+  ReleaseSemaphore(p->hWork, p->nThread, NULL);
+#else
+  pthread_cond_broadcast(&p->work);
+#endif
+  csvPoolLeave(p);
+  for(i=0; i<p->nThread; i++){
+#if defined(_WIN32)
+    WaitForSingleObject(p->aThread[i], INFINITE);
+    CloseHandle(p->aThread[i]);
+#else
+    pthread_join(p->aThread[i], 0);
+#endif
+  }
+#if defined(_WIN32)
+  DeleteCriticalSection(&p->mutex);
+  CloseHandle(p->hWork);
+  CloseHandle(p->hDone);
+#else
+  pthread_cond_destroy(&p->done);
+  pthread_cond_destroy(&p->work);
+  pthread_mutex_destroy(&p->mutex);
+#endif
+  memset(p, 0, sizeof(*p));
+}
+
+/*
+** Make chunk p of cursor pCur pending, for a worker thread to parse, or
+** else to be parsed when csvChunkWait() is called.
+*/
+static void csvChunkStart(CsvCursor *pCur, CsvChunk *p){
+  CsvPool *pPool = &pCur->pool;
+  csvPoolEnter(pPool);
+  p->eState = CSV_CHUNK_PENDING;
+  if( pPool->bMutex ){
+#if defined(_WIN32)
+    ReleaseSemaphore(pPool->hWork, 1, NULL);
+#else
+    pthread_cond_signal(&pPool->work);
+#endif
+  }
+  csvPoolLeave(pPool);
+}
+
+/*
+** Wait for the worker thread parsing chunk p of cursor pCur, if any.  If
+** no thread has taken the chunk yet, parse it now, unless bSkip is true.
+*/
+static void csvChunkWait(CsvCursor *pCur, CsvChunk *p, int bSkip){
+  CsvPool *pPool = &pCur->pool;
+  csvPoolEnter(pPool);
+  while( p->eState==CSV_CHUNK_RUNNING ) csvPoolWaitDone(pPool);
+  if( p->eState==CSV_CHUNK_PENDING && !bSkip ){
+    p->eState = CSV_CHUNK_RUNNING;
+    csvPoolLeave(pPool);
+    csvParseChunk(p);
+    csvPoolEnter(pPool);
+  }
+  p->eState = CSV_CHUNK_DONE;
+  csvPoolLeave(pPool);
+}
+
+/*
+** Return the offset at which chunk number j is expected to start, which
+** is just after the first newline of the j-th block of szChunk bytes.
+** Return the size of the file if there is no such chunk.
+*/
+static sqlite3_int64 csvChunkOffset(CsvCursor *pCur, sqlite3_int64 j){
+  CsvTable *pTab = (CsvTable *)pCur->base.pVtab;
+  sqlite3_int64 i;
+  const char *zEol;
+  if( j==0 ) return pCur->iBody;
+  i = pCur->iBody + j*pTab->szChunk - 1;
+  if( i>=pCur->map.nData ) return pCur->map.nData;
+  zEol = (const char *)memchr(&pCur->map.zData[i], '\n',
+                              (size_t)(pCur->map.nData-i));
+  return zEol ? (zEol - pCur->map.zData) + 1 : pCur->map.nData;
+}
+
+/*
+** Start parsing chunk number j into its entry of the ring.  The chunk
+** previously held by that entry must have been waited for.
+*/
+static void csvChunkLaunch(CsvCursor *pCur, sqlite3_int64 j){
+  CsvChunk *p = &pCur->aChunk[j % pCur->nChunk];
+  p->iStart = csvChunkOffset(pCur, j);
+  if( p->iStart>=pCur->map.nData ){
+    p->iStart = p->iEnd = p->iStop = pCur->map.nData;
+    p->nRow = 0;
+    p->rc = SQLITE_OK;
+    p->eState = CSV_CHUNK_DONE;
+    return;
+  }
+  p->iEnd = csvChunkOffset(pCur, j+1);
+  csvChunkStart(pCur, p);
+}
+
+/*
+** Stop the worker threads of cursor pCur and release the chunks and the
+** file.
+*/
+static void csvCursorReset(CsvCursor *pCur){
+  int i;
+  csvPoolStop(pCur);
+  for(i=0; i<pCur->nChunk; i++){
+    sqlite3_free(pCur->aChunk[i].aValue);
+    sqlite3_free(pCur->aChunk[i].aBuf);
+  }
+  sqlite3_free(pCur->aChunk);
+  pCur->aChunk = 0;
+  pCur->nChunk = 0;
+  csvMapClose(&pCur->map);
+}
+
+/*
+** Return the number of worker threads to use by default.
+*/
+static int csvDefaultThreads(void){
+  int n;
+#if defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  n = (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+  n = 1;
+#endif
+  return n<1 ? 1 : n;
+}
+
+/*
+** Return a copy of the value of argument zArg, obtained from
+** sqlite3_malloc(), if it is "zKey=VALUE".  Return NULL otherwise.
+** Surrounding white space and quotes are removed from the value.
+*/
+static char *csvParameter(const char *zArg, const char *zKey){
+  int nKey = (int)strlen(zKey);
+  int n;
+  char *zValue;
+  char cQuote;
+  while( totypeIsspace(*zArg) ) zArg++;
+  if( sqlite3_strnicmp(zArg, zKey, nKey)!=0 ) return 0;
+  zArg += nKey;
+  while( totypeIsspace(*zArg) ) zArg++;
+  if( *zArg!='=' ) return 0;
+  zArg++;
+  while( totypeIsspace(*zArg) ) zArg++;
+  n = (int)strlen(zArg);
+  while( n>0 && totypeIsspace(zArg[n-1]) ) n--;
+  zValue = sqlite3_mprintf("%.*s", n, zArg);
+  if( zValue==0 ) return 0;
+  cQuote = zValue[0];
+  if( n>=2 && (cQuote=='\'' || cQuote=='"' || cQuote=='`')
+   && zValue[n-1]==cQuote ){
+    int i, j;
+    for(i=1, j=0; i<n-1; i++){
+      zValue[j++] = zValue[i];
+      if( zValue[i]==cQuote ) i++;
+    }
+    zValue[j] = 0;
+  }
+  return zValue;
+}
+
+/*
+** Return the value of boolean or integer parameter z.
+*/
+static int csvParameterInt(const char *z){
+  sqlite3_int64 v;
+  if( sqlite3_stricmp(z, "true")==0 || sqlite3_stricmp(z, "yes")==0
+   || sqlite3_stricmp(z, "on")==0 ){
+    return 1;
+  }
+  if( sqlite3_stricmp(z, "false")==0 || sqlite3_stricmp(z, "no")==0
+   || sqlite3_stricmp(z, "off")==0 ){
+    return 0;
+  }
+  if( totypeAtoi64(z, &v, (int)strlen(z))!=0 || v<0 || v>0x7fffffff ){
+    return -1;
+  }
+  return (int)v;
+}
+
+/*
+** This method is the destructor for CsvTable objects.
+*/
+static int csvDisconnect(sqlite3_vtab *pVtab){
+  CsvTable *pTab = (CsvTable *)pVtab;
+  sqlite3_free(pTab->zFilename);
+  sqlite3_free(pTab);
+  return SQLITE_OK;
+}
+
+/*
+** The csvConnect() method is invoked to create a new csv virtual table,
+** which has no persistent state, so it is also the xCreate method.
+**
+** argv[0]   -> module name  ("csv")
+** argv[1]   -> database name
+** argv[2]   -> table name
+** argv[3].. -> the arguments described at the top of this file
+*/
+static int csvConnect(
+  sqlite3 *db,
+  void *pAux,
+  int argc,
+  const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pzErr
+){
+  CsvTable *pTab;
+  CsvChunk header;
+  CsvMap map;
+  char *zSql = 0;
+  sqlite3_int64 iOff;
+  int bLast;
+  int i;
+  int rc;
+
+  (void)pAux;
+  pTab = sqlite3_malloc( sizeof(*pTab) );
+  if( pTab==0 ) return SQLITE_NOMEM;
+  memset(pTab, 0, sizeof(*pTab));
+  pTab->nCol = -1;
+  pTab->cSep = ',';
+  pTab->szChunk = CSV_CHUNK_SIZE;
+  pTab->db = db;
+  for(i=3; i<argc; i++){
+    static const char *azKey[] = {
+      "filename", "header", "columns", "separator", "threads", "chunksize"
+    };
+    char *zValue = 0;
+    int iKey;
+    int v = 0;
+    for(iKey=0; iKey<(int)(sizeof(azKey)/sizeof(azKey[0])); iKey++){
+      zValue = csvParameter(argv[i], azKey[iKey]);
+      if( zValue ) break;
+    }
+    if( zValue==0 ){
+      *pzErr = sqlite3_mprintf("csv: unknown argument: %s", argv[i]);
+      csvDisconnect(&pTab->base);
+      return SQLITE_ERROR;
+    }
+    if( iKey>0 && iKey!=3 ){
+      v = csvParameterInt(zValue);
+      if( v<0 || (iKey==5 && v==0) ){
+        *pzErr = sqlite3_mprintf("csv: bad %s: %s", azKey[iKey], zValue);
+        sqlite3_free(zValue);
+        csvDisconnect(&pTab->base);
+        return SQLITE_ERROR;
+      }
+    }
+    switch( iKey ){
+      case 0: {
+        sqlite3_free(pTab->zFilename);
+        pTab->zFilename = zValue;
+        zValue = 0;
+        break;
+      }
+      case 1: pTab->bHeader = v!=0;  break;
+      case 2: pTab->nCol = v;        break;
+      case 3: {
+        if( strlen(zValue)!=1 || zValue[0]=='"' || zValue[0]=='\n'
+         || zValue[0]=='\r' ){
+          *pzErr = sqlite3_mprintf("csv: bad separator: %s", zValue);
+          sqlite3_free(zValue);
+          csvDisconnect(&pTab->base);
+          return SQLITE_ERROR;
+        }
+        pTab->cSep = zValue[0];
+        break;
+      }
+      case 4: pTab->nThread = v;     break;
+      case 5: pTab->szChunk = v;     break;
+    }
+    sqlite3_free(zValue);
+  }
+  if( pTab->zFilename==0 ){
+    *pzErr = sqlite3_mprintf("csv: no filename");
+    csvDisconnect(&pTab->base);
+    return SQLITE_ERROR;
+  }
+
+  /* Read the first record for the column names or the number of columns. */
+  memset(&header, 0, sizeof(header));
+  memset(&map, 0, sizeof(map));
+  map.zData = "";
+  if( pTab->bHeader || pTab->nCol<0 ){
+    rc = csvMapOpen(&map, pTab->zFilename);
+    if( rc!=SQLITE_OK ){
+      *pzErr = sqlite3_mprintf("csv: cannot open %s", pTab->zFilename);
+      csvDisconnect(&pTab->base);
+      return rc==SQLITE_CANTOPEN ? SQLITE_ERROR : rc;
+    }
+    header.zData = map.zData;
+    header.nData = map.nData;
+    header.cSep = pTab->cSep;
+  }
+  zSql = sqlite3_mprintf("CREATE TABLE x(");
+  iOff = csvFirstRecord(&map);
+  bLast = iOff>=map.nData;
+  for(i=0; zSql && (!bLast || i<pTab->nCol); i++){
+    const char *zField = 0;
+    sqlite3_int64 nField = 0;
+    int bQuoted;
+    if( !bLast ){
+      bLast = csvReadField(&header, &iOff, &zField, &nField, &bQuoted);
+      if( zField==0 ) zField = &header.aBuf[header.nBuf - nField];
+      if( pTab->nCol>=0 && i>=pTab->nCol ) continue;
+      if( !pTab->bHeader ) nField = 0;
+    }
+    if( nField>0 ){
+      char *zName = sqlite3_mprintf("%.*s", (int)nField, zField);
+      if( zName ){
+        zSql = sqlite3_mprintf("%z%s\"%w\"", zSql, i>0 ? "," : "", zName);
+        sqlite3_free(zName);
+      }else{
+        sqlite3_free(zSql);
+        zSql = 0;
+      }
+    }else{
+      zSql = sqlite3_mprintf("%z%s\"c%d\"", zSql, i>0 ? "," : "", i+1);
+    }
+  }
+  if( pTab->nCol<0 ) pTab->nCol = i;
+  if( pTab->nCol==0 ){
+    pTab->nCol = 1;
+    zSql = sqlite3_mprintf("%z\"c1\"", zSql);
+  }
+  zSql = sqlite3_mprintf("%z)", zSql);
+  rc = header.rc;
+  sqlite3_free(header.aBuf);
+  if( header.zData ) csvMapClose(&map);
+  if( zSql==0 ) rc = SQLITE_NOMEM;
+  if( rc==SQLITE_OK ) rc = sqlite3_declare_vtab(db, zSql);
+  sqlite3_free(zSql);
+  if( rc!=SQLITE_OK ){
+    csvDisconnect(&pTab->base);
+    return rc;
+  }
+  *ppVtab = &pTab->base;
+  return SQLITE_OK;
+}
+
+/*
+** There are no constraints to use, so every query is a full scan of the
+** file.
+*/
+static int csvBestIndex(sqlite3_vtab *pVtab, sqlite3_index_info *pInfo){
+  (void)pVtab;
+  pInfo->estimatedCost = 1000000.0;
+  return SQLITE_OK;
+}
+
+/*
+** Constructor for a new CsvCursor object.
+*/
+static int csvOpen(sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor){
+  CsvCursor *pCur;
+  (void)pVtab;
+  pCur = sqlite3_malloc( sizeof(*pCur) );
+  if( pCur==0 ) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pCur->map.zData = "";
+#if defined(_WIN32)
+  pCur->map.hFile = INVALID_HANDLE_VALUE;
+#endif
+  pCur->bEof = 1;
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+/*
+** Destructor for a CsvCursor.
+*/
+static int csvClose(sqlite3_vtab_cursor *cur){
+  CsvCursor *pCur = (CsvCursor *)cur;
+  csvCursorReset(pCur);
+  sqlite3_free(pCur);
+  return SQLITE_OK;
+}
+
+/*
+** Move to the next chunk that has rows, launching the parse of a later
+** chunk into the ring entry that is no longer needed.
+*/
+static int csvNextChunk(CsvCursor *pCur){
+  do{
+    CsvChunk *p = &pCur->aChunk[pCur->iChunk % pCur->nChunk];
+    sqlite3_int64 iStop = p->iStop;
+    csvChunkLaunch(pCur, pCur->iChunk + pCur->nChunk);
+    pCur->iChunk++;
+    pCur->iRow = 0;
+    if( iStop>=pCur->map.nData ){
+      pCur->bEof = 1;
+      return SQLITE_OK;
+    }
+    p = &pCur->aChunk[pCur->iChunk % pCur->nChunk];
+    csvChunkWait(pCur, p, 0);
+    if( p->iStart!=iStop ){
+      /* The chunk was cut within a record.  Parse it again. */
+      p->iStart = iStop;
+      csvParseChunk(p);
+    }
+    if( p->rc!=SQLITE_OK ) return p->rc;
+  }while( pCur->aChunk[pCur->iChunk % pCur->nChunk].nRow==0 );
+  return SQLITE_OK;
+}
+
+/*
+** Advance a CsvCursor to its next row of output.
+*/
+static int csvNext(sqlite3_vtab_cursor *cur){
+  CsvCursor *pCur = (CsvCursor *)cur;
+  pCur->iRowid++;
+  pCur->iRow++;
+  if( pCur->iRow<pCur->aChunk[pCur->iChunk % pCur->nChunk].nRow ){
+    return SQLITE_OK;
+  }
+  return csvNextChunk(pCur);
+}
+
+/*
+** Open the file, skip its header, and start parsing the first chunks.
+*/
+static int csvFilter(
+  sqlite3_vtab_cursor *cur,
+  int idxNum, const char *idxStr,
+  int argc, sqlite3_value **argv
+){
+  CsvCursor *pCur = (CsvCursor *)cur;
+  CsvTable *pTab = (CsvTable *)cur->pVtab;
+  int nThread = pTab->nThread;
+  CsvChunk *p;
+  sqlite3_int64 j;
+  int rc;
+
+  (void)idxNum;
+  (void)idxStr;
+  (void)argc;
+  (void)argv;
+  csvCursorReset(pCur);
+  pCur->bEof = 1;
+  pCur->iRowid = 0;
+  pCur->iChunk = 0;
+  pCur->iRow = -1;
+  rc = csvMapOpen(&pCur->map, pTab->zFilename);
+  if( rc!=SQLITE_OK ){
+    if( rc==SQLITE_CANTOPEN ){
+      sqlite3_free(pTab->base.zErrMsg);
+      pTab->base.zErrMsg = sqlite3_mprintf("csv: cannot open %s",
+                                           pTab->zFilename);
+      rc = SQLITE_ERROR;
+    }
+    return rc;
+  }
+  if( nThread==0 ) nThread = csvDefaultThreads();
+  if( nThread>CSV_MAX_THREADS ) nThread = CSV_MAX_THREADS;
+
+  /* The worker threads use the memory allocator of SQLite, which is only
+  ** safe if the library was built and configured for threads.  A connection
+  ** has no mutex in single-thread mode, so take that as the runtime check.
+  */
+  if( !sqlite3_threadsafe() || sqlite3_db_mutex(pTab->db)==0 ) nThread = 1;
+  pCur->nChunk = nThread>1 ? nThread+1 : 1;
+  pCur->aChunk = sqlite3_malloc( pCur->nChunk*sizeof(CsvChunk) );
+  if( pCur->aChunk==0 ){
+    pCur->nChunk = 0;
+    return SQLITE_NOMEM;
+  }
+  memset(pCur->aChunk, 0, pCur->nChunk*sizeof(CsvChunk));
+  for(j=0; j<pCur->nChunk; j++){
+    p = &pCur->aChunk[j];
+    p->zData = pCur->map.zData;
+    p->nData = pCur->map.nData;
+    p->nCol = pTab->nCol;
+    p->cSep = pTab->cSep;
+  }
+
+  /* Skip the byte-order mark and the header record. */
+  pCur->iBody = csvFirstRecord(&pCur->map);
+  if( pTab->bHeader && pCur->iBody<pCur->map.nData ){
+    const char *zField;
+    sqlite3_int64 nField;
+    int bQuoted;
+    p = &pCur->aChunk[0];
+    while( !csvReadField(p, &pCur->iBody, &zField, &nField, &bQuoted) ){}
+    if( p->rc!=SQLITE_OK ) return p->rc;
+  }
+
+  if( nThread>1 ) csvPoolStart(pCur, nThread);
+  for(j=0; j<pCur->nChunk; j++) csvChunkLaunch(pCur, j);
+  p = &pCur->aChunk[0];
+  csvChunkWait(pCur, p, 0);
+  if( p->rc!=SQLITE_OK ) return p->rc;
+  pCur->bEof = 0;
+  return csvNext(cur);
+}
+
+/*
+** Return TRUE if the cursor has been moved off of the last row of output.
+*/
+static int csvEof(sqlite3_vtab_cursor *cur){
+  CsvCursor *pCur = (CsvCursor *)cur;
+  return pCur->bEof;
+}
+
+/*
+** Return values of columns for the row at which the CsvCursor is currently
+** pointing.
+*/
+static int csvColumn(
+  sqlite3_vtab_cursor *cur,
+  sqlite3_context *ctx,
+  int i
+){
+  CsvCursor *pCur = (CsvCursor *)cur;
+  CsvChunk *p = &pCur->aChunk[pCur->iChunk % pCur->nChunk];
+  CsvValue *pVal = &p->aValue[pCur->iRow*p->nCol + i];
+  switch( pVal->eType ){
+    case CSV_INTEGER: {
+      sqlite3_result_int64(ctx, pVal->u.i);
+      break;
+    }
+    case CSV_FLOAT: {
+      sqlite3_result_double(ctx, pVal->u.r);
+      break;
+    }
+    case CSV_TEXT: {
+      sqlite3_result_text(ctx, pVal->u.z, pVal->n, SQLITE_TRANSIENT);
+      break;
+    }
+    case CSV_ESCAPED: {
+      sqlite3_result_text(ctx, &p->aBuf[pVal->u.i], pVal->n,
+                          SQLITE_TRANSIENT);
+      break;
+    }
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Return the rowid for the current row, which is its number among the
+** records returned, starting at one.
+*/
+static int csvRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid){
+  CsvCursor *pCur = (CsvCursor *)cur;
+  *pRowid = pCur->iRowid;
+  return SQLITE_OK;
+}
+
+/*
+** This following structure defines all the methods for the
+** csv virtual table.
+*/
+static sqlite3_module csvModule = {
+  0,                         /* iVersion */
+  csvConnect,                /* xCreate */
+  csvConnect,                /* xConnect */
+  csvBestIndex,              /* xBestIndex */
+  csvDisconnect,             /* xDisconnect */
+  csvDisconnect,             /* xDestroy */
+  csvOpen,                   /* xOpen - open a cursor */
+  csvClose,                  /* xClose - close a cursor */
+  csvFilter,                 /* xFilter - configure scan constraints */
+  csvNext,                   /* xNext - advance a cursor */
+  csvEof,                    /* xEof - check for end of scan */
+  csvColumn,                 /* xColumn - read data */
+  csvRowid,                  /* xRowid - read data */
+  0,                         /* xUpdate */
+  0,                         /* xBegin */
+  0,                         /* xSync */
+  0,                         /* xCommit */
+  0,                         /* xRollback */
+  0,                         /* xFindMethod */
+  0,                         /* xRename */
+};
+
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int sqlite3_csv_init(
+  sqlite3 *db,
+  char **pzErrMsg,
+  const sqlite3_api_routines *pApi
+){
+  SQLITE_EXTENSION_INIT2(pApi);
+  (void)pzErrMsg;  /* Unused parameter */
+  return sqlite3_create_module(db, "csv", &csvModule, 0);
+}
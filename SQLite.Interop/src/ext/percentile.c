@@ -57,6 +57,11 @@
 **  (12)  The percentile(Y,P) is implemented as a single C99 source-code
 **        file that compiles into a shared-library or DLL that can be loaded
 **        into SQLite using the sqlite3_load_extension() interface.
+**
+** This file also implements percentiles(Y,L), which computes several
+** percentiles in one pass, and percentile_state(Y), percentile_merge(S,P)
+** and percentile_state_merge(S), which save and combine the inputs of
+** partial percentile() computations, as described further below.
 */
 #include "sqlite3ext.h"
 SQLITE_EXTENSION_INIT1
@@ -86,6 +91,25 @@ static int isInfinity(double r){
   return ((u>>52)&0x7ff)==0x7ff;
 }
 
+/*
+** Return TRUE if the P argument is a number between 0.0 and 100.0.  This
+** also rejects NaN, which fails every comparison.
+*/
+static int isPercent(double r){
+  return r==r && r>=0.0 && r<=100.0;
+}
+
+/*
+** Return the fractional index of the P-th percentile of N sorted values,
+** clamped to 0..N-1 so that it can never index past the last value.
+*/
+static double pctIndex(double rPct, sqlite3_uint64 n){
+  double ix = rPct*(double)(n-1)*0.01;
+  if( ix<0.0 ) ix = 0.0;
+  if( ix>(double)(n-1) ) ix = (double)(n-1);
+  return ix;
+}
+
 /*
 ** Return TRUE if two doubles differ by 0.001 or less
 */
@@ -108,8 +132,7 @@ static void percentStep(sqlite3_context *pCtx, int argc, sqlite3_value **argv){
   /* Requirement 3:  P must be a number between 0 and 100 */
   eType = sqlite3_value_numeric_type(argv[1]);
   rPct = sqlite3_value_double(argv[1]);
-  if( (eType!=SQLITE_INTEGER && eType!=SQLITE_FLOAT) ||
-      ((rPct = sqlite3_value_double(argv[1]))<0.0 || rPct>100.0) ){
+  if( (eType!=SQLITE_INTEGER && eType!=SQLITE_FLOAT) || !isPercent(rPct) ){
     sqlite3_result_error(pCtx, "2nd argument to percentile() is not "
                          "a number between 0.0 and 100.0", -1);
     return;
@@ -189,7 +212,7 @@ static void percentFinal(sqlite3_context *pCtx){
   if( p->a==0 ) return;
   if( p->nUsed ){
     qsort(p->a, p->nUsed, sizeof(double), doubleCmp);
-    ix = (p->rPct-1.0)*(p->nUsed-1)*0.01;
+    ix = pctIndex(p->rPct-1.0, p->nUsed);
     i1 = (unsigned)ix;
     i2 = ix==(double)i1 || i1==p->nUsed-1 ? i1 : i1+1;
     v1 = p->a[i1];
@@ -201,6 +224,508 @@ static void percentFinal(sqlite3_context *pCtx){
   memset(p, 0, sizeof(*p));
 }
 
+/*
+** The percentiles(Y,L) aggregate computes several percentiles of the
+** same Y values in one pass.  L is a text list of comma-separated P values,
+** e.g. '50,90,99,99.9', each subject to the same rules as the P argument
+** to percentile(Y,P), and must be the same for every row.  The Y values
+** are buffered and sorted only once.  The result is a JSON array holding
+** the requested percentiles in the order they were listed, or NULL if
+** there are no non-NULL values for Y.
+*/
+
+/* The session context for a single percentiles() function. */
+typedef struct Percentiles Percentiles;
+struct Percentiles {
+  Percentile y;            /* The Y values, as for percentile() */
+  char *zList;             /* Copy of the L argument */
+  int nPct;                /* Number of P values */
+  double *aPct;            /* The P values */
+};
+
+/*
+** Parse one decimal number of the L argument to percentiles(), as an
+** optional sign, digits with an optional decimal point, and an optional
+** exponent.  This does not depend on the C library locale, and does not
+** accept the hexadecimal, infinity, and NaN forms that strtod() does.
+** The value is exact for up to 15 significant digits and exponents up to
+** 22, which covers any sensible percentage.  Returns a pointer past the
+** number or z itself if there is none.
+*/
+static const char *pctParseNumber(const char *z, double *pr){
+  static const double aPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char *zStart = z;
+  sqlite3_uint64 m = 0;
+  int nDigit = 0;
+  int e = 0;
+  int neg = 0;
+  double r;
+  if( *z=='-' || *z=='+' ) neg = *z++=='-';
+  for(; *z>='0' && *z<='9'; z++, nDigit++){
+    if( m<(((sqlite3_uint64)1)<<60)/10 ) m = m*10 + (*z-'0'); else e++;
+  }
+  if( *z=='.' ){
+    for(z++; *z>='0' && *z<='9'; z++, nDigit++){
+      if( m<(((sqlite3_uint64)1)<<60)/10 ){ m = m*10 + (*z-'0'); e--; }
+    }
+  }
+  if( nDigit==0 ) return zStart;
+  if( *z=='e' || *z=='E' ){
+    int eNeg = 0, x = 0;
+    z++;
+    if( *z=='-' || *z=='+' ) eNeg = *z++=='-';
+    if( *z<'0' || *z>'9' ) return zStart;
+    for(; *z>='0' && *z<='9'; z++){
+      if( x<10000 ) x = x*10 + (*z-'0');
+    }
+    e += eNeg ? -x : x;
+  }
+  r = (double)m;
+  if( m!=0 ){
+    for(; e>22; e-=22) r *= aPow10[22];
+    for(; e<-22; e+=22) r /= aPow10[22];
+    r = e<0 ? r/aPow10[-e] : r*aPow10[e];
+  }
+  *pr = neg ? -r : r;
+  return z;
+}
+
+/*
+** Parse the L argument to percentiles() into the context.  Returns
+** non-zero, after reporting the error, if it is malformed.
+*/
+static int percentsParse(sqlite3_context *pCtx, Percentiles *p, const char *zList){
+  const char *z;
+  int n = 1;
+  for(z=zList; *z; z++){
+    if( *z==',' ) n++;
+  }
+  p->zList = sqlite3_mprintf("%s", zList);
+  p->aPct = sqlite3_malloc(sizeof(double)*n);
+  if( p->zList==0 || p->aPct==0 ){
+    sqlite3_result_error_nomem(pCtx);
+    return 1;
+  }
+  for(z=zList, p->nPct=0; p->nPct<n; p->nPct++){
+    const char *zEnd;
+    double rPct = 0.0;
+    while( *z==' ' ) z++;
+    zEnd = pctParseNumber(z, &rPct);
+    while( *zEnd==' ' ) zEnd++;
+    if( zEnd==z || (*zEnd!=',' && *zEnd!=0) || !isPercent(rPct) ){
+      sqlite3_result_error(pCtx, "2nd argument to percentiles() is not a "
+                           "list of numbers between 0.0 and 100.0", -1);
+      return 1;
+    }
+    p->aPct[p->nPct] = rPct;
+    z = *zEnd ? zEnd+1 : zEnd;
+  }
+  return 0;
+}
+
+/*
+** Release all the memory of a percentiles() context.
+*/
+static void percentsReset(Percentiles *p){
+  sqlite3_free(p->y.a);
+  sqlite3_free(p->zList);
+  sqlite3_free(p->aPct);
+  memset(p, 0, sizeof(*p));
+}
+
+/*
+** The "step" function for percentiles(Y,L) is called once for each
+** input row.
+*/
+static void percentsStep(sqlite3_context *pCtx, int argc, sqlite3_value **argv){
+  Percentiles *p;
+  const char *zList;
+  int eType;
+  double y;
+  assert( argc==2 );
+
+  zList = (const char*)sqlite3_value_text(argv[1]);
+  if( zList==0 ){
+    sqlite3_result_error(pCtx, "2nd argument to percentiles() is not a "
+                         "list of numbers between 0.0 and 100.0", -1);
+    return;
+  }
+
+  /* Allocate the session context. */
+  p = (Percentiles*)sqlite3_aggregate_context(pCtx, sizeof(*p));
+  if( p==0 ) return;
+
+  /* Parse the list of P values once.  Throw an error if it is different
+  ** from any prior row. */
+  if( p->aPct==0 ){
+    if( percentsParse(pCtx, p, zList) ){
+      percentsReset(p);
+      return;
+    }
+  }else if( strcmp(p->zList, zList)!=0 ){
+    sqlite3_result_error(pCtx, "2nd argument to percentiles() is not the "
+                               "same for all input rows", -1);
+    return;
+  }
+
+  /* Ignore rows for which Y is NULL */
+  eType = sqlite3_value_type(argv[0]);
+  if( eType==SQLITE_NULL ) return;
+
+  /* If not NULL, then Y must be numeric.  Otherwise throw an error. */
+  if( eType!=SQLITE_INTEGER && eType!=SQLITE_FLOAT ){
+    sqlite3_result_error(pCtx, "1st argument to percentiles() is not "
+                               "numeric", -1);
+    return;
+  }
+
+  /* Throw an error if the Y value is infinity or NaN */
+  y = sqlite3_value_double(argv[0]);
+  if( isInfinity(y) ){
+    sqlite3_result_error(pCtx, "Inf input to percentiles()", -1);
+    return;
+  }
+
+  /* Allocate and store the Y */
+  if( p->y.nUsed>=p->y.nAlloc ){
+    unsigned n = p->y.nAlloc*2 + 250;
+    double *a = sqlite3_realloc(p->y.a, sizeof(double)*n);
+    if( a==0 ){
+      percentsReset(p);
+      sqlite3_result_error_nomem(pCtx);
+      return;
+    }
+    p->y.nAlloc = n;
+    p->y.a = a;
+  }
+  p->y.a[p->y.nUsed++] = y;
+}
+
+/*
+** Called to compute the final output of percentiles() and to clean
+** up all allocated memory.
+*/
+static void percentsFinal(sqlite3_context *pCtx){
+  Percentiles *p;
+  char *zOut = 0;
+  int i;
+  p = (Percentiles*)sqlite3_aggregate_context(pCtx, 0);
+  if( p==0 ) return;
+  if( p->y.nUsed ){
+    qsort(p->y.a, p->y.nUsed, sizeof(double), doubleCmp);
+    for(i=0; i<p->nPct; i++){
+      unsigned i1, i2;
+      double ix, v1, v2;
+      ix = pctIndex(p->aPct[i], p->y.nUsed);
+      i1 = (unsigned)ix;
+      i2 = ix==(double)i1 || i1==p->y.nUsed-1 ? i1 : i1+1;
+      v1 = p->y.a[i1];
+      v2 = p->y.a[i2];
+      /* 17 significant digits, so that each value reads back as the same
+      ** double, unlike the 15 used when SQLite converts a REAL to text. */
+      zOut = sqlite3_mprintf("%z%s%!.17g", zOut, i ? "," : "[",
+                             v1 + (v2-v1)*(ix-i1));
+      if( zOut==0 ) break;
+    }
+    if( zOut ) zOut = sqlite3_mprintf("%z]", zOut);
+    if( zOut ){
+      sqlite3_result_text(pCtx, zOut, -1, sqlite3_free);
+    }else{
+      sqlite3_result_error_nomem(pCtx);
+    }
+  }
+  percentsReset(p);
+}
+
+/*
+** The values seen by a percentile() computation can also be saved using
+** the percentile_state(Y) aggregate, e.g. into hourly rollup tables, and
+** combined later using the percentile_merge(S,P) and
+** percentile_state_merge(S) aggregates, without rescanning the original
+** rows.  The results are exact, the same as percentile(Y,P) over all the
+** original rows.
+**
+** A state is a blob holding the 4-byte PERCENTILE_STATE_MAGIC followed by
+** the distinct Y values in ascending order, each with the number of times
+** it occurs, stored as two 8-byte little-endian integers (the bits of the
+** double and the count).  Repeated values, which are common in measured
+** data, are stored only once.
+*/
+#define PERCENTILE_STATE_MAGIC "PCT1"
+
+/* One distinct Y value of a percentile state and its number of occurrences */
+typedef struct PercentilePair PercentilePair;
+struct PercentilePair {
+  double y;                /* The Y value */
+  sqlite3_uint64 n;        /* Number of times it occurs */
+};
+
+/* The session context for percentile_state(), percentile_merge() and
+** percentile_state_merge().
+*/
+typedef struct PercentileState PercentileState;
+struct PercentileState {
+  unsigned nAlloc;         /* Number of slots allocated for a[] */
+  unsigned nUsed;          /* Number of slots actually used in a[] */
+  unsigned nSorted;        /* Number of leading slots that are coalesced */
+  double rPct;             /* 1.0 more than the value for P */
+  PercentilePair *a;       /* Array of Y values and counts */
+};
+
+static void pctPutU64(unsigned char *z, sqlite3_uint64 v){
+  int i;
+  for(i=0; i<8; i++){
+    z[i] = (unsigned char)(v & 0xff);
+    v >>= 8;
+  }
+}
+
+static sqlite3_uint64 pctGetU64(const unsigned char *z){
+  sqlite3_uint64 v = 0;
+  int i;
+  for(i=7; i>=0; i--){
+    v = (v<<8) | z[i];
+  }
+  return v;
+}
+
+/*
+** Compare two pairs by their Y values for sorting using qsort()
+*/
+static int pairCmp(const void *pA, const void *pB){
+  return doubleCmp(&((PercentilePair*)pA)->y, &((PercentilePair*)pB)->y);
+}
+
+/*
+** Sort the pairs and combine the ones with equal Y values.
+*/
+static void pctStateCoalesce(PercentileState *p){
+  unsigned i, j;
+  if( p->nSorted==p->nUsed ) return;
+  qsort(p->a, p->nUsed, sizeof(PercentilePair), pairCmp);
+  for(i=j=0; i<p->nUsed; i++){
+    if( j>0 && p->a[j-1].y==p->a[i].y ){
+      p->a[j-1].n += p->a[i].n;
+    }else{
+      p->a[j++] = p->a[i];
+    }
+  }
+  p->nUsed = p->nSorted = j;
+}
+
+/*
+** Append a Y value and its count.  Returns SQLITE_NOMEM, after releasing
+** all the memory of the state, if it cannot be grown.  Long runs of
+** unsorted pairs are coalesced first, which keeps the state proportional
+** to the number of distinct values.
+*/
+static int pctStateAppend(PercentileState *p, double y, sqlite3_uint64 n){
+  if( p->nUsed>=p->nAlloc ){
+    unsigned nNew;
+    PercentilePair *a;
+    if( p->nUsed - p->nSorted > p->nSorted ){
+      pctStateCoalesce(p);
+    }
+    nNew = p->nAlloc*2 + 250;
+    if( p->nUsed<p->nAlloc/2 ){
+      nNew = p->nAlloc;
+    }
+    a = nNew==p->nAlloc ? p->a : sqlite3_realloc(p->a, sizeof(PercentilePair)*nNew);
+    if( a==0 ){
+      sqlite3_free(p->a);
+      memset(p, 0, sizeof(*p));
+      return SQLITE_NOMEM;
+    }
+    p->nAlloc = nNew;
+    p->a = a;
+  }
+  if( p->nUsed>0 && p->nSorted==p->nUsed && p->a[p->nUsed-1].y==y ){
+    p->a[p->nUsed-1].n += n;
+    return SQLITE_OK;
+  }
+  if( p->nSorted==p->nUsed && (p->nUsed==0 || p->a[p->nUsed-1].y<y) ){
+    p->nSorted++;
+  }
+  p->a[p->nUsed].y = y;
+  p->a[p->nUsed].n = n;
+  p->nUsed++;
+  return SQLITE_OK;
+}
+
+/*
+** Add all the pairs of a serialized state.  Returns non-zero, after
+** reporting the error, if the state is malformed or out of memory.
+*/
+static int pctStateDecode(
+  sqlite3_context *pCtx,
+  PercentileState *p,
+  sqlite3_value *pState
+){
+  const unsigned char *z;
+  int nByte;
+  int i;
+  if( sqlite3_value_type(pState)==SQLITE_NULL ) return 0;
+  z = sqlite3_value_blob(pState);
+  nByte = sqlite3_value_bytes(pState);
+  if( nByte<4 || (nByte-4)%16!=0 || memcmp(z, PERCENTILE_STATE_MAGIC, 4)!=0 ){
+    sqlite3_result_error(pCtx, "1st argument is not a percentile_state() "
+                               "value", -1);
+    return 1;
+  }
+  for(i=4; i<nByte; i+=16){
+    sqlite3_uint64 u = pctGetU64(z+i);
+    double y;
+    memcpy(&y, &u, sizeof(y));
+    if( pctStateAppend(p, y, pctGetU64(z+i+8))!=SQLITE_OK ){
+      sqlite3_result_error_nomem(pCtx);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+** The "step" function for percentile_state(Y) is called once for each
+** input row.  The Y values are checked the same way as for percentile().
+*/
+static void percentStateStep(sqlite3_context *pCtx, int argc, sqlite3_value **argv){
+  PercentileState *p;
+  int eType;
+  double y;
+  assert( argc==1 );
+
+  p = (PercentileState*)sqlite3_aggregate_context(pCtx, sizeof(*p));
+  if( p==0 ) return;
+
+  eType = sqlite3_value_type(argv[0]);
+  if( eType==SQLITE_NULL ) return;
+  if( eType!=SQLITE_INTEGER && eType!=SQLITE_FLOAT ){
+    sqlite3_result_error(pCtx, "1st argument to percentile_state() is not "
+                               "numeric", -1);
+    return;
+  }
+  y = sqlite3_value_double(argv[0]);
+  if( isInfinity(y) ){
+    sqlite3_result_error(pCtx, "Inf input to percentile_state()", -1);
+    return;
+  }
+  if( pctStateAppend(p, y, 1)!=SQLITE_OK ){
+    sqlite3_result_error_nomem(pCtx);
+  }
+}
+
+/*
+** The "step" function for percentile_state_merge(S).
+*/
+static void percentStateMergeStep(sqlite3_context *pCtx, int argc, sqlite3_value **argv){
+  PercentileState *p;
+  assert( argc==1 );
+  p = (PercentileState*)sqlite3_aggregate_context(pCtx, sizeof(*p));
+  if( p==0 ) return;
+  pctStateDecode(pCtx, p, argv[0]);
+}
+
+/*
+** Called to compute the final output of percentile_state() and
+** percentile_state_merge() and to clean up all allocated memory.
+*/
+static void percentStateFinal(sqlite3_context *pCtx){
+  PercentileState *p;
+  unsigned char *z;
+  unsigned i;
+  int nByte;
+  p = (PercentileState*)sqlite3_aggregate_context(pCtx, 0);
+  if( p ) pctStateCoalesce(p);
+  nByte = 4 + 16*(p ? p->nUsed : 0);
+  z = sqlite3_malloc(nByte);
+  if( z==0 ){
+    sqlite3_result_error_nomem(pCtx);
+  }else{
+    memcpy(z, PERCENTILE_STATE_MAGIC, 4);
+    for(i=0; p && i<p->nUsed; i++){
+      sqlite3_uint64 u;
+      memcpy(&u, &p->a[i].y, sizeof(u));
+      pctPutU64(z+4+16*i, u);
+      pctPutU64(z+12+16*i, p->a[i].n);
+    }
+    sqlite3_result_blob(pCtx, z, nByte, sqlite3_free);
+  }
+  if( p ){
+    sqlite3_free(p->a);
+    memset(p, 0, sizeof(*p));
+  }
+}
+
+/*
+** The "step" function for percentile_merge(S,P).  The P argument is
+** checked the same way as for percentile().
+*/
+static void percentMergeStep(sqlite3_context *pCtx, int argc, sqlite3_value **argv){
+  PercentileState *p;
+  double rPct;
+  int eType;
+  assert( argc==2 );
+
+  eType = sqlite3_value_numeric_type(argv[1]);
+  rPct = sqlite3_value_double(argv[1]);
+  if( (eType!=SQLITE_INTEGER && eType!=SQLITE_FLOAT) || !isPercent(rPct) ){
+    sqlite3_result_error(pCtx, "2nd argument to percentile_merge() is not "
+                         "a number between 0.0 and 100.0", -1);
+    return;
+  }
+
+  p = (PercentileState*)sqlite3_aggregate_context(pCtx, sizeof(*p));
+  if( p==0 ) return;
+
+  if( p->rPct==0.0 ){
+    p->rPct = rPct+1.0;
+  }else if( !sameValue(p->rPct,rPct+1.0) ){
+    sqlite3_result_error(pCtx, "2nd argument to percentile_merge() is not "
+                               "the same for all input rows", -1);
+    return;
+  }
+
+  pctStateDecode(pCtx, p, argv[0]);
+}
+
+/*
+** Called to compute the final output of percentile_merge() and to clean
+** up all allocated memory.  The result is the same as percentFinal() would
+** return for the original Y values.
+*/
+static void percentMergeFinal(sqlite3_context *pCtx){
+  PercentileState *p;
+  sqlite3_uint64 nTotal = 0;
+  sqlite3_uint64 i1, i2, nSeen;
+  double v1 = 0.0, v2 = 0.0;
+  double ix;
+  unsigned i;
+  p = (PercentileState*)sqlite3_aggregate_context(pCtx, 0);
+  if( p==0 ) return;
+  if( p->a==0 ) return;
+  pctStateCoalesce(p);
+  for(i=0; i<p->nUsed; i++) nTotal += p->a[i].n;
+  if( nTotal ){
+    ix = pctIndex(p->rPct-1.0, nTotal);
+    i1 = (sqlite3_uint64)ix;
+    i2 = ix==(double)i1 || i1==nTotal-1 ? i1 : i1+1;
+    for(i=0, nSeen=0; i<p->nUsed; i++){
+      if( i1>=nSeen && i1<nSeen+p->a[i].n ) v1 = p->a[i].y;
+      if( i2>=nSeen && i2<nSeen+p->a[i].n ){
+        v2 = p->a[i].y;
+        break;
+      }
+      nSeen += p->a[i].n;
+    }
+    sqlite3_result_double(pCtx, v1 + (v2-v1)*(ix-(double)i1));
+  }
+  sqlite3_free(p->a);
+  memset(p, 0, sizeof(*p));
+}
+
 
 #ifdef _WIN32
 __declspec(dllexport)
@@ -215,5 +740,22 @@ int sqlite3_percentile_init(
   (void)pzErrMsg;  /* Unused parameter */
   rc = sqlite3_create_function(db, "percentile", 2, SQLITE_UTF8, 0,
                                0, percentStep, percentFinal);
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_create_function(db, "percentiles", 2, SQLITE_UTF8, 0,
+                                 0, percentsStep, percentsFinal);
+  }
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_create_function(db, "percentile_state", 1, SQLITE_UTF8, 0,
+                                 0, percentStateStep, percentStateFinal);
+  }
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_create_function(db, "percentile_state_merge", 1, SQLITE_UTF8,
+                                 0, 0, percentStateMergeStep,
+                                 percentStateFinal);
+  }
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_create_function(db, "percentile_merge", 2, SQLITE_UTF8, 0,
+                                 0, percentMergeStep, percentMergeFinal);
+  }
   return rc;
 }
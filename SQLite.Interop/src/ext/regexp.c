@@ -14,12 +14,25 @@
 ** efficient regular-expression matcher for posix extended regular
 ** expressions against UTF8 text.
 **
-** This file is an SQLite extension.  It registers a single function
-** named "regexp(A,B)" where A is the regular expression and B is the
-** string to be matched.  By registering this function, SQLite will also
-** then implement the "B regexp A" operator.  Note that with the function
-** the regular expression comes first, but with the operator it comes
-** second.
+** This file is an SQLite extension.  It registers a function named
+** "regexp(A,B)" where A is the regular expression and B is the string to
+** be matched.  By registering this function, SQLite will also then
+** implement the "B regexp A" operator.  Note that with the function the
+** regular expression comes first, but with the operator it comes second.
+** Compiled regular expressions are cached per database connection; the
+** "regexp_cache_status(NAME)" function reports on that cache.
+**
+** The "regexp_any(P,B)" and "regexp_which(P,B)" functions match a set of
+** regular expressions, given one per line in P, against the string B in
+** a single pass.  They return whether any of them matched and which ones
+** did, respectively.
+**
+** The "regexp_extract(B,A,N)", "regexp_replace(B,A,R)" and
+** "regexp_count(B,A)" functions take the string first.  They return the
+** text matched by group N (the whole match when N is 0 or omitted) of the
+** first match, B with every match replaced by R (in which "\0" through
+** "\9" stand for the groups of the match and "\\" for a backslash), and
+** the number of non-overlapping matches, respectively.
 **
 **  The following regular expression syntax is supported:
 **
@@ -93,18 +106,38 @@ SQLITE_EXTENSION_INIT1
 #define RE_OP_SPACE      15    /* space:  [ \t\n\r\v\f] */
 #define RE_OP_NOTSPACE   16    /* Not a digit */
 #define RE_OP_BOUNDARY   17    /* Boundary between word and non-word */
+#define RE_OP_SAVE       18    /* Record the input offset in capture slot iArg */
+
+/* Maximum number of "(...)" groups in a pattern whose submatches are
+** recorded.
+*/
+#define RE_MAX_GROUP     99
 
 /* Each opcode is a "state" in the NFA */
-typedef unsigned short ReStateNumber;
+typedef unsigned ReStateNumber;
+
+/* One instruction of the NFA program.  The operator and its argument are
+** kept next to each other, in a single array, so that the matcher only
+** touches one cache line per state.
+*/
+typedef struct ReOp ReOp;
+struct ReOp {
+  int op;                     /* The RE_OP_* operator */
+  int arg;                    /* Argument to the operator */
+};
 
 /* Because this is an NFA and not a DFA, multiple states can be active at
 ** once.  An instance of the following object records all active states in
-** the NFA.  The implementation is optimized for the common case where the
-** number of actives states is small.
+** the NFA.  aStamp[x]==iGen if and only if state x is in aState[], so
+** adding a state takes constant time and each step of the matcher is
+** linear in the number of states.  The arrays are allocated along with
+** the compiled program and reused by every match.
 */
 typedef struct ReStateSet {
   unsigned nState;            /* Number of current states */
   ReStateNumber *aState;      /* Current states */
+  unsigned *aStamp;           /* Generation in which each state was added */
+  unsigned iGen;              /* Current generation */
 } ReStateSet;
 
 /* An input string read one character at a time.
@@ -123,20 +156,52 @@ typedef struct ReCompiled ReCompiled;
 struct ReCompiled {
   ReInput sIn;                /* Regular expression text */
   const char *zErr;           /* Error message to return */
-  char *aOp;                  /* Operators for the virtual machine */
-  int *aArg;                  /* Arguments to each operator */
+  ReOp *aOp;                  /* Program for the virtual machine */
   unsigned (*xNextChar)(ReInput*);  /* Next character function */
   unsigned char zInit[12];    /* Initial text to match */
   int nInit;                  /* Number of characters in zInit */
-  unsigned nState;            /* Number of entries in aOp[] and aArg[] */
-  unsigned nAlloc;            /* Slots allocated for aOp[] and aArg[] */
+  unsigned nState;            /* Number of entries in aOp[] */
+  unsigned nAlloc;            /* Slots allocated for aOp[] */
+  ReStateSet aSet[2];         /* State sets used by re_match() */
+  int bCapture;               /* True to record submatches with RE_OP_SAVE */
+  int nGroup;                 /* Number of recorded "(...)" groups */
+  int *aCapture;              /* Space used by re_exec(), if bCapture */
 };
 
 /* Add a state to the given state set if it is not already there */
 static void re_add_state(ReStateSet *pSet, int newState){
-  unsigned i;
-  for(i=0; i<pSet->nState; i++) if( pSet->aState[i]==newState ) return;
-  pSet->aState[pSet->nState++] = newState;
+  if( pSet->aStamp[newState]!=pSet->iGen ){
+    pSet->aStamp[newState] = pSet->iGen;
+    pSet->aState[pSet->nState++] = newState;
+  }
+}
+
+/* Empty the given state set */
+static void re_clear_states(ReStateSet *pSet, unsigned nState){
+  pSet->nState = 0;
+  if( ++pSet->iGen==0 ){
+    memset(pSet->aStamp, 0, sizeof(pSet->aStamp[0])*(nState+1));
+    pSet->iGen = 1;
+  }
+}
+
+/* Allocate the two state sets used to run a program with nState states.
+** Return non-zero if out of memory.  The memory is freed by passing
+** aSet[0].aStamp to sqlite3_free().
+*/
+static int re_alloc_states(ReStateSet *aSet, unsigned nState){
+  unsigned n = nState+1;
+  int nByte = 2*n*(sizeof(ReStateNumber)+sizeof(unsigned));
+  char *pSpace = sqlite3_malloc( nByte );
+  if( pSpace==0 ) return 1;
+  memset(pSpace, 0, nByte);
+  aSet[0].aStamp = (unsigned*)pSpace;
+  aSet[1].aStamp = &aSet[0].aStamp[n];
+  aSet[0].aState = (ReStateNumber*)&aSet[1].aStamp[n];
+  aSet[1].aState = &aSet[0].aState[n];
+  aSet[0].iGen = aSet[1].iGen = 1;
+  aSet[0].nState = aSet[1].nState = 0;
+  return 0;
 }
 
 /* Extract the next unicode character from *pzIn and return it.  Advance
@@ -195,9 +260,7 @@ static int re_space_char(int c){
 ** string zIn[].  Return true on a match and false if there is no match.
 */
 static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
-  ReStateSet aStateSet[2], *pThis, *pNext;
-  ReStateNumber aSpace[100];
-  ReStateNumber *pToFree;
+  ReStateSet *pThis, *pNext;
   unsigned int i = 0;
   unsigned int iSwap = 0;
   int c = RE_EOF+1;
@@ -221,34 +284,25 @@ static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
     if( in.i+pRe->nInit>in.mx ) return 0;
   }
 
-  if( pRe->nState<=(sizeof(aSpace)/(sizeof(aSpace[0])*2)) ){
-    pToFree = 0;
-    aStateSet[0].aState = aSpace;
-  }else{
-    pToFree = sqlite3_malloc( sizeof(ReStateNumber)*2*pRe->nState );
-    if( pToFree==0 ) return -1;
-    aStateSet[0].aState = pToFree;
-  }
-  aStateSet[1].aState = &aStateSet[0].aState[pRe->nState];
-  pNext = &aStateSet[1];
-  pNext->nState = 0;
+  pNext = &pRe->aSet[1];
+  re_clear_states(pNext, pRe->nState);
   re_add_state(pNext, 0);
   while( c!=RE_EOF && pNext->nState>0 ){
     cPrev = c;
     c = pRe->xNextChar(&in);
     pThis = pNext;
-    pNext = &aStateSet[iSwap];
+    pNext = &pRe->aSet[iSwap];
     iSwap = 1 - iSwap;
-    pNext->nState = 0;
+    re_clear_states(pNext, pRe->nState);
     for(i=0; i<pThis->nState; i++){
       int x = pThis->aState[i];
-      switch( pRe->aOp[x] ){
+      switch( pRe->aOp[x].op ){
         case RE_OP_MATCH: {
-          if( pRe->aArg[x]==c ) re_add_state(pNext, x+1);
+          if( pRe->aOp[x].arg==c ) re_add_state(pNext, x+1);
           break;
         }
         case RE_OP_ANY: {
-          re_add_state(pNext, x+1);
+          if( c!=RE_EOF ) re_add_state(pNext, x+1);
           break;
         }
         case RE_OP_WORD: {
@@ -256,7 +310,7 @@ static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
           break;
         }
         case RE_OP_NOTWORD: {
-          if( !re_word_char(c) ) re_add_state(pNext, x+1);
+          if( !re_word_char(c) && c!=RE_EOF ) re_add_state(pNext, x+1);
           break;
         }
         case RE_OP_DIGIT: {
@@ -264,7 +318,7 @@ static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
           break;
         }
         case RE_OP_NOTDIGIT: {
-          if( !re_digit_char(c) ) re_add_state(pNext, x+1);
+          if( !re_digit_char(c) && c!=RE_EOF ) re_add_state(pNext, x+1);
           break;
         }
         case RE_OP_SPACE: {
@@ -272,7 +326,7 @@ static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
           break;
         }
         case RE_OP_NOTSPACE: {
-          if( !re_space_char(c) ) re_add_state(pNext, x+1);
+          if( !re_space_char(c) && c!=RE_EOF ) re_add_state(pNext, x+1);
           break;
         }
         case RE_OP_BOUNDARY: {
@@ -285,12 +339,16 @@ static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
           break;
         }
         case RE_OP_FORK: {
-          re_add_state(pThis, x+pRe->aArg[x]);
+          re_add_state(pThis, x+pRe->aOp[x].arg);
           re_add_state(pThis, x+1);
           break;
         }
         case RE_OP_GOTO: {
-          re_add_state(pThis, x+pRe->aArg[x]);
+          re_add_state(pThis, x+pRe->aOp[x].arg);
+          break;
+        }
+        case RE_OP_SAVE: {
+          re_add_state(pThis, x+1);
           break;
         }
         case RE_OP_ACCEPT: {
@@ -300,16 +358,16 @@ static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
         case RE_OP_CC_INC:
         case RE_OP_CC_EXC: {
           int j = 1;
-          int n = pRe->aArg[x];
+          int n = pRe->aOp[x].arg;
           int hit = 0;
           for(j=1; j>0 && j<n; j++){
-            if( pRe->aOp[x+j]==RE_OP_CC_VALUE ){
-              if( pRe->aArg[x+j]==c ){
+            if( pRe->aOp[x+j].op==RE_OP_CC_VALUE ){
+              if( pRe->aOp[x+j].arg==c ){
                 hit = 1;
                 j = -1;
               }
             }else{
-              if( pRe->aArg[x+j]<=c && pRe->aArg[x+j+1]>=c ){
+              if( pRe->aOp[x+j].arg<=c && pRe->aOp[x+j+1].arg>=c ){
                 hit = 1;
                 j = -1;
               }else{
@@ -317,7 +375,7 @@ static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
               }
             }
           }
-          if( pRe->aOp[x]==RE_OP_CC_EXC ) hit = !hit;
+          if( pRe->aOp[x].op==RE_OP_CC_EXC ) hit = !hit && c!=RE_EOF;
           if( hit ) re_add_state(pNext, x+n);
           break;            
         }
@@ -325,24 +383,19 @@ static int re_match(ReCompiled *pRe, const unsigned char *zIn, int nIn){
     }
   }
   for(i=0; i<pNext->nState; i++){
-    if( pRe->aOp[pNext->aState[i]]==RE_OP_ACCEPT ){ rc = 1; break; }
+    if( pRe->aOp[pNext->aState[i]].op==RE_OP_ACCEPT ){ rc = 1; break; }
   }
 re_match_end:
-  sqlite3_free(pToFree);
   return rc;
 }
 
 /* Resize the opcode and argument arrays for an RE under construction.
 */
 static int re_resize(ReCompiled *p, int N){
-  char *aOp;
-  int *aArg;
+  ReOp *aOp;
   aOp = sqlite3_realloc(p->aOp, N*sizeof(p->aOp[0]));
   if( aOp==0 ) return 1;
   p->aOp = aOp;
-  aArg = sqlite3_realloc(p->aArg, N*sizeof(p->aArg[0]));
-  if( aArg==0 ) return 1;
-  p->aArg = aArg;
   p->nAlloc = N;
   return 0;
 }
@@ -355,11 +408,10 @@ static int re_insert(ReCompiled *p, int iBefore, int op, int arg){
   if( p->nAlloc<=p->nState && re_resize(p, p->nAlloc*2) ) return 0;
   for(i=p->nState; i>iBefore; i--){
     p->aOp[i] = p->aOp[i-1];
-    p->aArg[i] = p->aArg[i-1];
   }
   p->nState++;
-  p->aOp[iBefore] = op;
-  p->aArg[iBefore] = arg;
+  p->aOp[iBefore].op = op;
+  p->aOp[iBefore].arg = arg;
   return iBefore;
 }
 
@@ -375,7 +427,6 @@ static int re_append(ReCompiled *p, int op, int arg){
 static void re_copy(ReCompiled *p, int iStart, int N){
   if( p->nState+N>=p->nAlloc && re_resize(p, p->nAlloc*2+N) ) return;
   memcpy(&p->aOp[p->nState], &p->aOp[iStart], N*sizeof(p->aOp[0]));
-  memcpy(&p->aArg[p->nState], &p->aArg[iStart], N*sizeof(p->aArg[0]));
   p->nState += N;
 }
 
@@ -462,7 +513,7 @@ static const char *re_subcompile_re(ReCompiled *p){
     p->sIn.i++;
     zErr = re_subcompile_string(p);
     if( zErr ) return zErr;
-    p->aArg[iGoto] = p->nState - iGoto;
+    p->aOp[iGoto].arg = p->nState - iGoto;
   }
   return 0;
 }
@@ -486,10 +537,17 @@ static const char *re_subcompile_string(ReCompiled *p){
         return 0;
       }
       case '(': {
+        int iGroup = 0;
+        if( p->bCapture ){
+          if( p->nGroup>=RE_MAX_GROUP ) return "too many groups";
+          iGroup = ++p->nGroup;
+          re_append(p, RE_OP_SAVE, iGroup*2);
+        }
         zErr = re_subcompile_re(p);
         if( zErr ) return zErr;
         if( rePeek(p)!=')' ) return "unmatched '('";
         p->sIn.i++;
+        if( iGroup ) re_append(p, RE_OP_SAVE, iGroup*2+1);
         break;
       }
       case '.': {
@@ -535,6 +593,7 @@ static const char *re_subcompile_string(ReCompiled *p){
         if( m==0 ){
           if( n==0 ) return "both m and n are zero in '{m,n}'";
           re_insert(p, iPrev, RE_OP_FORK, sz+1);
+          iPrev++;
           n--;
         }else{
           for(j=1; j<m; j++) re_copy(p, iPrev, sz);
@@ -573,7 +632,7 @@ static const char *re_subcompile_string(ReCompiled *p){
           if( rePeek(p)==']' ){ p->sIn.i++; break; }
         }
         if( c==0 ) return "unclosed '['";
-        p->aArg[iFirst] = p->nState - iFirst;
+        p->aOp[iFirst].arg = p->nState - iFirst;
         break;
       }
       case '\\': {
@@ -613,7 +672,8 @@ static const char *re_subcompile_string(ReCompiled *p){
 void re_free(ReCompiled *pRe){
   if( pRe ){
     sqlite3_free(pRe->aOp);
-    sqlite3_free(pRe->aArg);
+    sqlite3_free(pRe->aSet[0].aStamp);
+    sqlite3_free(pRe->aCapture);
     sqlite3_free(pRe);
   }
 }
@@ -622,9 +682,16 @@ void re_free(ReCompiled *pRe){
 ** Compile a textual regular expression in zIn[] into a compiled regular
 ** expression suitable for us by re_match() and return a pointer to the
 ** compiled regular expression in *ppRe.  Return NULL on success or an
-** error message if something goes wrong.
+** error message if something goes wrong.  If bCapture is true, the
+** program also records the offsets of the match and of its "(...)"
+** groups, for use by re_exec().
 */
-const char *re_compile(ReCompiled **ppRe, const char *zIn, int noCase){
+static const char *re_compile_ex(
+  ReCompiled **ppRe,
+  const char *zIn,
+  int noCase,
+  int bCapture
+){
   ReCompiled *pRe;
   const char *zErr;
   int i, j;
@@ -636,6 +703,7 @@ const char *re_compile(ReCompiled **ppRe, const char *zIn, int noCase){
   }
   memset(pRe, 0, sizeof(*pRe));
   pRe->xNextChar = noCase ? re_next_char_nocase : re_next_char;
+  pRe->bCapture = bCapture;
   if( re_resize(pRe, 30) ){
     re_free(pRe);
     return "out of memory";
@@ -645,6 +713,7 @@ const char *re_compile(ReCompiled **ppRe, const char *zIn, int noCase){
   }else{
     re_append(pRe, RE_OP_ANYSTAR, 0);
   }
+  if( bCapture ) re_append(pRe, RE_OP_SAVE, 0);
   pRe->sIn.z = (unsigned char*)zIn;
   pRe->sIn.i = 0;
   pRe->sIn.mx = (int)strlen(zIn);
@@ -654,10 +723,12 @@ const char *re_compile(ReCompiled **ppRe, const char *zIn, int noCase){
     return zErr;
   }
   if( rePeek(pRe)=='$' && pRe->sIn.i+1>=pRe->sIn.mx ){
+    if( bCapture ) re_append(pRe, RE_OP_SAVE, 1);
     re_append(pRe, RE_OP_MATCH, RE_EOF);
     re_append(pRe, RE_OP_ACCEPT, 0);
     *ppRe = pRe;
   }else if( pRe->sIn.i>=pRe->sIn.mx ){
+    if( bCapture ) re_append(pRe, RE_OP_SAVE, 1);
     re_append(pRe, RE_OP_ACCEPT, 0);
     *ppRe = pRe;
   }else{
@@ -665,6 +736,28 @@ const char *re_compile(ReCompiled **ppRe, const char *zIn, int noCase){
     return "unrecognized character";
   }
 
+  /* Allocate the state sets once, so that re_match() does not have to.
+  ** re_exec() also needs, for each of the two sets, the capture slots of
+  ** every state, then one set of slots to work in and its stack. */
+  if( re_alloc_states(pRe->aSet, pRe->nState) ){
+    re_free(pRe);
+    *ppRe = 0;
+    return "out of memory";
+  }
+  if( bCapture ){
+    sqlite3_int64 n = pRe->nState+1;
+    sqlite3_int64 nSlot = 2*(pRe->nGroup+1);
+    sqlite3_int64 nByte = sizeof(int)*(2*n*nSlot + nSlot + 2*(2*n+1));
+    if( nByte<=0x7fffffff ){
+      pRe->aCapture = sqlite3_malloc( (int)nByte );
+    }
+    if( pRe->aCapture==0 ){
+      re_free(pRe);
+      *ppRe = 0;
+      return "out of memory";
+    }
+  }
+
   /* The following is a performance optimization.  If the regex begins with
   ** ".*" (if the input regex lacks an initial "^") and afterwards there are
   ** one or more matching characters, enter those matching characters into
@@ -673,16 +766,18 @@ const char *re_compile(ReCompiled **ppRe, const char *zIn, int noCase){
   ** regex engine over the string.  Do not worry able trying to match
   ** unicode characters beyond plane 0 - those are very rare and this is
   ** just an optimization. */
-  if( pRe->aOp[0]==RE_OP_ANYSTAR ){
-    for(j=0, i=1; j<sizeof(pRe->zInit)-2 && pRe->aOp[i]==RE_OP_MATCH; i++){
-      unsigned x = pRe->aArg[i];
+  if( pRe->aOp[0].op==RE_OP_ANYSTAR ){
+    for(j=0, i=1; j<sizeof(pRe->zInit)-2; i++){
+      unsigned x = pRe->aOp[i].arg;
+      if( pRe->aOp[i].op==RE_OP_SAVE ) continue;
+      if( pRe->aOp[i].op!=RE_OP_MATCH ) break;
       if( x<=127 ){
         pRe->zInit[j++] = x;
-      }else if( x<=0xfff ){
+      }else if( x<=0x7ff ){
         pRe->zInit[j++] = 0xc0 | (x>>6);
         pRe->zInit[j++] = 0x80 | (x&0x3f);
       }else if( x<=0xffff ){
-        pRe->zInit[j++] = 0xd0 | (x>>12);
+        pRe->zInit[j++] = 0xe0 | (x>>12);
         pRe->zInit[j++] = 0x80 | ((x>>6)&0x3f);
         pRe->zInit[j++] = 0x80 | (x&0x3f);
       }else{
@@ -695,6 +790,881 @@ const char *re_compile(ReCompiled **ppRe, const char *zIn, int noCase){
   return pRe->zErr;
 }
 
+/*
+** Compile a textual regular expression in zIn[] for use by re_match().
+** See re_compile_ex() for details.
+*/
+const char *re_compile(ReCompiled **ppRe, const char *zIn, int noCase){
+  return re_compile_ex(ppRe, zIn, noCase, 0);
+}
+
+/* Return the character that ends just before byte offset i of zIn[], or
+** zero if i is the start of the string.
+*/
+static unsigned re_prev_char(const unsigned char *zIn, int i){
+  ReInput in;
+  if( i<=0 ) return 0;
+  in.z = zIn;
+  in.i = i-1;
+  in.mx = i;
+  while( in.i>0 && (zIn[in.i]&0xc0)==0x80 ) in.i--;
+  return re_next_char(&in);
+}
+
+/* Add state iState, and every state reachable from it without consuming
+** input, as threads of re_exec() to pSet.  aThread[] holds the capture
+** slots of the threads in pSet and aCap[] those of the new thread.  The
+** input offset is iPos, the characters before and after it are cPrev
+** and c.
+**
+** The states are visited depth first, so the threads are added in
+** priority order.  A FORK that jumps backwards prefers the jump and a
+** FORK that jumps forwards prefers the next opcode, which makes all the
+** repetition operators greedy and "|" prefer its left operand.
+*/
+static void re_add_thread(
+  ReCompiled *pRe,
+  ReStateSet *pSet,
+  int *aThread,
+  int iState,
+  int *aCap,
+  int iPos,
+  int cPrev,
+  int c
+){
+  int nSlot = 2*(pRe->nGroup+1);
+  int *aStack = &pRe->aCapture[2*(pRe->nState+1)*nSlot + nSlot];
+  int nStack = 0;
+
+  /* Each stack entry is either a state number and -1, or the negated
+  ** number of a capture slot (less one) and the value to restore it to */
+  aStack[nStack++] = iState;
+  aStack[nStack++] = -1;
+  while( nStack>0 ){
+    int x, arg;
+    nStack -= 2;
+    x = aStack[nStack];
+    if( x<0 ){
+      aCap[-1-x] = aStack[nStack+1];
+      continue;
+    }
+    if( pSet->aStamp[x]==pSet->iGen ) continue;
+    pSet->aStamp[x] = pSet->iGen;
+    arg = pRe->aOp[x].arg;
+    switch( pRe->aOp[x].op ){
+      case RE_OP_GOTO: {
+        aStack[nStack++] = x+arg;
+        aStack[nStack++] = -1;
+        break;
+      }
+      case RE_OP_FORK: {
+        aStack[nStack++] = arg<0 ? x+1 : x+arg;
+        aStack[nStack++] = -1;
+        aStack[nStack++] = arg<0 ? x+arg : x+1;
+        aStack[nStack++] = -1;
+        break;
+      }
+      case RE_OP_SAVE: {
+        aStack[nStack++] = -1-arg;
+        aStack[nStack++] = aCap[arg];
+        aCap[arg] = iPos;
+        aStack[nStack++] = x+1;
+        aStack[nStack++] = -1;
+        break;
+      }
+      case RE_OP_BOUNDARY: {
+        if( re_word_char(c)!=re_word_char(cPrev) ){
+          aStack[nStack++] = x+1;
+          aStack[nStack++] = -1;
+        }
+        break;
+      }
+      default: {
+        memcpy(&aThread[pSet->nState*nSlot], aCap, sizeof(int)*nSlot);
+        pSet->aState[pSet->nState++] = x;
+        if( pRe->aOp[x].op==RE_OP_ANYSTAR ){
+          /* Staying on the ".*" comes first, as it is greedy */
+          aStack[nStack++] = x+1;
+          aStack[nStack++] = -1;
+        }
+        break;
+      }
+    }
+  }
+}
+
+/*
+** Find the first match of pRe, which must have been compiled with
+** re_compile_ex() and bCapture set, in the nIn bytes of zIn[] that
+** follow byte offset iStart.  This is a Pike VM: each thread of the NFA
+** carries its own capture slots.  Among the matches that start first,
+** the one chosen is the one preferred by greedy repetition and by the
+** left operand of "|".
+**
+** Return true if there is a match.  If there is, aCap[2*k] and
+** aCap[2*k+1] are set to the byte offsets of the start and the end of
+** group k, where group 0 is the whole match, or to -1 for groups that
+** took no part in the match.  aCap[] must have space for the slots of
+** all the groups of pRe.  No memory is allocated.
+*/
+static int re_exec(
+  ReCompiled *pRe,
+  const unsigned char *zIn,
+  int nIn,
+  int iStart,
+  int *aCap
+){
+  int nSlot = 2*(pRe->nGroup+1);
+  int *aThread[2];          /* Capture slots of the threads in aSet[] */
+  int *aNew;                /* Capture slots of a new thread */
+  int bAnchor;              /* True if the pattern starts with "^" */
+  int iFirst;               /* First state of a new thread */
+  int bMatch = 0;           /* True once a match has been found */
+  int iThis = 0;            /* Index of pThis in aSet[] */
+  int iPos;                 /* Offset of character c */
+  int cPrev, c, cNext;      /* Characters before, at, and after iPos */
+  ReStateSet *pThis, *pNext;
+  ReInput in, inNext;
+  unsigned i;
+  int k;
+
+  aThread[0] = pRe->aCapture;
+  aThread[1] = &aThread[0][(pRe->nState+1)*nSlot];
+  aNew = &aThread[1][(pRe->nState+1)*nSlot];
+  bAnchor = pRe->aOp[0].op!=RE_OP_ANYSTAR;
+  iFirst = bAnchor ? 0 : 1;
+  if( bAnchor && iStart>0 ) return 0;
+
+  /* Look for the initial prefix match, if there is one. */
+  if( pRe->nInit ){
+    unsigned char x = pRe->zInit[0];
+    while( iStart+pRe->nInit<=nIn
+     && (zIn[iStart]!=x ||
+         memcmp(zIn+iStart, pRe->zInit, pRe->nInit)!=0)
+    ){
+      iStart++;
+    }
+    if( iStart+pRe->nInit>nIn ) return 0;
+  }
+
+  in.z = zIn;
+  in.i = iStart;
+  in.mx = nIn;
+  iPos = iStart;
+  cPrev = re_prev_char(zIn, iStart);
+  c = pRe->xNextChar(&in);
+  pThis = &pRe->aSet[0];
+  re_clear_states(pThis, pRe->nState);
+  for(;;){
+    /* A match that starts at iPos comes after all the running threads */
+    if( !bMatch && (!bAnchor || iPos==iStart) ){
+      for(k=0; k<nSlot; k++) aNew[k] = -1;
+      re_add_thread(pRe, pThis, aThread[iThis], iFirst, aNew, iPos, cPrev, c);
+    }
+    if( pThis->nState==0 && (bMatch || bAnchor) ) break;
+    inNext = in;
+    cNext = pRe->xNextChar(&inNext);
+    pNext = &pRe->aSet[1-iThis];
+    re_clear_states(pNext, pRe->nState);
+    for(i=0; i<pThis->nState; i++){
+      int x = pThis->aState[i];
+      int *aT = &aThread[iThis][i*nSlot];
+      int y = x+1;
+      int hit = 0;
+      switch( pRe->aOp[x].op ){
+        case RE_OP_MATCH:    hit = pRe->aOp[x].arg==c;                 break;
+        case RE_OP_ANY:      hit = c!=RE_EOF;                          break;
+        case RE_OP_WORD:     hit = re_word_char(c);                    break;
+        case RE_OP_NOTWORD:  hit = !re_word_char(c) && c!=RE_EOF;      break;
+        case RE_OP_DIGIT:    hit = re_digit_char(c);                   break;
+        case RE_OP_NOTDIGIT: hit = !re_digit_char(c) && c!=RE_EOF;     break;
+        case RE_OP_SPACE:    hit = re_space_char(c);                   break;
+        case RE_OP_NOTSPACE: hit = !re_space_char(c) && c!=RE_EOF;     break;
+        case RE_OP_ANYSTAR: {
+          hit = c!=RE_EOF;
+          y = x;
+          break;
+        }
+        case RE_OP_ACCEPT: {
+          /* Threads after this one have a lower priority.  Drop them. */
+          memcpy(aCap, aT, sizeof(int)*nSlot);
+          bMatch = 1;
+          i = pThis->nState;
+          continue;
+        }
+        case RE_OP_CC_INC:
+        case RE_OP_CC_EXC: {
+          int j;
+          int n = pRe->aOp[x].arg;
+          for(j=1; j<n; j++){
+            if( pRe->aOp[x+j].op==RE_OP_CC_VALUE ){
+              if( pRe->aOp[x+j].arg==c ){ hit = 1; break; }
+            }else{
+              if( pRe->aOp[x+j].arg<=c && pRe->aOp[x+j+1].arg>=c ){
+                hit = 1;
+                break;
+              }
+              j++;
+            }
+          }
+          if( pRe->aOp[x].op==RE_OP_CC_EXC ) hit = !hit && c!=RE_EOF;
+          y = x+n;
+          break;
+        }
+      }
+      if( hit ){
+        re_add_thread(pRe, pNext, aThread[1-iThis], y, aT, in.i, c, cNext);
+      }
+    }
+    pThis = pNext;
+    iThis = 1-iThis;
+    if( c==RE_EOF ){
+      /* Only a "$" at the very end can have consumed the RE_EOF */
+      for(i=0; i<pThis->nState; i++){
+        if( pRe->aOp[pThis->aState[i]].op==RE_OP_ACCEPT ){
+          memcpy(aCap, &aThread[iThis][i*nSlot], sizeof(int)*nSlot);
+          bMatch = 1;
+          break;
+        }
+      }
+      break;
+    }
+    iPos = in.i;
+    cPrev = c;
+    c = cNext;
+    in = inNext;
+  }
+  return bMatch;
+}
+
+/*
+** A set of regular expressions that are matched together, in a single
+** pass over the input string, by the regexp_any() and regexp_which()
+** functions.  The programs of all the patterns are concatenated into one
+** NFA (the FORK, GOTO and character class arguments are relative, so they
+** need no adjustment) and the argument of each RE_OP_ACCEPT is set to the
+** number of the pattern it belongs to.
+**
+** Most patterns do not start with "^" and many start with a literal
+** string, recorded in zInit[] by re_compile().  Such a pattern cannot
+** match before the first occurrence of its literal prefix.  These
+** prefixes are entered into an Aho-Corasick automaton, which finds the
+** first occurrence of all of them in one scan of the input.  Patterns
+** whose prefix does not occur at all are then left out of the NFA run.
+*/
+typedef struct ReAcNode ReAcNode;
+struct ReAcNode {
+  int iChild;                 /* First child node, or 0 for none */
+  int iSibling;               /* Next child of the same parent, or 0 */
+  int iFail;                  /* Node for the longest proper suffix */
+  int iOut;                   /* First pattern whose prefix ends here or -1 */
+  int iDict;                  /* Next node on the iFail chain with iOut>=0 */
+  unsigned char c;            /* Byte leading from the parent to this node */
+};
+
+typedef struct ReSet ReSet;
+struct ReSet {
+  int nPat;                   /* Number of patterns (lines) in the set */
+  int nState;                 /* Number of entries in aOp[] */
+  ReOp *aOp;                  /* Programs of all the patterns */
+  int *aStart;                /* First state of each pattern or -1 if empty */
+  unsigned char *aAnchor;     /* True if the pattern started with "^" */
+  int *aInit;                 /* Length of the literal prefix of a pattern */
+  int *aNextOut;              /* Next pattern with the same literal prefix */
+  int nNode;                  /* Number of Aho-Corasick nodes */
+  ReAcNode *aNode;            /* Aho-Corasick nodes, aNode[0] is the root */
+  int aRoot[256];             /* Children of the root node, by byte */
+  /* Space used while matching.  It is part of the set so that nothing
+  ** needs to be allocated per call. */
+  int *aFirst;                /* First offset where a pattern may start */
+  int *aCand;                 /* Unanchored patterns that may match */
+  unsigned char *aHit;        /* True for each pattern that matched */
+  ReStateSet aSet[2];         /* Current and next NFA states */
+};
+
+/* Free a pattern set.
+*/
+static void re_set_free(ReSet *p){
+  if( p ){
+    sqlite3_free(p->aOp);
+    sqlite3_free(p->aStart);
+    sqlite3_free(p->aAnchor);
+    sqlite3_free(p->aInit);
+    sqlite3_free(p->aNextOut);
+    sqlite3_free(p->aNode);
+    sqlite3_free(p->aFirst);
+    sqlite3_free(p->aCand);
+    sqlite3_free(p->aHit);
+    sqlite3_free(p->aSet[0].aStamp);
+    sqlite3_free(p);
+  }
+}
+
+/* Return the child of Aho-Corasick node iNode for byte c or 0 if there is
+** none.
+*/
+static int re_ac_child(ReSet *p, int iNode, unsigned char c){
+  int i;
+  if( iNode==0 ) return p->aRoot[c];
+  for(i=p->aNode[iNode].iChild; i; i=p->aNode[i].iSibling){
+    if( p->aNode[i].c==c ) return i;
+  }
+  return 0;
+}
+
+/* Build the Aho-Corasick automaton for the literal prefixes of the
+** patterns.  apRe[k] is the compiled form of pattern k, or NULL.  Return
+** non-zero if out of memory.
+*/
+static int re_ac_build(ReSet *p, ReCompiled **apRe){
+  int *aQueue;
+  int nAlloc = 1;
+  int k, i, iNode, iHead, iTail;
+
+  for(k=0; k<p->nPat; k++){
+    if( apRe[k] && !p->aAnchor[k] ) nAlloc += apRe[k]->nInit;
+  }
+  p->aNode = sqlite3_malloc( sizeof(ReAcNode)*nAlloc );
+  aQueue = sqlite3_malloc( sizeof(int)*nAlloc );
+  if( p->aNode==0 || aQueue==0 ){
+    sqlite3_free(aQueue);
+    return 1;
+  }
+  memset(&p->aNode[0], 0, sizeof(ReAcNode));
+  p->aNode[0].iOut = -1;
+  p->aNode[0].iDict = 0;
+  p->nNode = 1;
+
+  /* Enter the prefixes into the trie */
+  for(k=0; k<p->nPat; k++){
+    p->aNextOut[k] = -1;
+    if( apRe[k]==0 || p->aAnchor[k] || apRe[k]->nInit==0 ) continue;
+    iNode = 0;
+    for(i=0; i<apRe[k]->nInit; i++){
+      unsigned char c = apRe[k]->zInit[i];
+      int iChild = re_ac_child(p, iNode, c);
+      if( iChild==0 ){
+        ReAcNode *pNew = &p->aNode[p->nNode];
+        iChild = p->nNode++;
+        memset(pNew, 0, sizeof(*pNew));
+        pNew->c = c;
+        pNew->iOut = -1;
+        if( iNode==0 ){
+          p->aRoot[c] = iChild;
+        }else{
+          pNew->iSibling = p->aNode[iNode].iChild;
+          p->aNode[iNode].iChild = iChild;
+        }
+      }
+      iNode = iChild;
+    }
+    p->aNextOut[k] = p->aNode[iNode].iOut;
+    p->aNode[iNode].iOut = k;
+  }
+
+  /* Compute the failure and dictionary links, breadth first */
+  iHead = iTail = 0;
+  for(i=0; i<256; i++){
+    if( p->aRoot[i] ) aQueue[iTail++] = p->aRoot[i];
+  }
+  while( iHead<iTail ){
+    int iParent = aQueue[iHead++];
+    for(iNode=p->aNode[iParent].iChild; iNode; iNode=p->aNode[iNode].iSibling){
+      ReAcNode *pNode = &p->aNode[iNode];
+      int iFail = p->aNode[iParent].iFail;
+      int iNext;
+      for(;;){
+        iNext = re_ac_child(p, iFail, pNode->c);
+        if( iNext || iFail==0 ) break;
+        iFail = p->aNode[iFail].iFail;
+      }
+      pNode->iFail = iNext;
+      pNode->iDict = p->aNode[iNext].iOut>=0 ? iNext : p->aNode[iNext].iDict;
+      aQueue[iTail++] = iNode;
+    }
+  }
+  sqlite3_free(aQueue);
+  return 0;
+}
+
+/*
+** Compile the nIn bytes of zIn, which holds one regular expression per
+** line, into a pattern set.  Empty lines are ignored but still counted
+** when numbering the patterns.  Return NULL on success or an error
+** message obtained from sqlite3_mprintf() if something goes wrong.  An
+** out of memory condition is reported by returning NULL and leaving
+** *ppSet set to NULL.
+*/
+static char *re_set_compile(ReSet **ppSet, const char *zIn, int nIn){
+  ReSet *p;
+  ReCompiled **apRe = 0;
+  char *zLine = 0;
+  char *zErr = 0;
+  int nPat = 1;
+  int i, j, k, nLine;
+  int bOom = 1;
+
+  *ppSet = 0;
+  for(i=0; i<nIn; i++){
+    if( zIn[i]=='\n' ) nPat++;
+  }
+  p = sqlite3_malloc( sizeof(*p) );
+  if( p==0 ) return 0;
+  memset(p, 0, sizeof(*p));
+  p->nPat = nPat;
+  apRe = sqlite3_malloc( sizeof(ReCompiled*)*nPat );
+  zLine = sqlite3_malloc( nIn+1 );
+  p->aStart = sqlite3_malloc( sizeof(int)*nPat );
+  p->aAnchor = sqlite3_malloc( nPat );
+  p->aInit = sqlite3_malloc( sizeof(int)*nPat );
+  p->aNextOut = sqlite3_malloc( sizeof(int)*nPat );
+  p->aFirst = sqlite3_malloc( sizeof(int)*nPat );
+  p->aCand = sqlite3_malloc( sizeof(int)*nPat );
+  p->aHit = sqlite3_malloc( nPat );
+  if( apRe==0 || zLine==0 || p->aStart==0 || p->aAnchor==0 || p->aInit==0
+   || p->aNextOut==0 || p->aFirst==0 || p->aCand==0 || p->aHit==0 ){
+    goto re_set_compile_end;
+  }
+  memset(apRe, 0, sizeof(ReCompiled*)*nPat);
+
+  /* Compile each pattern on its own */
+  for(i=k=0; k<nPat; k++){
+    for(j=i; j<nIn && zIn[j]!='\n'; j++){}
+    nLine = j-i;
+    if( nLine>0 && zIn[j-1]=='\r' ) nLine--;
+    memcpy(zLine, &zIn[i], nLine);
+    zLine[nLine] = 0;
+    i = j+1;
+    if( nLine==0 ) continue;
+    {
+      const char *zMsg = re_compile(&apRe[k], zLine, 0);
+      if( zMsg ){
+        zErr = sqlite3_mprintf("%s in pattern %d", zMsg, k+1);
+        if( zErr ) bOom = 0;
+        goto re_set_compile_end;
+      }
+      if( apRe[k]==0 ) goto re_set_compile_end;
+    }
+    p->nState += apRe[k]->nState;
+  }
+
+  /* Concatenate the programs */
+  p->aOp = sqlite3_malloc( sizeof(ReOp)*(p->nState>0 ? p->nState : 1) );
+  if( p->aOp==0 ) goto re_set_compile_end;
+  if( re_alloc_states(p->aSet, p->nState) ) goto re_set_compile_end;
+  for(i=k=0; k<nPat; k++){
+    ReCompiled *pRe = apRe[k];
+    p->aInit[k] = 0;
+    p->aAnchor[k] = 0;
+    if( pRe==0 ){
+      p->aStart[k] = -1;
+      continue;
+    }
+    p->aStart[k] = i;
+    if( pRe->aOp[0].op==RE_OP_ANYSTAR ){
+      /* The leading ".*" is implemented by re_set_match() instead */
+      p->aStart[k]++;
+      p->aInit[k] = pRe->nInit;
+    }else{
+      p->aAnchor[k] = 1;
+    }
+    memcpy(&p->aOp[i], pRe->aOp, sizeof(ReOp)*pRe->nState);
+    for(j=0; j<(int)pRe->nState; j++){
+      if( pRe->aOp[j].op==RE_OP_ACCEPT ) p->aOp[i+j].arg = k;
+    }
+    i += pRe->nState;
+  }
+  if( re_ac_build(p, apRe) ) goto re_set_compile_end;
+  bOom = 0;
+
+re_set_compile_end:
+  if( apRe ){
+    for(k=0; k<nPat; k++) re_free(apRe[k]);
+    sqlite3_free(apRe);
+  }
+  sqlite3_free(zLine);
+  if( zErr || bOom ){
+    re_set_free(p);
+  }else{
+    *ppSet = p;
+  }
+  return zErr;
+}
+
+/*
+** Match all the patterns of a set against the nIn bytes of zIn.  On
+** return, p->aHit[k] is true if pattern k matched.  If bAll is false,
+** matching stops at the first pattern that matches.  Return the number
+** of patterns that matched.
+*/
+static int re_set_match(ReSet *p, const unsigned char *zIn, int nIn, int bAll){
+  ReStateSet *pThis, *pNext;
+  ReInput in;
+  int nHit = 0;
+  int nCand = 0;
+  int bAnchor = 0;
+  int iSwap = 0;
+  int iStart = nIn;
+  int c = RE_EOF+1;
+  int cPrev = 0;
+  int iNode = 0;
+  int i, k;
+
+  memset(p->aHit, 0, p->nPat);
+
+  /* Find the first occurrence of each literal prefix */
+  for(k=0; k<p->nPat; k++){
+    p->aFirst[k] = (p->aStart[k]>=0 && p->aInit[k]==0) ? 0 : -1;
+    if( p->aStart[k]>=0 && p->aAnchor[k] ) bAnchor = 1;
+  }
+  if( p->nNode>1 ){
+    for(i=0; i<nIn; i++){
+      int iOut;
+      for(;;){
+        int iNext = re_ac_child(p, iNode, zIn[i]);
+        if( iNext || iNode==0 ){
+          iNode = iNext;
+          break;
+        }
+        iNode = p->aNode[iNode].iFail;
+      }
+      iOut = p->aNode[iNode].iOut>=0 ? iNode : p->aNode[iNode].iDict;
+      while( iOut>0 ){
+        for(k=p->aNode[iOut].iOut; k>=0; k=p->aNextOut[k]){
+          if( p->aFirst[k]<0 ) p->aFirst[k] = i+1-p->aInit[k];
+        }
+        iOut = p->aNode[iOut].iDict;
+      }
+    }
+  }
+  for(k=0; k<p->nPat; k++){
+    if( p->aFirst[k]<0 || p->aAnchor[k] ) continue;
+    p->aCand[nCand++] = k;
+    if( p->aFirst[k]<iStart ) iStart = p->aFirst[k];
+  }
+  if( nCand==0 && !bAnchor ) return 0;
+  if( bAnchor ) iStart = 0;
+
+  in.z = zIn;
+  in.i = iStart;
+  in.mx = nIn;
+  pNext = &p->aSet[1];
+  re_clear_states(pNext, p->nState);
+  for(k=0; k<p->nPat; k++){
+    if( p->aStart[k]>=0 && p->aAnchor[k] ) re_add_state(pNext, p->aStart[k]);
+  }
+  while( c!=RE_EOF && (pNext->nState>0 || nCand>0) ){
+    int iPos = in.i;
+    cPrev = c;
+    c = re_next_char(&in);
+    pThis = pNext;
+    pNext = &p->aSet[iSwap];
+    iSwap = 1 - iSwap;
+    re_clear_states(pNext, p->nState);
+    for(i=0; i<nCand; i++){
+      k = p->aCand[i];
+      if( p->aFirst[k]<=iPos && !p->aHit[k] ) re_add_state(pThis, p->aStart[k]);
+    }
+    for(i=0; i<(int)pThis->nState; i++){
+      int x = pThis->aState[i];
+      switch( p->aOp[x].op ){
+        case RE_OP_MATCH: {
+          if( p->aOp[x].arg==c ) re_add_state(pNext, x+1);
+          break;
+        }
+        case RE_OP_ANY: {
+          if( c!=RE_EOF ) re_add_state(pNext, x+1);
+          break;
+        }
+        case RE_OP_WORD: {
+          if( re_word_char(c) ) re_add_state(pNext, x+1);
+          break;
+        }
+        case RE_OP_NOTWORD: {
+          if( !re_word_char(c) && c!=RE_EOF ) re_add_state(pNext, x+1);
+          break;
+        }
+        case RE_OP_DIGIT: {
+          if( re_digit_char(c) ) re_add_state(pNext, x+1);
+          break;
+        }
+        case RE_OP_NOTDIGIT: {
+          if( !re_digit_char(c) && c!=RE_EOF ) re_add_state(pNext, x+1);
+          break;
+        }
+        case RE_OP_SPACE: {
+          if( re_space_char(c) ) re_add_state(pNext, x+1);
+          break;
+        }
+        case RE_OP_NOTSPACE: {
+          if( !re_space_char(c) && c!=RE_EOF ) re_add_state(pNext, x+1);
+          break;
+        }
+        case RE_OP_BOUNDARY: {
+          if( re_word_char(c)!=re_word_char(cPrev) ) re_add_state(pThis, x+1);
+          break;
+        }
+        case RE_OP_ANYSTAR: {
+          re_add_state(pNext, x);
+          re_add_state(pThis, x+1);
+          break;
+        }
+        case RE_OP_FORK: {
+          re_add_state(pThis, x+p->aOp[x].arg);
+          re_add_state(pThis, x+1);
+          break;
+        }
+        case RE_OP_GOTO: {
+          re_add_state(pThis, x+p->aOp[x].arg);
+          break;
+        }
+        case RE_OP_ACCEPT: {
+          k = p->aOp[x].arg;
+          if( !p->aHit[k] ){
+            p->aHit[k] = 1;
+            nHit++;
+            if( !bAll ) return nHit;
+          }
+          break;
+        }
+        case RE_OP_CC_INC:
+        case RE_OP_CC_EXC: {
+          int j = 1;
+          int n = p->aOp[x].arg;
+          int hit = 0;
+          for(j=1; j>0 && j<n; j++){
+            if( p->aOp[x+j].op==RE_OP_CC_VALUE ){
+              if( p->aOp[x+j].arg==c ){
+                hit = 1;
+                j = -1;
+              }
+            }else{
+              if( p->aOp[x+j].arg<=c && p->aOp[x+j+1].arg>=c ){
+                hit = 1;
+                j = -1;
+              }else{
+                j++;
+              }
+            }
+          }
+          if( p->aOp[x].op==RE_OP_CC_EXC ) hit = !hit && c!=RE_EOF;
+          if( hit ) re_add_state(pNext, x+n);
+          break;
+        }
+      }
+    }
+  }
+  for(i=0; i<(int)pNext->nState; i++){
+    int x = pNext->aState[i];
+    if( p->aOp[x].op==RE_OP_ACCEPT && !p->aHit[p->aOp[x].arg] ){
+      p->aHit[p->aOp[x].arg] = 1;
+      nHit++;
+    }
+  }
+  return nHit;
+}
+
+/*
+** Compiled regular expressions are kept in a cache that belongs to the
+** database connection and is shared by all of its statements.  This way
+** a pattern that changes from one row to the next (ex: "x REGEXP t.re")
+** or that is used again by a later statement does not have to be compiled
+** again.  Entries are keyed by the pattern text and the compile flags.
+** At most RE_CACHE_SIZE entries are kept; the least recently used one is
+** discarded to make room for a new one.
+*/
+#ifndef RE_CACHE_SIZE
+# define RE_CACHE_SIZE 64
+#endif
+#define RE_CACHE_NHASH 127     /* Number of hash table buckets */
+
+/* Compile flags for cache entries */
+#define RE_CACHE_NOCASE   0x01   /* Ignore the case of ASCII letters */
+#define RE_CACHE_SET      0x02   /* One pattern per line, see ReSet */
+#define RE_CACHE_CAPTURE  0x04   /* Record submatches, for re_exec() */
+
+/* One compiled pattern in the cache.  The entry is freed when the last
+** reference to it is released.  The cache itself holds one reference
+** while the entry is in the cache; each function call that is using the
+** compiled pattern (including through sqlite3_set_auxdata()) holds
+** another.
+*/
+typedef struct ReCacheEntry ReCacheEntry;
+struct ReCacheEntry {
+  char *zPattern;             /* Text of the pattern */
+  int nPattern;               /* Number of bytes in zPattern */
+  int flags;                  /* RE_CACHE_* compile flags */
+  unsigned h;                 /* Hash of the pattern and the flags */
+  int nRef;                   /* Number of references to this entry */
+  ReCompiled *pRe;            /* The compiled pattern */
+  ReSet *pSet;                /* The compiled pattern set (RE_CACHE_SET) */
+  ReCacheEntry *pHashNext;    /* Next entry in the same hash bucket */
+  ReCacheEntry *pPrev;        /* Next more recently used entry */
+  ReCacheEntry *pNext;        /* Next less recently used entry */
+};
+
+/* The compiled pattern cache for one database connection.
+*/
+typedef struct ReCache ReCache;
+struct ReCache {
+  int nRef;                   /* Number of functions using this cache */
+  int nEntry;                 /* Number of entries in the cache */
+  int mxEntry;                /* Maximum number of entries */
+  sqlite3_int64 nHit;         /* Lookups satisfied from the cache */
+  sqlite3_int64 nMiss;        /* Lookups that had to compile the pattern */
+  ReCacheEntry *pFirst;       /* Most recently used entry */
+  ReCacheEntry *pLast;        /* Least recently used entry */
+  ReCacheEntry *aHash[RE_CACHE_NHASH];  /* Hash table of all entries */
+};
+
+/* Release one reference to a cache entry, freeing it if that was the
+** last one.
+*/
+static void re_cache_release(void *p){
+  ReCacheEntry *pEntry = (ReCacheEntry*)p;
+  if( pEntry && --pEntry->nRef<=0 ){
+    re_free(pEntry->pRe);
+    re_set_free(pEntry->pSet);
+    sqlite3_free(pEntry->zPattern);
+    sqlite3_free(pEntry);
+  }
+}
+
+/* Unlink an entry from the LRU list of the cache.
+*/
+static void re_cache_unlink_lru(ReCache *pCache, ReCacheEntry *pEntry){
+  if( pEntry->pPrev ){
+    pEntry->pPrev->pNext = pEntry->pNext;
+  }else{
+    pCache->pFirst = pEntry->pNext;
+  }
+  if( pEntry->pNext ){
+    pEntry->pNext->pPrev = pEntry->pPrev;
+  }else{
+    pCache->pLast = pEntry->pPrev;
+  }
+  pEntry->pPrev = pEntry->pNext = 0;
+}
+
+/* Make an entry the most recently used one.
+*/
+static void re_cache_link_lru(ReCache *pCache, ReCacheEntry *pEntry){
+  pEntry->pPrev = 0;
+  pEntry->pNext = pCache->pFirst;
+  if( pCache->pFirst ){
+    pCache->pFirst->pPrev = pEntry;
+  }else{
+    pCache->pLast = pEntry;
+  }
+  pCache->pFirst = pEntry;
+}
+
+/* Remove an entry from the cache and release the reference held by the
+** cache.
+*/
+static void re_cache_remove(ReCache *pCache, ReCacheEntry *pEntry){
+  ReCacheEntry **pp = &pCache->aHash[pEntry->h % RE_CACHE_NHASH];
+  while( *pp!=pEntry ) pp = &(*pp)->pHashNext;
+  *pp = pEntry->pHashNext;
+  re_cache_unlink_lru(pCache, pEntry);
+  pCache->nEntry--;
+  re_cache_release(pEntry);
+}
+
+/* Release one reference to the cache, freeing it and all of its entries
+** if that was the last one.  This is the destructor for the application
+** data of the functions registered by sqlite3_regexp_init().
+*/
+static void re_cache_unref(void *p){
+  ReCache *pCache = (ReCache*)p;
+  if( pCache && --pCache->nRef<=0 ){
+    while( pCache->pFirst ) re_cache_remove(pCache, pCache->pFirst);
+    sqlite3_free(pCache);
+  }
+}
+
+/* Return the compiled form of the nPattern byte pattern zPattern, either
+** from the cache or by compiling (and caching) it.  The caller owns one
+** reference to the returned entry and must release it using
+** re_cache_release().  Return NULL and set *pzErr to an error message
+** obtained from sqlite3_mprintf() (or to NULL when out of memory) if the
+** pattern cannot be compiled.
+*/
+static ReCacheEntry *re_cache_acquire(
+  ReCache *pCache,
+  const char *zPattern,
+  int nPattern,
+  int flags,
+  char **pzErr
+){
+  ReCacheEntry *pEntry;
+  ReCompiled *pRe = 0;
+  ReSet *pSet = 0;
+  const char *zErr;
+  unsigned h = 0;
+  int i;
+
+  *pzErr = 0;
+  for(i=0; i<nPattern; i++){
+    h = (h<<3) ^ h ^ (unsigned char)zPattern[i];
+  }
+  h ^= (unsigned)flags;
+  for(pEntry=pCache->aHash[h % RE_CACHE_NHASH]; pEntry;
+      pEntry=pEntry->pHashNext){
+    if( pEntry->h==h && pEntry->nPattern==nPattern && pEntry->flags==flags
+     && memcmp(pEntry->zPattern, zPattern, nPattern)==0 ){
+      pCache->nHit++;
+      if( pCache->pFirst!=pEntry ){
+        re_cache_unlink_lru(pCache, pEntry);
+        re_cache_link_lru(pCache, pEntry);
+      }
+      pEntry->nRef++;
+      return pEntry;
+    }
+  }
+  pCache->nMiss++;
+  if( flags & RE_CACHE_SET ){
+    *pzErr = re_set_compile(&pSet, zPattern, nPattern);
+    if( pSet==0 ) return 0;
+  }else{
+    zErr = re_compile_ex(&pRe, zPattern, flags & RE_CACHE_NOCASE,
+                         flags & RE_CACHE_CAPTURE);
+    if( zErr ){
+      re_free(pRe);
+      *pzErr = sqlite3_mprintf("%s", zErr);
+      return 0;
+    }
+    if( pRe==0 ) return 0;
+  }
+  pEntry = sqlite3_malloc( sizeof(*pEntry) );
+  if( pEntry ){
+    memset(pEntry, 0, sizeof(*pEntry));
+    pEntry->zPattern = sqlite3_malloc( nPattern+1 );
+  }
+  if( pEntry==0 || pEntry->zPattern==0 ){
+    sqlite3_free(pEntry);
+    re_free(pRe);
+    re_set_free(pSet);
+    return 0;
+  }
+  memcpy(pEntry->zPattern, zPattern, nPattern);
+  pEntry->zPattern[nPattern] = 0;
+  pEntry->nPattern = nPattern;
+  pEntry->flags = flags;
+  pEntry->h = h;
+  pEntry->pRe = pRe;
+  pEntry->pSet = pSet;
+  pEntry->nRef = 2;  /* One for the cache and one for the caller */
+  if( pCache->nEntry>=pCache->mxEntry && pCache->pLast ){
+    re_cache_remove(pCache, pCache->pLast);
+  }
+  pEntry->pHashNext = pCache->aHash[h % RE_CACHE_NHASH];
+  pCache->aHash[h % RE_CACHE_NHASH] = pEntry;
+  re_cache_link_lru(pCache, pEntry);
+  pCache->nEntry++;
+  return pEntry;
+}
+
 /*
 ** Implementation of the regexp() SQL function.  This function implements
 ** the build-in REGEXP operator.  The first argument to the function is the
@@ -709,34 +1679,387 @@ static void re_sql_func(
   int argc, 
   sqlite3_value **argv
 ){
-  ReCompiled *pRe;          /* Compiled regular expression */
+  ReCacheEntry *pEntry;     /* Cached compiled regular expression */
   const char *zPattern;     /* The regular expression */
   const unsigned char *zStr;/* String being searched */
-  const char *zErr;         /* Compile error message */
+  char *zErr;               /* Compile error message */
   int setAux = 0;           /* True to invoke sqlite3_set_auxdata() */
 
-  pRe = sqlite3_get_auxdata(context, 0);
-  if( pRe==0 ){
+  pEntry = sqlite3_get_auxdata(context, 0);
+  if( pEntry==0 ){
     zPattern = (const char*)sqlite3_value_text(argv[0]);
     if( zPattern==0 ) return;
-    zErr = re_compile(&pRe, zPattern, 0);
-    if( zErr ){
-      re_free(pRe);
-      sqlite3_result_error(context, zErr, -1);
-      return;
-    }
-    if( pRe==0 ){
-      sqlite3_result_error_nomem(context);
+    pEntry = re_cache_acquire((ReCache*)sqlite3_user_data(context), zPattern,
+                              sqlite3_value_bytes(argv[0]), 0, &zErr);
+    if( pEntry==0 ){
+      if( zErr ){
+        sqlite3_result_error(context, zErr, -1);
+        sqlite3_free(zErr);
+      }else{
+        sqlite3_result_error_nomem(context);
+      }
       return;
     }
     setAux = 1;
   }
   zStr = (const unsigned char*)sqlite3_value_text(argv[1]);
   if( zStr!=0 ){
-    sqlite3_result_int(context, re_match(pRe, zStr, -1));
+    sqlite3_result_int(context, re_match(pEntry->pRe, zStr, -1));
   }
   if( setAux ){
-    sqlite3_set_auxdata(context, 0, pRe, (void(*)(void*))re_free);
+    sqlite3_set_auxdata(context, 0, pEntry, re_cache_release);
+  }
+}
+
+/*
+** Return the compiled form, with the RE_CACHE_* flags given, of the
+** pattern in argument iArg of a function call.  The caller owns a
+** reference to the entry and must pass it to re_entry_done().  Return
+** NULL if the pattern is NULL or cannot be compiled, in which case the
+** result has been set to NULL or to an error.
+*/
+static ReCacheEntry *re_entry_get(
+  sqlite3_context *context,
+  sqlite3_value **argv,
+  int iArg,
+  int flags
+){
+  ReCacheEntry *pEntry;     /* Cached compiled pattern */
+  const char *zPattern;     /* The regular expression */
+  char *zErr;               /* Compile error message */
+
+  pEntry = sqlite3_get_auxdata(context, iArg);
+  if( pEntry ){
+    pEntry->nRef++;
+    return pEntry;
+  }
+  zPattern = (const char*)sqlite3_value_text(argv[iArg]);
+  if( zPattern==0 ) return 0;
+  pEntry = re_cache_acquire((ReCache*)sqlite3_user_data(context), zPattern,
+                            sqlite3_value_bytes(argv[iArg]), flags, &zErr);
+  if( pEntry==0 ){
+    if( zErr ){
+      sqlite3_result_error(context, zErr, -1);
+      sqlite3_free(zErr);
+    }else{
+      sqlite3_result_error_nomem(context);
+    }
+  }
+  return pEntry;
+}
+
+/*
+** Finish with the entry returned by re_entry_get(), keeping it with the
+** function call so that later rows can use it without a cache lookup.
+*/
+static void re_entry_done(
+  sqlite3_context *context,
+  int iArg,
+  ReCacheEntry *pEntry
+){
+  if( pEntry ){
+    if( sqlite3_get_auxdata(context, iArg)==(void*)pEntry ){
+      re_cache_release(pEntry);
+    }else{
+      sqlite3_set_auxdata(context, iArg, pEntry, re_cache_release);
+    }
+  }
+}
+
+/*
+** Match the pattern set in argv[0] against the string in argv[1].  This
+** is the common part of regexp_any() and regexp_which().  Return the
+** number of patterns that matched or -1 if no result should be set, the
+** result having been set to NULL or an error already.  The caller owns a
+** reference to *ppEntry, if it is not NULL, and must pass it to
+** re_entry_done().
+*/
+static int re_set_run(
+  sqlite3_context *context,
+  sqlite3_value **argv,
+  int bAll,
+  ReCacheEntry **ppEntry
+){
+  ReCacheEntry *pEntry;     /* Cached compiled pattern set */
+  const unsigned char *zStr;/* String being searched */
+
+  *ppEntry = pEntry = re_entry_get(context, argv, 0, RE_CACHE_SET);
+  if( pEntry==0 ) return -1;
+  zStr = (const unsigned char*)sqlite3_value_text(argv[1]);
+  if( zStr==0 ) return -1;
+  return re_set_match(pEntry->pSet, zStr, sqlite3_value_bytes(argv[1]), bAll);
+}
+
+/*
+** Implementation of the regexp_any(PATTERNS,X) SQL function.  PATTERNS
+** holds one regular expression per line.  All of them are matched against
+** the string X in a single pass.  The result is 1 if any of the patterns
+** match and 0 otherwise.
+*/
+static void re_any_func(
+  sqlite3_context *context, 
+  int argc, 
+  sqlite3_value **argv
+){
+  ReCacheEntry *pEntry;
+  int nHit = re_set_run(context, argv, 0, &pEntry);
+  if( nHit>=0 ){
+    sqlite3_result_int(context, nHit>0);
+  }
+  re_entry_done(context, 0, pEntry);
+}
+
+/*
+** Implementation of the regexp_which(PATTERNS,X) SQL function.  Same as
+** regexp_any() except that the result is a JSON array with the (1-based)
+** line numbers of the patterns that match, in order, ex: "[2,5]".  Empty
+** lines are not patterns but are still counted.
+*/
+static void re_which_func(
+  sqlite3_context *context, 
+  int argc, 
+  sqlite3_value **argv
+){
+  ReCacheEntry *pEntry;
+  ReSet *pSet;
+  char *zOut, *z;
+  int nHit = re_set_run(context, argv, 1, &pEntry);
+  int k;
+  if( nHit>=0 ){
+    pSet = pEntry->pSet;
+    /* Each number takes at most 10 digits plus a separator */
+    zOut = z = sqlite3_malloc( nHit*11 + 3 );
+    if( zOut==0 ){
+      sqlite3_result_error_nomem(context);
+    }else{
+      *(z++) = '[';
+      for(k=0; k<pSet->nPat; k++){
+        if( !pSet->aHit[k] ) continue;
+        if( z[-1]!='[' ) *(z++) = ',';
+        sqlite3_snprintf(12, z, "%d", k+1);
+        z += strlen(z);
+      }
+      *(z++) = ']';
+      *z = 0;
+      sqlite3_result_text(context, zOut, (int)(z-zOut), sqlite3_free);
+    }
+  }
+  re_entry_done(context, 0, pEntry);
+}
+
+/*
+** Implementation of the regexp_extract(X,PATTERN,N) SQL function.  The
+** result is the text matched by group N of the first match of PATTERN in
+** the string X, or NULL if there is no match or group N took no part in
+** it.  Groups are numbered from 1, in the order of their "(", and group
+** 0 is the whole match.  N may be omitted, in which case it is 0.
+*/
+static void re_extract_func(
+  sqlite3_context *context, 
+  int argc, 
+  sqlite3_value **argv
+){
+  ReCacheEntry *pEntry;     /* Cached compiled regular expression */
+  const unsigned char *zStr;/* String being searched */
+  int aCap[2*(RE_MAX_GROUP+1)];
+  int iGroup = 0;
+
+  pEntry = re_entry_get(context, argv, 1, RE_CACHE_CAPTURE);
+  if( pEntry==0 ) return;
+  if( argc>2 ) iGroup = sqlite3_value_int(argv[2]);
+  if( iGroup<0 || iGroup>pEntry->pRe->nGroup ){
+    sqlite3_result_error(context, "regexp_extract() group out of range", -1);
+  }else{
+    zStr = (const unsigned char*)sqlite3_value_text(argv[0]);
+    if( zStr!=0
+     && re_exec(pEntry->pRe, zStr, sqlite3_value_bytes(argv[0]), 0, aCap)
+     && aCap[2*iGroup]>=0
+    ){
+      sqlite3_result_text(context, (const char*)zStr + aCap[2*iGroup],
+                          aCap[2*iGroup+1] - aCap[2*iGroup],
+                          SQLITE_TRANSIENT);
+    }
+  }
+  re_entry_done(context, 1, pEntry);
+}
+
+/*
+** Return the offset at which to look for the match that follows the one
+** recorded in aCap[].  After an empty match, that is one character
+** further on, so that the same empty match is not found again.
+*/
+static int re_next_start(const unsigned char *zIn, int nIn, int *aCap){
+  int i = aCap[1];
+  if( aCap[0]==i ){
+    for(i++; i<nIn && (zIn[i]&0xc0)==0x80; i++){}
+  }
+  return i;
+}
+
+/*
+** Implementation of the regexp_count(X,PATTERN) SQL function.  The result
+** is the number of non-overlapping matches of PATTERN in the string X.
+*/
+static void re_count_func(
+  sqlite3_context *context, 
+  int argc, 
+  sqlite3_value **argv
+){
+  ReCacheEntry *pEntry;     /* Cached compiled regular expression */
+  const unsigned char *zStr;/* String being searched */
+  int aCap[2*(RE_MAX_GROUP+1)];
+  int nStr, i;
+  sqlite3_int64 nMatch = 0;
+
+  pEntry = re_entry_get(context, argv, 1, RE_CACHE_CAPTURE);
+  if( pEntry==0 ) return;
+  zStr = (const unsigned char*)sqlite3_value_text(argv[0]);
+  if( zStr!=0 ){
+    nStr = sqlite3_value_bytes(argv[0]);
+    for(i=0; i<=nStr && re_exec(pEntry->pRe, zStr, nStr, i, aCap); ){
+      nMatch++;
+      i = re_next_start(zStr, nStr, aCap);
+    }
+    sqlite3_result_int64(context, nMatch);
+  }
+  re_entry_done(context, 1, pEntry);
+}
+
+/* A string under construction by regexp_replace().
+*/
+typedef struct ReBuf ReBuf;
+struct ReBuf {
+  char *z;                    /* The string, not zero-terminated */
+  int n;                      /* Number of bytes used in z[] */
+  int nAlloc;                 /* Number of bytes allocated for z[] */
+  int bTooBig;                /* True if the string got too large */
+};
+
+/* Append the n bytes of z[] to the string under construction.  Return
+** non-zero if out of memory or if the string got too large.
+*/
+static int re_buf_append(ReBuf *p, const char *z, int n){
+  if( n<=0 ) return 0;
+  if( n>p->nAlloc-p->n ){
+    sqlite3_int64 nNew = (sqlite3_int64)p->nAlloc*2 + n;
+    char *zNew;
+    if( nNew>0x7fffffff ){
+      p->bTooBig = 1;
+      return 1;
+    }
+    zNew = sqlite3_realloc(p->z, (int)nNew);
+    if( zNew==0 ) return 1;
+    p->z = zNew;
+    p->nAlloc = (int)nNew;
+  }
+  memcpy(&p->z[p->n], z, n);
+  p->n += n;
+  return 0;
+}
+
+/*
+** Implementation of the regexp_replace(X,PATTERN,R) SQL function.  The
+** result is the string X with every non-overlapping match of PATTERN
+** replaced by R.  In R, "\0" stands for the whole match, "\1" through
+** "\9" for the text matched by the corresponding group (or nothing, if
+** the group took no part in the match) and "\\" for a single backslash.
+*/
+static void re_replace_func(
+  sqlite3_context *context, 
+  int argc, 
+  sqlite3_value **argv
+){
+  ReCacheEntry *pEntry;     /* Cached compiled regular expression */
+  const unsigned char *zStr;/* String being searched */
+  const char *zRep;         /* The replacement */
+  int aCap[2*(RE_MAX_GROUP+1)];
+  int nStr, nRep, i, j, k;
+  int iCopy = 0;            /* Bytes of zStr[] copied into the result */
+  int rc = 0;
+  ReBuf out;
+
+  pEntry = re_entry_get(context, argv, 1, RE_CACHE_CAPTURE);
+  if( pEntry==0 ) return;
+  zStr = (const unsigned char*)sqlite3_value_text(argv[0]);
+  nStr = sqlite3_value_bytes(argv[0]);
+  zRep = (const char*)sqlite3_value_text(argv[2]);
+  nRep = sqlite3_value_bytes(argv[2]);
+  if( zStr==0 || zRep==0 ) goto replace_end;
+  for(j=0; j<nRep; j++){
+    if( zRep[j]!='\\' || j+1>=nRep ) continue;
+    j++;
+    if( zRep[j]>='0' && zRep[j]<='9' && zRep[j]-'0'>pEntry->pRe->nGroup ){
+      sqlite3_result_error(context, "regexp_replace() group out of range",
+                           -1);
+      goto replace_end;
+    }
+  }
+  memset(&out, 0, sizeof(out));
+  for(i=0; rc==0 && i<=nStr && re_exec(pEntry->pRe, zStr, nStr, i, aCap); ){
+    rc = re_buf_append(&out, (const char*)zStr+iCopy, aCap[0]-iCopy);
+    for(j=k=0; rc==0 && j+1<nRep; j++){
+      char c = zRep[j+1];
+      if( zRep[j]!='\\' || (c!='\\' && (c<'0' || c>'9')) ) continue;
+      rc = re_buf_append(&out, &zRep[k], j-k);
+      if( rc==0 && c=='\\' ){
+        rc = re_buf_append(&out, "\\", 1);
+      }else if( rc==0 && aCap[2*(c-'0')]>=0 ){
+        rc = re_buf_append(&out, (const char*)zStr + aCap[2*(c-'0')],
+                           aCap[2*(c-'0')+1] - aCap[2*(c-'0')]);
+      }
+      j++;
+      k = j+1;
+    }
+    if( rc==0 ) rc = re_buf_append(&out, &zRep[k], nRep-k);
+    iCopy = aCap[1];
+    i = re_next_start(zStr, nStr, aCap);
+  }
+  if( rc==0 ) rc = re_buf_append(&out, (const char*)zStr+iCopy, nStr-iCopy);
+  if( rc==0 && out.z==0 ){
+    sqlite3_result_text(context, "", 0, SQLITE_STATIC);
+  }else if( rc==0 ){
+    sqlite3_result_text(context, out.z, out.n, sqlite3_free);
+  }else{
+    sqlite3_free(out.z);
+    if( out.bTooBig ){
+      sqlite3_result_error_toobig(context);
+    }else{
+      sqlite3_result_error_nomem(context);
+    }
+  }
+
+replace_end:
+  re_entry_done(context, 1, pEntry);
+}
+
+/*
+** Implementation of the regexp_cache_status(NAME) SQL function.  It
+** returns one of the statistics of the compiled pattern cache of the
+** database connection:
+**
+**       hits      Number of patterns found in the cache
+**       misses    Number of patterns that had to be compiled
+**       entries   Number of patterns currently in the cache
+**       size      Maximum number of patterns in the cache
+*/
+static void re_cache_status_func(
+  sqlite3_context *context, 
+  int argc, 
+  sqlite3_value **argv
+){
+  ReCache *pCache = (ReCache*)sqlite3_user_data(context);
+  const char *zName = (const char*)sqlite3_value_text(argv[0]);
+  if( zName==0 ) return;
+  if( sqlite3_stricmp(zName, "hits")==0 ){
+    sqlite3_result_int64(context, pCache->nHit);
+  }else if( sqlite3_stricmp(zName, "misses")==0 ){
+    sqlite3_result_int64(context, pCache->nMiss);
+  }else if( sqlite3_stricmp(zName, "entries")==0 ){
+    sqlite3_result_int(context, pCache->nEntry);
+  }else if( sqlite3_stricmp(zName, "size")==0 ){
+    sqlite3_result_int(context, pCache->mxEntry);
+  }else{
+    sqlite3_result_error(context, "unknown regexp cache statistic", -1);
   }
 }
 
@@ -753,8 +2076,46 @@ int sqlite3_regexp_init(
   const sqlite3_api_routines *pApi
 ){
   int rc = SQLITE_OK;
+  ReCache *pCache;
   SQLITE_EXTENSION_INIT2(pApi);
-  rc = sqlite3_create_function(db, "regexp", 2, SQLITE_UTF8, 0,
-                                 re_sql_func, 0, 0);
+  pCache = sqlite3_malloc( sizeof(*pCache) );
+  if( pCache==0 ) return SQLITE_NOMEM;
+  memset(pCache, 0, sizeof(*pCache));
+  pCache->mxEntry = RE_CACHE_SIZE;
+
+  /* Each function holds a reference to the cache.  If the registration
+  ** fails, the destructor is invoked and releases that reference. */
+  pCache->nRef++;
+  rc = sqlite3_create_function_v2(db, "regexp", 2, SQLITE_UTF8, pCache,
+                                  re_sql_func, 0, 0, re_cache_unref);
+  if( rc!=SQLITE_OK ) return rc;
+  pCache->nRef++;
+  rc = sqlite3_create_function_v2(db, "regexp_any", 2, SQLITE_UTF8, pCache,
+                                  re_any_func, 0, 0, re_cache_unref);
+  if( rc!=SQLITE_OK ) return rc;
+  pCache->nRef++;
+  rc = sqlite3_create_function_v2(db, "regexp_which", 2, SQLITE_UTF8, pCache,
+                                  re_which_func, 0, 0, re_cache_unref);
+  if( rc!=SQLITE_OK ) return rc;
+  pCache->nRef++;
+  rc = sqlite3_create_function_v2(db, "regexp_extract", 2, SQLITE_UTF8, pCache,
+                                  re_extract_func, 0, 0, re_cache_unref);
+  if( rc!=SQLITE_OK ) return rc;
+  pCache->nRef++;
+  rc = sqlite3_create_function_v2(db, "regexp_extract", 3, SQLITE_UTF8, pCache,
+                                  re_extract_func, 0, 0, re_cache_unref);
+  if( rc!=SQLITE_OK ) return rc;
+  pCache->nRef++;
+  rc = sqlite3_create_function_v2(db, "regexp_replace", 3, SQLITE_UTF8, pCache,
+                                  re_replace_func, 0, 0, re_cache_unref);
+  if( rc!=SQLITE_OK ) return rc;
+  pCache->nRef++;
+  rc = sqlite3_create_function_v2(db, "regexp_count", 2, SQLITE_UTF8, pCache,
+                                  re_count_func, 0, 0, re_cache_unref);
+  if( rc!=SQLITE_OK ) return rc;
+  pCache->nRef++;
+  rc = sqlite3_create_function_v2(db, "regexp_cache_status", 1, SQLITE_UTF8,
+                                  pCache, re_cache_status_func, 0, 0,
+                                  re_cache_unref);
   return rc;
 }
@@ -0,0 +1,1491 @@
+/*
+** 2014-12-09
+**
+** The author disclaims copyright to this source code.  In place of
+** a legal notice, here is a blessing:
+**
+**    May you do good and not evil.
+**    May you find forgiveness for yourself and forgive others.
+**    May you share freely, never taking more than you give.
+**
+******************************************************************************
+**
+** This SQLite extension implements a virtual table, named "trigram", that
+** indexes one text column by its trigrams (each run of three bytes) so
+** that substring searches do not have to scan every row:
+**
+**     CREATE VIRTUAL TABLE product_name USING trigram(name, soundex=1);
+**
+**     CREATE TRIGGER product_ai AFTER INSERT ON product BEGIN
+**       INSERT INTO product_name(rowid, name) VALUES(new.rowid, new.name);
+**     END;
+**     CREATE TRIGGER product_ad AFTER DELETE ON product BEGIN
+**       DELETE FROM product_name WHERE rowid = old.rowid;
+**     END;
+**     CREATE TRIGGER product_au AFTER UPDATE OF name ON product BEGIN
+**       UPDATE product_name SET name = new.name WHERE rowid = old.rowid;
+**     END;
+**
+**     SELECT * FROM product WHERE rowid IN
+**       (SELECT rowid FROM product_name WHERE name MATCH '%widget%');
+**
+** The right-hand side of MATCH is a LIKE pattern, with the same meaning as
+** the built-in LIKE operator: "%" matches any run of characters, "_" any
+** one character, and ASCII letters match regardless of case.  The index
+** finds the rows that contain every trigram of the literal parts of the
+** pattern, and each of those rows is then checked against the pattern.  A
+** pattern without three literal characters in a row is answered by a full
+** scan.  Expressions such as "name LIKE '%x%'" or "charindex('x', name)>0"
+** can be written as "name MATCH '%x%'" to use the index.
+**
+** The table also has a hidden column named "soundex", which holds the
+** soundex code of the text, as computed by the difference() function of
+** extension-functions.c.  With the soundex=1 argument, these codes are
+** indexed too, so that the rows that sound like a name can be found with:
+**
+**     SELECT rowid FROM product_name
+**      WHERE soundex = trigram_soundex('Smyth');
+**
+** which are the rows for which difference(name, 'Smyth') is 4.
+**
+** The text is kept in the shadow table %_content.  The posting list of each
+** trigram or soundex code (the sorted rowids of the rows that contain it)
+** is split into blocks of at most TRIGRAM_BLOCK_SIZE rowids, stored in the
+** shadow table %_index as delta-encoded varints.  Changes made by INSERT,
+** UPDATE and DELETE are gathered in memory and merged into the affected
+** blocks when the transaction commits, when a savepoint is opened, before
+** the index is queried, or when TRIGRAM_MAX_PENDING changes are pending.
+*/
+#include "sqlite3ext.h"
+SQLITE_EXTENSION_INIT1
+#include <stdlib.h>
+#include <string.h>
+
+/*
+** The maximum number of rowids in one block of a posting list.
+*/
+#ifndef TRIGRAM_BLOCK_SIZE
+# define TRIGRAM_BLOCK_SIZE 1024
+#endif
+
+/*
+** The number of pending posting list changes that causes them to be
+** written to the %_index table before the end of the transaction.
+*/
+#ifndef TRIGRAM_MAX_PENDING
+# define TRIGRAM_MAX_PENDING (1024*1024)
+#endif
+
+/*
+** A posting list is only intersected with the rows found so far if it is
+** at most this many times longer.  Otherwise, the rows are just checked
+** against the pattern.
+*/
+#ifndef TRIGRAM_INTERSECT_RATIO
+# define TRIGRAM_INTERSECT_RATIO 64
+#endif
+
+/*
+** Posting list terms.  A trigram is stored as its three bytes, with ASCII
+** letters folded to lower case.  A soundex code is stored as its four
+** characters, above all the trigrams.
+*/
+#define TRIGRAM_SOUNDEX_TERM  (((sqlite3_int64)1)<<32)
+
+/*
+** Limits of 64-bit rowids.
+*/
+#define TRIGRAM_LARGEST_INT64  (0xffffffff|(((sqlite3_int64)0x7fffffff)<<32))
+#define TRIGRAM_SMALLEST_INT64 (((sqlite3_int64)-1) - TRIGRAM_LARGEST_INT64)
+
+/*
+** Query plans, the idxNum values passed from xBestIndex to xFilter.
+*/
+#define TRIGRAM_PLAN_SCAN     0    /* Scan all the rows */
+#define TRIGRAM_PLAN_ROWID    1    /* rowid=?1 */
+#define TRIGRAM_PLAN_SOUNDEX  2    /* soundex=?1 */
+#define TRIGRAM_PLAN_MATCH    3    /* text MATCH ?1 */
+
+/*
+** The column numbers of the virtual table.
+*/
+#define TRIGRAM_COLUMN_TEXT     0
+#define TRIGRAM_COLUMN_SOUNDEX  1
+
+/*
+** The statements cached by each virtual table.
+*/
+#define TRIGRAM_STMT_CONTENT_INSERT  0
+#define TRIGRAM_STMT_CONTENT_DELETE  1
+#define TRIGRAM_STMT_CONTENT_SELECT  2
+#define TRIGRAM_STMT_CONTENT_UPDATE  3
+#define TRIGRAM_STMT_INDEX_RANGE     4
+#define TRIGRAM_STMT_INDEX_COUNT     5
+#define TRIGRAM_STMT_INDEX_INSERT    6
+#define TRIGRAM_STMT_INDEX_DELETE    7
+#define TRIGRAM_NSTMT                8
+
+typedef struct TrigramList TrigramList;
+typedef struct TrigramOp TrigramOp;
+typedef struct TrigramPending TrigramPending;
+typedef struct TrigramTable TrigramTable;
+typedef struct TrigramCursor TrigramCursor;
+
+/*
+** A growable array of rowids or terms.
+*/
+struct TrigramList {
+  sqlite3_int64 *a;             /* The values */
+  int n;                        /* Number of values in a[] */
+  int nAlloc;                   /* Number of values allocated for a[] */
+};
+
+/*
+** A pending change to a posting list.
+*/
+struct TrigramOp {
+  sqlite3_int64 iRowid;         /* The row */
+  int iSeq;                     /* Order of the change */
+  int bDelete;                  /* True to remove the row, false to add it */
+};
+
+/*
+** The pending changes to the posting list of one term.
+*/
+struct TrigramPending {
+  sqlite3_int64 iTerm;          /* The term */
+  int nOp;                      /* Number of changes in aOp[] */
+  int nOpAlloc;                 /* Number of changes allocated for aOp[] */
+  TrigramOp *aOp;               /* The changes, in order */
+  TrigramPending *pNext;        /* Next term in the same hash bucket */
+};
+
+/*
+** An instance of the trigram virtual table.
+*/
+struct TrigramTable {
+  sqlite3_vtab base;            /* Base class.  Must be first */
+  sqlite3 *db;                  /* The database connection */
+  char *zDb;                    /* Name of the database holding the table */
+  char *zName;                  /* Name of the virtual table */
+  int bSoundex;                 /* True if the soundex codes are indexed */
+  sqlite3_stmt *aStmt[TRIGRAM_NSTMT];  /* Cached statements, or NULL */
+  int nHash;                    /* Number of buckets in apHash[] */
+  int nTerm;                    /* Number of terms in apHash[] */
+  int nOp;                      /* Total number of pending changes */
+  TrigramPending **apHash;      /* Pending changes, by term */
+};
+
+/*
+** A cursor for the trigram virtual table.  The rows are either read with
+** a scan of the %_content table or looked up, one entry of rowids at a
+** time.
+*/
+struct TrigramCursor {
+  sqlite3_vtab_cursor base;     /* Base class.  Must be first */
+  sqlite3_stmt *pScan;          /* Scan of the content, or NULL */
+  sqlite3_stmt *pLookup;        /* Lookup of one row of the content */
+  TrigramList rowids;           /* The rows to look up */
+  int iRowid;                   /* Next entry of rowids to look up */
+  char *zPattern;               /* LIKE pattern rows must match, or NULL */
+  int bEof;                     /* True at the end of the rows */
+};
+
+/*
+** Fold an ASCII letter to lower case.
+*/
+#define TRIGRAM_FOLD(c) ((c)>='A' && (c)<='Z' ? (c)+32 : (c))
+
+/*
+** True if c is an ASCII letter.
+*/
+#define TRIGRAM_ISALPHA(c) (TRIGRAM_FOLD(c)>='a' && TRIGRAM_FOLD(c)<='z')
+
+/*
+** Move z past one UTF-8 character.
+*/
+#define TRIGRAM_SKIP_UTF8(z) {                          \
+  if( (*(z++))>=0xc0 ){                                 \
+    while( (*z & 0xc0)==0x80 ){ z++; }                  \
+  }                                                     \
+}
+
+/*
+** Make sure pList has room for n more values.  Return SQLITE_OK or
+** SQLITE_NOMEM.
+*/
+static int trigramListReserve(TrigramList *pList, int n){
+  if( pList->n+n>pList->nAlloc ){
+    int nNew = pList->nAlloc ? pList->nAlloc*2 : 64;
+    sqlite3_int64 *aNew;
+    while( nNew<pList->n+n ) nNew *= 2;
+    aNew = sqlite3_realloc(pList->a, nNew*sizeof(sqlite3_int64));
+    if( aNew==0 ) return SQLITE_NOMEM;
+    pList->a = aNew;
+    pList->nAlloc = nNew;
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Append value v to pList.  Return SQLITE_OK or SQLITE_NOMEM.
+*/
+static int trigramListAppend(TrigramList *pList, sqlite3_int64 v){
+  if( trigramListReserve(pList, 1) ) return SQLITE_NOMEM;
+  pList->a[pList->n++] = v;
+  return SQLITE_OK;
+}
+
+/*
+** Free the values of pList.
+*/
+static void trigramListFree(TrigramList *pList){
+  sqlite3_free(pList->a);
+  memset(pList, 0, sizeof(*pList));
+}
+
+/*
+** Comparison function for qsort() on an array of sqlite3_int64 values.
+*/
+static int trigramCompareInt64(const void *pA, const void *pB){
+  sqlite3_int64 a = *(const sqlite3_int64 *)pA;
+  sqlite3_int64 b = *(const sqlite3_int64 *)pB;
+  return a<b ? -1 : a>b;
+}
+
+/*
+** Sort the values of pList and remove the duplicates.
+*/
+static void trigramListSort(TrigramList *pList){
+  int i, j;
+  if( pList->n<2 ) return;
+  qsort(pList->a, pList->n, sizeof(sqlite3_int64), trigramCompareInt64);
+  for(i=j=1; i<pList->n; i++){
+    if( pList->a[i]!=pList->a[j-1] ) pList->a[j++] = pList->a[i];
+  }
+  pList->n = j;
+}
+
+/*
+** Remove from the sorted list pList the values that are not in the sorted
+** array a[] of n values.
+*/
+static void trigramListIntersect(
+  TrigramList *pList,
+  const sqlite3_int64 *a,
+  int n
+){
+  int i = 0, j = 0, k = 0;
+  while( i<pList->n && j<n ){
+    if( pList->a[i]<a[j] ){
+      i++;
+    }else if( pList->a[i]>a[j] ){
+      j++;
+    }else{
+      pList->a[k++] = pList->a[i++];
+      j++;
+    }
+  }
+  pList->n = k;
+}
+
+/*
+** Write v to p as a varint of 7 bits per byte, least significant first,
+** and return the number of bytes written (at most 10).
+*/
+static int trigramPutVarint(unsigned char *p, sqlite3_uint64 v){
+  int n = 0;
+  do{
+    p[n++] = (unsigned char)((v & 0x7f) | (v>0x7f ? 0x80 : 0));
+    v >>= 7;
+  }while( v );
+  return n;
+}
+
+/*
+** Read a varint written by trigramPutVarint() from p, which ends at pEnd,
+** into *pv.  Return the number of bytes read, or 0 if it is malformed.
+*/
+static int trigramGetVarint(
+  const unsigned char *p,
+  const unsigned char *pEnd,
+  sqlite3_uint64 *pv
+){
+  sqlite3_uint64 v = 0;
+  int n = 0;
+  while( p+n<pEnd && n<10 ){
+    v |= ((sqlite3_uint64)(p[n] & 0x7f))<<(7*n);
+    if( (p[n++] & 0x80)==0 ){
+      *pv = v;
+      return n;
+    }
+  }
+  return 0;
+}
+
+/*
+** Add the distinct trigrams of the n bytes at z to pList.
+*/
+static int trigramTextTerms(
+  const unsigned char *z,
+  int n,
+  TrigramList *pList
+){
+  int i;
+  if( n<3 ) return SQLITE_OK;
+  if( trigramListReserve(pList, n-2) ) return SQLITE_NOMEM;
+  for(i=0; i+2<n; i++){
+    pList->a[pList->n++] = ((sqlite3_int64)TRIGRAM_FOLD(z[i])<<16)
+                         | ((sqlite3_int64)TRIGRAM_FOLD(z[i+1])<<8)
+                         | (sqlite3_int64)TRIGRAM_FOLD(z[i+2]);
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Add the distinct trigrams of the literal parts of LIKE pattern zPattern
+** to pList.
+*/
+static int trigramPatternTerms(
+  const unsigned char *zPattern,
+  TrigramList *pList
+){
+  int i = 0;
+  while( zPattern[i] ){
+    int n = 0;
+    while( zPattern[i+n] && zPattern[i+n]!='%' && zPattern[i+n]!='_' ) n++;
+    if( trigramTextTerms(&zPattern[i], n, pList) ) return SQLITE_NOMEM;
+    i += n;
+    if( zPattern[i] ) i++;
+  }
+  trigramListSort(pList);
+  return SQLITE_OK;
+}
+
+/*
+** Compute the soundex code of zIn into zResult[], which must have room
+** for five bytes.  This is the algorithm used by the difference() function
+** of extension-functions.c.
+*/
+static void trigramSoundex(const unsigned char *zIn, char *zResult){
+  static const unsigned char iCode[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 1, 2, 3, 0, 1, 2, 0, 0, 2, 2, 4, 5, 5, 0,
+    1, 2, 6, 2, 3, 0, 1, 0, 2, 0, 2, 0, 0, 0, 0, 0,
+    0, 0, 1, 2, 3, 0, 1, 2, 0, 0, 2, 2, 4, 5, 5, 0,
+    1, 2, 6, 2, 3, 0, 1, 0, 2, 0, 2, 0, 0, 0, 0, 0,
+  };
+  int i, j;
+  for(i=0; zIn[i] && !TRIGRAM_ISALPHA(zIn[i]); i++){}
+  if( zIn[i] ){
+    zResult[0] = (char)(TRIGRAM_FOLD(zIn[i]) - 32);
+    for(j=1; j<4 && zIn[i]; i++){
+      int code = iCode[zIn[i]&0x7f];
+      if( code>0 ) zResult[j++] = (char)(code + '0');
+    }
+    while( j<4 ) zResult[j++] = '0';
+    zResult[j] = 0;
+  }else{
+    memcpy(zResult, "?000", 5);
+  }
+}
+
+/*
+** Return the posting list term of soundex code z, or -1 if z is not a
+** soundex code.
+*/
+static sqlite3_int64 trigramSoundexTerm(const unsigned char *z){
+  if( z==0 || strlen((const char *)z)!=4 ) return -1;
+  return TRIGRAM_SOUNDEX_TERM | ((sqlite3_int64)z[0]<<24)
+       | ((sqlite3_int64)z[1]<<16) | ((sqlite3_int64)z[2]<<8) | z[3];
+}
+
+/*
+** Return true if string zStr matches LIKE pattern zPattern, with the
+** semantics of the built-in LIKE operator without an ESCAPE clause.
+*/
+static int trigramLike(
+  const unsigned char *zPattern,
+  const unsigned char *zStr
+){
+  const unsigned char *zStar = 0;    /* Pattern just after the last "%" */
+  const unsigned char *zBack = 0;    /* Where that "%" match would resume */
+  while( *zStr ){
+    if( *zPattern=='%' ){
+      while( *zPattern=='%' ) zPattern++;
+      if( *zPattern==0 ) return 1;
+      zStar = zPattern;
+      zBack = zStr;
+    }else if( *zPattern=='_' ){
+      zPattern++;
+      TRIGRAM_SKIP_UTF8(zStr);
+    }else if( *zPattern && TRIGRAM_FOLD(*zPattern)==TRIGRAM_FOLD(*zStr) ){
+      zPattern++;
+      zStr++;
+    }else if( zStar ){
+      zPattern = zStar;
+      TRIGRAM_SKIP_UTF8(zBack);
+      zStr = zBack;
+    }else{
+      return 0;
+    }
+  }
+  while( *zPattern=='%' ) zPattern++;
+  return *zPattern==0;
+}
+
+/*
+** Return the cached statement iStmt of table pTab in *ppStmt, preparing
+** it if needed.
+*/
+static int trigramGetStmt(
+  TrigramTable *pTab,
+  int iStmt,
+  sqlite3_stmt **ppStmt
+){
+  static const char *azSql[TRIGRAM_NSTMT] = {
+    /* TRIGRAM_STMT_CONTENT_INSERT */
+    "INSERT INTO \"%w\".\"%w_content\"(id, c) VALUES(?1, ?2)",
+    /* TRIGRAM_STMT_CONTENT_DELETE */
+    "DELETE FROM \"%w\".\"%w_content\" WHERE id=?1",
+    /* TRIGRAM_STMT_CONTENT_SELECT */
+    "SELECT c FROM \"%w\".\"%w_content\" WHERE id=?1",
+    /* TRIGRAM_STMT_CONTENT_UPDATE */
+    "UPDATE \"%w\".\"%w_content\" SET id=?2, c=?3 WHERE id=?1",
+    /* TRIGRAM_STMT_INDEX_RANGE */
+    "SELECT first, doclist FROM \"%w\".\"%w_index\" WHERE term=?1"
+    " AND first<=?3 AND first>=coalesce((SELECT max(first)"
+    " FROM \"%w\".\"%w_index\" WHERE term=?1 AND first<=?2), ?2)"
+    " ORDER BY first",
+    /* TRIGRAM_STMT_INDEX_COUNT */
+    "SELECT sum(n) FROM \"%w\".\"%w_index\" WHERE term=?1",
+    /* TRIGRAM_STMT_INDEX_INSERT */
+    "INSERT INTO \"%w\".\"%w_index\"(term, first, n, doclist)"
+    " VALUES(?1, ?2, ?3, ?4)",
+    /* TRIGRAM_STMT_INDEX_DELETE */
+    "DELETE FROM \"%w\".\"%w_index\" WHERE term=?1 AND first=?2",
+  };
+  int rc = SQLITE_OK;
+  if( pTab->aStmt[iStmt]==0 ){
+    char *zSql = sqlite3_mprintf(azSql[iStmt], pTab->zDb, pTab->zName,
+                                 pTab->zDb, pTab->zName);
+    if( zSql==0 ) return SQLITE_NOMEM;
+    rc = sqlite3_prepare_v2(pTab->db, zSql, -1, &pTab->aStmt[iStmt], 0);
+    sqlite3_free(zSql);
+  }
+  *ppStmt = pTab->aStmt[iStmt];
+  return rc;
+}
+
+/*
+** Finalize the cached statements of pTab.
+*/
+static void trigramFinalizeStmts(TrigramTable *pTab){
+  int i;
+  for(i=0; i<TRIGRAM_NSTMT; i++){
+    sqlite3_finalize(pTab->aStmt[i]);
+    pTab->aStmt[i] = 0;
+  }
+}
+
+/*
+** Run the SQL statement zFormat, a printf() format whose arguments are
+** the database name and the table name, as many times as needed.
+*/
+static int trigramExec(TrigramTable *pTab, const char *zFormat){
+  int rc;
+  char *zSql = sqlite3_mprintf(zFormat, pTab->zDb, pTab->zName,
+                               pTab->zDb, pTab->zName);
+  if( zSql==0 ) return SQLITE_NOMEM;
+  rc = sqlite3_exec(pTab->db, zSql, 0, 0, 0);
+  sqlite3_free(zSql);
+  return rc;
+}
+
+/*
+** Read the rowids of posting list iTerm that may lie between iFirst and
+** iLast into pList.  If pFirsts is not NULL, the first rowid of each block
+** read is added to it.
+*/
+static int trigramLoadList(
+  TrigramTable *pTab,
+  sqlite3_int64 iTerm,
+  sqlite3_int64 iFirst,
+  sqlite3_int64 iLast,
+  TrigramList *pList,
+  TrigramList *pFirsts
+){
+  sqlite3_stmt *pStmt;
+  int rc = trigramGetStmt(pTab, TRIGRAM_STMT_INDEX_RANGE, &pStmt);
+  if( rc!=SQLITE_OK ) return rc;
+  sqlite3_bind_int64(pStmt, 1, iTerm);
+  sqlite3_bind_int64(pStmt, 2, iFirst);
+  sqlite3_bind_int64(pStmt, 3, iLast);
+  while( rc==SQLITE_OK && sqlite3_step(pStmt)==SQLITE_ROW ){
+    sqlite3_int64 iRowid = sqlite3_column_int64(pStmt, 0);
+    const unsigned char *p = sqlite3_column_blob(pStmt, 1);
+    const unsigned char *pEnd = p + sqlite3_column_bytes(pStmt, 1);
+    if( pFirsts ) rc = trigramListAppend(pFirsts, iRowid);
+    if( rc==SQLITE_OK ) rc = trigramListAppend(pList, iRowid);
+    while( rc==SQLITE_OK && p<pEnd ){
+      sqlite3_uint64 iDelta;
+      int n = trigramGetVarint(p, pEnd, &iDelta);
+      if( n==0 ){
+        rc = SQLITE_CORRUPT_VTAB;
+        break;
+      }
+      p += n;
+      iRowid += (sqlite3_int64)iDelta;
+      rc = trigramListAppend(pList, iRowid);
+    }
+  }
+  if( sqlite3_reset(pStmt)!=SQLITE_OK && rc==SQLITE_OK ){
+    rc = sqlite3_errcode(pTab->db);
+  }
+  return rc;
+}
+
+/*
+** Write the sorted rowids of pList as blocks of posting list iTerm.  A
+** block is keyed by its first rowid, and its doclist holds the difference
+** between each of the following rowids and the one before it.
+*/
+static int trigramWriteList(
+  TrigramTable *pTab,
+  sqlite3_int64 iTerm,
+  TrigramList *pList
+){
+  unsigned char aBuf[TRIGRAM_BLOCK_SIZE*10];
+  sqlite3_stmt *pStmt;
+  int nBlock, nPerBlock;
+  int i, j;
+  int rc;
+
+  if( pList->n==0 ) return SQLITE_OK;
+  rc = trigramGetStmt(pTab, TRIGRAM_STMT_INDEX_INSERT, &pStmt);
+  if( rc!=SQLITE_OK ) return rc;
+  nBlock = (pList->n + TRIGRAM_BLOCK_SIZE - 1)/TRIGRAM_BLOCK_SIZE;
+  nPerBlock = (pList->n + nBlock - 1)/nBlock;
+  for(i=0; rc==SQLITE_OK && i<pList->n; i+=nPerBlock){
+    int nRowid = pList->n-i<nPerBlock ? pList->n-i : nPerBlock;
+    int nBuf = 0;
+    for(j=1; j<nRowid; j++){
+      nBuf += trigramPutVarint(&aBuf[nBuf],
+          (sqlite3_uint64)pList->a[i+j] - (sqlite3_uint64)pList->a[i+j-1]);
+    }
+    sqlite3_bind_int64(pStmt, 1, iTerm);
+    sqlite3_bind_int64(pStmt, 2, pList->a[i]);
+    sqlite3_bind_int(pStmt, 3, nRowid);
+    sqlite3_bind_blob(pStmt, 4, aBuf, nBuf, SQLITE_STATIC);
+    sqlite3_step(pStmt);
+    rc = sqlite3_reset(pStmt);
+  }
+  return rc;
+}
+
+/*
+** Comparison function for qsort() on an array of TrigramOp.
+*/
+static int trigramCompareOp(const void *pA, const void *pB){
+  const TrigramOp *a = (const TrigramOp *)pA;
+  const TrigramOp *b = (const TrigramOp *)pB;
+  if( a->iRowid!=b->iRowid ) return a->iRowid<b->iRowid ? -1 : 1;
+  return a->iSeq - b->iSeq;
+}
+
+/*
+** Merge the pending changes of one term into the blocks of its posting
+** list that they affect.
+*/
+static int trigramMergeTerm(TrigramTable *pTab, TrigramPending *p){
+  TrigramList old = {0, 0, 0};
+  TrigramList firsts = {0, 0, 0};
+  TrigramList merged = {0, 0, 0};
+  sqlite3_stmt *pStmt;
+  int i, j;
+  int rc;
+
+  qsort(p->aOp, p->nOp, sizeof(TrigramOp), trigramCompareOp);
+  rc = trigramLoadList(pTab, p->iTerm, p->aOp[0].iRowid,
+                       p->aOp[p->nOp-1].iRowid, &old, &firsts);
+  if( rc==SQLITE_OK ) rc = trigramListReserve(&merged, old.n + p->nOp);
+  if( rc==SQLITE_OK ){
+    /* The last change of each rowid decides whether it is in the list. */
+    for(i=j=0; i<p->nOp; i++){
+      sqlite3_int64 iRowid = p->aOp[i].iRowid;
+      if( i+1<p->nOp && p->aOp[i+1].iRowid==iRowid ) continue;
+      while( j<old.n && old.a[j]<iRowid ) merged.a[merged.n++] = old.a[j++];
+      if( j<old.n && old.a[j]==iRowid ) j++;
+      if( !p->aOp[i].bDelete ) merged.a[merged.n++] = iRowid;
+    }
+    while( j<old.n ) merged.a[merged.n++] = old.a[j++];
+    rc = trigramGetStmt(pTab, TRIGRAM_STMT_INDEX_DELETE, &pStmt);
+  }
+  for(i=0; rc==SQLITE_OK && i<firsts.n; i++){
+    sqlite3_bind_int64(pStmt, 1, p->iTerm);
+    sqlite3_bind_int64(pStmt, 2, firsts.a[i]);
+    sqlite3_step(pStmt);
+    rc = sqlite3_reset(pStmt);
+  }
+  if( rc==SQLITE_OK ) rc = trigramWriteList(pTab, p->iTerm, &merged);
+  trigramListFree(&old);
+  trigramListFree(&firsts);
+  trigramListFree(&merged);
+  return rc;
+}
+
+/*
+** Discard the pending changes of pTab.
+*/
+static void trigramPendingClear(TrigramTable *pTab){
+  int i;
+  for(i=0; i<pTab->nHash; i++){
+    TrigramPending *p, *pNext;
+    for(p=pTab->apHash[i]; p; p=pNext){
+      pNext = p->pNext;
+      sqlite3_free(p->aOp);
+      sqlite3_free(p);
+    }
+  }
+  sqlite3_free(pTab->apHash);
+  pTab->apHash = 0;
+  pTab->nHash = 0;
+  pTab->nTerm = 0;
+  pTab->nOp = 0;
+}
+
+/*
+** Write the pending changes of pTab to the %_index table.
+*/
+static int trigramPendingFlush(TrigramTable *pTab){
+  int rc = SQLITE_OK;
+  int i;
+  for(i=0; rc==SQLITE_OK && i<pTab->nHash; i++){
+    TrigramPending *p;
+    for(p=pTab->apHash[i]; rc==SQLITE_OK && p; p=p->pNext){
+      rc = trigramMergeTerm(pTab, p);
+    }
+  }
+  trigramPendingClear(pTab);
+  return rc;
+}
+
+/*
+** Return the hash bucket of term iTerm in a table of nHash buckets.
+*/
+static int trigramHash(sqlite3_int64 iTerm, int nHash){
+  sqlite3_uint64 h = (sqlite3_uint64)iTerm * 0x9E3779B97F4A7C15ULL;
+  return (int)((h>>32) % (sqlite3_uint64)nHash);
+}
+
+/*
+** Record that row iRowid was added to (bDelete false) or removed from
+** (bDelete true) posting list iTerm.
+*/
+static int trigramPendingAdd(
+  TrigramTable *pTab,
+  sqlite3_int64 iTerm,
+  sqlite3_int64 iRowid,
+  int bDelete
+){
+  TrigramPending *p;
+  int h;
+
+  if( pTab->nTerm>=pTab->nHash ){
+    int nNew = pTab->nHash ? pTab->nHash*2 : 1024;
+    TrigramPending **apNew = sqlite3_malloc(nNew*sizeof(TrigramPending *));
+    int i;
+    if( apNew==0 ) return SQLITE_NOMEM;
+    memset(apNew, 0, nNew*sizeof(TrigramPending *));
+    for(i=0; i<pTab->nHash; i++){
+      TrigramPending *pNext;
+      for(p=pTab->apHash[i]; p; p=pNext){
+        pNext = p->pNext;
+        h = trigramHash(p->iTerm, nNew);
+        p->pNext = apNew[h];
+        apNew[h] = p;
+      }
+    }
+    sqlite3_free(pTab->apHash);
+    pTab->apHash = apNew;
+    pTab->nHash = nNew;
+  }
+  h = trigramHash(iTerm, pTab->nHash);
+  for(p=pTab->apHash[h]; p && p->iTerm!=iTerm; p=p->pNext){}
+  if( p==0 ){
+    p = sqlite3_malloc( sizeof(*p) );
+    if( p==0 ) return SQLITE_NOMEM;
+    memset(p, 0, sizeof(*p));
+    p->iTerm = iTerm;
+    p->pNext = pTab->apHash[h];
+    pTab->apHash[h] = p;
+    pTab->nTerm++;
+  }
+  if( p->nOp>=p->nOpAlloc ){
+    int nNew = p->nOpAlloc ? p->nOpAlloc*2 : 8;
+    TrigramOp *aNew = sqlite3_realloc(p->aOp, nNew*sizeof(TrigramOp));
+    if( aNew==0 ) return SQLITE_NOMEM;
+    p->aOp = aNew;
+    p->nOpAlloc = nNew;
+  }
+  p->aOp[p->nOp].iRowid = iRowid;
+  p->aOp[p->nOp].iSeq = p->nOp;
+  p->aOp[p->nOp].bDelete = bDelete;
+  p->nOp++;
+  pTab->nOp++;
+  return SQLITE_OK;
+}
+
+/*
+** Set pTerms to the distinct terms under which text pText is indexed: its
+** trigrams and, if they are indexed, its soundex code.
+*/
+static int trigramRowTerms(
+  TrigramTable *pTab,
+  sqlite3_value *pText,
+  TrigramList *pTerms
+){
+  const unsigned char *z;
+  int rc;
+
+  pTerms->n = 0;
+  if( sqlite3_value_type(pText)==SQLITE_NULL ) return SQLITE_OK;
+  z = sqlite3_value_text(pText);
+  if( z==0 ) return SQLITE_NOMEM;
+  rc = trigramTextTerms(z, sqlite3_value_bytes(pText), pTerms);
+  if( rc==SQLITE_OK && pTab->bSoundex ){
+    char zCode[8];
+    trigramSoundex(z, zCode);
+    rc = trigramListAppend(pTerms,
+                           trigramSoundexTerm((const unsigned char *)zCode));
+  }
+  trigramListSort(pTerms);
+  return rc;
+}
+
+/*
+** Record the addition or removal of row iRowid in the posting lists of
+** the terms in pTerms.
+*/
+static int trigramIndexRow(
+  TrigramTable *pTab,
+  sqlite3_int64 iRowid,
+  TrigramList *pTerms,
+  int bDelete
+){
+  int rc = SQLITE_OK;
+  int i;
+  for(i=0; rc==SQLITE_OK && i<pTerms->n; i++){
+    rc = trigramPendingAdd(pTab, pTerms->a[i], iRowid, bDelete);
+  }
+  if( rc==SQLITE_OK && pTab->nOp>=TRIGRAM_MAX_PENDING ){
+    rc = trigramPendingFlush(pTab);
+  }
+  return rc;
+}
+
+/*
+** Return a copy of identifier z, obtained from sqlite3_malloc(), without
+** its quotes, if any.
+*/
+static char *trigramDequote(const char *z){
+  int n = (int)strlen(z);
+  char cQuote = z[0];
+  char *zOut;
+  int i, j;
+  if( cQuote=='[' ) cQuote = ']';
+  if( n<2 || (cQuote!='"' && cQuote!='\'' && cQuote!='`' && cQuote!=']')
+   || z[n-1]!=cQuote ){
+    return sqlite3_mprintf("%s", z);
+  }
+  zOut = sqlite3_malloc(n);
+  if( zOut==0 ) return 0;
+  for(i=1, j=0; i<n-1; i++){
+    zOut[j++] = z[i];
+    if( z[i]==cQuote && cQuote!=']' ) i++;
+  }
+  zOut[j] = 0;
+  return zOut;
+}
+
+/*
+** This method is the destructor for TrigramTable objects.
+*/
+static int trigramDisconnect(sqlite3_vtab *pVtab){
+  TrigramTable *pTab = (TrigramTable *)pVtab;
+  trigramFinalizeStmts(pTab);
+  trigramPendingClear(pTab);
+  sqlite3_free(pTab->zDb);
+  sqlite3_free(pTab->zName);
+  sqlite3_free(pTab);
+  return SQLITE_OK;
+}
+
+/*
+** Create or connect to a trigram virtual table.
+**
+** argv[0]   -> module name  ("trigram")
+** argv[1]   -> database name
+** argv[2]   -> table name
+** argv[3]   -> name of the indexed column (default "content")
+** argv[4..] -> "soundex=1" to index the soundex codes
+*/
+static int trigramInit(
+  sqlite3 *db,
+  int argc,
+  const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pzErr,
+  int bCreate
+){
+  TrigramTable *pTab;
+  char *zCol = 0;
+  char *zSql;
+  int rc = SQLITE_OK;
+  int i;
+
+  pTab = sqlite3_malloc( sizeof(*pTab) );
+  if( pTab==0 ) return SQLITE_NOMEM;
+  memset(pTab, 0, sizeof(*pTab));
+  pTab->db = db;
+  pTab->zDb = sqlite3_mprintf("%s", argv[1]);
+  pTab->zName = sqlite3_mprintf("%s", argv[2]);
+  if( pTab->zDb==0 || pTab->zName==0 ) rc = SQLITE_NOMEM;
+  for(i=3; rc==SQLITE_OK && i<argc; i++){
+    const char *z = argv[i];
+    while( *z==' ' || *z=='\t' ) z++;
+    if( sqlite3_strnicmp(z, "soundex", 7)==0 && strchr(z, '=') ){
+      const char *zValue = strchr(z, '=') + 1;
+      while( *zValue==' ' || *zValue=='\t' ) zValue++;
+      pTab->bSoundex = zValue[0]=='1' || sqlite3_strnicmp(zValue, "true", 4)==0
+                    || sqlite3_strnicmp(zValue, "on", 2)==0
+                    || sqlite3_strnicmp(zValue, "yes", 3)==0;
+    }else if( zCol==0 && z[0] ){
+      zCol = trigramDequote(z);
+      if( zCol==0 ) rc = SQLITE_NOMEM;
+    }else{
+      *pzErr = sqlite3_mprintf("trigram: unknown argument: %s", argv[i]);
+      rc = SQLITE_ERROR;
+    }
+  }
+  if( rc==SQLITE_OK ){
+    zSql = sqlite3_mprintf("CREATE TABLE x(\"%w\", soundex HIDDEN)",
+                           zCol ? zCol : "content");
+    rc = zSql ? sqlite3_declare_vtab(db, zSql) : SQLITE_NOMEM;
+    sqlite3_free(zSql);
+  }
+  sqlite3_free(zCol);
+  if( rc==SQLITE_OK && bCreate ){
+    rc = trigramExec(pTab,
+        "CREATE TABLE \"%w\".\"%w_content\"(id INTEGER PRIMARY KEY, c);"
+        "CREATE TABLE \"%w\".\"%w_index\"(term INTEGER, first INTEGER,"
+        " n INTEGER, doclist BLOB, PRIMARY KEY(term, first)) WITHOUT ROWID;"
+    );
+    if( rc!=SQLITE_OK && *pzErr==0 ){
+      *pzErr = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+    }
+  }
+  if( rc!=SQLITE_OK ){
+    trigramDisconnect(&pTab->base);
+    return rc;
+  }
+  *ppVtab = &pTab->base;
+  return SQLITE_OK;
+}
+
+/*
+** The xCreate method creates the shadow tables.
+*/
+static int trigramCreate(
+  sqlite3 *db,
+  void *pAux,
+  int argc,
+  const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pzErr
+){
+  (void)pAux;
+  return trigramInit(db, argc, argv, ppVtab, pzErr, 1);
+}
+
+/*
+** The xConnect method uses the existing shadow tables.
+*/
+static int trigramConnect(
+  sqlite3 *db,
+  void *pAux,
+  int argc,
+  const char *const*argv,
+  sqlite3_vtab **ppVtab,
+  char **pzErr
+){
+  (void)pAux;
+  return trigramInit(db, argc, argv, ppVtab, pzErr, 0);
+}
+
+/*
+** The xDestroy method drops the shadow tables.
+*/
+static int trigramDestroy(sqlite3_vtab *pVtab){
+  TrigramTable *pTab = (TrigramTable *)pVtab;
+  int rc;
+  trigramFinalizeStmts(pTab);
+  rc = trigramExec(pTab,
+      "DROP TABLE IF EXISTS \"%w\".\"%w_content\";"
+      "DROP TABLE IF EXISTS \"%w\".\"%w_index\";"
+  );
+  if( rc==SQLITE_OK ) trigramDisconnect(pVtab);
+  return rc;
+}
+
+/*
+** Choose the best of the constraints "rowid=?", "soundex=?" (if the
+** soundex codes are indexed) and "text MATCH ?".  Each is answered
+** completely by xFilter.
+*/
+static int trigramBestIndex(sqlite3_vtab *pVtab, sqlite3_index_info *pInfo){
+  TrigramTable *pTab = (TrigramTable *)pVtab;
+  int aiConstraint[4] = {-1, -1, -1, -1};
+  int i;
+
+  for(i=0; i<pInfo->nConstraint; i++){
+    const struct sqlite3_index_constraint *p = &pInfo->aConstraint[i];
+    if( !p->usable ) continue;
+    if( p->iColumn<0 && p->op==SQLITE_INDEX_CONSTRAINT_EQ ){
+      aiConstraint[TRIGRAM_PLAN_ROWID] = i;
+    }else if( p->iColumn==TRIGRAM_COLUMN_SOUNDEX && pTab->bSoundex
+           && p->op==SQLITE_INDEX_CONSTRAINT_EQ ){
+      aiConstraint[TRIGRAM_PLAN_SOUNDEX] = i;
+    }else if( p->iColumn==TRIGRAM_COLUMN_TEXT
+           && p->op==SQLITE_INDEX_CONSTRAINT_MATCH ){
+      aiConstraint[TRIGRAM_PLAN_MATCH] = i;
+    }
+  }
+  pInfo->idxNum = TRIGRAM_PLAN_SCAN;
+  pInfo->estimatedCost = 1000000.0;
+  for(i=TRIGRAM_PLAN_ROWID; i<=TRIGRAM_PLAN_MATCH; i++){
+    if( aiConstraint[i]>=0 ){
+      static const double aCost[] = { 0.0, 1.0, 100.0, 1000.0 };
+      pInfo->idxNum = i;
+      pInfo->estimatedCost = aCost[i];
+      pInfo->aConstraintUsage[aiConstraint[i]].argvIndex = 1;
+      pInfo->aConstraintUsage[aiConstraint[i]].omit = 1;
+      break;
+    }
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Constructor for a new TrigramCursor object.
+*/
+static int trigramOpen(sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor){
+  TrigramCursor *pCur;
+  (void)pVtab;
+  pCur = sqlite3_malloc( sizeof(*pCur) );
+  if( pCur==0 ) return SQLITE_NOMEM;
+  memset(pCur, 0, sizeof(*pCur));
+  pCur->bEof = 1;
+  *ppCursor = &pCur->base;
+  return SQLITE_OK;
+}
+
+/*
+** Release the results of the last query of a cursor.
+*/
+static void trigramCursorReset(TrigramCursor *pCur){
+  sqlite3_finalize(pCur->pScan);
+  pCur->pScan = 0;
+  if( pCur->pLookup ) sqlite3_reset(pCur->pLookup);
+  pCur->rowids.n = 0;
+  pCur->iRowid = 0;
+  sqlite3_free(pCur->zPattern);
+  pCur->zPattern = 0;
+  pCur->bEof = 1;
+}
+
+/*
+** Destructor for a TrigramCursor.
+*/
+static int trigramClose(sqlite3_vtab_cursor *cur){
+  TrigramCursor *pCur = (TrigramCursor *)cur;
+  trigramCursorReset(pCur);
+  sqlite3_finalize(pCur->pLookup);
+  trigramListFree(&pCur->rowids);
+  sqlite3_free(pCur);
+  return SQLITE_OK;
+}
+
+/*
+** Advance a TrigramCursor to the next row that matches the pattern, if
+** any.
+*/
+static int trigramNext(sqlite3_vtab_cursor *cur){
+  TrigramCursor *pCur = (TrigramCursor *)cur;
+  sqlite3_stmt *pStmt = pCur->pScan ? pCur->pScan : pCur->pLookup;
+  for(;;){
+    const unsigned char *zText;
+    if( pStmt==pCur->pLookup ){
+      sqlite3_reset(pStmt);
+      if( pCur->iRowid>=pCur->rowids.n ) break;
+      sqlite3_bind_int64(pStmt, 1, pCur->rowids.a[pCur->iRowid++]);
+    }
+    if( sqlite3_step(pStmt)!=SQLITE_ROW ){
+      if( pStmt==pCur->pScan || sqlite3_reset(pStmt)!=SQLITE_OK ) break;
+      continue;
+    }
+    if( pCur->zPattern==0 ) return SQLITE_OK;
+    zText = sqlite3_column_text(pStmt, 1);
+    if( zText && trigramLike((const unsigned char *)pCur->zPattern, zText) ){
+      return SQLITE_OK;
+    }
+  }
+  pCur->bEof = 1;
+  return sqlite3_reset(pStmt);
+}
+
+/*
+** Find the rows that contain every trigram of the LIKE pattern of the
+** cursor, starting with the rarest trigram.  Set *pbScan if the pattern
+** has no trigram.
+*/
+static int trigramMatchRowids(
+  TrigramTable *pTab,
+  TrigramCursor *pCur,
+  int *pbScan
+){
+  TrigramList terms = {0, 0, 0};
+  TrigramList counts = {0, 0, 0};
+  TrigramList list = {0, 0, 0};
+  sqlite3_stmt *pStmt;
+  int rc;
+  int i;
+
+  rc = trigramPatternTerms((const unsigned char *)pCur->zPattern, &terms);
+  if( rc==SQLITE_OK && terms.n==0 ) *pbScan = 1;
+  if( rc==SQLITE_OK && terms.n>0 ){
+    rc = trigramGetStmt(pTab, TRIGRAM_STMT_INDEX_COUNT, &pStmt);
+  }
+
+  /* Order the terms by the length of their posting lists. */
+  for(i=0; rc==SQLITE_OK && i<terms.n; i++){
+    sqlite3_int64 nRowid = 0;
+    sqlite3_bind_int64(pStmt, 1, terms.a[i]);
+    if( sqlite3_step(pStmt)==SQLITE_ROW ){
+      nRowid = sqlite3_column_int64(pStmt, 0);
+    }
+    rc = sqlite3_reset(pStmt);
+    if( rc==SQLITE_OK ) rc = trigramListAppend(&counts, nRowid);
+  }
+  if( rc==SQLITE_OK && terms.n>0 ){
+    for(i=1; i<terms.n; i++){
+      int j;
+      for(j=i; j>0 && counts.a[j]<counts.a[j-1]; j--){
+        sqlite3_int64 t = counts.a[j]; counts.a[j] = counts.a[j-1];
+        counts.a[j-1] = t;
+        t = terms.a[j]; terms.a[j] = terms.a[j-1]; terms.a[j-1] = t;
+      }
+    }
+    if( counts.a[0]>0 ){
+      rc = trigramLoadList(pTab, terms.a[0], TRIGRAM_SMALLEST_INT64,
+                           TRIGRAM_LARGEST_INT64, &pCur->rowids, 0);
+    }
+  }
+  for(i=1; rc==SQLITE_OK && i<terms.n && pCur->rowids.n>0; i++){
+    /* Checking each row is cheaper than reading a much longer list. */
+    if( counts.a[i]>TRIGRAM_INTERSECT_RATIO*(sqlite3_int64)pCur->rowids.n ){
+      break;
+    }
+    list.n = 0;
+    rc = trigramLoadList(pTab, terms.a[i], pCur->rowids.a[0],
+                         pCur->rowids.a[pCur->rowids.n-1], &list, 0);
+    trigramListIntersect(&pCur->rowids, list.a, list.n);
+  }
+  trigramListFree(&terms);
+  trigramListFree(&counts);
+  trigramListFree(&list);
+  return rc;
+}
+
+/*
+** Start a query, using the plan chosen by xBestIndex.
+*/
+static int trigramFilter(
+  sqlite3_vtab_cursor *cur,
+  int idxNum, const char *idxStr,
+  int argc, sqlite3_value **argv
+){
+  TrigramCursor *pCur = (TrigramCursor *)cur;
+  TrigramTable *pTab = (TrigramTable *)cur->pVtab;
+  int bScan = idxNum==TRIGRAM_PLAN_SCAN;
+  char *zSql;
+  int rc = SQLITE_OK;
+
+  (void)idxStr;
+  trigramCursorReset(pCur);
+  pCur->bEof = 0;
+  if( idxNum==TRIGRAM_PLAN_MATCH || idxNum==TRIGRAM_PLAN_SOUNDEX ){
+    rc = trigramPendingFlush(pTab);
+  }
+  if( rc==SQLITE_OK && argc>0 ){
+    sqlite3_value *pArg = argv[0];
+    switch( idxNum ){
+      case TRIGRAM_PLAN_ROWID: {
+        int eType = sqlite3_value_numeric_type(pArg);
+        double r = sqlite3_value_double(pArg);
+        if( eType==SQLITE_INTEGER || (eType==SQLITE_FLOAT
+            && r>=-9.2e18 && r<=9.2e18 && r==(double)(sqlite3_int64)r) ){
+          rc = trigramListAppend(&pCur->rowids, sqlite3_value_int64(pArg));
+        }
+        break;
+      }
+      case TRIGRAM_PLAN_SOUNDEX: {
+        sqlite3_int64 iTerm = trigramSoundexTerm(sqlite3_value_text(pArg));
+        if( iTerm>=0 ){
+          rc = trigramLoadList(pTab, iTerm, TRIGRAM_SMALLEST_INT64,
+                               TRIGRAM_LARGEST_INT64, &pCur->rowids, 0);
+        }
+        break;
+      }
+      case TRIGRAM_PLAN_MATCH: {
+        if( sqlite3_value_type(pArg)==SQLITE_NULL ) break;
+        pCur->zPattern = sqlite3_mprintf("%s", sqlite3_value_text(pArg));
+        if( pCur->zPattern==0 ){
+          rc = SQLITE_NOMEM;
+        }else{
+          rc = trigramMatchRowids(pTab, pCur, &bScan);
+        }
+        break;
+      }
+    }
+  }
+  if( rc==SQLITE_OK && bScan ){
+    zSql = sqlite3_mprintf("SELECT id, c FROM \"%w\".\"%w_content\"",
+                           pTab->zDb, pTab->zName);
+    rc = zSql ? sqlite3_prepare_v2(pTab->db, zSql, -1, &pCur->pScan, 0)
+              : SQLITE_NOMEM;
+    sqlite3_free(zSql);
+  }
+  if( rc==SQLITE_OK && !bScan && pCur->pLookup==0 ){
+    zSql = sqlite3_mprintf("SELECT id, c FROM \"%w\".\"%w_content\""
+                           " WHERE id=?1", pTab->zDb, pTab->zName);
+    rc = zSql ? sqlite3_prepare_v2(pTab->db, zSql, -1, &pCur->pLookup, 0)
+              : SQLITE_NOMEM;
+    sqlite3_free(zSql);
+  }
+  if( rc!=SQLITE_OK ){
+    pCur->bEof = 1;
+    return rc;
+  }
+  return trigramNext(cur);
+}
+
+/*
+** Return TRUE if the cursor has been moved off of the last row of output.
+*/
+static int trigramEof(sqlite3_vtab_cursor *cur){
+  TrigramCursor *pCur = (TrigramCursor *)cur;
+  return pCur->bEof;
+}
+
+/*
+** Return values of columns for the row at which the TrigramCursor is
+** currently pointing.
+*/
+static int trigramColumn(
+  sqlite3_vtab_cursor *cur,
+  sqlite3_context *ctx,
+  int i
+){
+  TrigramCursor *pCur = (TrigramCursor *)cur;
+  sqlite3_stmt *pStmt = pCur->pScan ? pCur->pScan : pCur->pLookup;
+  if( i==TRIGRAM_COLUMN_TEXT ){
+    sqlite3_result_value(ctx, sqlite3_column_value(pStmt, 1));
+  }else if( sqlite3_column_type(pStmt, 1)!=SQLITE_NULL ){
+    char zCode[8];
+    trigramSoundex(sqlite3_column_text(pStmt, 1), zCode);
+    sqlite3_result_text(ctx, zCode, -1, SQLITE_TRANSIENT);
+  }
+  return SQLITE_OK;
+}
+
+/*
+** Return the rowid for the current row.
+*/
+static int trigramRowid(sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid){
+  TrigramCursor *pCur = (TrigramCursor *)cur;
+  sqlite3_stmt *pStmt = pCur->pScan ? pCur->pScan : pCur->pLookup;
+  *pRowid = sqlite3_column_int64(pStmt, 0);
+  return SQLITE_OK;
+}
+
+/*
+** The xUpdate method for INSERT, UPDATE and DELETE statements.
+**
+** argc = 1:  DELETE row argv[0]
+** argc > 1:  INSERT (argv[0] NULL) or UPDATE row argv[0], with the new
+**            rowid in argv[1], the text in argv[2] and the soundex column,
+**            which is ignored, in argv[3].
+**
+** The content is changed by a single statement, and the posting lists
+** only once that has succeeded, so that a failed statement leaves both
+** unchanged.
+*/
+static int trigramUpdate(
+  sqlite3_vtab *pVtab,
+  int argc,
+  sqlite3_value **argv,
+  sqlite_int64 *pRowid
+){
+  TrigramTable *pTab = (TrigramTable *)pVtab;
+  TrigramList terms = {0, 0, 0};
+  sqlite3_stmt *pStmt;
+  sqlite3_int64 iOld = 0;
+  sqlite3_int64 iNew = 0;
+  int rc = SQLITE_OK;
+
+  /* Find the terms of the old row, if any. */
+  if( sqlite3_value_type(argv[0])!=SQLITE_NULL ){
+    iOld = sqlite3_value_int64(argv[0]);
+    rc = trigramGetStmt(pTab, TRIGRAM_STMT_CONTENT_SELECT, &pStmt);
+    if( rc==SQLITE_OK ){
+      sqlite3_bind_int64(pStmt, 1, iOld);
+      if( sqlite3_step(pStmt)==SQLITE_ROW ){
+        rc = trigramRowTerms(pTab, sqlite3_column_value(pStmt, 0), &terms);
+      }
+      if( sqlite3_reset(pStmt)!=SQLITE_OK && rc==SQLITE_OK ){
+        rc = sqlite3_errcode(pTab->db);
+      }
+    }
+  }
+
+  /* Change the content. */
+  if( rc==SQLITE_OK ){
+    if( argc==1 ){
+      rc = trigramGetStmt(pTab, TRIGRAM_STMT_CONTENT_DELETE, &pStmt);
+      if( rc==SQLITE_OK ) sqlite3_bind_int64(pStmt, 1, iOld);
+    }else if( sqlite3_value_type(argv[0])==SQLITE_NULL ){
+      rc = trigramGetStmt(pTab, TRIGRAM_STMT_CONTENT_INSERT, &pStmt);
+      if( rc==SQLITE_OK ){
+        sqlite3_bind_value(pStmt, 1, argv[1]);
+        sqlite3_bind_value(pStmt, 2, argv[2]);
+      }
+    }else{
+      iNew = sqlite3_value_type(argv[1])==SQLITE_NULL ?
+          iOld : sqlite3_value_int64(argv[1]);
+      rc = trigramGetStmt(pTab, TRIGRAM_STMT_CONTENT_UPDATE, &pStmt);
+      if( rc==SQLITE_OK ){
+        sqlite3_bind_int64(pStmt, 1, iOld);
+        sqlite3_bind_int64(pStmt, 2, iNew);
+        sqlite3_bind_value(pStmt, 3, argv[2]);
+      }
+    }
+    if( rc==SQLITE_OK ){
+      sqlite3_step(pStmt);
+      rc = sqlite3_reset(pStmt);
+    }
+  }
+
+  /* Then the posting lists. */
+  if( rc==SQLITE_OK && sqlite3_value_type(argv[0])!=SQLITE_NULL ){
+    rc = trigramIndexRow(pTab, iOld, &terms, 1);
+  }
+  if( rc==SQLITE_OK && argc>1 ){
+    if( sqlite3_value_type(argv[0])==SQLITE_NULL ){
+      iNew = sqlite3_last_insert_rowid(pTab->db);
+    }
+    *pRowid = iNew;
+    rc = trigramRowTerms(pTab, argv[2], &terms);
+    if( rc==SQLITE_OK ) rc = trigramIndexRow(pTab, iNew, &terms, 0);
+  }
+  trigramListFree(&terms);
+  return rc;
+}
+
+/*
+** Nothing needs to be done when a transaction begins.
+*/
+static int trigramBegin(sqlite3_vtab *pVtab){
+  (void)pVtab;
+  return SQLITE_OK;
+}
+
+/*
+** Write the pending changes before the transaction commits.
+*/
+static int trigramSync(sqlite3_vtab *pVtab){
+  return trigramPendingFlush((TrigramTable *)pVtab);
+}
+
+/*
+** Nothing needs to be done when a transaction commits.
+*/
+static int trigramCommit(sqlite3_vtab *pVtab){
+  (void)pVtab;
+  return SQLITE_OK;
+}
+
+/*
+** Discard the pending changes when a transaction is rolled back.
+*/
+static int trigramRollback(sqlite3_vtab *pVtab){
+  trigramPendingClear((TrigramTable *)pVtab);
+  return SQLITE_OK;
+}
+
+/*
+** Write the pending changes when a savepoint is opened, so that those
+** made after it can be discarded by ROLLBACK TO.
+*/
+static int trigramSavepoint(sqlite3_vtab *pVtab, int iSavepoint){
+  (void)iSavepoint;
+  return trigramPendingFlush((TrigramTable *)pVtab);
+}
+
+/*
+** Nothing needs to be done when a savepoint is released.
+*/
+static int trigramRelease(sqlite3_vtab *pVtab, int iSavepoint){
+  (void)pVtab;
+  (void)iSavepoint;
+  return SQLITE_OK;
+}
+
+/*
+** Discard the changes made since the savepoint.
+*/
+static int trigramRollbackTo(sqlite3_vtab *pVtab, int iSavepoint){
+  (void)iSavepoint;
+  trigramPendingClear((TrigramTable *)pVtab);
+  return SQLITE_OK;
+}
+
+/*
+** Rename the shadow tables along with the virtual table.
+*/
+static int trigramRename(sqlite3_vtab *pVtab, const char *zNew){
+  TrigramTable *pTab = (TrigramTable *)pVtab;
+  char *zName = sqlite3_mprintf("%s", zNew);
+  char *zSql;
+  int rc;
+  if( zName==0 ) return SQLITE_NOMEM;
+  trigramFinalizeStmts(pTab);
+  zSql = sqlite3_mprintf(
+      "ALTER TABLE \"%w\".\"%w_content\" RENAME TO \"%w_content\";"
+      "ALTER TABLE \"%w\".\"%w_index\" RENAME TO \"%w_index\";",
+      pTab->zDb, pTab->zName, zNew, pTab->zDb, pTab->zName, zNew);
+  rc = zSql ? sqlite3_exec(pTab->db, zSql, 0, 0, 0) : SQLITE_NOMEM;
+  sqlite3_free(zSql);
+  if( rc==SQLITE_OK ){
+    sqlite3_free(pTab->zName);
+    pTab->zName = zName;
+  }else{
+    sqlite3_free(zName);
+  }
+  return rc;
+}
+
+/*
+** Implementation of the MATCH operator, for the rows that are not found
+** through the index: X MATCH P is true if X is LIKE P.  As for any MATCH
+** function, SQLite passes the pattern P first and the column value X second.
+*/
+static void trigramMatchFunc(
+  sqlite3_context *context,
+  int argc,
+  sqlite3_value **argv
+){
+  const unsigned char *zPattern = sqlite3_value_text(argv[0]);
+  const unsigned char *zText = sqlite3_value_text(argv[1]);
+  (void)argc;
+  if( zText==0 || zPattern==0 ) return;
+  sqlite3_result_int(context, trigramLike(zPattern, zText));
+}
+
+/*
+** Overload the MATCH operator for the columns of the virtual table.
+*/
+static int trigramFindFunction(
+  sqlite3_vtab *pVtab,
+  int nArg,
+  const char *zName,
+  void (**pxFunc)(sqlite3_context*,int,sqlite3_value**),
+  void **ppArg
+){
+  (void)pVtab;
+  if( nArg==2 && sqlite3_stricmp(zName, "match")==0 ){
+    *pxFunc = trigramMatchFunc;
+    *ppArg = 0;
+    return 1;
+  }
+  return 0;
+}
+
+/*
+** Implementation of the trigram_soundex(X) function, which returns the
+** soundex code of X, as stored in the soundex column of the virtual table.
+*/
+static void trigramSoundexFunc(
+  sqlite3_context *context,
+  int argc,
+  sqlite3_value **argv
+){
+  const unsigned char *zIn = sqlite3_value_text(argv[0]);
+  char zCode[8];
+  (void)argc;
+  if( zIn==0 ) return;
+  trigramSoundex(zIn, zCode);
+  sqlite3_result_text(context, zCode, -1, SQLITE_TRANSIENT);
+}
+
+/*
+** This following structure defines all the methods for the
+** trigram virtual table.
+*/
+static sqlite3_module trigramModule = {
+  2,                         /* iVersion */
+  trigramCreate,             /* xCreate */
+  trigramConnect,            /* xConnect */
+  trigramBestIndex,          /* xBestIndex */
+  trigramDisconnect,         /* xDisconnect */
+  trigramDestroy,            /* xDestroy */
+  trigramOpen,               /* xOpen - open a cursor */
+  trigramClose,              /* xClose - close a cursor */
+  trigramFilter,             /* xFilter - configure scan constraints */
+  trigramNext,               /* xNext - advance a cursor */
+  trigramEof,                /* xEof - check for end of scan */
+  trigramColumn,             /* xColumn - read data */
+  trigramRowid,              /* xRowid - read data */
+  trigramUpdate,             /* xUpdate */
+  trigramBegin,              /* xBegin */
+  trigramSync,               /* xSync */
+  trigramCommit,             /* xCommit */
+  trigramRollback,           /* xRollback */
+  trigramFindFunction,       /* xFindMethod */
+  trigramRename,             /* xRename */
+  trigramSavepoint,          /* xSavepoint */
+  trigramRelease,            /* xRelease */
+  trigramRollbackTo          /* xRollbackTo */
+};
+
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int sqlite3_trigram_init(
+  sqlite3 *db,
+  char **pzErrMsg,
+  const sqlite3_api_routines *pApi
+){
+  int rc;
+  SQLITE_EXTENSION_INIT2(pApi);
+  (void)pzErrMsg;  /* Unused parameter */
+  rc = sqlite3_create_module(db, "trigram", &trigramModule, 0);
+  if( rc==SQLITE_OK ){
+    rc = sqlite3_create_function(db, "trigram_soundex", 1, SQLITE_UTF8, 0,
+                                 trigramSoundexFunc, 0, 0);
+  }
+  return rc;
+}
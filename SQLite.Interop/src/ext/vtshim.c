@@ -17,6 +17,11 @@
 SQLITE_EXTENSION_INIT1
 #include <assert.h>
 #include <string.h>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
 #ifndef SQLITE_OMIT_VIRTUALTABLE
 
@@ -25,6 +30,13 @@ typedef struct vtshim_aux vtshim_aux;
 typedef struct vtshim_vtab vtshim_vtab;
 typedef struct vtshim_cursor vtshim_cursor;
 
+/* The maximum number of closed cursor objects kept for reuse by each
+** virtual table.  Correlated subqueries open and close a cursor once per
+** outer row, so a handful is enough to avoid nearly all allocations.
+*/
+#ifndef VTSHIM_MAX_FREE_CURSOR
+# define VTSHIM_MAX_FREE_CURSOR 4
+#endif
 
 /* The vtshim_aux argument is the auxiliary parameter that is passed
 ** into sqlite3_create_module_v2().
@@ -36,6 +48,7 @@ struct vtshim_aux {
   sqlite3 *db;                  /* The database to which we are attached */
   char *zName;                  /* Name of the module */
   int bDisposed;                /* True if disposed */
+  int bTiming;                  /* True to time the child cursor methods */
   vtshim_vtab *pAllVtab;        /* List of all vtshim_vtab objects */
   sqlite3_module sSelf;         /* Methods used by this shim */
 };
@@ -46,8 +59,16 @@ struct vtshim_vtab {
   sqlite3_vtab *pChild;    /* Child virtual table */
   vtshim_aux *pAux;        /* Pointer to vtshim_aux object */
   vtshim_cursor *pAllCur;  /* List of all cursors */
+  vtshim_cursor *pFreeCur; /* Closed cursors available for reuse */
+  int nFreeCur;            /* Number of cursors on pFreeCur */
   vtshim_vtab **ppPrev;    /* Previous on list */
   vtshim_vtab *pNext;      /* Next on list */
+  char *zDb;               /* Name of the database holding the table */
+  char *zName;             /* Name of the virtual table */
+  int nOpenCur;            /* Number of cursors currently open */
+  sqlite3_int64 nFilter;   /* Number of xFilter calls */
+  sqlite3_int64 nNext;     /* Number of xNext calls */
+  sqlite3_int64 iChildTime; /* Clock ticks spent in child cursor methods */
 };
 
 /* A vtshim cursor object */
@@ -55,7 +76,7 @@ struct vtshim_cursor {
   sqlite3_vtab_cursor base;    /* Base class - must be first */
   sqlite3_vtab_cursor *pChild; /* Cursor generated by the managed subclass */
   vtshim_cursor **ppPrev;      /* Previous on list of all cursors */
-  vtshim_cursor *pNext;        /* Next on list of all cursors */
+  vtshim_cursor *pNext;        /* Next on list of all cursors or free list */
 };
 
 /* Macro used to copy the child vtable error message to outer vtable */
@@ -65,6 +86,76 @@ struct vtshim_cursor {
     pVtab->base.zErrMsg = sqlite3_mprintf("%s", pVtab->pChild->zErrMsg); \
   } while (0)
 
+/* Return the current value of a monotonic high resolution clock */
+static sqlite3_int64 vtshimClock(void){
+#if defined(_WIN32)
+  LARGE_INTEGER t;
+  QueryPerformanceCounter(&t);
+  return (sqlite3_int64)t.QuadPart;
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (sqlite3_int64)t.tv_sec*1000000000 + t.tv_nsec;
+#endif
+}
+
+/* Convert a number of vtshimClock() ticks into microseconds */
+static sqlite3_int64 vtshimClockToMicroseconds(sqlite3_int64 n){
+#if defined(_WIN32)
+  LARGE_INTEGER f;
+  if( !QueryPerformanceFrequency(&f) || f.QuadPart<=0 ) return 0;
+  return (sqlite3_int64)((double)n*1000000.0/(double)f.QuadPart);
+#else
+  return n/1000;
+#endif
+}
+
+/* Macro used to call a child cursor method and time it, if timing has
+** been enabled for the module using sqlite3_vtshim_timing()
+*/
+#define VTSHIM_TIMED_CALL(X)                                             \
+  do {                                                                   \
+    if( pAux->bTiming ){                                                 \
+      sqlite3_int64 iStart = vtshimClock();                              \
+      X;                                                                 \
+      pVtab->iChildTime += vtshimClock() - iStart;                       \
+    }else{                                                               \
+      X;                                                                 \
+    }                                                                    \
+  } while (0)
+
+/* Add a new vtshim_vtab object to the list of all virtual tables */
+static void vtshimLinkVtab(
+  vtshim_aux *pAux,
+  vtshim_vtab *pNew,
+  const char *zDb,
+  const char *zName
+){
+  pNew->pAux = pAux;
+  pNew->zDb = sqlite3_mprintf("%s", zDb);
+  pNew->zName = sqlite3_mprintf("%s", zName);
+  pNew->ppPrev = &pAux->pAllVtab;
+  pNew->pNext = pAux->pAllVtab;
+  if( pAux->pAllVtab ) pAux->pAllVtab->ppPrev = &pNew->pNext;
+  pAux->pAllVtab = pNew;
+}
+
+/* Remove a vtshim_vtab object from the list and free it, together with
+** its reusable cursors.
+*/
+static void vtshimFreeVtab(vtshim_vtab *pVtab){
+  while( pVtab->pFreeCur ){
+    vtshim_cursor *pCur = pVtab->pFreeCur;
+    pVtab->pFreeCur = pCur->pNext;
+    sqlite3_free(pCur);
+  }
+  if( pVtab->pNext ) pVtab->pNext->ppPrev = pVtab->ppPrev;
+  *pVtab->ppPrev = pVtab->pNext;
+  sqlite3_free(pVtab->zDb);
+  sqlite3_free(pVtab->zName);
+  sqlite3_free(pVtab);
+}
+
 /* Methods for the vtshim module */
 static int vtshimCreate(
   sqlite3 *db,
@@ -95,12 +186,9 @@ static int vtshimCreate(
   if( rc ){
     sqlite3_free(pNew);
     *ppVtab = 0;
+    return rc;
   }
-  pNew->pAux = pAux;
-  pNew->ppPrev = &pAux->pAllVtab;
-  pNew->pNext = pAux->pAllVtab;
-  if( pAux->pAllVtab ) pAux->pAllVtab->ppPrev = &pNew->pNext;
-  pAux->pAllVtab = pNew;
+  vtshimLinkVtab(pAux, pNew, argc>1 ? argv[1] : 0, argc>2 ? argv[2] : 0);
   return rc;
 }
 
@@ -133,12 +221,9 @@ static int vtshimConnect(
   if( rc ){
     sqlite3_free(pNew);
     *ppVtab = 0;
+    return rc;
   }
-  pNew->pAux = pAux;
-  pNew->ppPrev = &pAux->pAllVtab;
-  pNew->pNext = pAux->pAllVtab;
-  if( pAux->pAllVtab ) pAux->pAllVtab->ppPrev = &pNew->pNext;
-  pAux->pAllVtab = pNew;
+  vtshimLinkVtab(pAux, pNew, argc>1 ? argv[1] : 0, argc>2 ? argv[2] : 0);
   return rc;
 }
 
@@ -164,9 +249,7 @@ static int vtshimDisconnect(sqlite3_vtab *pBase){
   if( !pAux->bDisposed ){
     rc = pAux->pMod->xDisconnect(pVtab->pChild);
   }
-  if( pVtab->pNext ) pVtab->pNext->ppPrev = pVtab->ppPrev;
-  *pVtab->ppPrev = pVtab->pNext;
-  sqlite3_free(pVtab);
+  vtshimFreeVtab(pVtab);
   return rc;
 }
 
@@ -177,9 +260,7 @@ static int vtshimDestroy(sqlite3_vtab *pBase){
   if( !pAux->bDisposed ){
     rc = pAux->pMod->xDestroy(pVtab->pChild);
   }
-  if( pVtab->pNext ) pVtab->pNext->ppPrev = pVtab->ppPrev;
-  *pVtab->ppPrev = pVtab->pNext;
-  sqlite3_free(pVtab);
+  vtshimFreeVtab(pVtab);
   return rc;
 }
 
@@ -190,12 +271,20 @@ static int vtshimOpen(sqlite3_vtab *pBase, sqlite3_vtab_cursor **ppCursor){
   int rc;
   *ppCursor = 0;
   if( pAux->bDisposed ) return SQLITE_ERROR;
-  pCur = sqlite3_malloc( sizeof(*pCur) );
-  if( pCur==0 ) return SQLITE_NOMEM;
+  if( pVtab->pFreeCur ){
+    pCur = pVtab->pFreeCur;
+    pVtab->pFreeCur = pCur->pNext;
+    pVtab->nFreeCur--;
+  }else{
+    pCur = sqlite3_malloc( sizeof(*pCur) );
+    if( pCur==0 ) return SQLITE_NOMEM;
+  }
   memset(pCur, 0, sizeof(*pCur));
   rc = pAux->pMod->xOpen(pVtab->pChild, &pCur->pChild);
   if( rc ){
-    sqlite3_free(pCur);
+    pCur->pNext = pVtab->pFreeCur;
+    pVtab->pFreeCur = pCur;
+    pVtab->nFreeCur++;
     VTSHIM_COPY_ERRMSG();
     return rc;
   }
@@ -205,6 +294,7 @@ static int vtshimOpen(sqlite3_vtab *pBase, sqlite3_vtab_cursor **ppCursor){
   if( pVtab->pAllCur ) pVtab->pAllCur->ppPrev = &pCur->pNext;
   pCur->pNext = pVtab->pAllCur;
   pVtab->pAllCur = pCur;
+  pVtab->nOpenCur++;
   return SQLITE_OK;
 }
 
@@ -221,7 +311,14 @@ static int vtshimClose(sqlite3_vtab_cursor *pX){
   }
   if( pCur->pNext ) pCur->pNext->ppPrev = pCur->ppPrev;
   *pCur->ppPrev = pCur->pNext;
-  sqlite3_free(pCur);
+  pVtab->nOpenCur--;
+  if( pVtab->nFreeCur<VTSHIM_MAX_FREE_CURSOR ){
+    pCur->pNext = pVtab->pFreeCur;
+    pVtab->pFreeCur = pCur;
+    pVtab->nFreeCur++;
+  }else{
+    sqlite3_free(pCur);
+  }
   return rc;
 }
 
@@ -237,7 +334,10 @@ static int vtshimFilter(
   vtshim_aux *pAux = pVtab->pAux;
   int rc;
   if( pAux->bDisposed ) return SQLITE_ERROR;
-  rc = pAux->pMod->xFilter(pCur->pChild, idxNum, idxStr, argc, argv);
+  pVtab->nFilter++;
+  VTSHIM_TIMED_CALL(
+    rc = pAux->pMod->xFilter(pCur->pChild, idxNum, idxStr, argc, argv)
+  );
   if( rc!=SQLITE_OK ){
     VTSHIM_COPY_ERRMSG();
   }
@@ -250,7 +350,8 @@ static int vtshimNext(sqlite3_vtab_cursor *pX){
   vtshim_aux *pAux = pVtab->pAux;
   int rc;
   if( pAux->bDisposed ) return SQLITE_ERROR;
-  rc = pAux->pMod->xNext(pCur->pChild);
+  pVtab->nNext++;
+  VTSHIM_TIMED_CALL( rc = pAux->pMod->xNext(pCur->pChild) );
   if( rc!=SQLITE_OK ){
     VTSHIM_COPY_ERRMSG();
   }
@@ -263,7 +364,7 @@ static int vtshimEof(sqlite3_vtab_cursor *pX){
   vtshim_aux *pAux = pVtab->pAux;
   int rc;
   if( pAux->bDisposed ) return 1;
-  rc = pAux->pMod->xEof(pCur->pChild);
+  VTSHIM_TIMED_CALL( rc = pAux->pMod->xEof(pCur->pChild) );
   VTSHIM_COPY_ERRMSG();
   return rc;
 }
@@ -274,7 +375,7 @@ static int vtshimColumn(sqlite3_vtab_cursor *pX, sqlite3_context *ctx, int i){
   vtshim_aux *pAux = pVtab->pAux;
   int rc;
   if( pAux->bDisposed ) return SQLITE_ERROR;
-  rc = pAux->pMod->xColumn(pCur->pChild, ctx, i);
+  VTSHIM_TIMED_CALL( rc = pAux->pMod->xColumn(pCur->pChild, ctx, i) );
   if( rc!=SQLITE_OK ){
     VTSHIM_COPY_ERRMSG();
   }
@@ -287,7 +388,7 @@ static int vtshimRowid(sqlite3_vtab_cursor *pX, sqlite3_int64 *pRowid){
   vtshim_aux *pAux = pVtab->pAux;
   int rc;
   if( pAux->bDisposed ) return SQLITE_ERROR;
-  rc = pAux->pMod->xRowid(pCur->pChild, pRowid);
+  VTSHIM_TIMED_CALL( rc = pAux->pMod->xRowid(pCur->pChild, pRowid) );
   if( rc!=SQLITE_OK ){
     VTSHIM_COPY_ERRMSG();
   }
@@ -383,6 +484,12 @@ static int vtshimRename(sqlite3_vtab *pBase, const char *zNewName){
   rc = pAux->pMod->xRename(pVtab->pChild, zNewName);
   if( rc!=SQLITE_OK ){
     VTSHIM_COPY_ERRMSG();
+  }else{
+    char *zName = sqlite3_mprintf("%s", zNewName);
+    if( zName ){
+      sqlite3_free(pVtab->zName);
+      pVtab->zName = zName;
+    }
   }
   return rc;
 }
@@ -478,6 +585,7 @@ void *sqlite3_create_disposable_module(
   pAux->db = db;
   pAux->zName = sqlite3_mprintf("%s", zName);
   pAux->bDisposed = 0;
+  pAux->bTiming = 0;
   pAux->pAllVtab = 0;
   pAux->sSelf.iVersion = p->iVersion<=2 ? p->iVersion : 2;
   pAux->sSelf.xCreate = p->xCreate ? vtshimCreate : 0;
@@ -535,6 +643,79 @@ void sqlite3_dispose_module(void *pX){
   }
 }
 
+/*
+** Enable (onOff>0) or disable (onOff==0) timing of the cursor methods of
+** the child module for all the virtual tables that use the disposable
+** module pX, or leave it unchanged (onOff<0).  Timing reads a high
+** resolution clock twice per call, so it is disabled by default.  Returns
+** the previous setting.
+*/
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int sqlite3_vtshim_timing(void *pX, int onOff){
+  vtshim_aux *pAux = (vtshim_aux*)pX;
+  int bOld;
+  if( pAux==0 ) return 0;
+  bOld = pAux->bTiming;
+  if( onOff>=0 ) pAux->bTiming = onOff!=0;
+  return bOld;
+}
+
+/*
+** Report the instrumentation counters of the virtual table zTable in the
+** database zDb ("main" if NULL) that uses the disposable module pX: the
+** number of cursors currently open, the number of xFilter and xNext calls,
+** and the total time spent in the cursor methods of the child module, in
+** microseconds, which is only measured while timing is enabled using
+** sqlite3_vtshim_timing().  Any output pointer may be NULL.  If resetFlag
+** is non-zero, the call counts and the time are reset after being
+** reported.  SQLITE_NOTFOUND is returned if there is no such virtual table.
+*/
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int sqlite3_vtshim_stats(
+  void *pX,                    /* Module from sqlite3_create_disposable_module */
+  const char *zDb,             /* Name of the database, or NULL for "main" */
+  const char *zTable,          /* Name of the virtual table */
+  int resetFlag,               /* Reset the counters after reporting them */
+  int *pnOpenCursor,           /* OUT: Number of open cursors */
+  sqlite3_int64 *pnFilter,     /* OUT: Number of xFilter calls */
+  sqlite3_int64 *pnNext,       /* OUT: Number of xNext calls */
+  sqlite3_int64 *pnChildTime   /* OUT: Microseconds spent in child methods */
+){
+  vtshim_aux *pAux = (vtshim_aux*)pX;
+  vtshim_vtab *pVtab;
+  sqlite3_mutex *mutex;
+  if( pAux==0 || zTable==0 ) return SQLITE_MISUSE;
+  if( zDb==0 ) zDb = "main";
+  mutex = sqlite3_db_mutex(pAux->db);
+  sqlite3_mutex_enter(mutex);
+  for(pVtab=pAux->pAllVtab; pVtab; pVtab=pVtab->pNext){
+    if( pVtab->zDb && sqlite3_stricmp(pVtab->zDb, zDb)==0
+     && pVtab->zName && sqlite3_stricmp(pVtab->zName, zTable)==0 ){
+      break;
+    }
+  }
+  if( pVtab==0 ){
+    sqlite3_mutex_leave(mutex);
+    return SQLITE_NOTFOUND;
+  }
+  if( pnOpenCursor ) *pnOpenCursor = pVtab->nOpenCur;
+  if( pnFilter ) *pnFilter = pVtab->nFilter;
+  if( pnNext ) *pnNext = pVtab->nNext;
+  if( pnChildTime ){
+    *pnChildTime = vtshimClockToMicroseconds(pVtab->iChildTime);
+  }
+  if( resetFlag ){
+    pVtab->nFilter = 0;
+    pVtab->nNext = 0;
+    pVtab->iChildTime = 0;
+  }
+  sqlite3_mutex_leave(mutex);
+  return SQLITE_OK;
+}
 
 #endif /* SQLITE_OMIT_VIRTUALTABLE */
 
@@ -11,20 +11,61 @@
 #include <windows.h>
 #include <wincrypt.h>
 
-/* Extra padding before and after the cryptographic buffer */
+/* Extra padding before and after the cryptographic buffer, only needed by ciphers that
+** do not preserve the length of the data
+*/
 #define CRYPT_OFFSET 8
 
+/* While an incremental rekey is in progress, the last page rewritten using
+** the new key is recorded in the "reserved for expansion" area of the
+** database header, following a marker.
+*/
+#define CRYPT_REKEY_OFFSET 72
+#define CRYPT_REKEY_MARKER "RKEY"
+
 typedef struct _CRYPTBLOCK
 {
   Pager    *pPager;       /* Pager this cryptblock belongs to */
   HCRYPTKEY hReadKey;     /* Key used to read from the database and write to the journal */
   HCRYPTKEY hWriteKey;    /* Key used to write to the database */
   DWORD     dwPageSize;   /* Size of pages */
-  LPVOID    pvCrypt;      /* A buffer for encrypting/decrypting (if necessary) */
-  DWORD     dwCryptSize;  /* Equal to or greater than dwPageSize.  If larger, pvCrypt is valid and this is its size */
+  LPVOID    pvCrypt;      /* Output buffer for encrypted pages, also used for decrypting if the cipher pads, followed by a spare copy of page 1 */
+  DWORD     dwCryptSize;  /* Equal to or greater than dwPageSize.  If larger, the cipher pads and this is the padded size */
+  HCRYPTKEY hRekeyKey;    /* Incremental rekey: the new key, zero if none or if the database is being decrypted */
+  Pgno      nRekeyPage;   /* Incremental rekey: pages 2 through nRekeyPage use hRekeyKey, zero if no marker is in effect */
+  BOOL      bRekeyFinal;  /* Incremental rekey: page 1 is being written using hRekeyKey */
+  BOOL      bRekeyKey;    /* Incremental rekey: hRekeyKey holds the new key */
 } CRYPTBLOCK, *LPCRYPTBLOCK;
 
-HCRYPTPROV g_hProvider = 0; /* Global instance of the cryptographic provider */
+/* Random salt mixed into the digests used to look up cached keys */
+#define CRYPT_SALT_SIZE 16
+
+/* Size of a SHA1 digest */
+#define CRYPT_DIGEST_SIZE 20
+
+/* Number of derived keys kept in the key cache, must be a power of two */
+#ifndef CRYPT_KEY_CACHE_SIZE
+#define CRYPT_KEY_CACHE_SIZE 16
+#endif
+
+typedef struct _CRYPTPROVIDER
+{
+  HCRYPTPROV hProvider;               /* The cryptographic provider */
+  BYTE       aSalt[CRYPT_SALT_SIZE];  /* Salt for key cache digests */
+} CRYPTPROVIDER, *LPCRYPTPROVIDER;
+
+typedef struct _CRYPTKEYCACHE
+{
+  volatile LONG lLock;                     /* Non-zero while the entry is in use */
+  BYTE          aDigest[CRYPT_DIGEST_SIZE]; /* Salted digest of the user-supplied key */
+  HCRYPTKEY     hKey;                      /* Derived key, duplicated for each caller */
+} CRYPTKEYCACHE, *LPCRYPTKEYCACHE;
+
+/* Global instance of the cryptographic provider, published once */
+static LPCRYPTPROVIDER volatile g_pProvider = NULL;
+
+/* Cache of recently derived keys, indexed by digest */
+static CRYPTKEYCACHE g_aKeyCache[CRYPT_KEY_CACHE_SIZE];
 
 #define SQLITECRYPTERROR_PROVIDER "Cryptographic provider not available"
 
@@ -39,27 +80,79 @@ void sqlite3_activate_see(const char *info)
 }
 
 /* Create a cryptographic context.  Use the enhanced provider because it is available on
-** most platforms
+** most platforms.  No lock is taken: threads racing to create the context each acquire
+** one and all but the first to publish theirs release it again.
 */
-static BOOL InitializeProvider()
+static LPCRYPTPROVIDER InitializeProvider()
 {
-  MUTEX_LOGIC( sqlite3_mutex *pMaster = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_MASTER); )
-  sqlite3_mutex_enter(pMaster);
+  LPCRYPTPROVIDER pProvider = g_pProvider;
+  LPCRYPTPROVIDER pExisting;
 
-  if (g_hProvider)
+  if (pProvider) return pProvider;
+
+  pProvider = (LPCRYPTPROVIDER)HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(CRYPTPROVIDER));
+  if (!pProvider) return NULL;
+
+  if (!CryptAcquireContext(&pProvider->hProvider, NULL, MS_ENHANCED_PROV, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT))
   {
-    sqlite3_mutex_leave(pMaster);
-    return TRUE;
+    HeapFree(GetProcessHeap(), 0, pProvider);
+    return NULL;
   }
 
-  if (!CryptAcquireContext(&g_hProvider, NULL, MS_ENHANCED_PROV, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT))
+  if (!CryptGenRandom(pProvider->hProvider, CRYPT_SALT_SIZE, pProvider->aSalt))
   {
-    sqlite3_mutex_leave(pMaster);
-    return FALSE;
+    CryptReleaseContext(pProvider->hProvider, 0);
+    HeapFree(GetProcessHeap(), 0, pProvider);
+    return NULL;
+  }
+
+  pExisting = (LPCRYPTPROVIDER)InterlockedCompareExchangePointer((PVOID volatile *)&g_pProvider, pProvider, NULL);
+  if (pExisting) /* Another thread got there first, use its context */
+  {
+    CryptReleaseContext(pProvider->hProvider, 0);
+    HeapFree(GetProcessHeap(), 0, pProvider);
+    return pExisting;
+  }
+
+  return pProvider;
+}
+
+/* Compute the salted digest of a user-supplied key, used to look it up in the key cache
+** without keeping the key itself around
+*/
+static BOOL DigestKey(LPCRYPTPROVIDER pProvider, const void *pKey, int nKey, LPBYTE pDigest)
+{
+  HCRYPTHASH hHash = 0;
+  DWORD dwDigestSize = CRYPT_DIGEST_SIZE;
+  BOOL bOk = FALSE;
+
+  if (CryptCreateHash(pProvider->hProvider, CALG_SHA1, 0, 0, &hHash))
+  {
+    bOk = CryptHashData(hHash, pProvider->aSalt, CRYPT_SALT_SIZE, 0) &&
+          CryptHashData(hHash, (LPBYTE)pKey, nKey, 0) &&
+          CryptGetHashParam(hHash, HP_HASHVAL, pDigest, &dwDigestSize, 0);
+    CryptDestroyHash(hHash);
   }
 
-  sqlite3_mutex_leave(pMaster);
-  return TRUE;
+  return bOk;
+}
+
+/* Claim and release a key cache entry.  Entries are only held long enough to compare
+** a digest and duplicate a key, so spinning is cheaper than a kernel lock.
+*/
+static LPCRYPTKEYCACHE LockKeyCache(const BYTE *pDigest)
+{
+  LPCRYPTKEYCACHE pEntry = &g_aKeyCache[pDigest[0] & (CRYPT_KEY_CACHE_SIZE - 1)];
+
+  while (InterlockedCompareExchange(&pEntry->lLock, 1, 0) != 0)
+    Sleep(0);
+
+  return pEntry;
+}
+
+static void UnlockKeyCache(LPCRYPTKEYCACHE pEntry)
+{
+  InterlockedExchange(&pEntry->lLock, 0);
 }
 
 /* Create or update a cryptographic context for a pager.
@@ -99,9 +192,15 @@ static LPCRYPTBLOCK CreateCryptBlock(HCRYPTKEY hKey, Pager *pager, int pageSize,
     pBlock->pvCrypt = NULL;
   }
 
-  /* Figure out how big to make our spare crypt block */
+  /* Figure out how big to make our spare crypt block.  A length-preserving cipher (e.g.
+  ** RC4) needs exactly one page, without any padding around it.  Either way, it is
+  ** followed by one more page that CodecLoadPage1() uses to hold a copy of page 1.
+  */
   CryptEncrypt(hKey, 0, TRUE, 0, NULL, &pBlock->dwCryptSize, pBlock->dwCryptSize * 2);
-  pBlock->pvCrypt = sqlite3_malloc(pBlock->dwCryptSize + (CRYPT_OFFSET * 2));
+  if (pBlock->dwCryptSize == pBlock->dwPageSize)
+    pBlock->pvCrypt = sqlite3_malloc(pBlock->dwPageSize * 2);
+  else
+    pBlock->pvCrypt = sqlite3_malloc(pBlock->dwCryptSize + (CRYPT_OFFSET * 2) + pBlock->dwPageSize);
   if (!pBlock->pvCrypt)
   {
     /* We created a new block in here, so free it.  Otherwise leave the original intact */
@@ -130,6 +229,12 @@ static void sqlite3CodecFree(LPVOID pv)
     CryptDestroyKey(pBlock->hWriteKey);
   }
 
+  /* Destroy the new key of an unfinished incremental rekey */
+  if (pBlock->hRekeyKey)
+  {
+    CryptDestroyKey(pBlock->hRekeyKey);
+  }
+
   /* If there's extra buffer space allocated, free it as well */
   if (pBlock->pvCrypt)
   {
@@ -151,57 +256,200 @@ void sqlite3CodecSizeChange(void *pArg, int pageSize, int reservedSize)
   }
 }
 
+/* Returns the key that the database file image of a page is encrypted with
+** (bWrite is zero) or the key to use when writing it to the database file
+** (bWrite is non-zero).  While an incremental rekey marker is in effect,
+** pages 2 through nRekeyPage have been rewritten using the new key and the
+** others still use the original key, for reads and writes alike.  Page 1
+** holds the marker, so it only switches to the new key in the final step.
+** Merely holding the new key changes nothing until a marker exists.
+*/
+static HCRYPTKEY CodecPageKey(LPCRYPTBLOCK pBlock, Pgno nPageNum, BOOL bWrite)
+{
+  if (!pBlock->nRekeyPage)
+    return bWrite ? pBlock->hWriteKey : pBlock->hReadKey;
+
+  if (nPageNum == 1)
+    return (bWrite && pBlock->bRekeyFinal) ? pBlock->hRekeyKey : pBlock->hReadKey;
+
+  return (nPageNum <= pBlock->nRekeyPage) ? pBlock->hRekeyKey : pBlock->hReadKey;
+}
+
+/* Returns the start of the page within the spare crypt block */
+static LPBYTE CodecBuffer(LPCRYPTBLOCK pBlock)
+{
+  if (pBlock->dwCryptSize == pBlock->dwPageSize)
+    return (LPBYTE)pBlock->pvCrypt;
+
+  return ((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET;
+}
+
+/* Returns the spare copy of page 1 that follows the spare crypt block */
+static LPBYTE CodecPage1Copy(LPCRYPTBLOCK pBlock)
+{
+  if (pBlock->dwCryptSize == pBlock->dwPageSize)
+    return ((LPBYTE)pBlock->pvCrypt) + pBlock->dwPageSize;
+
+  return ((LPBYTE)pBlock->pvCrypt) + pBlock->dwCryptSize + (CRYPT_OFFSET * 2);
+}
+
+/* Decrypt a page in place, using the scratch buffer only if the algorithm
+** requires padding.
+*/
+static void CodecDecrypt(LPCRYPTBLOCK pBlock, HCRYPTKEY hKey, LPVOID data)
+{
+  DWORD dwPageSize;
+  LPVOID pvTemp = NULL;
+
+  if (!hKey) return;
+
+  /* Block ciphers often need to write extra padding beyond the
+  data block.  We don't have that luxury for a given page of data so
+  we must copy the page data to a buffer that IS large enough to hold
+  the padding.  We then encrypt the block and write the buffer back to
+  the page without the unnecessary padding.
+  We only use the special block of memory if its absolutely necessary. */
+  if (pBlock->dwCryptSize != pBlock->dwPageSize)
+  {
+    CopyMemory(CodecBuffer(pBlock), data, pBlock->dwPageSize);
+    pvTemp = data;
+    data = CodecBuffer(pBlock);
+  }
+
+  dwPageSize = pBlock->dwCryptSize;
+  CryptDecrypt(hKey, 0, TRUE, 0, (LPBYTE)data, &dwPageSize);
+
+  /* If the encryption algorithm required extra padding and we were forced to encrypt or
+  ** decrypt a copy of the page data to a temp buffer, then write the contents of the temp
+  ** buffer back to the page data minus any padding applied.
+  */
+  if (pBlock->dwCryptSize != pBlock->dwPageSize)
+  {
+    CopyMemory(pvTemp, data, pBlock->dwPageSize);
+  }
+}
+
+/* Encrypt a page into the spare crypt block and return it.  The page itself belongs to the
+** pager cache and must stay in plain text, so this is the only copy made when writing.
+*/
+static LPVOID CodecEncrypt(LPCRYPTBLOCK pBlock, HCRYPTKEY hKey, LPVOID data)
+{
+  LPBYTE pOut = CodecBuffer(pBlock);
+  DWORD dwPageSize = pBlock->dwPageSize;
+
+  CopyMemory(pOut, data, pBlock->dwPageSize);
+  CryptEncrypt(hKey, 0, TRUE, 0, pOut, &dwPageSize, pBlock->dwCryptSize);
+
+  return pOut;
+}
+
+/* Read the incremental rekey progress marker from a decrypted page 1 */
+static Pgno CodecRekeyMarker(LPVOID data)
+{
+  LPBYTE a = ((LPBYTE)data) + CRYPT_REKEY_OFFSET;
+
+  if (memcmp(a, CRYPT_REKEY_MARKER, 4) != 0) return 0;
+  return (Pgno)sqlite3Get4byte(a + 4);
+}
+
+/* Replace the original key with the new one once an incremental rekey has
+** been completed (by this connection or another one).
+*/
+static void CodecRekeyComplete(LPCRYPTBLOCK pBlock)
+{
+  if (pBlock->hWriteKey && pBlock->hWriteKey != pBlock->hReadKey)
+  {
+    CryptDestroyKey(pBlock->hWriteKey);
+  }
+  if (pBlock->hReadKey)
+  {
+    CryptDestroyKey(pBlock->hReadKey);
+  }
+  pBlock->hReadKey = pBlock->hRekeyKey;
+  pBlock->hWriteKey = pBlock->hRekeyKey;
+  pBlock->hRekeyKey = 0;
+  pBlock->nRekeyPage = 0;
+  pBlock->bRekeyFinal = FALSE;
+  pBlock->bRekeyKey = FALSE;
+}
+
+/* Decrypt page 1 and pick up the incremental rekey state from it.  When this
+** connection holds the new key and page 1 cannot be read using the original
+** one, another connection has completed the rekey, so switch over to it.
+**
+** When a rekey is in progress and this connection has not been given the new
+** key, some pages cannot be decrypted.  Rather than fail on those pages (the
+** pager reports a codec failure as SQLITE_NOMEM), set the read version (byte
+** 19) in the header of the cached copy of page 1 to one SQLite does not
+** support, so every transaction fails up front with SQLITE_NOTADB, just as
+** with a wrong key.  Supplying the new key discards the cached copy.
+**
+** The original image of page 1 is kept in the spare page at the end of the
+** crypt block, so loading it never needs to allocate memory.
+*/
+static void CodecLoadPage1(LPCRYPTBLOCK pBlock, LPVOID data)
+{
+  LPVOID pvCopy = NULL;
+
+  if (pBlock->bRekeyKey && pBlock->hRekeyKey != pBlock->hReadKey)
+  {
+    pvCopy = CodecPage1Copy(pBlock);
+    CopyMemory(pvCopy, data, pBlock->dwPageSize);
+  }
+
+  CodecDecrypt(pBlock, pBlock->hReadKey, data);
+
+  if (pvCopy)
+  {
+    if (memcmp(data, SQLITE_FILE_HEADER, 16) != 0)
+    {
+      CopyMemory(data, pvCopy, pBlock->dwPageSize);
+      CodecDecrypt(pBlock, pBlock->hRekeyKey, data);
+
+      if (memcmp(data, SQLITE_FILE_HEADER, 16) == 0)
+        CodecRekeyComplete(pBlock);
+      else
+        CopyMemory(data, pvCopy, pBlock->dwPageSize);
+    }
+  }
+
+  pBlock->nRekeyPage = CodecRekeyMarker(data);
+
+  if (pBlock->nRekeyPage && !pBlock->bRekeyKey)
+    ((LPBYTE)data)[19] = 0xFF;
+}
+
 /* Encrypt/Decrypt functionality, called by pager.c */
 void * sqlite3Codec(void *pArg, void *data, Pgno nPageNum, int nMode)
 {
   LPCRYPTBLOCK pBlock = (LPCRYPTBLOCK)pArg;
-  DWORD dwPageSize;
-  LPVOID pvTemp = NULL;
+  HCRYPTKEY hKey;
 
   if (!pBlock) return data;
   if (pBlock->pvCrypt == NULL) return NULL; /* This only happens if CreateCryptBlock() failed to make scratch space */
 
+  /* Pages already rewritten by an incremental rekey cannot be used until the
+  ** new key has been supplied to this connection.  CodecLoadPage1() normally
+  ** stops such a connection before it gets this far.
+  */
+  if (pBlock->nRekeyPage && !pBlock->bRekeyKey && nPageNum != 1 && nPageNum <= pBlock->nRekeyPage)
+    return NULL;
+
   switch(nMode)
   {
   case 0: /* Undo a "case 7" journal file encryption */
+    CodecDecrypt(pBlock, CodecPageKey(pBlock, nPageNum, FALSE), data);
+    break;
   case 2: /* Reload a page */
   case 3: /* Load a page */
-    if (!pBlock->hReadKey) break;
-
-    /* Block ciphers often need to write extra padding beyond the
-    data block.  We don't have that luxury for a given page of data so
-    we must copy the page data to a buffer that IS large enough to hold
-    the padding.  We then encrypt the block and write the buffer back to
-    the page without the unnecessary padding.
-    We only use the special block of memory if its absolutely necessary. */
-    if (pBlock->dwCryptSize != pBlock->dwPageSize)
-    {
-      CopyMemory(((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET, data, pBlock->dwPageSize);
-      pvTemp = data;
-      data = ((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET;
-    }
-
-    dwPageSize = pBlock->dwCryptSize;
-    CryptDecrypt(pBlock->hReadKey, 0, TRUE, 0, (LPBYTE)data, &dwPageSize);
-
-    /* If the encryption algorithm required extra padding and we were forced to encrypt or
-    ** decrypt a copy of the page data to a temp buffer, then write the contents of the temp
-    ** buffer back to the page data minus any padding applied.
-    */
-    if (pBlock->dwCryptSize != pBlock->dwPageSize)
-    {
-      CopyMemory(pvTemp, data, pBlock->dwPageSize);
-      data = pvTemp;
-    }
+    if (nPageNum == 1)
+      CodecLoadPage1(pBlock, data);
+    else
+      CodecDecrypt(pBlock, CodecPageKey(pBlock, nPageNum, FALSE), data);
     break;
   case 6: /* Encrypt a page for the main database file */
-    if (!pBlock->hWriteKey) break;
-
-    CopyMemory(((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET, data, pBlock->dwPageSize);
-    data = ((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET;
-
-    dwPageSize = pBlock->dwPageSize;
-    CryptEncrypt(pBlock->hWriteKey, 0, TRUE, 0, ((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET, &dwPageSize, pBlock->dwCryptSize);
+    hKey = CodecPageKey(pBlock, nPageNum, TRUE);
+    if (hKey) data = CodecEncrypt(pBlock, hKey, data);
     break;
   case 7: /* Encrypt a page for the journal file */
     /* Under normal circumstances, the readkey is the same as the writekey.  However,
@@ -210,48 +458,71 @@ void * sqlite3Codec(void *pArg, void *data, Pgno nPageNum, int nMode)
     database file because it is, by nature, a rollback journal.
     Therefore, for case 7, when the rollback is being written, always encrypt using
     the database's readkey, which is guaranteed to be the same key that was used to
-    read the original data.
+    read the original data.  During an incremental rekey, that is the key of the
+    page as it currently exists in the database file.
     */
-    if (!pBlock->hReadKey) break;
-
-    CopyMemory(((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET, data, pBlock->dwPageSize);
-    data = ((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET;
-
-    dwPageSize = pBlock->dwPageSize;
-    CryptEncrypt(pBlock->hReadKey, 0, TRUE, 0, ((LPBYTE)pBlock->pvCrypt) + CRYPT_OFFSET, &dwPageSize, pBlock->dwCryptSize);
+    hKey = CodecPageKey(pBlock, nPageNum, FALSE);
+    if (hKey) data = CodecEncrypt(pBlock, hKey, data);
     break;
   }
 
   return data;
 }
 
-/* Derive an encryption key from a user-supplied buffer */
+/* Derive an encryption key from a user-supplied buffer.  Recently derived keys are cached,
+** so opening the same database again only costs a digest and a key duplication.  The
+** caller owns the returned key.
+*/
 static HCRYPTKEY DeriveKey(const void *pKey, int nKey)
 {
+  LPCRYPTPROVIDER pProvider;
+  LPCRYPTKEYCACHE pEntry;
   HCRYPTHASH hHash = 0;
-  HCRYPTKEY  hKey;
+  HCRYPTKEY  hKey = MAXDWORD;
+  HCRYPTKEY  hCacheKey;
+  BYTE       aDigest[CRYPT_DIGEST_SIZE];
+  BOOL       bDigest;
 
   if (!pKey || !nKey) return 0;
 
-  if (!InitializeProvider())
+  pProvider = InitializeProvider();
+  if (!pProvider)
   {
     return MAXDWORD;
   }
 
+  bDigest = DigestKey(pProvider, pKey, nKey, aDigest);
+  if (bDigest)
   {
-    MUTEX_LOGIC( sqlite3_mutex *pMaster = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_MASTER); )
-    sqlite3_mutex_enter(pMaster);
+    pEntry = LockKeyCache(aDigest);
+    if (pEntry->hKey && memcmp(pEntry->aDigest, aDigest, CRYPT_DIGEST_SIZE) == 0)
+    {
+      if (!CryptDuplicateKey(pEntry->hKey, NULL, 0, &hKey))
+        hKey = MAXDWORD;
+    }
+    UnlockKeyCache(pEntry);
+
+    if (hKey != MAXDWORD) return hKey;
+  }
 
-    if (CryptCreateHash(g_hProvider, CALG_SHA1, 0, 0, &hHash))
+  if (CryptCreateHash(pProvider->hProvider, CALG_SHA1, 0, 0, &hHash))
+  {
+    if (CryptHashData(hHash, (LPBYTE)pKey, nKey, 0))
     {
-      if (CryptHashData(hHash, (LPBYTE)pKey, nKey, 0))
-      {
-        CryptDeriveKey(g_hProvider, CALG_RC4, hHash, 0, &hKey);
-      }
-      CryptDestroyHash(hHash);
+      if (!CryptDeriveKey(pProvider->hProvider, CALG_RC4, hHash, 0, &hKey))
+        hKey = MAXDWORD;
     }
+    CryptDestroyHash(hHash);
+  }
 
-    sqlite3_mutex_leave(pMaster);
+  /* Keep a copy of the new key in the cache, replacing whatever was there */
+  if (bDigest && hKey != MAXDWORD && CryptDuplicateKey(hKey, NULL, 0, &hCacheKey))
+  {
+    pEntry = LockKeyCache(aDigest);
+    if (pEntry->hKey) CryptDestroyKey(pEntry->hKey);
+    CopyMemory(pEntry->aDigest, aDigest, CRYPT_DIGEST_SIZE);
+    pEntry->hKey = hCacheKey;
+    UnlockKeyCache(pEntry);
   }
 
   return hKey;
@@ -358,6 +629,13 @@ SQLITE_API int sqlite3_rekey_v2(sqlite3 *db, const char *zDbName, const void *pK
 
   if (!pBlock && !hKey) return SQLITE_OK; /* Wasn't encrypted to begin with */
 
+  /* An incremental rekey must be completed using sqlite3_rekey_step() */
+  if (pBlock && (pBlock->nRekeyPage || pBlock->bRekeyKey))
+  {
+    if (hKey) CryptDestroyKey(hKey);
+    return SQLITE_MISUSE;
+  }
+
   /* To rekey a database, we change the writekey for the pager.  The readkey remains
   ** the same
   */
@@ -461,5 +739,213 @@ SQLITE_API int sqlite3_rekey(sqlite3 *db, const void *pKey, int nKey)
   return sqlite3_rekey_v2(db, 0, pKey, nKey);
 }
 
+/* Re-encrypts the next nPage pages of the main database using a new key, in
+** a transaction of its own, so that an existing database can be rekeyed
+** without blocking other connections for the whole operation.  Pages are
+** processed in order and the last page rewritten is recorded in page 1, so
+** the codec knows which key applies to each page and an interrupted rekey
+** resumes where it left off.  Every connection reading or writing the
+** database while a rekey is in progress must be given the new key by calling
+** this function with nPage equal to zero.  The same new key must be used
+** until the rekey is complete.
+**
+** Returns SQLITE_OK if pages remain, SQLITE_DONE once the whole database uses
+** the new key, or an error code (e.g. SQLITE_BUSY, in which case the step can
+** simply be retried).  The optional output parameters receive the number of
+** pages remaining and the total number of pages.
+*/
+SQLITE_API int sqlite3_rekey_step(sqlite3 *db, const void *pKey, int nKey, int nPage, int *pnRemaining, int *pnPageCount)
+{
+  Btree *pbt = db->aDb[0].pBt;
+  Pager *p = sqlite3BtreePager(pbt);
+  LPCRYPTBLOCK pBlock = (LPCRYPTBLOCK)sqlite3pager_get_codecarg(p);
+  Pgno nOldRekeyPage;
+  Pgno nStart;
+  Pgno nEnd = 0;
+  Pgno nSkip;
+  Pgno nCount;
+  DbPage *pPage;
+  BOOL bFinal = FALSE;
+  int count = 0;
+  int rc;
+
+  if (pnRemaining) *pnRemaining = 0;
+  if (pnPageCount) *pnPageCount = 0;
+
+  /* Install the new key, unless that was already done.  It is kept apart from
+  ** the write key, and is only used for pages covered by a committed progress
+  ** marker, or by the one this step is about to commit.
+  */
+  if (!pBlock || !pBlock->bRekeyKey)
+  {
+    HCRYPTKEY hKey = DeriveKey(pKey, nKey);
+
+    if (hKey == MAXDWORD)
+    {
+#if SQLITE_VERSION_NUMBER >= 3008007
+      sqlite3ErrorWithMsg(db, SQLITE_ERROR, SQLITECRYPTERROR_PROVIDER);
+#else
+      sqlite3Error(db, SQLITE_ERROR, SQLITECRYPTERROR_PROVIDER);
+#endif
+      return SQLITE_ERROR;
+    }
+
+    if (!pBlock && !hKey) return SQLITE_DONE; /* Wasn't encrypted to begin with */
+
+    if (!pBlock) /* Encrypt an unencrypted database */
+    {
+      pBlock = CreateCryptBlock(hKey, p, -1, NULL);
+      if (!pBlock)
+      {
+        CryptDestroyKey(hKey);
+        return SQLITE_NOMEM;
+      }
+
+      pBlock->hReadKey = 0; /* Original database is not encrypted */
+      pBlock->hWriteKey = 0;
+      sqlite3PagerSetCodec(p, sqlite3Codec, sqlite3CodecSizeChange, sqlite3CodecFree, pBlock);
+    }
+    pBlock->hRekeyKey = hKey;
+    pBlock->bRekeyKey = TRUE;
+
+    /* Discard any copy of page 1 that CodecLoadPage1() made unusable */
+    sqlite3_mutex_enter(db->mutex);
+    if (p->eState == PAGER_OPEN) sqlite3PagerClearCache(p);
+    sqlite3_mutex_leave(db->mutex);
+  }
+
+  sqlite3_mutex_enter(db->mutex);
+
+  rc = sqlite3BtreeBeginTrans(pbt, nPage > 0 ? 1 : 0);
+  if (rc)
+  {
+    sqlite3_mutex_leave(db->mutex);
+    return rc;
+  }
+
+  /* Pick up the progress recorded by any earlier step (possibly made by
+  ** another connection).
+  */
+  sqlite3PagerPagecount(p, &count);
+  nCount = (Pgno)count;
+
+  if (nCount > 0)
+  {
+    rc = sqlite3PagerGet(p, 1, &pPage);
+    if (!rc)
+    {
+      pBlock->nRekeyPage = CodecRekeyMarker(sqlite3PagerGetData(pPage));
+      sqlite3PagerUnref(pPage);
+    }
+  }
+
+  nOldRekeyPage = pBlock->nRekeyPage;
+  nStart = nOldRekeyPage ? nOldRekeyPage + 1 : 2;
+
+  if (!rc && nPage > 0)
+  {
+#ifdef SPILLFLAG_OFF
+    /* Pages must not reach the database file before the new progress
+    ** marker is in effect, so do not let the pager spill its cache.
+    */
+    u8 doNotSpill = p->doNotSpill;
+    p->doNotSpill |= SPILLFLAG_OFF;
+#endif
+
+    nEnd = nStart + (Pgno)nPage - 1;
+    if (nEnd >= nCount)
+    {
+      nEnd = nCount;
+      bFinal = TRUE;
+    }
+
+    /* Journal the pages while the old progress marker is still in effect */
+    nSkip = PAGER_MJ_PGNO(p);
+    for (nPage = (int)nStart; !rc && (Pgno)nPage <= nEnd; nPage++)
+    {
+      if ((Pgno)nPage == nSkip) continue;
+      rc = sqlite3PagerGet(p, (Pgno)nPage, &pPage);
+      if (!rc)
+      {
+        rc = sqlite3PagerWrite(pPage);
+        sqlite3PagerUnref(pPage);
+      }
+    }
+
+    /* Record the progress, or remove the marker in the final step */
+    if (!rc)
+    {
+      rc = sqlite3PagerGet(p, 1, &pPage);
+      if (!rc)
+      {
+        rc = sqlite3PagerWrite(pPage);
+        if (!rc)
+        {
+          LPBYTE a = ((LPBYTE)sqlite3PagerGetData(pPage)) + CRYPT_REKEY_OFFSET;
+          if (bFinal)
+          {
+            ZeroMemory(a, 8);
+          }
+          else
+          {
+            CopyMemory(a, CRYPT_REKEY_MARKER, 4);
+            sqlite3Put4byte(a + 4, nEnd);
+          }
+        }
+        sqlite3PagerUnref(pPage);
+      }
+    }
+
+    /* The pages are encrypted as they are written to the database file,
+    ** which happens during the commit, using the new progress marker.
+    */
+    if (!rc)
+    {
+      pBlock->nRekeyPage = (nEnd > 1) ? nEnd : 1;
+      pBlock->bRekeyFinal = bFinal;
+    }
+
+#ifdef SPILLFLAG_OFF
+    p->doNotSpill = doNotSpill;
+#endif
+  }
+
+  if (!rc)
+  {
+    rc = sqlite3BtreeCommit(pbt);
+  }
+
+  if (rc)
+  {
+    /* Put back the old progress marker before the journal is played back */
+    pBlock->nRekeyPage = nOldRekeyPage;
+    pBlock->bRekeyFinal = FALSE;
+#if SQLITE_VERSION_NUMBER >= 3008007
+    sqlite3BtreeRollback(pbt, SQLITE_OK, 0);
+#else
+    sqlite3BtreeRollback(pbt, SQLITE_OK);
+#endif
+  }
+  else if (bFinal)
+  {
+    CodecRekeyComplete(pBlock);
+
+    /* If the database is no longer encrypted, remove the codec */
+    if (!pBlock->hReadKey && !pBlock->hWriteKey)
+    {
+      sqlite3PagerSetCodec(p, NULL, NULL, NULL, NULL);
+    }
+  }
+
+  sqlite3_mutex_leave(db->mutex);
+
+  if (rc) return rc;
+
+  if (pnRemaining) *pnRemaining = bFinal ? 0 : (int)(nCount - (nEnd ? nEnd : nOldRekeyPage));
+  if (pnPageCount) *pnPageCount = (int)nCount;
+
+  return bFinal ? SQLITE_DONE : SQLITE_OK;
+}
+
 #endif /* SQLITE_HAS_CODEC */
 #endif /* SQLITE_OMIT_DISKIO */
@@ -17,14 +17,22 @@
 #include "../ext/percentile.c"
 #endif
 
-#if defined(INTEROP_TOTYPE_EXTENSION)
+#if defined(INTEROP_TOTYPE_EXTENSION) || defined(INTEROP_CSV_EXTENSION)
 #include "../ext/totype.c"
 #endif
 
+#if defined(INTEROP_CSV_EXTENSION)
+#include "../ext/csv.c"
+#endif
+
 #if defined(INTEROP_REGEXP_EXTENSION)
 #include "../ext/regexp.c"
 #endif
 
+#if defined(INTEROP_TRIGRAM_EXTENSION)
+#include "../ext/trigram.c"
+#endif
+
 #if defined(INTEROP_EXTENSION_FUNCTIONS)
 #include "../contrib/extension-functions.c"
 extern int RegisterExtensionFunctions(sqlite3 *db);
@@ -82,6 +90,9 @@ static const char * const azInteropCompileOpt[] = {
 #ifdef INTEROP_CODEC
   "CODEC",
 #endif
+#ifdef INTEROP_CSV_EXTENSION
+  "CSV_EXTENSION",
+#endif
 #ifdef INTEROP_DEBUG
   "DEBUG=" CTIMEOPT_VAL(INTEROP_DEBUG),
 #endif
@@ -106,6 +117,9 @@ static const char * const azInteropCompileOpt[] = {
 #ifdef INTEROP_TOTYPE_EXTENSION
   "TOTYPE_EXTENSION",
 #endif
+#ifdef INTEROP_TRIGRAM_EXTENSION
+  "TRIGRAM_EXTENSION",
+#endif
 #ifdef SQLITE_VERSION_NUMBER
   "VERSION_NUMBER=" CTIMEOPT_VAL(SQLITE_VERSION_NUMBER),
 #endif
@@ -181,8 +195,96 @@ SQLITE_PRIVATE void sqlite3InteropDebug(const char *zFormat, ...){
 #if defined(INTEROP_LOG)
 SQLITE_PRIVATE int logConfigured = 0;
 
+/*
+** The messages passed to the log callback are queued in a fixed-size ring
+** buffer and read in batches by the managed drainer thread, so the threads
+** generating them never wait on managed code.  Each slot carries a sequence
+** number; writers claim slots with an interlocked compare-and-exchange and
+** never block.  When the ring is full, or the per-second limit for a result
+** code has been reached, the message is dropped and counted instead.
+*/
+#ifndef INTEROP_LOG_RING_SIZE
+# define INTEROP_LOG_RING_SIZE    (256) /* Must be a power of two */
+#endif
+
+#ifndef INTEROP_LOG_MESSAGE_SIZE
+# define INTEROP_LOG_MESSAGE_SIZE (256) /* Includes the NUL terminator */
+#endif
+
+typedef struct InteropLogEntry InteropLogEntry;
+struct InteropLogEntry {
+  volatile LONG iSeq;                   /* Slot state, see above */
+  int iCode;                            /* Result code passed to sqlite3_log() */
+  sqlite3_int64 iTime;                  /* UTC time, as a Win32 FILETIME */
+  char zMsg[INTEROP_LOG_MESSAGE_SIZE];  /* Message text, possibly truncated */
+};
+
+SQLITE_PRIVATE InteropLogEntry aLogRing[INTEROP_LOG_RING_SIZE];
+SQLITE_PRIVATE volatile LONG iLogHead = 0;    /* Next slot to be read */
+SQLITE_PRIVATE volatile LONG iLogTail = 0;    /* Next slot to be written */
+SQLITE_PRIVATE volatile LONG nLogDropped = 0; /* Messages dropped so far */
+
+/*
+** Per primary result code: the maximum number of messages per second (zero
+** means no limit and a negative value means all messages are discarded),
+** the second the current window started, and the messages in that window.
+*/
+SQLITE_PRIVATE volatile LONG aLogLimit[256];
+SQLITE_PRIVATE volatile LONG aLogWindow[256];
+SQLITE_PRIVATE volatile LONG aLogCount[256];
+
 SQLITE_PRIVATE void sqlite3InteropLogCallback(void *pArg, int iCode, const char *zMsg){
-  sqlite3InteropDebug("INTEROP_LOG (%d) %s\n", iCode, zMsg);
+  int iPrimary = iCode & 0xff;
+  LONG nLimit = aLogLimit[iPrimary];
+  InteropLogEntry *pEntry;
+  FILETIME fileTime;
+  sqlite3_int64 iTime;
+  LONG iPos;
+  int nMsg;
+
+  if( nLimit<0 ) return;
+  GetSystemTimeAsFileTime(&fileTime);
+  iTime = ((sqlite3_int64)fileTime.dwHighDateTime << 32) |
+          fileTime.dwLowDateTime;
+  if( nLimit>0 ){
+    LONG iSecond = (LONG)((iTime / 10000000) & 0x7fffffff);
+    LONG iWindow = aLogWindow[iPrimary];
+    if( iWindow!=iSecond && InterlockedCompareExchange(
+            &aLogWindow[iPrimary], iSecond, iWindow)==iWindow ){
+      InterlockedExchange(&aLogCount[iPrimary], 0);
+    }
+    if( InterlockedIncrement(&aLogCount[iPrimary])>nLimit ){
+      InterlockedIncrement(&nLogDropped);
+      return;
+    }
+  }
+  iPos = iLogTail;
+  for(;;){
+    LONG iDiff;
+    pEntry = &aLogRing[iPos & (INTEROP_LOG_RING_SIZE-1)];
+    iDiff = (LONG)((ULONG)pEntry->iSeq - (ULONG)iPos);
+    if( iDiff==0 ){
+      LONG iPrior = InterlockedCompareExchange(&iLogTail, iPos+1, iPos);
+      if( iPrior==iPos ) break;
+      iPos = iPrior;
+    }else if( iDiff<0 ){
+      InterlockedIncrement(&nLogDropped);
+      return;
+    }else{
+      iPos = iLogTail;
+    }
+  }
+  nMsg = zMsg ? (int)strlen(zMsg) : 0;
+  if( nMsg>=INTEROP_LOG_MESSAGE_SIZE ){
+    nMsg = INTEROP_LOG_MESSAGE_SIZE-1;
+    while( nMsg>0 && (zMsg[nMsg]&0xc0)==0x80 ) nMsg--;
+  }
+  pEntry->iCode = iCode;
+  pEntry->iTime = iTime;
+  if( nMsg>0 ) memcpy(pEntry->zMsg, zMsg, nMsg);
+  pEntry->zMsg[nMsg] = 0;
+  MemoryBarrier();
+  pEntry->iSeq = iPos+1;
 }
 #endif
 
@@ -309,6 +411,10 @@ SQLITE_API int WINAPI sqlite3_config_log_interop()
 {
   int ret;
   if( !logConfigured ){
+    int i;
+    for(i=0; i<INTEROP_LOG_RING_SIZE; i++){
+      aLogRing[i].iSeq = i;
+    }
     ret = sqlite3_config(SQLITE_CONFIG_LOG, sqlite3InteropLogCallback, 0);
     if( ret==SQLITE_OK ){
       logConfigured = 1;
@@ -320,6 +426,53 @@ SQLITE_API int WINAPI sqlite3_config_log_interop()
   }
   return ret;
 }
+
+/*
+** Copies up to nMax queued log messages into the caller's arrays and
+** returns the number copied.  Each message is stored NUL-terminated in a
+** slot of nMsg bytes within aMsg, truncated if necessary.
+*/
+SQLITE_API int WINAPI sqlite3_log_read_interop(int nMax, int *aCode, sqlite3_int64 *aTime, char *aMsg, int nMsg)
+{
+  int nRead = 0;
+  if( !aCode || !aTime || !aMsg || nMsg<1 ) return 0;
+  while( nRead<nMax ){
+    LONG iPos = iLogHead;
+    InteropLogEntry *pEntry = &aLogRing[iPos & (INTEROP_LOG_RING_SIZE-1)];
+    LONG iDiff = (LONG)((ULONG)pEntry->iSeq - (ULONG)(iPos+1));
+    if( iDiff<0 ) break; /* The ring is empty */
+    if( iDiff>0 ) continue; /* Another reader took this slot */
+    if( InterlockedCompareExchange(&iLogHead, iPos+1, iPos)!=iPos ) continue;
+    aCode[nRead] = pEntry->iCode;
+    aTime[nRead] = pEntry->iTime;
+    sqlite3_snprintf(nMsg, &aMsg[nRead*nMsg], "%s", pEntry->zMsg);
+    MemoryBarrier();
+    pEntry->iSeq = iPos+INTEROP_LOG_RING_SIZE;
+    nRead++;
+  }
+  return nRead;
+}
+
+/*
+** Sets the maximum number of log messages per second for the specified
+** primary result code, or all of them if it is negative.  Zero removes the
+** limit and a negative limit discards all messages for the result code.
+*/
+SQLITE_API int WINAPI sqlite3_log_filter_interop(int iCode, int nLimit)
+{
+  int i;
+  if( iCode>=(int)(sizeof(aLogLimit)/sizeof(aLogLimit[0])) ) return SQLITE_RANGE;
+  for(i=(iCode<0 ? 0 : iCode); i<=(iCode<0 ? 255 : iCode); i++){
+    InterlockedExchange(&aLogLimit[i], nLimit);
+    InterlockedExchange(&aLogCount[i], 0);
+  }
+  return SQLITE_OK;
+}
+
+SQLITE_API int WINAPI sqlite3_log_dropped_interop()
+{
+  return (int)nLogDropped;
+}
 #endif
 
 SQLITE_API const char *WINAPI interop_libversion(void)
@@ -890,6 +1043,668 @@ SQLITE_API int WINAPI sqlite3_index_column_info_interop(sqlite3 *db, const char
   return SQLITE_ERROR;
 }
 
+/* A growable buffer used to return packed schema information.  Each field is
+** written as a marker byte ('+' for a value, '-' for NULL), followed by the
+** UTF-8 text of the value (if any) and a NUL terminator.
+*/
+typedef struct InteropBuffer
+{
+  char *z;      /* The buffer, allocated using sqlite3_malloc() */
+  int n;        /* Number of bytes used */
+  int nAlloc;   /* Number of bytes allocated */
+  int rc;       /* SQLITE_NOMEM if an allocation has failed */
+} InteropBuffer;
+
+static void interopBufferAppend(InteropBuffer *p, const char *z, int n)
+{
+  if (p->rc != SQLITE_OK) return;
+  if (p->n + n > p->nAlloc)
+  {
+    int nAlloc = p->nAlloc * 2 + n + 256;
+    char *zNew = sqlite3_realloc(p->z, nAlloc);
+    if (!zNew)
+    {
+      p->rc = SQLITE_NOMEM;
+      return;
+    }
+    p->z = zNew;
+    p->nAlloc = nAlloc;
+  }
+  memcpy(p->z + p->n, z, n);
+  p->n += n;
+}
+
+static void interopBufferText(InteropBuffer *p, const char *z)
+{
+  if (!z)
+  {
+    interopBufferAppend(p, "-", 2);
+    return;
+  }
+  interopBufferAppend(p, "+", 1);
+  interopBufferAppend(p, z, (int)strlen(z) + 1);
+}
+
+static void interopBufferInt(InteropBuffer *p, int i)
+{
+  char z[16];
+  sqlite3_snprintf(sizeof(z), z, "%d", i);
+  interopBufferText(p, z);
+}
+
+#ifndef SQLITE_OMIT_FOREIGN_KEY
+static const char *interopActionName(u8 action)
+{
+  switch (action)
+  {
+    case OE_SetNull:  return "SET NULL";
+    case OE_SetDflt:  return "SET DEFAULT";
+    case OE_Cascade:  return "CASCADE";
+    case OE_Restrict: return "RESTRICT";
+    default:          return "NO ACTION";
+  }
+}
+#endif
+
+/* Appends the records for one table, with the same values that PRAGMA
+** table_info, index_list, index_info, and foreign_key_list would return,
+** plus the extended column and index column information:
+**
+**   T name nCol
+**   C cid name type notnull dflt_value pk coll autoinc (one per column)
+**   I name unique onError nKeyCol                     (one per index)
+**   X seqno cid name collation sortOrder              (one per index column)
+**   F id seq table from to on_update on_delete match  (one per foreign key column)
+*/
+static void interopSchemaTable(InteropBuffer *p, Table *pTab)
+{
+  Index *pPk = HasRowid(pTab) ? 0 : sqlite3PrimaryKeyIndex(pTab);
+  Index *pIdx;
+  int i, j, k;
+
+  interopBufferText(p, "T");
+  interopBufferText(p, pTab->zName);
+  interopBufferInt(p, pTab->nCol);
+
+  for (i = 0; i < pTab->nCol; i++)
+  {
+    Column *pCol = &pTab->aCol[i];
+
+    if ((pCol->colFlags & COLFLAG_PRIMKEY) == 0)
+      k = 0;
+    else if (!pPk)
+      k = 1;
+    else
+      for (k = 1; k <= pTab->nCol && pPk->aiColumn[k - 1] != i; k++) {}
+
+    interopBufferText(p, "C");
+    interopBufferInt(p, i);
+    interopBufferText(p, pCol->zName);
+    interopBufferText(p, pCol->zType ? pCol->zType : "");
+    interopBufferInt(p, pCol->notNull != 0);
+    interopBufferText(p, pCol->zDflt);
+    interopBufferInt(p, k);
+    interopBufferText(p, pCol->zColl ? pCol->zColl : "BINARY");
+    interopBufferInt(p, pTab->iPKey == i && (pTab->tabFlags & TF_Autoincrement) != 0);
+  }
+
+  for (pIdx = pTab->pIndex; pIdx; pIdx = pIdx->pNext)
+  {
+    interopBufferText(p, "I");
+    interopBufferText(p, pIdx->zName);
+    interopBufferInt(p, pIdx->onError != OE_None);
+    interopBufferInt(p, pIdx->onError);
+    interopBufferInt(p, pIdx->nKeyCol);
+
+    for (j = 0; j < pIdx->nKeyCol; j++)
+    {
+      int cnum = pIdx->aiColumn[j];
+
+      interopBufferText(p, "X");
+      interopBufferInt(p, j);
+      interopBufferInt(p, cnum);
+      interopBufferText(p, (cnum >= 0) ? pTab->aCol[cnum].zName : 0);
+      interopBufferText(p, pIdx->azColl[j]);
+      interopBufferInt(p, pIdx->aSortOrder[j]);
+    }
+  }
+
+#ifndef SQLITE_OMIT_FOREIGN_KEY
+  {
+    FKey *pFK;
+
+    for (pFK = pTab->pFKey, i = 0; pFK; pFK = pFK->pNextFrom, i++)
+    {
+      for (j = 0; j < pFK->nCol; j++)
+      {
+        interopBufferText(p, "F");
+        interopBufferInt(p, i);
+        interopBufferInt(p, j);
+        interopBufferText(p, pFK->zTo);
+        interopBufferText(p, pTab->aCol[pFK->aCol[j].iFrom].zName);
+        interopBufferText(p, pFK->aCol[j].zCol);
+        interopBufferText(p, interopActionName(pFK->aAction[1]));
+        interopBufferText(p, interopActionName(pFK->aAction[0]));
+        interopBufferText(p, "NONE");
+      }
+    }
+  }
+#endif
+}
+
+/* Returns a packed description of the columns, indexes, and foreign keys of
+** every table in a database (or only the specified table), read from the
+** in-memory schema in one call instead of several PRAGMA queries per table.
+** Views and virtual tables are not included.  The caller must free the
+** returned buffer using sqlite3_free().
+*/
+SQLITE_API int WINAPI sqlite3_schema_info_interop(sqlite3 *db, const char *zDb, const char *zTable, char **pzInfo, int *pnInfo)
+{
+  InteropBuffer buf;
+  char *zErrMsg = 0;
+  HashElem *k;
+  Table *pTab;
+  int iDb = -1;
+  int rc;
+
+  if (!db || !pzInfo || !pnInfo) return SQLITE_ERROR;
+  *pzInfo = 0;
+  *pnInfo = 0;
+  memset(&buf, 0, sizeof(buf));
+
+  sqlite3_mutex_enter(db->mutex);
+  sqlite3BtreeEnterAll(db);
+
+  rc = sqlite3Init(db, &zErrMsg);
+  if (rc == SQLITE_OK)
+  {
+    iDb = sqlite3FindDbName(db, zDb ? zDb : "main");
+    if (iDb < 0) rc = SQLITE_ERROR;
+  }
+
+  if (rc == SQLITE_OK)
+  {
+    if (zTable)
+    {
+      pTab = sqlite3FindTable(db, zTable, db->aDb[iDb].zName);
+      if (pTab && !pTab->pSelect && !IsVirtual(pTab))
+        interopSchemaTable(&buf, pTab);
+    }
+    else
+    {
+      for (k = sqliteHashFirst(&db->aDb[iDb].pSchema->tblHash); k; k = sqliteHashNext(k))
+      {
+        pTab = (Table *)sqliteHashData(k);
+        if (pTab->pSelect || IsVirtual(pTab)) continue;
+        interopSchemaTable(&buf, pTab);
+      }
+    }
+    rc = buf.rc;
+  }
+
+  sqlite3DbFree(db, zErrMsg);
+  sqlite3BtreeLeaveAll(db);
+  sqlite3_mutex_leave(db->mutex);
+
+  if (rc != SQLITE_OK)
+  {
+    sqlite3_free(buf.z);
+    return rc;
+  }
+
+  *pzInfo = buf.z;
+  *pnInfo = buf.n;
+  return SQLITE_OK;
+}
+
+/* Returns the file name, the in-memory schema object, its generation, and
+** its schema cookie for a database.  A statement that finds the schema
+** cookie in the database file changed reloads the schema, which changes the
+** generation, so these can be compared to detect schema changes without any
+** I/O.  Returns SQLITE_ERROR if the database does not exist or its schema has
+** not been loaded.
+*/
+SQLITE_API int WINAPI sqlite3_schema_stamp_interop(sqlite3 *db, const char *zDb, const char **pzFile, void **ppSchema, int *piGeneration, int *piCookie)
+{
+  Schema *pSchema;
+  int rc = SQLITE_ERROR;
+  int iDb;
+
+  if (!db || !pzFile || !ppSchema || !piGeneration || !piCookie) return SQLITE_ERROR;
+
+  sqlite3_mutex_enter(db->mutex);
+  iDb = sqlite3FindDbName(db, zDb ? zDb : "main");
+  if (iDb >= 0 && DbHasProperty(db, iDb, DB_SchemaLoaded))
+  {
+    pSchema = db->aDb[iDb].pSchema;
+    *pzFile = sqlite3BtreeGetFilename(db->aDb[iDb].pBt);
+    *ppSchema = pSchema;
+    *piGeneration = pSchema->iGeneration;
+    *piCookie = pSchema->schema_cookie;
+    rc = SQLITE_OK;
+  }
+  sqlite3_mutex_leave(db->mutex);
+
+  return rc;
+}
+
+/* The column and index metadata cache of a connection.  Its records are
+** looked up by (database, table, column) or (database, index, column) in an
+** open-addressed hash table, instead of resolving the names again on every
+** call.  Each record remembers the database file and the schema it was
+** computed from and is only used while the same file is attached under that
+** name and its schema is still loaded with the same schema cookie.  The
+** cache is created on demand and owned by the caller, which must release it
+** using sqlite3_metadata_cache_free_interop().
+*/
+#ifndef INTEROP_META_CACHE_SIZE
+# define INTEROP_META_CACHE_SIZE    (64)   /* Initial number of slots, a power of two */
+#endif
+
+#ifndef INTEROP_META_CACHE_MAXIMUM
+# define INTEROP_META_CACHE_MAXIMUM (4096) /* Number of slots that causes a reset */
+#endif
+
+#define INTEROP_META_COLUMN         (1)
+#define INTEROP_META_INDEX          (2)
+
+typedef struct InteropMetaEntry
+{
+  unsigned int iHash;   /* Hash of the kind and key */
+  int eKind;            /* INTEROP_META_COLUMN or INTEROP_META_INDEX, zero if unused */
+  Btree *pBt;           /* The database file the record was computed from */
+  const char *zFile;    /* Its file name at that time */
+  Schema *pSchema;      /* The schema the record was computed from */
+  int iGeneration;      /* Its iGeneration at that time */
+  int iCookie;          /* Its schema_cookie at that time */
+  char *zKey;           /* The key, followed by copies of the strings below */
+  int nKey;             /* Number of bytes in the key */
+  const char *zType;    /* The declared data type of the column */
+  const char *zColl;    /* The collation sequence of the column or index column */
+  int iFlags;           /* NOT NULL, PRIMARY KEY, AUTOINCREMENT or the sort order */
+  int onError;          /* The conflict resolution algorithm of the index */
+} InteropMetaEntry;
+
+typedef struct InteropMetaCache
+{
+  int nSlot;                /* Number of slots, a power of two */
+  int nUsed;                /* Number of slots in use */
+  InteropMetaEntry *aSlot;  /* The hash table */
+} InteropMetaCache;
+
+static void interopMetaEntryClear(InteropMetaEntry *pEntry)
+{
+  sqlite3_free(pEntry->zKey);
+  memset(pEntry, 0, sizeof(InteropMetaEntry));
+}
+
+static void interopMetaCacheReset(InteropMetaCache *pCache)
+{
+  int i;
+
+  for (i = 0; i < pCache->nSlot; i++)
+    interopMetaEntryClear(&pCache->aSlot[i]);
+  pCache->nUsed = 0;
+}
+
+/* Builds the key "zDb\0zName\0zColumn" and its case-insensitive hash. */
+static char *interopMetaKey(int eKind, const char *zDb, const char *zName, const char *zColumn, int *pnKey, unsigned int *piHash)
+{
+  int nDb = (int)strlen(zDb) + 1;
+  int nName = (int)strlen(zName) + 1;
+  int nColumn = (int)strlen(zColumn);
+  unsigned int h = 2166136261u ^ (unsigned int)eKind;
+  char *zKey;
+  int i;
+
+  zKey = sqlite3_malloc(nDb + nName + nColumn + 1);
+  if (!zKey) return 0;
+  memcpy(zKey, zDb, nDb);
+  memcpy(zKey + nDb, zName, nName);
+  memcpy(zKey + nDb + nName, zColumn, nColumn + 1);
+
+  *pnKey = nDb + nName + nColumn;
+  for (i = 0; i < *pnKey; i++)
+    h = (h ^ sqlite3UpperToLower[(unsigned char)zKey[i]]) * 16777619u;
+  *piHash = h ? h : 1;
+  return zKey;
+}
+
+static int interopMetaKeyEqual(const char *zA, const char *zB, int nKey)
+{
+  int i;
+
+  for (i = 0; i < nKey; i++)
+  {
+    if (sqlite3UpperToLower[(unsigned char)zA[i]] != sqlite3UpperToLower[(unsigned char)zB[i]])
+      return 0;
+  }
+  return 1;
+}
+
+/* Returns the slot holding the key or the unused slot where it belongs. */
+static InteropMetaEntry *interopMetaCacheSlot(InteropMetaCache *pCache, int eKind, const char *zKey, int nKey, unsigned int iHash)
+{
+  int i = (int)(iHash & (unsigned int)(pCache->nSlot - 1));
+
+  for (;;)
+  {
+    InteropMetaEntry *pEntry = &pCache->aSlot[i];
+
+    if (pEntry->eKind == 0) return pEntry;
+    if (pEntry->iHash == iHash && pEntry->eKind == eKind && pEntry->nKey == nKey && interopMetaKeyEqual(pEntry->zKey, zKey, nKey))
+      return pEntry;
+    i = (i + 1) & (pCache->nSlot - 1);
+  }
+}
+
+/* Makes room for one more record, growing the hash table or, once it has
+** reached its maximum size, discarding all the records.
+*/
+static int interopMetaCacheReserve(InteropMetaCache *pCache)
+{
+  InteropMetaEntry *aOld = pCache->aSlot;
+  InteropMetaEntry *aNew;
+  int nOld = pCache->nSlot;
+  int nNew;
+  int i;
+
+  if (aOld && (pCache->nUsed + 1) * 4 <= nOld * 3) return SQLITE_OK;
+
+  if (nOld >= INTEROP_META_CACHE_MAXIMUM)
+  {
+    interopMetaCacheReset(pCache);
+    return SQLITE_OK;
+  }
+
+  nNew = nOld ? nOld * 2 : INTEROP_META_CACHE_SIZE;
+  aNew = sqlite3_malloc(nNew * sizeof(InteropMetaEntry));
+  if (!aNew) return SQLITE_NOMEM;
+  memset(aNew, 0, nNew * sizeof(InteropMetaEntry));
+
+  pCache->aSlot = aNew;
+  pCache->nSlot = nNew;
+
+  for (i = 0; i < nOld; i++)
+  {
+    if (aOld[i].eKind)
+      *interopMetaCacheSlot(pCache, aOld[i].eKind, aOld[i].zKey, aOld[i].nKey, aOld[i].iHash) = aOld[i];
+  }
+  sqlite3_free(aOld);
+  return SQLITE_OK;
+}
+
+/* Copies the key, the file name and the strings of a record into a single
+** allocation.
+*/
+static int interopMetaEntrySet(InteropMetaEntry *pEntry, const char *zKey, int nKey, const char *zFile, const char *zType, const char *zColl)
+{
+  int nFile = (int)strlen(zFile) + 1;
+  int nType = zType ? (int)strlen(zType) + 1 : 0;
+  int nColl = zColl ? (int)strlen(zColl) + 1 : 0;
+  char *z = sqlite3_malloc(nKey + 1 + nFile + nType + nColl);
+
+  if (!z) return SQLITE_NOMEM;
+  memcpy(z, zKey, nKey + 1);
+  pEntry->zKey = z;
+  pEntry->nKey = nKey;
+  z += nKey + 1;
+  memcpy(z, zFile, nFile);
+  pEntry->zFile = z;
+  z += nFile;
+  pEntry->zType = 0;
+  pEntry->zColl = 0;
+  if (zType) { memcpy(z, zType, nType); pEntry->zType = z; z += nType; }
+  if (zColl) { memcpy(z, zColl, nColl); pEntry->zColl = z; }
+  return SQLITE_OK;
+}
+
+/* Returns the name of the file attached as the specified database, or an
+** empty string for in-memory and temporary databases.
+*/
+static const char *interopMetaFileName(sqlite3 *db, int iDb)
+{
+  const char *zFile = db->aDb[iDb].pBt ? sqlite3BtreeGetFilename(db->aDb[iDb].pBt) : 0;
+
+  return zFile ? zFile : "";
+}
+
+/* Finds (or computes and caches) the record for a table or index column.
+** Must be called with the database connection mutex held.
+*/
+static int interopMetaCacheLookup(sqlite3 *db, InteropMetaCache **ppCache, int eKind, const char *zDb, const char *zName, const char *zColumn, InteropMetaEntry **ppEntry)
+{
+  InteropMetaCache *pCache = *ppCache;
+  InteropMetaEntry *pEntry;
+  InteropMetaEntry entry;
+  Schema *pSchema;
+  const char *zFile;
+  unsigned int iHash;
+  char *zKey;
+  int nKey;
+  int iDb;
+  int rc;
+
+  if (!zName || !zColumn) return SQLITE_ERROR;
+  if (!zDb) zDb = "main";
+
+  if (!pCache)
+  {
+    pCache = sqlite3_malloc(sizeof(InteropMetaCache));
+    if (!pCache) return SQLITE_NOMEM;
+    memset(pCache, 0, sizeof(InteropMetaCache));
+    *ppCache = pCache;
+  }
+
+  iDb = sqlite3FindDbName(db, zDb);
+  if (iDb < 0) return SQLITE_ERROR;
+
+  zKey = interopMetaKey(eKind, zDb, zName, zColumn, &nKey, &iHash);
+  if (!zKey) return SQLITE_NOMEM;
+
+  /* Look for a record that is still valid before making room for a new one;
+  ** growing the hash table would move the records around.
+  */
+  if (pCache->aSlot)
+  {
+    pEntry = interopMetaCacheSlot(pCache, eKind, zKey, nKey, iHash);
+    pSchema = db->aDb[iDb].pSchema;
+    if (pEntry->eKind && pEntry->pBt == db->aDb[iDb].pBt && pEntry->pSchema == pSchema && pEntry->iGeneration == pSchema->iGeneration && pEntry->iCookie == pSchema->schema_cookie && strcmp(pEntry->zFile, interopMetaFileName(db, iDb)) == 0)
+    {
+      sqlite3_free(zKey);
+      *ppEntry = pEntry;
+      return SQLITE_OK;
+    }
+  }
+
+  memset(&entry, 0, sizeof(entry));
+
+  if (eKind == INTEROP_META_COLUMN)
+  {
+    char const *zType = 0;
+    char const *zColl = 0;
+    int notNull = 0;
+    int primaryKey = 0;
+    int autoInc = 0;
+
+    rc = sqlite3_table_column_metadata(db, zDb, zName, zColumn, &zType, &zColl, &notNull, &primaryKey, &autoInc);
+    if (rc == SQLITE_OK)
+    {
+      rc = interopMetaEntrySet(&entry, zKey, nKey, interopMetaFileName(db, iDb), zType, zColl);
+      entry.iFlags = (notNull ? 1 : 0) | (primaryKey ? 2 : 0) | (autoInc ? 4 : 0);
+    }
+  }
+  else
+  {
+    char *zErrMsg = 0;
+    Index *pIdx;
+    int n;
+
+    rc = sqlite3Init(db, &zErrMsg);
+    sqlite3DbFree(db, zErrMsg);
+    pIdx = (rc == SQLITE_OK) ? sqlite3FindIndex(db, zName, zDb) : 0;
+    if (rc == SQLITE_OK) rc = SQLITE_ERROR;
+
+    for (n = 0; pIdx && n < pIdx->nColumn; n++)
+    {
+      int cnum = pIdx->aiColumn[n];
+      if (cnum >= 0 && sqlite3StrICmp(pIdx->pTable->aCol[cnum].zName, zColumn) == 0)
+      {
+        rc = interopMetaEntrySet(&entry, zKey, nKey, interopMetaFileName(db, iDb), 0, pIdx->azColl[n]);
+        entry.iFlags = pIdx->aSortOrder[n];
+        entry.onError = pIdx->onError;
+        break;
+      }
+    }
+  }
+
+  sqlite3_free(zKey);
+  if (rc != SQLITE_OK) return rc;
+
+  rc = interopMetaCacheReserve(pCache);
+  if (rc != SQLITE_OK)
+  {
+    interopMetaEntryClear(&entry);
+    return rc;
+  }
+
+  /* The schema may have been loaded by the calls above. */
+  pSchema = db->aDb[iDb].pSchema;
+  entry.iHash = iHash;
+  entry.eKind = eKind;
+  entry.pBt = db->aDb[iDb].pBt;
+  entry.pSchema = pSchema;
+  entry.iGeneration = pSchema->iGeneration;
+  entry.iCookie = pSchema->schema_cookie;
+
+  pEntry = interopMetaCacheSlot(pCache, eKind, entry.zKey, nKey, iHash);
+  if (pEntry->eKind)
+    interopMetaEntryClear(pEntry);
+  else
+    pCache->nUsed++;
+  *pEntry = entry;
+  *ppEntry = pEntry;
+  return SQLITE_OK;
+}
+
+SQLITE_API void WINAPI sqlite3_metadata_cache_free_interop(void *pCache)
+{
+  InteropMetaCache *p = (InteropMetaCache *)pCache;
+
+  if (!p) return;
+  interopMetaCacheReset(p);
+  sqlite3_free(p->aSlot);
+  sqlite3_free(p);
+}
+
+/* Same as sqlite3_index_column_info_interop(), using the metadata cache.
+** The returned collation sequence remains valid until the next call using
+** the same cache.
+*/
+SQLITE_API int WINAPI sqlite3_index_column_info_cached_interop(sqlite3 *db, void **ppCache, const char *zDb, const char *zIndexName, const char *zColumnName, int *sortOrder, int *onError, char **pzColl, int *plen)
+{
+  InteropMetaEntry *pEntry = 0;
+  int rc;
+
+  if (!db || !ppCache) return SQLITE_ERROR;
+  sqlite3_mutex_enter(db->mutex);
+  sqlite3BtreeEnterAll(db);
+
+  rc = interopMetaCacheLookup(db, (InteropMetaCache **)ppCache, INTEROP_META_INDEX, zDb, zIndexName, zColumnName, &pEntry);
+  if (rc == SQLITE_OK)
+  {
+    if ( sortOrder ) *sortOrder = pEntry->iFlags;
+    if ( pzColl ) *pzColl = (char *)pEntry->zColl;
+    if ( plen ) *plen = pEntry->zColl ? strlen(pEntry->zColl) : 0;
+    if ( onError ) *onError = pEntry->onError;
+  }
+
+  sqlite3BtreeLeaveAll(db);
+  sqlite3_mutex_leave(db->mutex);
+  return rc;
+}
+
+/* Returns the origin and metadata of every result column of a statement in
+** one call, using the metadata cache.  For each column, the packed buffer
+** (see InteropBuffer) contains the fields:
+**
+**   database table origin status data_type collation notnull pk autoinc
+**
+** The origin names are NULL for expressions.  The status is 1 if the
+** remaining fields are valid, or 0 if the metadata could not be obtained
+** (e.g. because the column belongs to a view) and should be queried
+** separately.  The caller must free the returned buffer using
+** sqlite3_free().
+*/
+SQLITE_API int WINAPI sqlite3_statement_metadata_interop(sqlite3_stmt *pstmt, void **ppCache, char **pzInfo, int *pnInfo)
+{
+  sqlite3 *db;
+  InteropBuffer buf;
+  int nCol;
+  int i;
+
+  if (!pstmt || !ppCache || !pzInfo || !pnInfo) return SQLITE_ERROR;
+  *pzInfo = 0;
+  *pnInfo = 0;
+  memset(&buf, 0, sizeof(buf));
+
+  db = sqlite3_db_handle(pstmt);
+  sqlite3_mutex_enter(db->mutex);
+  sqlite3BtreeEnterAll(db);
+
+  nCol = sqlite3_column_count(pstmt);
+  for (i = 0; i < nCol && buf.rc == SQLITE_OK; i++)
+  {
+    const char *zDb = sqlite3_column_database_name(pstmt, i);
+    const char *zTable = sqlite3_column_table_name(pstmt, i);
+    const char *zColumn = sqlite3_column_origin_name(pstmt, i);
+    InteropMetaEntry *pEntry = 0;
+    int rc = SQLITE_ERROR;
+
+    interopBufferText(&buf, zDb);
+    interopBufferText(&buf, zTable);
+    interopBufferText(&buf, zColumn);
+
+    if (zDb && zTable && zColumn)
+    {
+      rc = interopMetaCacheLookup(db, (InteropMetaCache **)ppCache, INTEROP_META_COLUMN, zDb, zTable, zColumn, &pEntry);
+      if (rc == SQLITE_NOMEM) buf.rc = rc;
+    }
+
+    if (rc == SQLITE_OK)
+    {
+      interopBufferInt(&buf, 1);
+      interopBufferText(&buf, pEntry->zType);
+      interopBufferText(&buf, pEntry->zColl);
+      interopBufferInt(&buf, (pEntry->iFlags & 1) != 0);
+      interopBufferInt(&buf, (pEntry->iFlags & 2) != 0);
+      interopBufferInt(&buf, (pEntry->iFlags & 4) != 0);
+    }
+    else
+    {
+      interopBufferInt(&buf, 0);
+      interopBufferText(&buf, 0);
+      interopBufferText(&buf, 0);
+      interopBufferInt(&buf, 0);
+      interopBufferInt(&buf, 0);
+      interopBufferInt(&buf, 0);
+    }
+  }
+
+  sqlite3BtreeLeaveAll(db);
+  sqlite3_mutex_leave(db->mutex);
+
+  if (buf.rc != SQLITE_OK)
+  {
+    sqlite3_free(buf.z);
+    return buf.rc;
+  }
+
+  *pzInfo = buf.z;
+  *pnInfo = buf.n;
+  return SQLITE_OK;
+}
+
 SQLITE_API int WINAPI sqlite3_table_cursor_interop(sqlite3_stmt *pstmt, int iDb, Pgno tableRootPage)
 {
   Vdbe *p = (Vdbe *)pstmt;
@@ -914,15 +1729,14 @@ SQLITE_API int WINAPI sqlite3_table_cursor_interop(sqlite3_stmt *pstmt, int iDb,
   return ret;
 }
 
-SQLITE_API int WINAPI sqlite3_cursor_rowid_interop(sqlite3_stmt *pstmt, int cursor, sqlite_int64 *prowid)
+/* Returns the rowid of the current row of a table cursor.  Must be called
+** with the database connection mutex held.
+*/
+static int interopCursorRowid(Vdbe *p, int cursor, sqlite_int64 *prowid)
 {
-  Vdbe *p = (Vdbe *)pstmt;
-  sqlite3 *db = (p == NULL) ? NULL : p->db;
   VdbeCursor *pC;
   int ret = SQLITE_OK;
 
-  if (!p || !db) return SQLITE_ERROR;
-  sqlite3_mutex_enter(db->mutex);
   while (1)
   {
     if (cursor < 0 || cursor >= p->nCursor)
@@ -971,10 +1785,47 @@ SQLITE_API int WINAPI sqlite3_cursor_rowid_interop(sqlite3_stmt *pstmt, int curs
     }
     break;
   }
+
+  return ret;
+}
+
+SQLITE_API int WINAPI sqlite3_cursor_rowid_interop(sqlite3_stmt *pstmt, int cursor, sqlite_int64 *prowid)
+{
+  Vdbe *p = (Vdbe *)pstmt;
+  sqlite3 *db = (p == NULL) ? NULL : p->db;
+  int ret;
+
+  if (!p || !db) return SQLITE_ERROR;
+  sqlite3_mutex_enter(db->mutex);
+  ret = interopCursorRowid(p, cursor, prowid);
   sqlite3_mutex_leave(db->mutex);
 
   return ret;
 }
+
+/* Returns the rowids of the current rows of several table cursors in one
+** call, e.g. for all the tables joined by a statement.  The rowid of each
+** cursor that is not positioned on a row is set to zero.
+*/
+SQLITE_API int WINAPI sqlite3_cursor_rowids_interop(sqlite3_stmt *pstmt, int nCursor, int *aCursor, sqlite_int64 *aRowid)
+{
+  Vdbe *p = (Vdbe *)pstmt;
+  sqlite3 *db = (p == NULL) ? NULL : p->db;
+  int i;
+
+  if (!p || !db || nCursor < 0 || (nCursor > 0 && (!aCursor || !aRowid))) return SQLITE_ERROR;
+  sqlite3_mutex_enter(db->mutex);
+  for (i = 0; i < nCursor; i++)
+  {
+    sqlite_int64 rowid = 0;
+
+    if (interopCursorRowid(p, aCursor[i], &rowid) != SQLITE_OK) rowid = 0;
+    aRowid[i] = rowid;
+  }
+  sqlite3_mutex_leave(db->mutex);
+
+  return SQLITE_OK;
+}
 #endif /* SQLITE_OS_WIN */
 
 /*****************************************************************************/
@@ -77,6 +77,13 @@ namespace System.Data.SQLite
     /// </summary>
     protected List<SQLiteFunction> _functions;
 
+#if !SQLITE_STANDARD
+    /// <summary>
+    /// The native column and index metadata cache used with this connection, if any.
+    /// </summary>
+    private IntPtr _metaDataCache;
+#endif
+
 #if INTEROP_VIRTUAL_TABLE
     /// <summary>
     /// The modules created using this connection.
@@ -224,6 +231,14 @@ namespace System.Data.SQLite
     // resources belonging to the previously-registered functions.
     internal override void Close(bool canThrow)
     {
+#if !SQLITE_STANDARD
+      if (_metaDataCache != IntPtr.Zero)
+      {
+        UnsafeNativeMethods.sqlite3_metadata_cache_free_interop(_metaDataCache);
+        _metaDataCache = IntPtr.Zero;
+      }
+#endif
+
       if (_sql != null)
       {
           if (!_sql.OwnHandle)
@@ -316,6 +331,14 @@ namespace System.Data.SQLite
       }
     }
 
+    internal override string FileName
+    {
+      get
+      {
+        return _fileName;
+      }
+    }
+
     internal static string DefineConstants
     {
         get
@@ -2246,6 +2269,38 @@ namespace System.Data.SQLite
       SQLiteErrorCode n = UnsafeNativeMethods.sqlite3_rekey(_sql, newPasswordBytes, (newPasswordBytes == null) ? 0 : newPasswordBytes.Length);
       if (n != SQLiteErrorCode.Ok) throw new SQLiteException(n, GetLastError());
     }
+
+    internal override bool StepChangePassword(byte[] newPasswordBytes, int nPage, ref int remainingPages, ref int totalPages, ref bool retry)
+    {
+      int remaining;
+      int pageCount;
+
+      retry = false;
+
+      SQLiteErrorCode n = UnsafeNativeMethods.sqlite3_rekey_step(_sql, newPasswordBytes, (newPasswordBytes == null) ? 0 : newPasswordBytes.Length, nPage, out remaining, out pageCount);
+
+      if (n == SQLiteErrorCode.Ok)
+      {
+        remainingPages = remaining;
+        totalPages = pageCount;
+        return true;
+      }
+      else if ((n == SQLiteErrorCode.Busy) || (n == SQLiteErrorCode.Locked))
+      {
+        retry = true;
+        return true;
+      }
+      else if (n == SQLiteErrorCode.Done)
+      {
+        remainingPages = 0;
+        totalPages = pageCount;
+        return false;
+      }
+      else
+      {
+        throw new SQLiteException(n, GetLastError());
+      }
+    }
 #endif
 
     internal override void SetAuthorizerHook(SQLiteAuthorizerCallback func)
@@ -2670,6 +2725,18 @@ namespace System.Data.SQLite
 #endif
     }
 
+    internal override void GetRowIdsForCursors(SQLiteStatement stmt, int[] cursors, long[] rowids)
+    {
+#if !SQLITE_STANDARD
+      if (cursors.Length == 0) return;
+
+      SQLiteErrorCode rc = UnsafeNativeMethods.sqlite3_cursor_rowids_interop(stmt._sqlite_stmt, cursors.Length, cursors, rowids);
+      if (rc == SQLiteErrorCode.Ok) return;
+#endif
+
+      Array.Clear(rowids, 0, rowids.Length);
+    }
+
     internal override void GetIndexColumnExtendedInfo(string database, string index, string column, ref int sortMode, ref int onError, ref string collationSequence)
     {
 #if !SQLITE_STANDARD
@@ -2677,7 +2744,7 @@ namespace System.Data.SQLite
       int colllen = 0;
       SQLiteErrorCode rc;
 
-      rc = UnsafeNativeMethods.sqlite3_index_column_info_interop(_sql, ToUTF8(database), ToUTF8(index), ToUTF8(column), ref sortMode, ref onError, ref coll, ref colllen);
+      rc = UnsafeNativeMethods.sqlite3_index_column_info_cached_interop(_sql, ref _metaDataCache, ToUTF8(database), ToUTF8(index), ToUTF8(column), ref sortMode, ref onError, ref coll, ref colllen);
       if (rc != SQLiteErrorCode.Ok) throw new SQLiteException(rc, null);
 
       collationSequence = UTF8ToString(coll, colllen);
@@ -2688,6 +2755,113 @@ namespace System.Data.SQLite
 #endif
     }
 
+    internal override bool StatementColumnMetaData(SQLiteStatement stmt, string[] databaseNames, string[] tableNames, string[] columnNames, SQLiteSchemaCache.ColumnMetaData[] metaData)
+    {
+#if !SQLITE_STANDARD
+      IntPtr info = IntPtr.Zero;
+      int infolen = 0;
+      SQLiteErrorCode rc;
+
+      rc = UnsafeNativeMethods.sqlite3_statement_metadata_interop(stmt._sqlite_stmt, ref _metaDataCache, ref info, ref infolen);
+      if (rc != SQLiteErrorCode.Ok) throw new SQLiteException(rc, GetLastError());
+
+      byte[] bytes = new byte[infolen];
+
+      if (info != IntPtr.Zero)
+      {
+        try
+        {
+          Marshal.Copy(info, bytes, 0, infolen);
+        }
+        finally
+        {
+          UnsafeNativeMethods.sqlite3_free(info);
+        }
+      }
+
+      int offset = 0;
+
+      for (int n = 0; n < metaData.Length; n++)
+      {
+        databaseNames[n] = SQLiteSchemaInfo.NextField(bytes, ref offset);
+        tableNames[n] = SQLiteSchemaInfo.NextField(bytes, ref offset);
+        columnNames[n] = SQLiteSchemaInfo.NextField(bytes, ref offset);
+
+        bool valid = (SQLiteSchemaInfo.NextInt32(bytes, ref offset) != 0);
+        string dataType = SQLiteSchemaInfo.NextField(bytes, ref offset);
+        string collSeq = SQLiteSchemaInfo.NextField(bytes, ref offset);
+        bool notNull = (SQLiteSchemaInfo.NextInt32(bytes, ref offset) != 0);
+        bool primaryKey = (SQLiteSchemaInfo.NextInt32(bytes, ref offset) != 0);
+        bool autoIncrement = (SQLiteSchemaInfo.NextInt32(bytes, ref offset) != 0);
+
+        if (!valid)
+        {
+          metaData[n] = null;
+          continue;
+        }
+
+        metaData[n] = new SQLiteSchemaCache.ColumnMetaData();
+        metaData[n].DataType = (dataType != null) ? dataType : String.Empty;
+        metaData[n].CollationSequence = (collSeq != null) ? collSeq : String.Empty;
+        metaData[n].NotNull = notNull;
+        metaData[n].PrimaryKey = primaryKey;
+        metaData[n].AutoIncrement = autoIncrement;
+      }
+
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    internal override bool GetSchemaStamp(string database, ref string stamp)
+    {
+#if !SQLITE_STANDARD
+      IntPtr fileName = IntPtr.Zero;
+      IntPtr schema = IntPtr.Zero;
+      int generation = 0;
+      int cookie = 0;
+
+      if (UnsafeNativeMethods.sqlite3_schema_stamp_interop(_sql, ToUTF8(database), ref fileName, ref schema, ref generation, ref cookie) != SQLiteErrorCode.Ok)
+        return false;
+
+      stamp = String.Format(CultureInfo.InvariantCulture, "{0}\0{1}\0{2}\0{3}", UTF8ToString(fileName, -1), schema, generation, cookie);
+      return true;
+#else
+      return false;
+#endif
+    }
+
+    internal override Dictionary<string, SQLiteSchemaInfo.TableInfo> GetSchemaInfo(string database, string table)
+    {
+#if !SQLITE_STANDARD
+      IntPtr info = IntPtr.Zero;
+      int infolen = 0;
+      SQLiteErrorCode rc;
+
+      rc = UnsafeNativeMethods.sqlite3_schema_info_interop(_sql, ToUTF8(database), (table != null) ? ToUTF8(table) : null, ref info, ref infolen);
+      if (rc != SQLiteErrorCode.Ok) throw new SQLiteException(rc, GetLastError());
+
+      byte[] bytes = new byte[infolen];
+
+      if (info != IntPtr.Zero)
+      {
+        try
+        {
+          Marshal.Copy(info, bytes, 0, infolen);
+        }
+        finally
+        {
+          UnsafeNativeMethods.sqlite3_free(info);
+        }
+      }
+
+      return SQLiteSchemaInfo.Parse(bytes);
+#else
+      return null;
+#endif
+    }
+
     internal override SQLiteErrorCode FileControl(string zDbName, int op, IntPtr pArg)
     {
       return UnsafeNativeMethods.sqlite3_file_control(_sql, (zDbName != null) ? ToUTF8(zDbName) : null, op, pArg);
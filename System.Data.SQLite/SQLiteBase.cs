@@ -8,6 +8,7 @@
 namespace System.Data.SQLite
 {
   using System;
+  using System.Collections.Generic;
 
 #if !PLATFORM_COMPACTFRAMEWORK
   using System.Runtime.InteropServices;
@@ -41,6 +42,10 @@ namespace System.Data.SQLite
     /// </summary>
     internal abstract int VersionNumber { get; }
     /// <summary>
+    /// Returns the name of the database file associated with the native connection handle, if any.
+    /// </summary>
+    internal abstract string FileName { get; }
+    /// <summary>
     /// Returns the rowid of the most recent successful INSERT into the database from this connection.
     /// </summary>
     internal abstract long LastInsertRowId { get; }
@@ -215,6 +220,43 @@ namespace System.Data.SQLite
     internal abstract string ColumnTableName(SQLiteStatement stmt, int index);
     internal abstract void ColumnMetaData(string dataBase, string table, string column, ref string dataType, ref string collateSequence, ref bool notNull, ref bool primaryKey, ref bool autoIncrement);
     internal abstract void GetIndexColumnExtendedInfo(string database, string index, string column, ref int sortMode, ref int onError, ref string collationSequence);
+    /// <summary>
+    /// Returns the origin and the column metadata of all the result columns of a statement using
+    /// a single call into the SQLite core library.
+    /// </summary>
+    /// <param name="stmt">The statement.</param>
+    /// <param name="databaseNames">Receives the database name of each column.</param>
+    /// <param name="tableNames">Receives the table name of each column.</param>
+    /// <param name="columnNames">Receives the original name of each column.</param>
+    /// <param name="metaData">
+    /// Receives the metadata of each column or null if it must be queried separately using
+    /// <see cref="ColumnMetaData" />.
+    /// </param>
+    /// <returns>Non-zero if the arrays were filled in, zero if this is not supported.</returns>
+    internal abstract bool StatementColumnMetaData(SQLiteStatement stmt, string[] databaseNames, string[] tableNames, string[] columnNames, SQLiteSchemaCache.ColumnMetaData[] metaData);
+    /// <summary>
+    /// Returns a value that changes whenever the in-memory schema of a database is reloaded or a
+    /// different file is attached using its name, without querying the database.
+    /// </summary>
+    /// <param name="database">The name of the database.</param>
+    /// <param name="stamp">Receives the schema stamp.</param>
+    /// <returns>
+    /// Non-zero if the stamp was returned, zero if this is not supported or the schema of the
+    /// database has not been loaded.
+    /// </returns>
+    internal abstract bool GetSchemaStamp(string database, ref string stamp);
+
+    /// <summary>
+    /// Returns the column, index, and foreign key information for the tables of a database,
+    /// read from its in-memory schema in a single call.
+    /// </summary>
+    /// <param name="database">The name of the database.</param>
+    /// <param name="table">The name of the only table to return or null for all tables.</param>
+    /// <returns>
+    /// The information for each table, keyed by table name, or null if it is unavailable.  Views
+    /// and virtual tables are never included.
+    /// </returns>
+    internal abstract Dictionary<string, SQLiteSchemaInfo.TableInfo> GetSchemaInfo(string database, string table);
 
     internal abstract double GetDouble(SQLiteStatement stmt, int index);
     internal abstract SByte GetSByte(SQLiteStatement stmt, int index);
@@ -378,6 +420,32 @@ namespace System.Data.SQLite
 #if INTEROP_CODEC
     internal abstract void SetPassword(byte[] passwordBytes);
     internal abstract void ChangePassword(byte[] newPasswordBytes);
+
+    /// <summary>
+    /// Re-encrypts the next group of pages in the database using the new
+    /// password, in a transaction of its own.
+    /// </summary>
+    /// <param name="newPasswordBytes">
+    /// The new password.  This must be the same for every step.
+    /// </param>
+    /// <param name="nPage">
+    /// The number of pages to re-encrypt or zero to only supply the new
+    /// password to this connection.
+    /// </param>
+    /// <param name="remainingPages">
+    /// Receives the number of pages remaining to be re-encrypted.
+    /// </param>
+    /// <param name="totalPages">
+    /// Receives the total number of pages in the database.
+    /// </param>
+    /// <param name="retry">
+    /// Set to true if the operation needs to be retried due to database
+    /// locking issues.
+    /// </param>
+    /// <returns>
+    /// True if there are more pages to be re-encrypted, false otherwise.
+    /// </returns>
+    internal abstract bool StepChangePassword(byte[] newPasswordBytes, int nPage, ref int remainingPages, ref int totalPages, ref bool retry);
 #endif
 
     internal abstract void SetAuthorizerHook(SQLiteAuthorizerCallback func);
@@ -398,6 +466,15 @@ namespace System.Data.SQLite
 
     internal abstract int GetCursorForTable(SQLiteStatement stmt, int database, int rootPage);
     internal abstract long GetRowIdForCursor(SQLiteStatement stmt, int cursor);
+    /// <summary>
+    /// Returns the rowids of the current rows of several table cursors using a single call.
+    /// </summary>
+    /// <param name="stmt">The statement that owns the cursors.</param>
+    /// <param name="cursors">The cursor numbers, as returned by <see cref="GetCursorForTable" />.</param>
+    /// <param name="rowids">
+    /// Receives the rowid for each cursor, or zero if the cursor has no current row.
+    /// </param>
+    internal abstract void GetRowIdsForCursors(SQLiteStatement stmt, int[] cursors, long[] rowids);
 
     internal abstract object GetValue(SQLiteStatement stmt, SQLiteConnectionFlags flags, int index, SQLiteType typ);
 
@@ -1098,6 +1175,15 @@ namespace System.Data.SQLite
       /// </summary>
       NoConvertSettings = 0x8000000,
 
+      /// <summary>
+      /// Skip caching the table, column, and index metadata used to build
+      /// the column schema information (e.g. by the
+      /// <see cref="SQLiteDataReader.GetSchemaTable" /> method) for this
+      /// connection.  When this flag is not set, the metadata is kept until
+      /// the schema of the database it belongs to changes.
+      /// </summary>
+      NoSchemaCache = 0x10000000,
+
       /// <summary>
       /// When binding parameter values or returning column values, always
       /// treat them as though they were plain text (i.e. no numeric,
@@ -0,0 +1,664 @@
+/********************************************************
+ * ADO.NET 2.0 Data Provider for SQLite Version 3.X
+ * Written by Joe Mistachkin (joe@mistachkin.com)
+ *
+ * Released to the public domain, use at your own risk!
+ ********************************************************/
+
+namespace System.Data.SQLite
+{
+    using System;
+    using System.Collections.Generic;
+    using System.Globalization;
+    using System.Threading;
+
+    /// <summary>
+    /// This class checkpoints the write-ahead log of one database file on a
+    /// background connection, so that no writer has to run a checkpoint as
+    /// part of its commit.  While it is running, connections to the same
+    /// database file have their automatic checkpoints disabled; they are
+    /// restored when it stops or when the connection is closed.  At
+    /// every interval, a PASSIVE checkpoint copies whatever frames it can
+    /// without waiting for readers or writers.  After the log has been quiet
+    /// for a number of intervals (or sooner, once it has grown past the size
+    /// limit) a RESTART checkpoint is used, which waits for the readers so
+    /// that the next writer starts again at the beginning of the log file.
+    /// </summary>
+    public sealed class SQLiteCheckpointService : IDisposable
+    {
+        #region Private Constants
+        /// <summary>
+        /// The default number of milliseconds between checkpoints.
+        /// </summary>
+        private const int DefaultInterval = 1000;
+
+        /// <summary>
+        /// The default number of consecutive intervals without new log frames
+        /// before a RESTART checkpoint is attempted.
+        /// </summary>
+        private const int DefaultQuietIntervals = 5;
+
+        /// <summary>
+        /// The default number of log frames beyond which a RESTART checkpoint
+        /// is attempted after only one quiet interval.
+        /// </summary>
+        private const int DefaultSizeLimit = 10000;
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Static Data
+        /// <summary>
+        /// This lock protects the <see cref="_activeFileNames" /> dictionary.
+        /// </summary>
+        private static readonly object _syncRoot = new object();
+
+        /// <summary>
+        /// The number of services running for each database file, keyed by
+        /// the (case-insensitive) file name.
+        /// </summary>
+        private static Dictionary<string, int> _activeFileNames;
+
+        /// <summary>
+        /// This is incremented whenever a checkpoint service is started or
+        /// stopped.  It is read without taking the lock; therefore, it must
+        /// only be changed via the <see cref="Interlocked" /> class.
+        /// </summary>
+        private static int _generation;
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Data
+        /// <summary>
+        /// The connection used to run the checkpoints.
+        /// </summary>
+        private SQLiteConnection _connection;
+
+        /// <summary>
+        /// The database file name associated with this service.
+        /// </summary>
+        private string _fileName;
+
+        /// <summary>
+        /// The number of milliseconds between checkpoints.
+        /// </summary>
+        private int _interval;
+
+        /// <summary>
+        /// The number of consecutive intervals without new log frames before
+        /// a RESTART checkpoint is attempted.
+        /// </summary>
+        private int _quietIntervals;
+
+        /// <summary>
+        /// The number of log frames beyond which a RESTART checkpoint is
+        /// attempted after only one quiet interval.
+        /// </summary>
+        private int _sizeLimit;
+
+        /// <summary>
+        /// The thread that runs the checkpoints.
+        /// </summary>
+        private Thread _thread;
+
+        /// <summary>
+        /// This event is signaled to make the checkpoint thread exit.
+        /// </summary>
+        private ManualResetEvent _stop;
+
+        /// <summary>
+        /// This object is used to synchronize access to the counters.
+        /// </summary>
+        private readonly object _counterSyncRoot = new object();
+
+        /// <summary>
+        /// The number of frames in the log as of the last checkpoint.
+        /// </summary>
+        private long _walFrameCount;
+
+        /// <summary>
+        /// The total number of frames copied into the database file.
+        /// </summary>
+        private long _framesCheckpointed;
+
+        /// <summary>
+        /// The number of checkpoints that have been run.
+        /// </summary>
+        private long _checkpointCount;
+
+        /// <summary>
+        /// The number of RESTART checkpoints that have been run.
+        /// </summary>
+        private long _restartCount;
+
+        /// <summary>
+        /// The number of checkpoints that could not copy every frame in the
+        /// log because of readers (or that could not run at all).
+        /// </summary>
+        private long _busyCount;
+
+        /// <summary>
+        /// The number of milliseconds taken by the last checkpoint.
+        /// </summary>
+        private long _lastLatency;
+
+        /// <summary>
+        /// The largest number of milliseconds taken by any checkpoint.
+        /// </summary>
+        private long _maximumLatency;
+
+        /// <summary>
+        /// The total number of milliseconds taken by all checkpoints.
+        /// </summary>
+        private long _totalLatency;
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Constructors
+        /// <summary>
+        /// Starts a checkpoint service using the default policy.
+        /// </summary>
+        /// <param name="connectionString">
+        /// The connection string used to open the checkpoint connection.
+        /// </param>
+        public SQLiteCheckpointService(
+            string connectionString
+            )
+            : this(connectionString, DefaultInterval, DefaultQuietIntervals,
+                   DefaultSizeLimit)
+        {
+            // do nothing.
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Starts a checkpoint service.
+        /// </summary>
+        /// <param name="connectionString">
+        /// The connection string used to open the checkpoint connection.
+        /// </param>
+        /// <param name="interval">
+        /// The number of milliseconds between checkpoints.
+        /// </param>
+        /// <param name="quietIntervals">
+        /// The number of consecutive intervals without new log frames before
+        /// a RESTART checkpoint is attempted.
+        /// </param>
+        /// <param name="sizeLimit">
+        /// The number of log frames beyond which a RESTART checkpoint is
+        /// attempted after only one quiet interval.
+        /// </param>
+        public SQLiteCheckpointService(
+            string connectionString,
+            int interval,
+            int quietIntervals,
+            int sizeLimit
+            )
+        {
+            if (interval < 1)
+                throw new ArgumentOutOfRangeException("interval");
+
+            if (quietIntervals < 1)
+                throw new ArgumentOutOfRangeException("quietIntervals");
+
+            if (sizeLimit < 1)
+                throw new ArgumentOutOfRangeException("sizeLimit");
+
+            _interval = interval;
+            _quietIntervals = quietIntervals;
+            _sizeLimit = sizeLimit;
+
+            _connection = new SQLiteConnection(connectionString);
+            _connection.Open();
+
+            _fileName = _connection.FileName;
+
+            AddFileName(_fileName);
+
+            _stop = new ManualResetEvent(false);
+            _thread = new Thread(ThreadStart);
+            _thread.IsBackground = true;
+#if !PLATFORM_COMPACTFRAMEWORK
+            _thread.Name = "SQLiteCheckpointService";
+#endif
+            _thread.Start();
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Internal Static Properties
+        /// <summary>
+        /// Returns a number that changes whenever a checkpoint service is
+        /// started or stopped.  Connections use it to avoid checking their
+        /// database file name against the running services before every
+        /// command.
+        /// </summary>
+        internal static int Generation
+        {
+            get { return Interlocked.CompareExchange(ref _generation, 0, 0); }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Internal Static Methods
+        /// <summary>
+        /// Determines if a checkpoint service is running for the specified
+        /// database file.
+        /// </summary>
+        /// <param name="fileName">
+        /// The database file name.
+        /// </param>
+        /// <returns>
+        /// Non-zero if a checkpoint service is running for the database file.
+        /// </returns>
+        internal static bool IsActive(
+            string fileName
+            )
+        {
+            if (String.IsNullOrEmpty(fileName))
+                return false;
+
+            lock (_syncRoot)
+            {
+                return (_activeFileNames != null) &&
+                    _activeFileNames.ContainsKey(fileName);
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Static Methods
+        /// <summary>
+        /// Records that a checkpoint service is running for the specified
+        /// database file.
+        /// </summary>
+        /// <param name="fileName">
+        /// The database file name.
+        /// </param>
+        private static void AddFileName(
+            string fileName
+            )
+        {
+            if (String.IsNullOrEmpty(fileName))
+                return;
+
+            lock (_syncRoot)
+            {
+                if (_activeFileNames == null)
+                {
+                    _activeFileNames = new Dictionary<string, int>(
+                        StringComparer.OrdinalIgnoreCase);
+                }
+
+                int count;
+
+                _activeFileNames.TryGetValue(fileName, out count);
+                _activeFileNames[fileName] = count + 1;
+                Interlocked.Increment(ref _generation);
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Records that a checkpoint service is no longer running for the
+        /// specified database file.
+        /// </summary>
+        /// <param name="fileName">
+        /// The database file name.
+        /// </param>
+        private static void RemoveFileName(
+            string fileName
+            )
+        {
+            if (String.IsNullOrEmpty(fileName))
+                return;
+
+            lock (_syncRoot)
+            {
+                int count;
+
+                if ((_activeFileNames == null) ||
+                    !_activeFileNames.TryGetValue(fileName, out count))
+                {
+                    return;
+                }
+
+                if (count > 1)
+                    _activeFileNames[fileName] = count - 1;
+                else
+                    _activeFileNames.Remove(fileName);
+
+                Interlocked.Increment(ref _generation);
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Properties
+        /// <summary>
+        /// Returns the database file name associated with this service.
+        /// </summary>
+        public string FileName
+        {
+            get { CheckDisposed(); return _fileName; }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the number of frames in the log as of the last checkpoint.
+        /// </summary>
+        public long WalFrameCount
+        {
+            get { CheckDisposed(); lock (_counterSyncRoot) { return _walFrameCount; } }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the total number of frames copied into the database file.
+        /// </summary>
+        public long FramesCheckpointed
+        {
+            get { CheckDisposed(); lock (_counterSyncRoot) { return _framesCheckpointed; } }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the number of checkpoints that have been run.
+        /// </summary>
+        public long CheckpointCount
+        {
+            get { CheckDisposed(); lock (_counterSyncRoot) { return _checkpointCount; } }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the number of RESTART checkpoints that have been run.
+        /// </summary>
+        public long RestartCount
+        {
+            get { CheckDisposed(); lock (_counterSyncRoot) { return _restartCount; } }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the number of checkpoints that could not copy every frame
+        /// in the log, typically because of active readers.
+        /// </summary>
+        public long BusyCount
+        {
+            get { CheckDisposed(); lock (_counterSyncRoot) { return _busyCount; } }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the number of milliseconds taken by the last checkpoint.
+        /// </summary>
+        public long LastLatency
+        {
+            get { CheckDisposed(); lock (_counterSyncRoot) { return _lastLatency; } }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the largest number of milliseconds taken by any checkpoint.
+        /// </summary>
+        public long MaximumLatency
+        {
+            get { CheckDisposed(); lock (_counterSyncRoot) { return _maximumLatency; } }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the total number of milliseconds taken by all checkpoints.
+        /// </summary>
+        public long TotalLatency
+        {
+            get { CheckDisposed(); lock (_counterSyncRoot) { return _totalLatency; } }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Methods
+        /// <summary>
+        /// Runs one checkpoint and updates the counters.
+        /// </summary>
+        /// <param name="mode">
+        /// The checkpoint mode, either "PASSIVE" or "RESTART".
+        /// </param>
+        /// <param name="logFrames">
+        /// Upon success, receives the number of frames in the log.  This will
+        /// be -1 if the database is not in WAL mode or the checkpoint could
+        /// not be run.
+        /// </param>
+        /// <returns>
+        /// Non-zero if every frame in the log has been copied into the database
+        /// file.
+        /// </returns>
+        private bool Checkpoint(
+            string mode,
+            ref long logFrames
+            )
+        {
+            uint startTick = (uint)Environment.TickCount;
+            bool busy = true;
+            bool failed = false;
+            long checkpointed = 0;
+
+            try
+            {
+                using (SQLiteCommand command = _connection.CreateCommand())
+                {
+                    command.CommandText = String.Format(
+                        CultureInfo.InvariantCulture,
+                        "PRAGMA wal_checkpoint({0});", mode);
+
+                    using (SQLiteDataReader reader = command.ExecuteReader())
+                    {
+                        if (reader.Read())
+                        {
+                            busy = (reader.GetInt32(0) != 0);
+                            logFrames = reader.GetInt64(1);
+                            checkpointed = reader.GetInt64(2);
+                        }
+                    }
+                }
+            }
+            catch (SQLiteException)
+            {
+                //
+                // NOTE: The checkpoint could not run (e.g. the database is
+                //       busy).  Count it as busy and try again next interval.
+                //       The caller must not mistake this for an empty log.
+                //
+                failed = true;
+            }
+
+            long latency = (long)((uint)Environment.TickCount - startTick);
+
+            if (logFrames < 0)
+                return true; /* NOTE: Not in WAL mode. */
+
+            busy = busy || (checkpointed < logFrames);
+
+            lock (_counterSyncRoot)
+            {
+                if (!failed)
+                    _walFrameCount = logFrames;
+
+                if (checkpointed > 0)
+                    _framesCheckpointed += checkpointed;
+
+                _checkpointCount++;
+
+                if (String.Equals(mode, "RESTART", StringComparison.Ordinal))
+                    _restartCount++;
+
+                if (busy)
+                    _busyCount++;
+
+                _lastLatency = latency;
+
+                if (latency > _maximumLatency)
+                    _maximumLatency = latency;
+
+                _totalLatency += latency;
+            }
+
+            if (failed)
+                logFrames = -1;
+
+            return !busy;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The entry point for the checkpoint thread.
+        /// </summary>
+        private void ThreadStart()
+        {
+            long previousFrames = 0;
+            int quiet = 0;
+            bool restarted = false;
+
+            while (!_stop.WaitOne(_interval, false))
+            {
+                long logFrames = 0;
+                bool complete = Checkpoint("PASSIVE", ref logFrames);
+
+                if (logFrames < 0)
+                    continue;
+
+                //
+                // NOTE: Any change in the number of frames (including a writer
+                //       restarting the log) means the log is not quiet.
+                //
+                if (logFrames != previousFrames)
+                {
+                    quiet = 0;
+                    restarted = false;
+                }
+                else
+                {
+                    quiet++;
+                }
+
+                previousFrames = logFrames;
+
+                if (restarted || (logFrames == 0))
+                    continue;
+
+                if ((quiet >= _quietIntervals) ||
+                    ((quiet >= 1) && (logFrames >= _sizeLimit)))
+                {
+                    //
+                    // NOTE: Once the readers that were holding back the PASSIVE
+                    //       checkpoint have gone (or if none were), a RESTART
+                    //       checkpoint will make the next writer reuse the log
+                    //       file from the start instead of growing it.
+                    //
+                    if (!complete)
+                        continue;
+
+                    if (Checkpoint("RESTART", ref logFrames))
+                        restarted = true;
+                }
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region IDisposable Members
+        /// <summary>
+        /// Stops the checkpoint thread and closes the checkpoint connection.
+        /// </summary>
+        public void Dispose()
+        {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region IDisposable "Pattern" Members
+        private bool disposed;
+        private void CheckDisposed() /* throw */
+        {
+#if THROW_ON_DISPOSED
+            if (disposed)
+                throw new ObjectDisposedException(typeof(SQLiteCheckpointService).Name);
+#endif
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        private void Dispose(bool disposing)
+        {
+            if (!disposed)
+            {
+                if (disposing)
+                {
+                    ////////////////////////////////////
+                    // dispose managed resources here...
+                    ////////////////////////////////////
+
+                    if (_thread != null)
+                    {
+                        _stop.Set();
+                        _thread.Join();
+                        _thread = null;
+                    }
+
+                    if (_stop != null)
+                    {
+                        _stop.Close();
+                        _stop = null;
+                    }
+
+                    RemoveFileName(_fileName);
+
+                    if (_connection != null)
+                    {
+                        _connection.Dispose();
+                        _connection = null;
+                    }
+                }
+
+                //////////////////////////////////////
+                // release unmanaged resources here...
+                //////////////////////////////////////
+
+                disposed = true;
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Destructor
+        ~SQLiteCheckpointService()
+        {
+            Dispose(false);
+        }
+        #endregion
+    }
+}
@@ -13,6 +13,12 @@ namespace System.Data.SQLite
   using System.Diagnostics;
   using System.Collections.Generic;
   using System.ComponentModel;
+  using System.Globalization;
+  using System.Threading;
+
+#if NET_45 || NET_451
+  using System.Threading.Tasks;
+#endif
 
   /// <summary>
   /// SQLite implementation of DbCommand.
@@ -642,6 +648,9 @@ namespace System.Data.SQLite
       if (_cnn.State != ConnectionState.Open)
         throw new InvalidOperationException("Database is not open");
 
+      // Start or stop deferring checkpoints to a checkpoint service
+      _cnn.SyncCheckpointService();
+
       // If the version of the connection has changed, clear out any previous commands before starting
       if (_cnn._version != _version)
       {
@@ -872,6 +881,342 @@ namespace System.Data.SQLite
       return ExecuteReader(CommandBehavior.Default);
     }
 
+    /// <summary>
+    /// Splits a query over a rowid table into rowid ranges and executes each range concurrently
+    /// on its own read connection, cloned from the one associated with this command.  The command
+    /// text must restrict the rowid using the "@minimumRowId" and "@maximumRowId" parameters (both
+    /// inclusive), which are added to each partition command automatically, e.g.
+    /// "SELECT SUM(x) FROM t1 WHERE rowid BETWEEN @minimumRowId AND @maximumRowId;".
+    /// </summary>
+    /// <remarks>
+    /// Each partition connection begins a read transaction before the range boundaries are computed
+    /// or any partition is started.  In WAL mode, all partitions therefore read from the same snapshot
+    /// unless a writer commits while those transactions are being opened (the native library does not
+    /// provide a way to share one snapshot between connections).  The ranges are evenly sized between
+    /// the minimum and maximum rowid of the table.  Each returned reader owns its connection and closes
+    /// it when the reader is closed.
+    /// </remarks>
+    /// <param name="tableName">The name of the rowid table being scanned, in the "main" database.</param>
+    /// <param name="partitionCount">The maximum number of partitions.</param>
+    /// <param name="behavior">The flags to be associated with each reader.</param>
+    /// <returns>One SQLiteDataReader per partition, in rowid order.  The array is empty if the table
+    /// is empty.</returns>
+    public SQLiteDataReader[] ExecutePartitionedReaders(
+        string tableName,
+        int partitionCount,
+        CommandBehavior behavior
+        )
+    {
+      return ExecutePartitionedReaders(null, tableName, partitionCount, behavior);
+    }
+
+    /// <summary>
+    /// Splits a query over a rowid table into rowid ranges and executes each range concurrently
+    /// on its own read connection.  See the
+    /// <see cref="ExecutePartitionedReaders(string, int, CommandBehavior)" /> method for details.
+    /// </summary>
+    /// <param name="databaseName">The name of the database containing the table, e.g. "main" or the
+    /// name of an attached database.  If this is null, "main" is used.</param>
+    /// <param name="tableName">The name of the rowid table being scanned.  It is quoted as a single
+    /// identifier, so it must not be qualified with the database name.</param>
+    /// <param name="partitionCount">The maximum number of partitions.</param>
+    /// <param name="behavior">The flags to be associated with each reader.</param>
+    /// <returns>One SQLiteDataReader per partition, in rowid order.  The array is empty if the table
+    /// is empty.</returns>
+    public SQLiteDataReader[] ExecutePartitionedReaders(
+        string databaseName,
+        string tableName,
+        int partitionCount,
+        CommandBehavior behavior
+        )
+    {
+      CheckDisposed();
+      SQLiteConnection.Check(_cnn);
+
+      if (String.IsNullOrEmpty(tableName))
+        throw new ArgumentNullException("tableName");
+
+      if (partitionCount < 1)
+        throw new ArgumentOutOfRangeException("partitionCount");
+
+      SQLiteConnection[] connections = new SQLiteConnection[partitionCount];
+      SQLiteDataReader[] readers = null;
+      bool success = false;
+
+      try
+      {
+        //
+        // NOTE: Open all the read transactions back-to-back so that they
+        //       see the same database snapshot.
+        //
+        for (int index = 0; index < partitionCount; index++)
+        {
+          connections[index] = new SQLiteConnection(_cnn);
+
+          using (SQLiteCommand command = connections[index].CreateCommand())
+          {
+            command.CommandText = "BEGIN;";
+            command.ExecuteNonQuery();
+
+            command.CommandText = "SELECT COUNT(*) FROM sqlite_master;";
+            command.ExecuteScalar();
+          }
+        }
+
+        long minimum;
+        long maximum;
+
+        using (SQLiteCommand command = connections[0].CreateCommand())
+        {
+          command.CommandText = String.Format(CultureInfo.InvariantCulture,
+            "SELECT MIN(rowid), MAX(rowid) FROM {0}.{1};",
+            SQLiteConvert.QuoteIdentifier((databaseName != null) ? databaseName : "main"),
+            SQLiteConvert.QuoteIdentifier(tableName));
+
+          using (SQLiteDataReader reader = command.ExecuteReader())
+          {
+            if (!reader.Read() || reader.IsDBNull(0))
+            {
+              success = true;
+              return new SQLiteDataReader[0];
+            }
+
+            minimum = reader.GetInt64(0);
+            maximum = reader.GetInt64(1);
+          }
+        }
+
+        //
+        // NOTE: Divide the (inclusive) rowid range into evenly sized pieces,
+        //       taking care not to overflow when the range is very large.
+        //
+        ulong span = unchecked((ulong)(maximum - minimum));
+
+        if ((ulong)partitionCount > span)
+          partitionCount = (int)(span + 1);
+
+        ulong quotient = span / (ulong)partitionCount;
+        ulong remainder = (span % (ulong)partitionCount) + 1;
+
+        if (remainder == (ulong)partitionCount)
+        {
+          quotient++;
+          remainder = 0;
+        }
+
+        SQLiteCommand[] commands = new SQLiteCommand[partitionCount];
+        long low = minimum;
+
+        for (int index = 0; index < partitionCount; index++)
+        {
+          ulong size = quotient + (((ulong)index < remainder) ? 1UL : 0UL);
+          long high = unchecked(low + (long)(size - 1));
+
+          commands[index] = new SQLiteCommand(this);
+          commands[index].Connection = connections[index];
+          SetParameterValue(commands[index], "@minimumRowId", low);
+          SetParameterValue(commands[index], "@maximumRowId", high);
+
+          low = unchecked(high + 1);
+        }
+
+        readers = new SQLiteDataReader[partitionCount];
+
+        Exception[] errors = new Exception[partitionCount];
+        Thread[] threads = new Thread[partitionCount];
+
+        //
+        // NOTE: Creating a reader steps its statement to the first row, which
+        //       is where aggregate queries do all their work; therefore, each
+        //       partition other than the first is created on its own thread.
+        //
+        for (int index = 1; index < partitionCount; index++)
+        {
+          int partition = index;
+
+          threads[index] = new Thread(delegate()
+          {
+            ExecutePartition(commands, readers, errors, partition, behavior);
+          });
+
+          threads[index].IsBackground = true;
+          threads[index].Start();
+        }
+
+        ExecutePartition(commands, readers, errors, 0, behavior);
+
+        for (int index = 1; index < partitionCount; index++)
+          threads[index].Join();
+
+        for (int index = 0; index < partitionCount; index++)
+        {
+          if (errors[index] != null)
+            throw errors[index];
+        }
+
+        success = true;
+        return readers;
+      }
+      finally
+      {
+        if (!success)
+        {
+          for (int index = 0; index < connections.Length; index++)
+          {
+            if ((readers != null) && (index < readers.Length) && (readers[index] != null))
+              readers[index].Dispose();
+
+            if (connections[index] != null)
+              connections[index].Dispose();
+          }
+        }
+        else
+        {
+          //
+          // NOTE: Close any connections that did not end up being used by a
+          //       partition (e.g. because the table was small or empty).
+          //
+          for (int index = (readers != null) ? readers.Length : 0; index < connections.Length; index++)
+          {
+            if (connections[index] != null)
+              connections[index].Dispose();
+          }
+        }
+      }
+    }
+
+    /// <summary>
+    /// Sets the value of a parameter of a partition command, adding the parameter only if the
+    /// cloned command does not already have one with that name.
+    /// </summary>
+    /// <param name="command">The partition command.</param>
+    /// <param name="parameterName">The name of the parameter.</param>
+    /// <param name="value">The value of the parameter.</param>
+    private static void SetParameterValue(SQLiteCommand command, string parameterName, long value)
+    {
+      int index = command.Parameters.IndexOf(parameterName);
+
+      if (index < 0)
+        command.Parameters.AddWithValue(parameterName, value);
+      else
+        command.Parameters[index].Value = value;
+    }
+
+    /// <summary>
+    /// Executes one partition for <see cref="ExecutePartitionedReaders(string, string, int, CommandBehavior)" />, capturing any error.
+    /// </summary>
+    /// <param name="commands">The commands for all partitions.</param>
+    /// <param name="readers">Receives the readers for all partitions.</param>
+    /// <param name="errors">Receives the errors for all partitions.</param>
+    /// <param name="index">The index of the partition to execute.</param>
+    /// <param name="behavior">The flags to be associated with the reader.</param>
+    private static void ExecutePartition(
+        SQLiteCommand[] commands,
+        SQLiteDataReader[] readers,
+        Exception[] errors,
+        int index,
+        CommandBehavior behavior
+        )
+    {
+      try
+      {
+        SQLiteDataReader reader = commands[index].ExecuteReader(
+          behavior | CommandBehavior.CloseConnection);
+
+        reader._disposeCommand = true;
+        readers[index] = reader;
+      }
+      catch (Exception e)
+      {
+        errors[index] = e;
+        commands[index].Dispose();
+      }
+    }
+
+#if NET_45 || NET_451
+    /// <summary>
+    /// Executes the command on the dedicated threads for the associated database file and
+    /// returns a SQLiteDataReader once the first row (if any) is available.  Signaling the
+    /// cancellation token interrupts the statement via the native sqlite3_interrupt() API.
+    /// </summary>
+    /// <param name="behavior">The flags to be associated with the reader.</param>
+    /// <param name="cancellationToken">The token used to cancel the operation.</param>
+    /// <returns>A task producing the SQLiteDataReader</returns>
+    protected override Task<DbDataReader> ExecuteDbDataReaderAsync(
+        CommandBehavior behavior,
+        CancellationToken cancellationToken
+        )
+    {
+      CheckDisposed();
+      SQLiteConnection.Check(_cnn);
+
+      return SQLiteTaskScheduler.Run<DbDataReader>(_cnn, delegate()
+      {
+        return ExecuteReader(behavior);
+      }, cancellationToken);
+    }
+
+    /// <summary>
+    /// Executes the command on the dedicated threads for the associated database file and
+    /// returns a SQLiteDataReader once the first row (if any) is available.
+    /// </summary>
+    /// <param name="behavior">The flags to be associated with the reader.</param>
+    /// <param name="cancellationToken">The token used to cancel the operation.</param>
+    /// <returns>A task producing the SQLiteDataReader</returns>
+    public new Task<SQLiteDataReader> ExecuteReaderAsync(
+        CommandBehavior behavior,
+        CancellationToken cancellationToken
+        )
+    {
+      CheckDisposed();
+      SQLiteConnection.Check(_cnn);
+
+      return SQLiteTaskScheduler.Run<SQLiteDataReader>(_cnn, delegate()
+      {
+        return ExecuteReader(behavior);
+      }, cancellationToken);
+    }
+
+    /// <summary>
+    /// Executes the command on the dedicated threads for the associated database file and
+    /// returns the number of rows inserted/updated affected by it.
+    /// </summary>
+    /// <param name="cancellationToken">The token used to cancel the operation.</param>
+    /// <returns>A task producing the number of rows inserted/updated affected by it.</returns>
+    public override Task<int> ExecuteNonQueryAsync(
+        CancellationToken cancellationToken
+        )
+    {
+      CheckDisposed();
+      SQLiteConnection.Check(_cnn);
+
+      return SQLiteTaskScheduler.Run<int>(_cnn, delegate()
+      {
+        return ExecuteNonQuery(CommandBehavior.Default);
+      }, cancellationToken);
+    }
+
+    /// <summary>
+    /// Executes the command on the dedicated threads for the associated database file and
+    /// returns the first column of the first row of the resultset (if present), or null if
+    /// no resultset was returned.
+    /// </summary>
+    /// <param name="cancellationToken">The token used to cancel the operation.</param>
+    /// <returns>A task producing the first column of the first row of the first resultset from the query.</returns>
+    public override Task<object> ExecuteScalarAsync(
+        CancellationToken cancellationToken
+        )
+    {
+      CheckDisposed();
+      SQLiteConnection.Check(_cnn);
+
+      return SQLiteTaskScheduler.Run<object>(_cnn, delegate()
+      {
+        return ExecuteScalar(CommandBehavior.Default);
+      }, cancellationToken);
+    }
+#endif
+
     /// <summary>
     /// Called by the SQLiteDataReader when the data reader is closed.
     /// </summary>
@@ -500,6 +500,35 @@ namespace System.Data.SQLite
     /// </summary>
     private Dictionary<string, object> _cachedSettings;
 
+    /// <summary>
+    /// The cached table, column, and index metadata used when returning
+    /// column schema information for this connection.  The metadata for
+    /// each database is discarded when its schema changes.
+    /// </summary>
+    internal SQLiteSchemaCache _schemaCache;
+
+    /// <summary>
+    /// The value of <see cref="SQLiteCheckpointService.Generation" /> when
+    /// this connection last checked whether a checkpoint service is running
+    /// for its database file.
+    /// </summary>
+    private int _checkpointGeneration;
+
+    /// <summary>
+    /// The automatic checkpoint threshold to restore once no checkpoint
+    /// service is running for the database file, or -1 if it has not been
+    /// changed.
+    /// </summary>
+    private int _savedAutoCheckpoint = -1;
+
+#if NET_45 || NET_451
+    /// <summary>
+    /// The scheduler used for the asynchronous methods of this connection, or
+    /// null if none have been used since it was opened.
+    /// </summary>
+    internal SQLiteTaskScheduler _taskScheduler;
+#endif
+
     /// <summary>
     /// The default databse type for this connection.  This value will only
     /// be used if the <see cref="SQLiteConnectionFlags.UseConnectionTypes" />
@@ -657,6 +686,8 @@ namespace System.Data.SQLite
       _cachedSettings = new Dictionary<string, object>(
           new TypeNameStringComparer());
 
+      _schemaCache = new SQLiteSchemaCache();
+
       _typeNames = new SQLiteDbTypeMap();
       _parseViaFramework = parseViaFramework;
       _flags = SQLiteConnectionFlags.Default;
@@ -1025,6 +1056,73 @@ namespace System.Data.SQLite
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
 
+    #region Checkpoint Service Support
+    /// <summary>
+    /// Disables the automatic checkpoints of this connection while a
+    /// checkpoint service is running for its database file and restores
+    /// them once it is not.  This only queries the database when a
+    /// checkpoint service has been started or stopped since the last call.
+    /// </summary>
+    internal void SyncCheckpointService()
+    {
+        int generation = SQLiteCheckpointService.Generation;
+
+        if (generation == _checkpointGeneration)
+            return;
+
+        _checkpointGeneration = generation;
+
+        if ((_sql == null) || (_connectionState != ConnectionState.Open))
+            return;
+
+        bool active = SQLiteCheckpointService.IsActive(_sql.FileName);
+
+        if (active && (_savedAutoCheckpoint < 0))
+        {
+            using (SQLiteCommand command = CreateCommand())
+            {
+                command.CommandText = "PRAGMA wal_autocheckpoint";
+
+                _savedAutoCheckpoint = Convert.ToInt32(
+                    command.ExecuteScalar(), CultureInfo.InvariantCulture);
+
+                command.CommandText = "PRAGMA wal_autocheckpoint=0";
+                command.ExecuteNonQuery();
+            }
+        }
+        else if (!active && (_savedAutoCheckpoint >= 0))
+        {
+            RestoreAutoCheckpoint();
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
+    /// <summary>
+    /// Restores the automatic checkpoint threshold saved by the
+    /// <see cref="SyncCheckpointService" /> method, if any.
+    /// </summary>
+    private void RestoreAutoCheckpoint()
+    {
+        if (_savedAutoCheckpoint < 0)
+            return;
+
+        int value = _savedAutoCheckpoint;
+
+        _savedAutoCheckpoint = -1;
+
+        using (SQLiteCommand command = CreateCommand())
+        {
+            command.CommandText = String.Format(CultureInfo.InvariantCulture,
+                "PRAGMA wal_autocheckpoint={0}", value);
+
+            command.ExecuteNonQuery();
+        }
+    }
+    #endregion
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////
+
     #region Per-Connection Type Mappings
     /// <summary>
     /// Clears the per-connection type mappings.
@@ -1532,6 +1630,28 @@ namespace System.Data.SQLite
 
       if (_sql != null)
       {
+        //
+        // NOTE: Connections returned to the pool must not keep automatic
+        //       checkpoints disabled once the checkpoint service is gone.
+        //
+        if (_savedAutoCheckpoint >= 0)
+        {
+          try
+          {
+            RestoreAutoCheckpoint();
+          }
+          catch (SQLiteException)
+          {
+            // do nothing.
+          }
+        }
+
+        _checkpointGeneration = 0;
+
+#if NET_45 || NET_451
+        SQLiteTaskScheduler.ReleaseScheduler(this);
+#endif
+
 #if !PLATFORM_COMPACTFRAMEWORK
         if (_enlistment != null)
         {
@@ -1560,6 +1680,9 @@ namespace System.Data.SQLite
         _transactionLevel = 0;
       }
 
+      if (_schemaCache != null)
+        _schemaCache.Clear();
+
       StateChangeEventArgs eventArgs = null;
       OnStateChange(ConnectionState.Closed, ref eventArgs);
 
@@ -2658,6 +2781,14 @@ namespace System.Data.SQLite
               }
           }
 
+          //
+          // NOTE: When a checkpoint service is running for this database file,
+          //       it takes over checkpointing; therefore, writers using this
+          //       connection should not run checkpoints themselves.
+          //
+          _checkpointGeneration = 0;
+          SyncCheckpointService();
+
           if (_authorizerHandler != null)
               _sql.SetAuthorizerHook(_authorizerCallback);
 
@@ -2837,6 +2968,21 @@ namespace System.Data.SQLite
         _sql.Cancel(); /* throw */
     }
 
+    /// <summary>
+    /// Returns the fully qualified name of the database file associated with
+    /// this connection -OR- null if it is not available (e.g. the connection
+    /// has never been opened).
+    /// </summary>
+    internal string FileName
+    {
+        get
+        {
+            SQLiteBase sql = _sql;
+
+            return (sql != null) ? sql.FileName : null;
+        }
+    }
+
     /// <summary>
     /// Returns the number of rows changed by the last INSERT, UPDATE, or DELETE statement executed on
     /// this connection.
@@ -3311,6 +3457,70 @@ namespace System.Data.SQLite
       _sql.ChangePassword(newPassword);
     }
 
+    /// <summary>
+    /// Change the password (or assign a password) to an open database incrementally, re-encrypting
+    /// a bounded number of pages in each of a series of short transactions, so that other connections
+    /// are not locked out of the database for the duration of the whole operation.
+    /// </summary>
+    /// <remarks>
+    /// While the password change is in progress, the progress is recorded in the database itself and
+    /// every other connection must also be supplied the new password using this method with a
+    /// <paramref name="pages" /> value of zero.  If the password change is halted, it can be resumed
+    /// later by calling this method again with the same new password.
+    /// </remarks>
+    /// <param name="newPassword">The new password to assign to the database</param>
+    /// <param name="pages">
+    /// The number of pages to re-encrypt with each step or zero to only supply the new password to
+    /// this connection.
+    /// </param>
+    /// <param name="callback">
+    /// The method to invoke between each step of the password change.  This parameter may be null
+    /// (i.e. no callbacks will be performed).
+    /// </param>
+    /// <param name="retryMilliseconds">
+    /// The number of milliseconds to sleep after encountering a locking error.  A value less than
+    /// zero means that no sleep should be performed.
+    /// </param>
+    /// <returns>
+    /// True if the whole database now uses the new password, false otherwise.
+    /// </returns>
+    public bool ChangePassword(byte[] newPassword, int pages, SQLiteRekeyCallback callback, int retryMilliseconds)
+    {
+      CheckDisposed();
+
+      if (_connectionState != ConnectionState.Open)
+        throw new InvalidOperationException("Database must be opened before changing the password.");
+
+      if (pages < 0)
+        throw new ArgumentOutOfRangeException("pages");
+
+      int remainingPages = 0;
+      int totalPages = 0;
+      bool retry = false;
+
+      while (_sql.StepChangePassword(newPassword, pages, ref remainingPages, ref totalPages, ref retry)) /* throw */
+      {
+        //
+        // NOTE: If a callback was supplied by our caller, call it.  If it
+        //       returns false, halt the password change; the pages already
+        //       re-encrypted remain that way until it is resumed.
+        //
+        if ((callback != null) && !callback(this, pages, remainingPages, totalPages, retry))
+          return false;
+
+        if (retry && (retryMilliseconds >= 0))
+          System.Threading.Thread.Sleep(retryMilliseconds);
+
+        //
+        // NOTE: Zero pages only supplies the new password; stop now.
+        //
+        if (pages == 0)
+          return false;
+      }
+
+      return true;
+    }
+
     /// <summary>
     /// Sets the password for a password-protected database.  A password-protected database is
     /// unusable for any operation until the password has been set.
@@ -3769,6 +3979,8 @@ namespace System.Data.SQLite
 
       string master = (String.Compare(strCatalog, "temp", StringComparison.OrdinalIgnoreCase) == 0) ? _tempmasterdb : _masterdb;
 
+      Dictionary<string, SQLiteSchemaInfo.TableInfo> schemaInfo = GetSchemaInfo(strCatalog, strTable);
+
       using (SQLiteCommand cmdTables = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT * FROM [{0}].[{1}] WHERE [type] LIKE 'table' OR [type] LIKE 'view'", strCatalog, master), this))
       using (SQLiteDataReader rdTables = cmdTables.ExecuteReader())
       {
@@ -3776,6 +3988,16 @@ namespace System.Data.SQLite
         {
           if (String.IsNullOrEmpty(strTable) || String.Compare(strTable, rdTables.GetString(2), StringComparison.OrdinalIgnoreCase) == 0)
           {
+            SQLiteSchemaInfo.TableInfo tableInfo;
+
+            // Views and virtual tables are not part of the schema information, so their columns
+            // are still described by preparing a query against them.
+            if (schemaInfo != null && schemaInfo.TryGetValue(rdTables.GetString(2), out tableInfo))
+            {
+              AddSchemaColumns(tbl, strCatalog, rdTables.GetString(2), strColumn, tableInfo);
+              continue;
+            }
+
             try
             {
               using (SQLiteCommand cmd = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT * FROM [{0}].[{1}]", strCatalog, rdTables.GetString(2)), this))
@@ -3824,6 +4046,200 @@ namespace System.Data.SQLite
       return tbl;
     }
 
+    /// <summary>
+    /// Adds the rows for the columns of one table to the Columns schema collection, computing the
+    /// same values that <see cref="SQLiteDataReader.GetSchemaTable(bool, bool)" /> would return for
+    /// a query of the whole table, from the schema information alone.
+    /// </summary>
+    /// <param name="tbl">The Columns schema collection</param>
+    /// <param name="strCatalog">The catalog (attached database) of the table</param>
+    /// <param name="strTable">The name of the table</param>
+    /// <param name="strColumn">The only column to add, can be null</param>
+    /// <param name="tableInfo">The schema information for the table</param>
+    private void AddSchemaColumns(DataTable tbl, string strCatalog, string strTable, string strColumn, SQLiteSchemaInfo.TableInfo tableInfo)
+    {
+      int primaryKeys = 0;
+      bool maybeRowId = false;
+
+      // An INTEGER PRIMARY KEY column is a rowid, which counts as a unique index on that column.
+      foreach (SQLiteSchemaInfo.ColumnInfo column in tableInfo.Columns)
+      {
+        if (column.PrimaryKey != 0)
+        {
+          primaryKeys++;
+
+          if (String.Compare(column.Type, "INTEGER", StringComparison.OrdinalIgnoreCase) == 0)
+            maybeRowId = true;
+        }
+      }
+
+      foreach (SQLiteSchemaInfo.ColumnInfo column in tableInfo.Columns)
+      {
+        if (strColumn != null && String.Compare(column.Name, strColumn, StringComparison.OrdinalIgnoreCase) != 0)
+          continue;
+
+        DbType typ = SQLiteConvert.TypeNameToDbType(this, column.Type, _flags);
+        bool primaryKey = (column.PrimaryKey != 0);
+        bool allowDBNull = !column.NotNull && !primaryKey;
+        bool unique = false;
+        string dataType = column.Type;
+        object columnSize = SQLiteConvert.DbTypeToColumnSize(typ);
+        object numericPrecision = SQLiteConvert.DbTypeToNumericPrecision(typ);
+        object numericScale = SQLiteConvert.DbTypeToNumericScale(typ);
+        string[] arSize;
+
+        // For types like varchar(50) and such, extract the size
+        arSize = dataType.Split('(');
+        if (arSize.Length > 1)
+        {
+          dataType = arSize[0];
+          arSize = arSize[1].Split(')');
+          if (arSize.Length > 1)
+          {
+            arSize = arSize[0].Split(',', '.');
+            if (typ == DbType.Binary || SQLiteConvert.IsStringDbType(typ))
+            {
+              columnSize = Convert.ToInt32(arSize[0], CultureInfo.InvariantCulture);
+            }
+            else
+            {
+              numericPrecision = Convert.ToInt32(arSize[0], CultureInfo.InvariantCulture);
+              if (arSize.Length > 1)
+                numericScale = Convert.ToInt32(arSize[1], CultureInfo.InvariantCulture);
+            }
+          }
+        }
+
+        // As with GetSchemaTable, the last index covering a NOT NULL column decides whether it
+        // is unique, provided that index has no other columns.
+        if (!allowDBNull)
+        {
+          if (primaryKey && primaryKeys == 1 && maybeRowId)
+            unique = true;
+
+          foreach (SQLiteSchemaInfo.IndexInfo index in tableInfo.Indexes)
+          {
+            foreach (SQLiteSchemaInfo.IndexColumnInfo indexColumn in index.Columns)
+            {
+              if (String.Compare(indexColumn.Name, column.Name, StringComparison.OrdinalIgnoreCase) == 0)
+              {
+                if (index.Columns.Count == 1)
+                  unique = index.Unique;
+
+                break;
+              }
+            }
+          }
+        }
+
+        DataRow row = tbl.NewRow();
+
+        row["NUMERIC_PRECISION"] = numericPrecision;
+        row["NUMERIC_SCALE"] = numericScale;
+        row["TABLE_NAME"] = strTable;
+        row["COLUMN_NAME"] = column.Name;
+        row["TABLE_CATALOG"] = strCatalog;
+        row["ORDINAL_POSITION"] = column.Id;
+        row["COLUMN_HASDEFAULT"] = (column.DefaultValue != null);
+        row["COLUMN_DEFAULT"] = (column.DefaultValue != null) ? (object)column.DefaultValue : DBNull.Value;
+        row["IS_NULLABLE"] = allowDBNull;
+        row["DATA_TYPE"] = dataType.ToLower(CultureInfo.InvariantCulture);
+        row["EDM_TYPE"] = SQLiteConvert.DbTypeToTypeName(this, typ, _flags).ToString().ToLower(CultureInfo.InvariantCulture);
+        row["CHARACTER_MAXIMUM_LENGTH"] = columnSize;
+        row["TABLE_SCHEMA"] = _baseSchemaName;
+        row["PRIMARY_KEY"] = primaryKey;
+        row["AUTOINCREMENT"] = column.AutoIncrement;
+        row["COLLATION_NAME"] = column.CollationSequence;
+        row["UNIQUE"] = unique;
+        tbl.Rows.Add(row);
+      }
+    }
+
+    /// <summary>
+    /// Returns the column, index, and foreign key information for the tables of a database, read
+    /// from its in-memory schema in a single call.
+    /// </summary>
+    /// <param name="strCatalog">The catalog (attached database) to query</param>
+    /// <param name="strTable">The only table to return information for, can be null</param>
+    /// <returns>The information for each table or null if it is unavailable</returns>
+    private Dictionary<string, SQLiteSchemaInfo.TableInfo> GetSchemaInfo(string strCatalog, string strTable)
+    {
+      try
+      {
+        return _sql.GetSchemaInfo(strCatalog, strTable);
+      }
+      catch (SQLiteException)
+      {
+        return null;
+      }
+    }
+
+    /// <summary>
+    /// Returns the information for one table, using the PRAGMA statements if the table is not
+    /// part of the information returned by <see cref="GetSchemaInfo" />.
+    /// </summary>
+    /// <param name="schemaInfo">The schema information for the database, can be null</param>
+    /// <param name="strCatalog">The catalog (attached database) of the table</param>
+    /// <param name="strTable">The name of the table</param>
+    /// <param name="wantIndexes">Non-zero if the indexes of the table are needed</param>
+    /// <param name="wantForeignKeys">Non-zero if the foreign keys of the table are needed</param>
+    /// <returns>The table information</returns>
+    private SQLiteSchemaInfo.TableInfo GetTableInfo(Dictionary<string, SQLiteSchemaInfo.TableInfo> schemaInfo, string strCatalog, string strTable, bool wantIndexes, bool wantForeignKeys)
+    {
+      SQLiteSchemaInfo.TableInfo tableInfo;
+
+      if (schemaInfo != null && schemaInfo.TryGetValue(strTable, out tableInfo))
+        return tableInfo;
+
+      return SQLiteSchemaInfo.Query(this, strCatalog, strTable, wantIndexes, wantForeignKeys);
+    }
+
+    /// <summary>
+    /// Returns the SQL used to create each index of a database, keyed by index name.
+    /// </summary>
+    /// <param name="strCatalog">The catalog (attached database) to query</param>
+    /// <param name="master">The name of the master table of the catalog</param>
+    /// <returns>The index definitions, which are null for automatic indexes</returns>
+    private Dictionary<string, string> GetIndexDefinitions(string strCatalog, string master)
+    {
+      Dictionary<string, string> result = new Dictionary<string, string>(StringComparer.OrdinalIgnoreCase);
+
+      using (SQLiteCommand cmdIndexes = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT [name], [sql] FROM [{0}].[{1}] WHERE [type] LIKE 'index'", strCatalog, master), this))
+      using (SQLiteDataReader rdIndexes = cmdIndexes.ExecuteReader())
+      {
+        while (rdIndexes.Read())
+        {
+          string name = rdIndexes.GetString(0);
+
+          if (!result.ContainsKey(name))
+            result.Add(name, rdIndexes.IsDBNull(1) ? null : rdIndexes.GetString(1));
+        }
+      }
+
+      return result;
+    }
+
+    /// <summary>
+    /// Returns the name of each index of a database, paired with the name of its table, in the
+    /// order they appear in the schema.
+    /// </summary>
+    /// <param name="strCatalog">The catalog (attached database) to query</param>
+    /// <param name="master">The name of the master table of the catalog</param>
+    /// <returns>The index and table names</returns>
+    private List<KeyValuePair<string, string>> GetIndexTableNames(string strCatalog, string master)
+    {
+      List<KeyValuePair<string, string>> result = new List<KeyValuePair<string, string>>();
+
+      using (SQLiteCommand cmdIndexes = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT [name], [tbl_name] FROM [{0}].[{1}] WHERE [type] LIKE 'index'", strCatalog, master), this))
+      using (SQLiteDataReader rdIndexes = cmdIndexes.ExecuteReader())
+      {
+        while (rdIndexes.Read())
+          result.Add(new KeyValuePair<string, string>(rdIndexes.GetString(0), rdIndexes.GetString(1)));
+      }
+
+      return result;
+    }
+
     /// <summary>
     /// Returns index information for the given database and catalog
     /// </summary>
@@ -3872,6 +4288,9 @@ namespace System.Data.SQLite
 
       string master = (String.Compare(strCatalog, "temp", StringComparison.OrdinalIgnoreCase) == 0) ? _tempmasterdb : _masterdb;
 
+      Dictionary<string, SQLiteSchemaInfo.TableInfo> schemaInfo = GetSchemaInfo(strCatalog, strTable);
+      Dictionary<string, string> indexDefinitions = null;
+
       using (SQLiteCommand cmdTables = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT * FROM [{0}].[{1}] WHERE [type] LIKE 'table'", strCatalog, master), this))
       using (SQLiteDataReader rdTables = cmdTables.ExecuteReader())
       {
@@ -3881,29 +4300,30 @@ namespace System.Data.SQLite
           primaryKeys.Clear();
           if (String.IsNullOrEmpty(strTable) || String.Compare(rdTables.GetString(2), strTable, StringComparison.OrdinalIgnoreCase) == 0)
           {
+            SQLiteSchemaInfo.TableInfo tableInfo;
+
+            try
+            {
+              tableInfo = GetTableInfo(schemaInfo, strCatalog, rdTables.GetString(2), true, false);
+            }
+            catch (SQLiteException)
+            {
+              continue;
+            }
+
             // First, look for any rowid indexes -- which sqlite defines are INTEGER PRIMARY KEY columns.
             // Such indexes are not listed in the indexes list but count as indexes just the same.
-            try
+            foreach (SQLiteSchemaInfo.ColumnInfo column in tableInfo.Columns)
             {
-              using (SQLiteCommand cmdTable = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "PRAGMA [{0}].table_info([{1}])", strCatalog, rdTables.GetString(2)), this))
-              using (SQLiteDataReader rdTable = cmdTable.ExecuteReader())
+              if (column.PrimaryKey != 0)
               {
-                while (rdTable.Read())
-                {
-                  if (rdTable.GetInt32(5) != 0)
-                  {
-                    primaryKeys.Add(rdTable.GetInt32(0));
+                primaryKeys.Add(column.Id);
 
-                    // If the primary key is of type INTEGER, then its a rowid and we need to make a fake index entry for it.
-                    if (String.Compare(rdTable.GetString(2), "INTEGER", StringComparison.OrdinalIgnoreCase) == 0)
-                      maybeRowId = true;
-                  }
-                }
+                // If the primary key is of type INTEGER, then its a rowid and we need to make a fake index entry for it.
+                if (String.Compare(column.Type, "INTEGER", StringComparison.OrdinalIgnoreCase) == 0)
+                  maybeRowId = true;
               }
             }
-            catch (SQLiteException)
-            {
-            }
             if (primaryKeys.Count == 1 && maybeRowId == true)
             {
               row = tbl.NewRow();
@@ -3925,71 +4345,54 @@ namespace System.Data.SQLite
             }
 
             // Now fetch all the rest of the indexes.
-            try
+            foreach (SQLiteSchemaInfo.IndexInfo index in tableInfo.Indexes)
             {
-              using (SQLiteCommand cmd = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "PRAGMA [{0}].index_list([{1}])", strCatalog, rdTables.GetString(2)), this))
-              using (SQLiteDataReader rd = (SQLiteDataReader)cmd.ExecuteReader())
+              if (String.Compare(index.Name, strIndex, StringComparison.OrdinalIgnoreCase) == 0
+              || strIndex == null)
               {
-                while (rd.Read())
-                {
-                  if (String.Compare(rd.GetString(1), strIndex, StringComparison.OrdinalIgnoreCase) == 0
-                  || strIndex == null)
-                  {
-                    row = tbl.NewRow();
+                row = tbl.NewRow();
 
-                    row["TABLE_CATALOG"] = strCatalog;
-                    row["TABLE_NAME"] = rdTables.GetString(2);
-                    row["INDEX_CATALOG"] = strCatalog;
-                    row["INDEX_NAME"] = rd.GetString(1);
-                    row["UNIQUE"] = SQLiteConvert.ToBoolean(rd.GetValue(2), CultureInfo.InvariantCulture, false);
-                    row["PRIMARY_KEY"] = false;
-
-                    // get the index definition
-                    using (SQLiteCommand cmdIndexes = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT * FROM [{0}].[{2}] WHERE [type] LIKE 'index' AND [name] LIKE '{1}'", strCatalog, rd.GetString(1).Replace("'", "''"), master), this))
-                    using (SQLiteDataReader rdIndexes = cmdIndexes.ExecuteReader())
-                    {
-                      while (rdIndexes.Read())
-                      {
-                        if (rdIndexes.IsDBNull(4) == false)
-                          row["INDEX_DEFINITION"] = rdIndexes.GetString(4);
-                        break;
-                      }
-                    }
+                row["TABLE_CATALOG"] = strCatalog;
+                row["TABLE_NAME"] = rdTables.GetString(2);
+                row["INDEX_CATALOG"] = strCatalog;
+                row["INDEX_NAME"] = index.Name;
+                row["UNIQUE"] = index.Unique;
+                row["PRIMARY_KEY"] = false;
 
-                    // Now for the really hard work.  Figure out which index is the primary key index.
-                    // The only way to figure it out is to check if the index was an autoindex and if we have a non-rowid
-                    // primary key, and all the columns in the given index match the primary key columns
-                    if (primaryKeys.Count > 0 && rd.GetString(1).StartsWith("sqlite_autoindex_" + rdTables.GetString(2), StringComparison.InvariantCultureIgnoreCase) == true)
+                // get the index definition
+                if (indexDefinitions == null)
+                  indexDefinitions = GetIndexDefinitions(strCatalog, master);
+
+                string indexDefinition;
+
+                if (indexDefinitions.TryGetValue(index.Name, out indexDefinition) && indexDefinition != null)
+                  row["INDEX_DEFINITION"] = indexDefinition;
+
+                // Now for the really hard work.  Figure out which index is the primary key index.
+                // The only way to figure it out is to check if the index was an autoindex and if we have a non-rowid
+                // primary key, and all the columns in the given index match the primary key columns
+                if (primaryKeys.Count > 0 && index.Name.StartsWith("sqlite_autoindex_" + rdTables.GetString(2), StringComparison.InvariantCultureIgnoreCase) == true)
+                {
+                  int nMatches = 0;
+                  foreach (SQLiteSchemaInfo.IndexColumnInfo indexColumn in index.Columns)
+                  {
+                    if (primaryKeys.Contains(indexColumn.ColumnId) == false)
                     {
-                      using (SQLiteCommand cmdDetails = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "PRAGMA [{0}].index_info([{1}])", strCatalog, rd.GetString(1)), this))
-                      using (SQLiteDataReader rdDetails = cmdDetails.ExecuteReader())
-                      {
-                        int nMatches = 0;
-                        while (rdDetails.Read())
-                        {
-                          if (primaryKeys.Contains(rdDetails.GetInt32(1)) == false)
-                          {
-                            nMatches = 0;
-                            break;
-                          }
-                          nMatches++;
-                        }
-                        if (nMatches == primaryKeys.Count)
-                        {
-                          row["PRIMARY_KEY"] = true;
-                          primaryKeys.Clear();
-                        }
-                      }
+                      nMatches = 0;
+                      break;
                     }
-
-                    tbl.Rows.Add(row);
+                    nMatches++;
+                  }
+                  if (nMatches == primaryKeys.Count)
+                  {
+                    row["PRIMARY_KEY"] = true;
+                    primaryKeys.Clear();
                   }
                 }
+
+                tbl.Rows.Add(row);
               }
             }
-            catch (SQLiteException)
-            {
-            }
           }
         }
       }
@@ -4288,6 +4691,9 @@ namespace System.Data.SQLite
 
       tbl.BeginLoadData();
 
+      Dictionary<string, SQLiteSchemaInfo.TableInfo> schemaInfo = GetSchemaInfo(strCatalog, strTable);
+      List<KeyValuePair<string, string>> indexes = null;
+
       using (SQLiteCommand cmdTables = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT * FROM [{0}].[{1}] WHERE [type] LIKE 'table'", strCatalog, master), this))
       using (SQLiteDataReader rdTables = cmdTables.ExecuteReader())
       {
@@ -4297,25 +4703,26 @@ namespace System.Data.SQLite
           primaryKeys.Clear();
           if (String.IsNullOrEmpty(strTable) || String.Compare(rdTables.GetString(2), strTable, StringComparison.OrdinalIgnoreCase) == 0)
           {
+            SQLiteSchemaInfo.TableInfo tableInfo;
+
             try
             {
-              using (SQLiteCommand cmdTable = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "PRAGMA [{0}].table_info([{1}])", strCatalog, rdTables.GetString(2)), this))
-              using (SQLiteDataReader rdTable = cmdTable.ExecuteReader())
-              {
-                while (rdTable.Read())
-                {
-                  if (rdTable.GetInt32(5) == 1) // is a primary key
-                  {
-                    primaryKeys.Add(new KeyValuePair<int, string>(rdTable.GetInt32(0), rdTable.GetString(1)));
-                    // Is an integer -- could be a rowid if no other primary keys exist in the table
-                    if (String.Compare(rdTable.GetString(2), "INTEGER", StringComparison.OrdinalIgnoreCase) == 0)
-                      maybeRowId = true;
-                  }
-                }
-              }
+              tableInfo = GetTableInfo(schemaInfo, strCatalog, rdTables.GetString(2), true, false);
             }
             catch (SQLiteException)
             {
+              continue;
+            }
+
+            foreach (SQLiteSchemaInfo.ColumnInfo column in tableInfo.Columns)
+            {
+              if (column.PrimaryKey == 1) // is a primary key
+              {
+                primaryKeys.Add(new KeyValuePair<int, string>(column.Id, column.Name));
+                // Is an integer -- could be a rowid if no other primary keys exist in the table
+                if (String.Compare(column.Type, "INTEGER", StringComparison.OrdinalIgnoreCase) == 0)
+                  maybeRowId = true;
+              }
             }
             // This is a rowid row
             if (primaryKeys.Count == 1 && maybeRowId == true)
@@ -4336,51 +4743,44 @@ namespace System.Data.SQLite
                 tbl.Rows.Add(row);
             }
 
-            using (SQLiteCommand cmdIndexes = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT * FROM [{0}].[{2}] WHERE [type] LIKE 'index' AND [tbl_name] LIKE '{1}'", strCatalog, rdTables.GetString(2).Replace("'", "''"), master), this))
-            using (SQLiteDataReader rdIndexes = cmdIndexes.ExecuteReader())
+            // The indexes of all tables are fetched once, in the order they appear in the schema
+            if (indexes == null)
+              indexes = GetIndexTableNames(strCatalog, master);
+
+            foreach (KeyValuePair<string, string> pair in indexes)
             {
-              while (rdIndexes.Read())
+              if (String.Compare(pair.Value, rdTables.GetString(2), StringComparison.OrdinalIgnoreCase) != 0)
+                continue;
+
+              int ordinal = 0;
+              if (String.IsNullOrEmpty(strIndex) || String.Compare(strIndex, pair.Key, StringComparison.OrdinalIgnoreCase) == 0)
               {
-                int ordinal = 0;
-                if (String.IsNullOrEmpty(strIndex) || String.Compare(strIndex, rdIndexes.GetString(1), StringComparison.OrdinalIgnoreCase) == 0)
+                SQLiteSchemaInfo.IndexInfo index = tableInfo.FindIndex(pair.Key);
+
+                if (index == null)
+                  continue;
+
+                foreach (SQLiteSchemaInfo.IndexColumnInfo indexColumn in index.Columns)
                 {
-                  try
-                  {
-                    using (SQLiteCommand cmdIndex = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "PRAGMA [{0}].index_info([{1}])", strCatalog, rdIndexes.GetString(1)), this))
-                    using (SQLiteDataReader rdIndex = cmdIndex.ExecuteReader())
-                    {
-                      while (rdIndex.Read())
-                      {
-                        row = tbl.NewRow();
-                        row["CONSTRAINT_CATALOG"] = strCatalog;
-                        row["CONSTRAINT_NAME"] = rdIndexes.GetString(1);
-                        row["TABLE_CATALOG"] = strCatalog;
-                        row["TABLE_NAME"] = rdIndexes.GetString(2);
-                        row["COLUMN_NAME"] = rdIndex.GetString(2);
-                        row["INDEX_NAME"] = rdIndexes.GetString(1);
-                        row["ORDINAL_POSITION"] = ordinal; // rdIndex.GetInt32(1);
-
-                        string collationSequence = null;
-                        int sortMode = 0;
-                        int onError = 0;
-                        _sql.GetIndexColumnExtendedInfo(strCatalog, rdIndexes.GetString(1), rdIndex.GetString(2), ref sortMode, ref onError, ref collationSequence);
-
-                        if (String.IsNullOrEmpty(collationSequence) == false)
-                          row["COLLATION_NAME"] = collationSequence;
-
-                        row["SORT_MODE"] = (sortMode == 0) ? "ASC" : "DESC";
-                        row["CONFLICT_OPTION"] = onError;
-
-                        ordinal++;
-
-                        if (String.IsNullOrEmpty(strColumn) || String.Compare(strColumn, row["COLUMN_NAME"].ToString(), StringComparison.OrdinalIgnoreCase) == 0)
-                          tbl.Rows.Add(row);
-                      }
-                    }
-                  }
-                  catch (SQLiteException)
-                  {
-                  }
+                  row = tbl.NewRow();
+                  row["CONSTRAINT_CATALOG"] = strCatalog;
+                  row["CONSTRAINT_NAME"] = pair.Key;
+                  row["TABLE_CATALOG"] = strCatalog;
+                  row["TABLE_NAME"] = pair.Value;
+                  row["COLUMN_NAME"] = indexColumn.Name;
+                  row["INDEX_NAME"] = pair.Key;
+                  row["ORDINAL_POSITION"] = ordinal; // indexColumn.Id;
+
+                  if (String.IsNullOrEmpty(indexColumn.CollationSequence) == false)
+                    row["COLLATION_NAME"] = indexColumn.CollationSequence;
+
+                  row["SORT_MODE"] = (indexColumn.SortMode == 0) ? "ASC" : "DESC";
+                  row["CONFLICT_OPTION"] = index.OnError;
+
+                  ordinal++;
+
+                  if (String.IsNullOrEmpty(strColumn) || String.Compare(strColumn, row["COLUMN_NAME"].ToString(), StringComparison.OrdinalIgnoreCase) == 0)
+                    tbl.Rows.Add(row);
                 }
               }
             }
@@ -4551,6 +4951,8 @@ namespace System.Data.SQLite
 
       tbl.BeginLoadData();
 
+      Dictionary<string, SQLiteSchemaInfo.TableInfo> schemaInfo = GetSchemaInfo(strCatalog, strTable);
+
       using (SQLiteCommand cmdTables = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "SELECT * FROM [{0}].[{1}] WHERE [type] LIKE 'table'", strCatalog, master), this))
       using (SQLiteDataReader rdTables = cmdTables.ExecuteReader())
       {
@@ -4560,29 +4962,29 @@ namespace System.Data.SQLite
           {
             try
             {
+              SQLiteSchemaInfo.TableInfo tableInfo = GetTableInfo(schemaInfo, strCatalog, rdTables.GetString(2), false, true);
+
               using (SQLiteCommandBuilder builder = new SQLiteCommandBuilder())
-              using (SQLiteCommand cmdKey = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "PRAGMA [{0}].foreign_key_list([{1}])", strCatalog, rdTables.GetString(2)), this))
-              using (SQLiteDataReader rdKey = cmdKey.ExecuteReader())
               {
-                while (rdKey.Read())
+                foreach (SQLiteSchemaInfo.ForeignKeyInfo foreignKey in tableInfo.ForeignKeys)
                 {
                   row = tbl.NewRow();
                   row["CONSTRAINT_CATALOG"] = strCatalog;
-                  row["CONSTRAINT_NAME"] = String.Format(CultureInfo.InvariantCulture, "FK_{0}_{1}_{2}", rdTables[2], rdKey.GetInt32(0), rdKey.GetInt32(1));
+                  row["CONSTRAINT_NAME"] = String.Format(CultureInfo.InvariantCulture, "FK_{0}_{1}_{2}", rdTables[2], foreignKey.Id, foreignKey.Sequence);
                   row["TABLE_CATALOG"] = strCatalog;
                   row["TABLE_NAME"] = builder.UnquoteIdentifier(rdTables.GetString(2));
                   row["CONSTRAINT_TYPE"] = "FOREIGN KEY";
                   row["IS_DEFERRABLE"] = false;
                   row["INITIALLY_DEFERRED"] = false;
-                  row["FKEY_ID"] = rdKey[0];
-                  row["FKEY_FROM_COLUMN"] = builder.UnquoteIdentifier(rdKey[3].ToString());
+                  row["FKEY_ID"] = foreignKey.Id;
+                  row["FKEY_FROM_COLUMN"] = builder.UnquoteIdentifier(foreignKey.From ?? String.Empty);
                   row["FKEY_TO_CATALOG"] = strCatalog;
-                  row["FKEY_TO_TABLE"] = builder.UnquoteIdentifier(rdKey[2].ToString());
-                  row["FKEY_TO_COLUMN"] = builder.UnquoteIdentifier(rdKey[4].ToString());
-                  row["FKEY_FROM_ORDINAL_POSITION"] = rdKey[1];
-                  row["FKEY_ON_UPDATE"] = (rdKey.FieldCount > 5) ? rdKey[5] : String.Empty;
-                  row["FKEY_ON_DELETE"] = (rdKey.FieldCount > 6) ? rdKey[6] : String.Empty;
-                  row["FKEY_MATCH"] = (rdKey.FieldCount > 7) ? rdKey[7] : String.Empty;
+                  row["FKEY_TO_TABLE"] = builder.UnquoteIdentifier(foreignKey.Table ?? String.Empty);
+                  row["FKEY_TO_COLUMN"] = builder.UnquoteIdentifier(foreignKey.To ?? String.Empty);
+                  row["FKEY_FROM_ORDINAL_POSITION"] = foreignKey.Sequence;
+                  row["FKEY_ON_UPDATE"] = foreignKey.OnUpdate;
+                  row["FKEY_ON_DELETE"] = foreignKey.OnDelete;
+                  row["FKEY_MATCH"] = foreignKey.Match;
 
                   if (String.IsNullOrEmpty(strKeyName) || String.Compare(strKeyName, row["CONSTRAINT_NAME"].ToString(), StringComparison.OrdinalIgnoreCase) == 0)
                     tbl.Rows.Add(row);
@@ -4935,6 +5337,43 @@ namespace System.Data.SQLite
 
   ///////////////////////////////////////////////////////////////////////////////////////////////
 
+#if INTEROP_CODEC
+  #region Rekey API Members
+  /// <summary>
+  /// Raised between each step of an incremental password change.
+  /// </summary>
+  /// <param name="connection">
+  /// The connection whose password is being changed.
+  /// </param>
+  /// <param name="pages">
+  /// The number of pages re-encrypted with each step.
+  /// </param>
+  /// <param name="remainingPages">
+  /// The number of pages remaining to be re-encrypted.
+  /// </param>
+  /// <param name="totalPages">
+  /// The total number of pages in the database.
+  /// </param>
+  /// <param name="retry">
+  /// Set to true if the operation needs to be retried due to database
+  /// locking issues; otherwise, set to false.
+  /// </param>
+  /// <returns>
+  /// True to continue with the password change or false to halt it.  Pages
+  /// that have already been re-encrypted keep the new password.
+  /// </returns>
+  public delegate bool SQLiteRekeyCallback(
+    SQLiteConnection connection,
+    int pages,
+    int remainingPages,
+    int totalPages,
+    bool retry
+  );
+  #endregion
+#endif
+
+  ///////////////////////////////////////////////////////////////////////////////////////////////
+
   /// <summary>
   /// The data associated with a call into the authorizer.
   /// </summary>
@@ -1719,6 +1719,27 @@ namespace System.Data.SQLite
         });
     }
 
+    /// <summary>
+    /// Quotes an identifier (e.g. a database or table name) using square
+    /// brackets, doubling any closing brackets it contains, so that it can
+    /// be safely embedded in SQL.
+    /// </summary>
+    /// <param name="identifier">
+    /// The identifier to quote.
+    /// </param>
+    /// <returns>
+    /// The quoted identifier.
+    /// </returns>
+    internal static string QuoteIdentifier(
+        string identifier
+        )
+    {
+        if (identifier == null)
+            return null;
+
+        return "[" + identifier.Replace("]", "]]") + "]";
+    }
+
     /// <summary>
     /// Determines if a database type is considered to be a string.
     /// </summary>
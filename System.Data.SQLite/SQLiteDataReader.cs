@@ -14,6 +14,11 @@ namespace System.Data.SQLite
   using System.Data.Common;
   using System.Globalization;
 
+#if NET_45 || NET_451
+  using System.Threading;
+  using System.Threading.Tasks;
+#endif
+
   /// <summary>
   /// SQLite implementation of DbDataReader.
   /// </summary>
@@ -874,7 +879,8 @@ namespace System.Data.SQLite
         SQLiteStatement stmt,
         int fieldCount,
         ref Dictionary<ColumnParent, List<int>> parentToColumns,
-        ref Dictionary<int, ColumnParent> columnToParent
+        ref Dictionary<int, ColumnParent> columnToParent,
+        ref SQLiteSchemaCache.ColumnMetaData[] columnMetaData
         )
     {
         if (parentToColumns == null)
@@ -884,11 +890,39 @@ namespace System.Data.SQLite
         if (columnToParent == null)
             columnToParent = new Dictionary<int, ColumnParent>();
 
+        //
+        // NOTE: When possible, fetch the origin and metadata of all the
+        //       columns using one native call, which resolves them via the
+        //       native metadata cache of the connection.
+        //
+        string[] databaseNames = new string[fieldCount];
+        string[] tableNames = new string[fieldCount];
+        string[] columnNames = new string[fieldCount];
+        SQLiteSchemaCache.ColumnMetaData[] metaData =
+            new SQLiteSchemaCache.ColumnMetaData[fieldCount];
+
+        if (sql.StatementColumnMetaData(
+                stmt, databaseNames, tableNames, columnNames, metaData))
+        {
+            columnMetaData = metaData;
+        }
+        else
+        {
+            columnMetaData = null;
+
+            for (int n = 0; n < fieldCount; n++)
+            {
+                databaseNames[n] = sql.ColumnDatabaseName(stmt, n);
+                tableNames[n] = sql.ColumnTableName(stmt, n);
+                columnNames[n] = sql.ColumnOriginalName(stmt, n);
+            }
+        }
+
         for (int n = 0; n < fieldCount; n++)
         {
-            string databaseName = sql.ColumnDatabaseName(stmt, n);
-            string tableName = sql.ColumnTableName(stmt, n);
-            string columnName = sql.ColumnOriginalName(stmt, n);
+            string databaseName = databaseNames[n];
+            string tableName = tableNames[n];
+            string columnName = columnNames[n];
 
             ColumnParent key = new ColumnParent(databaseName, tableName, null);
             ColumnParent value = new ColumnParent(databaseName, tableName, columnName);
@@ -902,6 +936,192 @@ namespace System.Data.SQLite
         }
     }
 
+    ///////////////////////////////////////////////////////////////////////////
+
+    #region Schema Metadata Helpers
+    /// <summary>
+    /// Returns the schema metadata cache to use for one call to
+    /// <see cref="GetSchemaTable(bool, bool)" />.  Unless disabled by the
+    /// <see cref="SQLiteConnectionFlags.NoSchemaCache" /> flag, this is the
+    /// cache of the connection, after discarding the metadata of any database
+    /// referenced by the statement whose schema has changed; otherwise, it is
+    /// a new cache used only for this call.
+    /// </summary>
+    private static SQLiteSchemaCache GetSchemaCache(
+        SQLiteConnection connection,
+        Dictionary<ColumnParent, List<int>> parentToColumns
+        )
+    {
+        SQLiteSchemaCache cache = connection._schemaCache;
+
+        if ((cache == null) || ((connection.Flags &
+                SQLiteConnectionFlags.NoSchemaCache) == SQLiteConnectionFlags.NoSchemaCache))
+        {
+            return new SQLiteSchemaCache();
+        }
+
+        List<string> databaseNames = new List<string>();
+
+        foreach (ColumnParent parent in parentToColumns.Keys)
+        {
+            if (String.IsNullOrEmpty(parent.DatabaseName) ||
+                String.IsNullOrEmpty(parent.TableName))
+            {
+                continue;
+            }
+
+            bool found = false;
+
+            foreach (string databaseName in databaseNames)
+            {
+                if (String.Equals(databaseName, parent.DatabaseName,
+                        StringComparison.OrdinalIgnoreCase))
+                {
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+                databaseNames.Add(parent.DatabaseName);
+        }
+
+        cache.Validate(connection, databaseNames);
+        return cache;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+
+    /// <summary>
+    /// Returns the metadata for a table-bound column, querying the database
+    /// only when it is not already cached or was not fetched along with the
+    /// other columns of the statement.
+    /// </summary>
+    private static SQLiteSchemaCache.ColumnMetaData GetColumnMetaData(
+        SQLiteConnection connection,
+        SQLiteSchemaCache cache,
+        SQLiteSchemaCache.ColumnMetaData[] columnMetaData,
+        int index,
+        string databaseName,
+        string tableName,
+        string columnName
+        )
+    {
+        SQLiteSchemaCache.ColumnMetaData metaData;
+
+        if (cache.TryGetColumn(databaseName, tableName, columnName, out metaData))
+            return metaData;
+
+        if ((columnMetaData != null) && (columnMetaData[index] != null))
+        {
+            metaData = columnMetaData[index];
+            cache.SetColumn(databaseName, tableName, columnName, metaData);
+            return metaData;
+        }
+
+        metaData = new SQLiteSchemaCache.ColumnMetaData();
+
+        connection._sql.ColumnMetaData(
+            databaseName, tableName, columnName, ref metaData.DataType,
+            ref metaData.CollationSequence, ref metaData.NotNull,
+            ref metaData.PrimaryKey, ref metaData.AutoIncrement);
+
+        cache.SetColumn(databaseName, tableName, columnName, metaData);
+        return metaData;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+
+    /// <summary>
+    /// Returns the default values of all the columns of a table that have
+    /// one, keyed by column name, querying the database only when they are
+    /// not already cached.
+    /// </summary>
+    private static Dictionary<string, object> GetTableDefaultValues(
+        SQLiteConnection connection,
+        SQLiteSchemaCache cache,
+        string databaseName,
+        string tableName
+        )
+    {
+        SQLiteSchemaCache.TableMetaData metaData = cache.GetTable(
+            databaseName, tableName);
+
+        if (metaData.DefaultValues != null)
+            return metaData.DefaultValues;
+
+        Dictionary<string, object> defaultValues = new Dictionary<string, object>(
+            StringComparer.OrdinalIgnoreCase);
+
+        using (SQLiteCommand cmdTable = new SQLiteCommand(String.Format(
+                CultureInfo.InvariantCulture, "PRAGMA [{0}].TABLE_INFO([{1}])",
+                databaseName, tableName), connection))
+        using (DbDataReader rdTable = cmdTable.ExecuteReader())
+        {
+            while (rdTable.Read())
+            {
+                string columnName = rdTable.GetString(1);
+
+                if (!rdTable.IsDBNull(4) && !defaultValues.ContainsKey(columnName))
+                    defaultValues.Add(columnName, rdTable[4]);
+            }
+        }
+
+        metaData.DefaultValues = defaultValues;
+        return defaultValues;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+
+    /// <summary>
+    /// Returns the indexes of a table, along with their column names,
+    /// querying the database only when they are not already cached.
+    /// </summary>
+    private static List<SQLiteSchemaCache.IndexMetaData> GetTableIndexes(
+        SQLiteConnection connection,
+        SQLiteSchemaCache cache,
+        string databaseName,
+        string tableName
+        )
+    {
+        SQLiteSchemaCache.TableMetaData metaData = cache.GetTable(
+            databaseName, tableName);
+
+        if (metaData.Indexes != null)
+            return metaData.Indexes;
+
+        List<SQLiteSchemaCache.IndexMetaData> indexes =
+            new List<SQLiteSchemaCache.IndexMetaData>();
+
+        DataTable tblIndexes = connection.GetSchema("Indexes", new string[] {
+            databaseName, null, tableName, null });
+
+        foreach (DataRow rowIndexes in tblIndexes.Rows)
+        {
+            SQLiteSchemaCache.IndexMetaData index =
+                new SQLiteSchemaCache.IndexMetaData();
+
+            index.Unique = rowIndexes["UNIQUE"];
+            index.PrimaryKey = (bool)rowIndexes["PRIMARY_KEY"];
+            index.ColumnNames = new List<string>();
+
+            DataTable tblIndexColumns = connection.GetSchema("IndexColumns",
+                new string[] { databaseName, null, tableName,
+                (string)rowIndexes["INDEX_NAME"], null });
+
+            foreach (DataRow rowColumnIndex in tblIndexColumns.Rows)
+                index.ColumnNames.Add((string)rowColumnIndex["COLUMN_NAME"]);
+
+            indexes.Add(index);
+        }
+
+        metaData.Indexes = indexes;
+        return indexes;
+    }
+    #endregion
+
+    ///////////////////////////////////////////////////////////////////////////
+
     internal DataTable GetSchemaTable(bool wantUniqueInfo, bool wantDefaultValue)
     {
       CheckClosed();
@@ -921,18 +1141,17 @@ namespace System.Data.SQLite
       //
       Dictionary<ColumnParent, List<int>> parentToColumns = null;
       Dictionary<int, ColumnParent> columnToParent = null;
+      SQLiteSchemaCache.ColumnMetaData[] columnMetaData = null;
 
       GetStatementColumnParents(
           _command.Connection._sql, _activeStatement, _fieldCount,
-          ref parentToColumns, ref columnToParent);
+          ref parentToColumns, ref columnToParent, ref columnMetaData);
+
+      SQLiteSchemaCache cache = GetSchemaCache(_command.Connection, parentToColumns);
 
       DataTable tbl = new DataTable("SchemaTable");
-      DataTable tblIndexes = null;
-      DataTable tblIndexColumns;
       DataRow row;
       string temp;
-      string strCatalog = "";
-      string strTable = "";
       string strColumn = "";
 
       tbl.Locale = CultureInfo.InvariantCulture;
@@ -1006,6 +1225,8 @@ namespace System.Data.SQLite
         // If we have a table-bound column, extract the extra information from it
         if (String.IsNullOrEmpty(strColumn) == false)
         {
+          string strCatalog = (string)row[SchemaTableOptionalColumn.BaseCatalogName];
+          string strTable = (string)row[SchemaTableColumn.BaseTableName];
           string collSeq = null;
           bool bNotNull = false;
           bool bPrimaryKey = false;
@@ -1013,11 +1234,14 @@ namespace System.Data.SQLite
           string[] arSize;
 
           // Get the column meta data
-          _command.Connection._sql.ColumnMetaData(
-            (string)row[SchemaTableOptionalColumn.BaseCatalogName],
-            (string)row[SchemaTableColumn.BaseTableName],
-            strColumn,
-            ref dataType, ref collSeq, ref bNotNull, ref bPrimaryKey, ref bAutoIncrement);
+          SQLiteSchemaCache.ColumnMetaData metaData = GetColumnMetaData(
+            _command.Connection, cache, columnMetaData, n, strCatalog, strTable, strColumn);
+
+          dataType = metaData.DataType;
+          collSeq = metaData.CollationSequence;
+          bNotNull = metaData.NotNull;
+          bPrimaryKey = metaData.PrimaryKey;
+          bAutoIncrement = metaData.AutoIncrement;
 
           if (bNotNull || bPrimaryKey) row[SchemaTableColumn.AllowDBNull] = false;
 
@@ -1049,55 +1273,21 @@ namespace System.Data.SQLite
 
           if (wantDefaultValue)
           {
-            // Determine the default value for the column, which sucks because we have to query the schema for each column
-            using (SQLiteCommand cmdTable = new SQLiteCommand(String.Format(CultureInfo.InvariantCulture, "PRAGMA [{0}].TABLE_INFO([{1}])",
-              row[SchemaTableOptionalColumn.BaseCatalogName],
-              row[SchemaTableColumn.BaseTableName]
-              ), _command.Connection))
-            using (DbDataReader rdTable = cmdTable.ExecuteReader())
-            {
-              // Find the matching column
-              while (rdTable.Read())
-              {
-                if (String.Compare((string)row[SchemaTableColumn.BaseColumnName], rdTable.GetString(1), StringComparison.OrdinalIgnoreCase) == 0)
-                {
-                  if (rdTable.IsDBNull(4) == false)
-                    row[SchemaTableOptionalColumn.DefaultValue] = rdTable[4];
+            // Determine the default value for the column, using the column information of the whole table
+            object defaultValue;
 
-                  break;
-                }
-              }
-            }
+            if (GetTableDefaultValues(_command.Connection, cache, strCatalog, strTable).TryGetValue(strColumn, out defaultValue))
+              row[SchemaTableOptionalColumn.DefaultValue] = defaultValue;
           }
 
           // Determine IsUnique properly, which is a pain in the butt!
           if (wantUniqueInfo)
           {
-            if ((string)row[SchemaTableOptionalColumn.BaseCatalogName] != strCatalog
-              || (string)row[SchemaTableColumn.BaseTableName] != strTable)
-            {
-              strCatalog = (string)row[SchemaTableOptionalColumn.BaseCatalogName];
-              strTable = (string)row[SchemaTableColumn.BaseTableName];
-
-              tblIndexes = _command.Connection.GetSchema("Indexes", new string[] {
-                (string)row[SchemaTableOptionalColumn.BaseCatalogName],
-                null,
-                (string)row[SchemaTableColumn.BaseTableName],
-                null });
-            }
-
-            foreach (DataRow rowIndexes in tblIndexes.Rows)
+            foreach (SQLiteSchemaCache.IndexMetaData index in GetTableIndexes(_command.Connection, cache, strCatalog, strTable))
             {
-              tblIndexColumns = _command.Connection.GetSchema("IndexColumns", new string[] {
-                (string)row[SchemaTableOptionalColumn.BaseCatalogName],
-                null,
-                (string)row[SchemaTableColumn.BaseTableName],
-                (string)rowIndexes["INDEX_NAME"],
-                null
-                });
-              foreach (DataRow rowColumnIndex in tblIndexColumns.Rows)
+              foreach (string indexColumnName in index.ColumnNames)
               {
-                if (String.Compare((string)rowColumnIndex["COLUMN_NAME"], strColumn, StringComparison.OrdinalIgnoreCase) == 0)
+                if (String.Compare(indexColumnName, strColumn, StringComparison.OrdinalIgnoreCase) == 0)
                 {
                   //
                   // BUGFIX: Make sure that we only flag this column as "unique"
@@ -1105,15 +1295,15 @@ namespace System.Data.SQLite
                   //         construct (i.e. a join) because in that case we must
                   //         allow duplicate values (refer to ticket [7e3fa93744]).
                   //
-                  if (parentToColumns.Count == 1 && tblIndexColumns.Rows.Count == 1 && (bool)row[SchemaTableColumn.AllowDBNull] == false)
-                    row[SchemaTableColumn.IsUnique] = rowIndexes["UNIQUE"];
+                  if (parentToColumns.Count == 1 && index.ColumnNames.Count == 1 && (bool)row[SchemaTableColumn.AllowDBNull] == false)
+                    row[SchemaTableColumn.IsUnique] = index.Unique;
 
                   // If its an integer primary key and the only primary key in the table, then its a rowid alias and is autoincrement
                   // NOTE:  Currently commented out because this is not always the desired behavior.  For example, a 1:1 relationship with
                   //        another table, where the other table is autoincrement, but this one is not, and uses the rowid from the other.
                   //        It is safer to only set Autoincrement on tables where we're SURE the user specified AUTOINCREMENT, even if its a rowid column.
 
-                  if (tblIndexColumns.Rows.Count == 1 && (bool)rowIndexes["PRIMARY_KEY"] == true && String.IsNullOrEmpty(dataType) == false &&
+                  if (index.ColumnNames.Count == 1 && index.PrimaryKey && String.IsNullOrEmpty(dataType) == false &&
                     String.Compare(dataType, "integer", StringComparison.OrdinalIgnoreCase) == 0)
                   {
                     //  row[SchemaTableOptionalColumn.IsAutoIncrement] = true;
@@ -1543,6 +1733,49 @@ namespace System.Data.SQLite
       return false;
     }
 
+#if NET_45 || NET_451
+    /// <summary>
+    /// Reads the next row from the resultset on the dedicated threads for the associated
+    /// database file.  Each call steps the statement exactly once, so the native side never
+    /// runs ahead of the consumer.  Signaling the cancellation token interrupts the step via
+    /// the native sqlite3_interrupt() API.
+    /// </summary>
+    /// <param name="cancellationToken">The token used to cancel the operation.</param>
+    /// <returns>A task producing true if a new row was successfully loaded and is ready for processing</returns>
+    public override Task<bool> ReadAsync(CancellationToken cancellationToken)
+    {
+      CheckDisposed();
+      CheckClosed();
+
+      //
+      // NOTE: When the first row was already stepped by NextResult(), or there
+      //       are no more rows, there is no native work to do.
+      //
+      if (_readingState != 0 || (_commandBehavior & CommandBehavior.SingleRow) != 0)
+      {
+        if (cancellationToken.IsCancellationRequested)
+          return base.ReadAsync(cancellationToken);
+
+        return Task.FromResult(Read());
+      }
+
+      return SQLiteTaskScheduler.Run<bool>(GetConnection(this), Read, cancellationToken);
+    }
+
+    /// <summary>
+    /// Moves to the next resultset on the dedicated threads for the associated database file.
+    /// </summary>
+    /// <param name="cancellationToken">The token used to cancel the operation.</param>
+    /// <returns>A task producing true if a new resultset is available, false otherwise.</returns>
+    public override Task<bool> NextResultAsync(CancellationToken cancellationToken)
+    {
+      CheckDisposed();
+      CheckClosed();
+
+      return SQLiteTaskScheduler.Run<bool>(GetConnection(this), NextResult, cancellationToken);
+    }
+#endif
+
     /// <summary>
     /// Retrieve the count of records affected by an update/insert command.  Only valid once the data reader is closed!
     /// </summary>
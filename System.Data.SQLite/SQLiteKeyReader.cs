@@ -25,6 +25,17 @@ namespace System.Data.SQLite
     private SQLiteStatement _stmt;
     private bool _isValid;
 
+    /// <summary>
+    /// The distinct table cursors used by the key columns, whose rowids are fetched together
+    /// for each row.
+    /// </summary>
+    private int[] _cursors;
+
+    /// <summary>
+    /// The rowids of the current row for each of the table cursors.
+    /// </summary>
+    private long[] _rowids;
+
     /// <summary>
     /// Used to support CommandBehavior.KeyInfo
     /// </summary>
@@ -38,6 +49,7 @@ namespace System.Data.SQLite
       internal int cursor;
       internal KeyQuery query;
       internal int column;
+      internal int slot;
     }
 
     /// <summary>
@@ -47,6 +59,7 @@ namespace System.Data.SQLite
     {
         private SQLiteCommand _command;
         internal SQLiteDataReader _reader;
+        private long _rowid;
 
         internal KeyQuery(SQLiteConnection cnn, string database, string table, params string[] columns)
         {
@@ -77,7 +90,16 @@ namespace System.Data.SQLite
 
         internal void Sync(long rowid)
         {
+            //
+            // NOTE: Consecutive rows often share the same row of this table
+            //       (e.g. the parent side of a join), there is no need to
+            //       query it again in that case.
+            //
+            if ((_reader != null) && (rowid != 0) && (rowid == _rowid))
+                return;
+
             IsValid = false;
+            _rowid = rowid;
             _command.Parameters[0].Value = rowid;
             _reader = _command.ExecuteReader();
             _reader.Read();
@@ -307,6 +329,29 @@ namespace System.Data.SQLite
       // CommandBehavior.KeyInfo
       _keyInfo = new KeyInfo[keys.Count];
       keys.CopyTo(_keyInfo);
+
+      // Collect the distinct table cursors, so the rowids of all of them can be fetched using
+      // a single call for each row
+      List<int> cursors = new List<int>();
+
+      for (int n = 0; n < _keyInfo.Length; n++)
+      {
+        _keyInfo[n].slot = -1;
+
+        if (_keyInfo[n].cursor == -1)
+          continue;
+
+        _keyInfo[n].slot = cursors.IndexOf(_keyInfo[n].cursor);
+
+        if (_keyInfo[n].slot == -1)
+        {
+          _keyInfo[n].slot = cursors.Count;
+          cursors.Add(_keyInfo[n].cursor);
+        }
+      }
+
+      _cursors = cursors.ToArray();
+      _rowids = new long[_cursors.Length];
     }
 
     ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -385,63 +430,74 @@ namespace System.Data.SQLite
       get { return (_keyInfo == null) ? 0 : _keyInfo.Length; }
     }
 
+    /// <summary>
+    /// Make sure the subquery for the given key column, if any, is open and ready and sync'd
+    /// with the current rowid of the table it's supporting.  Only the subqueries of the key
+    /// columns actually read are executed.
+    /// </summary>
+    /// <param name="i">The index of the key column</param>
     internal void Sync(int i)
     {
       Sync();
       if (_keyInfo[i].cursor == -1)
         throw new InvalidCastException();
+
+      SyncQuery(i);
+    }
+
+    /// <summary>
+    /// Make sure the subquery for the given key column, if any, is sync'd with the current
+    /// rowid of the table it's supporting
+    /// </summary>
+    /// <param name="i">The index of the key column</param>
+    private void SyncQuery(int i)
+    {
+      if (_keyInfo[i].query != null)
+        _keyInfo[i].query.Sync(GetRowId(i));
     }
 
     /// <summary>
-    /// Make sure all the subqueries are open and ready and sync'd with the current rowid
-    /// of the table they're supporting
+    /// Make sure the rowids of all the tables are sync'd with the current row, fetching them
+    /// using a single call
     /// </summary>
     internal void Sync()
     {
       if (_isValid == true) return;
 
-      KeyQuery last = null;
-
-      for (int n = 0; n < _keyInfo.Length; n++)
-      {
-        if (_keyInfo[n].query == null || _keyInfo[n].query != last)
-        {
-          last = _keyInfo[n].query;
-
-          if (last != null)
-          {
-            last.Sync(_stmt._sql.GetRowIdForCursor(_stmt, _keyInfo[n].cursor));
-          }
-        }
-      }
+      _stmt._sql.GetRowIdsForCursors(_stmt, _cursors, _rowids);
       _isValid = true;
     }
 
     /// <summary>
-    /// Release any readers on any subqueries
+    /// Invalidate the rowids fetched for the previous row.  The readers on the subqueries are
+    /// kept, so that they can be reused if the next row refers to the same rows.
     /// </summary>
     internal void Reset()
     {
       _isValid = false;
-      if (_keyInfo == null) return;
+    }
 
-      for (int n = 0; n < _keyInfo.Length; n++)
-      {
-        if (_keyInfo[n].query != null)
-          _keyInfo[n].query.IsValid = false;
-      }
+    /// <summary>
+    /// Returns the rowid of the current row of the table of the given key column
+    /// </summary>
+    /// <param name="i">The index of the key column</param>
+    /// <returns>The rowid or zero if the table has no current row</returns>
+    private long GetRowId(int i)
+    {
+      Sync();
+      return (_keyInfo[i].slot != -1) ? _rowids[_keyInfo[i].slot] : 0;
     }
 
     internal string GetDataTypeName(int i)
     {
-      Sync();
+      SyncQuery(i);
       if (_keyInfo[i].query != null) return _keyInfo[i].query._reader.GetDataTypeName(_keyInfo[i].column);
       else return "integer";
     }
 
     internal Type GetFieldType(int i)
     {
-      Sync();
+      SyncQuery(i);
       if (_keyInfo[i].query != null) return _keyInfo[i].query._reader.GetFieldType(_keyInfo[i].column);
       else return typeof(Int64);
     }
@@ -536,7 +592,7 @@ namespace System.Data.SQLite
       if (_keyInfo[i].query != null) return _keyInfo[i].query._reader.GetInt16(_keyInfo[i].column);
       else
       {
-        long rowid = _stmt._sql.GetRowIdForCursor(_stmt, _keyInfo[i].cursor);
+        long rowid = GetRowId(i);
         if (rowid == 0) throw new InvalidCastException();
         return Convert.ToInt16(rowid);
       }
@@ -548,7 +604,7 @@ namespace System.Data.SQLite
       if (_keyInfo[i].query != null) return _keyInfo[i].query._reader.GetInt32(_keyInfo[i].column);
       else
       {
-        long rowid = _stmt._sql.GetRowIdForCursor(_stmt, _keyInfo[i].cursor);
+        long rowid = GetRowId(i);
         if (rowid == 0) throw new InvalidCastException();
         return Convert.ToInt32(rowid);
       }
@@ -560,7 +616,7 @@ namespace System.Data.SQLite
       if (_keyInfo[i].query != null) return _keyInfo[i].query._reader.GetInt64(_keyInfo[i].column);
       else
       {
-        long rowid = _stmt._sql.GetRowIdForCursor(_stmt, _keyInfo[i].cursor);
+        long rowid = GetRowId(i);
         if (rowid == 0) throw new InvalidCastException();
         return Convert.ToInt64(rowid);
       }
@@ -591,7 +647,7 @@ namespace System.Data.SQLite
 
       Sync(i);
       if (_keyInfo[i].query != null) return _keyInfo[i].query._reader.IsDBNull(_keyInfo[i].column);
-      else return _stmt._sql.GetRowIdForCursor(_stmt, _keyInfo[i].cursor) == 0;
+      else return GetRowId(i) == 0;
     }
 
     /// <summary>
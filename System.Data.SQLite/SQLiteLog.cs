@@ -12,6 +12,11 @@ namespace System.Data.SQLite
     using System.Diagnostics;
     using System.Globalization;
 
+#if INTEROP_LOG
+    using System.Text;
+    using System.Threading;
+#endif
+
     /// <summary>
     /// Event data for logging event handlers.
     /// </summary>
@@ -69,7 +74,10 @@ namespace System.Data.SQLite
 
     /// <summary>
     /// Manages the SQLite custom logging functionality and the associated
-    /// callback for the whole process.
+    /// callback for the whole process.  When the interop assembly is built
+    /// with INTEROP_LOG, the native log callback queues its messages in a
+    /// ring buffer instead and a background drainer thread delivers them to
+    /// the registered log event handlers.
     /// </summary>
     public static class SQLiteLog
     {
@@ -121,6 +129,55 @@ namespace System.Data.SQLite
 
         ///////////////////////////////////////////////////////////////////////
 
+#if INTEROP_LOG
+        /// <summary>
+        /// The maximum number of queued native log messages read at once.
+        /// </summary>
+        private const int DrainBatchSize = 64;
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The size, in bytes, of the buffer used for each queued native log
+        /// message.
+        /// </summary>
+        private const int DrainMessageSize = 256;
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The number of milliseconds the drainer thread waits between reads
+        /// of the queued native log messages.
+        /// </summary>
+        private const int DrainInterval = 100;
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Object used to make sure that only one thread at a time reads the
+        /// queued native log messages.
+        /// </summary>
+        private static object drainSyncRoot = new object();
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The thread that periodically delivers the queued native log
+        /// messages to the registered log event handlers.
+        /// </summary>
+        private static Thread _drainThread;
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// This event is signaled to make the drainer thread exit.  The
+        /// drainer thread owns the event and closes it when it exits.
+        /// </summary>
+        private static ManualResetEvent _drainStop;
+#endif
+
+        ///////////////////////////////////////////////////////////////////////
+
         /// <summary>
         /// This will be non-zero if logging is currently enabled.
         /// </summary>
@@ -205,6 +262,30 @@ namespace System.Data.SQLite
                         throw new SQLiteException(rc,
                             "Failed to initialize logging.");
                 }
+#else
+                //
+                // NOTE: The native library queues its log messages in a ring
+                //       buffer instead of delivering them as they occur.
+                //       Start the thread that drains the ring buffer into the
+                //       registered log event handlers.  The stop event is
+                //       handed to the thread directly, because this class may
+                //       forget about it before the thread starts running.
+                //
+                if (_drainThread == null)
+                {
+                    ManualResetEvent drainStop = new ManualResetEvent(false);
+
+                    _drainStop = drainStop;
+                    _drainThread = new Thread(delegate()
+                    {
+                        DrainThreadStart(drainStop);
+                    });
+                    _drainThread.IsBackground = true;
+#if !PLATFORM_COMPACTFRAMEWORK
+                    _drainThread.Name = "SQLiteLog";
+#endif
+                    _drainThread.Start();
+                }
 #endif
 
                 //
@@ -277,6 +358,20 @@ namespace System.Data.SQLite
                 {
                     _callback = null;
                 }
+#else
+                //
+                // NOTE: Tell the drainer thread to exit.  It cannot be joined
+                //       here because it may be waiting for this lock.  The
+                //       thread closes the stop event itself once it exits.
+                //       Any messages still queued in the native ring buffer
+                //       will be delivered if logging is initialized again.
+                //
+                if (_drainThread != null)
+                {
+                    _drainStop.Set();
+                    _drainStop = null;
+                    _drainThread = null;
+                }
 #endif
 
                 //
@@ -396,6 +491,27 @@ namespace System.Data.SQLite
             object errorCode,
             string message
             )
+        {
+            LogMessage(errorCode, message, null);
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Log a message to all the registered log event handlers without going
+        /// through the SQLite library.
+        /// </summary>
+        /// <param name="errorCode">
+        /// The error code.  The type of this object value should be
+        /// System.Int32 or SQLiteErrorCode.
+        /// </param>
+        /// <param name="message">The message to be logged.</param>
+        /// <param name="data">The extra data, if any.</param>
+        private static void LogMessage(
+            object errorCode,
+            string message,
+            object data
+            )
         {
             bool enabled;
             SQLiteLogEventHandler handlers;
@@ -412,9 +528,151 @@ namespace System.Data.SQLite
 
             if (enabled && (handlers != null))
                 handlers(null, new LogEventArgs(
-                    IntPtr.Zero, errorCode, message, null));
+                    IntPtr.Zero, errorCode, message, data));
         }
 
+#if INTEROP_LOG
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the number of native log messages that have been dropped,
+        /// either because the queue was full or because the limit for their
+        /// result code was exceeded.
+        /// </summary>
+        public static int DroppedCount
+        {
+            get { return UnsafeNativeMethods.sqlite3_log_dropped_interop(); }
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Sets the maximum number of native log messages per second that are
+        /// queued for the specified result code.  The filtering is done by the
+        /// native library, before the messages reach managed code.
+        /// </summary>
+        /// <param name="errorCode">
+        /// The result code.  Extended result codes share the limit of their
+        /// primary result code.
+        /// </param>
+        /// <param name="maximumPerSecond">
+        /// The maximum number of messages per second.  Zero means there is no
+        /// limit and a negative value means all messages are discarded.
+        /// </param>
+        public static void SetLimit(
+            SQLiteErrorCode errorCode,
+            int maximumPerSecond
+            )
+        {
+            SQLiteErrorCode rc = UnsafeNativeMethods.sqlite3_log_filter_interop(
+                (int)(errorCode & SQLiteErrorCode.NonExtendedMask),
+                maximumPerSecond);
+
+            if (rc != SQLiteErrorCode.Ok)
+                throw new SQLiteException(rc, "Failed to set logging limit.");
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Removes the limits on the native log messages for all result codes.
+        /// </summary>
+        public static void ResetLimits()
+        {
+            SQLiteErrorCode rc = UnsafeNativeMethods.sqlite3_log_filter_interop(
+                -1, 0);
+
+            if (rc != SQLiteErrorCode.Ok)
+                throw new SQLiteException(rc, "Failed to reset logging limits.");
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Delivers the native log messages queued so far to the registered log
+        /// event handlers.  This is normally done periodically by a background
+        /// thread; calling this method is only necessary to flush the queue
+        /// right away.  The extra data for each message is the UTC time, as a
+        /// <see cref="DateTime" />, when it was queued.
+        /// </summary>
+        /// <returns>
+        /// The number of messages delivered.
+        /// </returns>
+        public static int Drain()
+        {
+            lock (drainSyncRoot)
+            {
+                int[] codes = new int[DrainBatchSize];
+                long[] times = new long[DrainBatchSize];
+                byte[] messages = new byte[DrainBatchSize * DrainMessageSize];
+                int total = 0;
+
+                while (true)
+                {
+                    int count = UnsafeNativeMethods.sqlite3_log_read_interop(
+                        DrainBatchSize, codes, times, messages,
+                        DrainMessageSize);
+
+                    for (int index = 0; index < count; index++)
+                    {
+                        int offset = index * DrainMessageSize;
+                        int length = Array.IndexOf(
+                            messages, (byte)0, offset, DrainMessageSize);
+
+                        length = (length >= 0) ?
+                            length - offset : DrainMessageSize;
+
+                        LogMessage(codes[index], Encoding.UTF8.GetString(
+                            messages, offset, length),
+                            DateTime.FromFileTimeUtc(times[index]));
+                    }
+
+                    total += count;
+
+                    if (count < DrainBatchSize)
+                        break;
+                }
+
+                return total;
+            }
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The entry point for the thread that delivers the queued native log
+        /// messages.
+        /// </summary>
+        /// <param name="drainStop">
+        /// The event that is signaled to make this thread exit.  It is closed
+        /// by this method before returning.
+        /// </param>
+        private static void DrainThreadStart(
+            ManualResetEvent drainStop
+            )
+        {
+            try
+            {
+                do
+                {
+                    try
+                    {
+                        Drain();
+                    }
+                    catch (Exception)
+                    {
+                        // do nothing.
+                    }
+                }
+                while (!drainStop.WaitOne(DrainInterval, false));
+            }
+            finally
+            {
+                drainStop.Close();
+            }
+        }
+#endif
+
         ///////////////////////////////////////////////////////////////////////
 
         /// <summary>
@@ -5535,6 +5535,14 @@ namespace System.Data.SQLite
 
         ///////////////////////////////////////////////////////////////////////
 
+        /// <summary>
+        /// This field is used to store the value of the
+        /// <see cref="MeasureChildTime" /> property.
+        /// </summary>
+        private bool measureChildTime;
+
+        ///////////////////////////////////////////////////////////////////////
+
 #if PLATFORM_COMPACTFRAMEWORK
         /// <summary>
         /// This field is used to hold the block of native memory that contains
@@ -5632,6 +5640,7 @@ namespace System.Data.SQLite
                     UnsafeNativeMethods.sqlite3_create_disposable_module(
                         pDb, pName, ref nativeModule, IntPtr.Zero, destroyModule);
 
+                SetChildTiming();
                 return (disposableModule != IntPtr.Zero);
 #elif !SQLITE_STANDARD
                 disposableModule =
@@ -5650,6 +5659,7 @@ namespace System.Data.SQLite
                        nativeModule.xSavepoint, nativeModule.xRelease,
                        nativeModule.xRollbackTo, IntPtr.Zero, destroyModule);
 
+                SetChildTiming();
                 return (disposableModule != IntPtr.Zero);
 #else
                 throw new NotImplementedException();
@@ -5669,6 +5679,24 @@ namespace System.Data.SQLite
         ///////////////////////////////////////////////////////////////////////
 
         #region Private Methods
+        /// <summary>
+        /// Enables or disables the timing of the cursor methods of this module
+        /// by the native "vtshim" module, according to the value of the
+        /// <see cref="MeasureChildTime" /> property.
+        /// </summary>
+        private void SetChildTiming()
+        {
+#if !SQLITE_STANDARD
+            if (disposableModule == IntPtr.Zero)
+                return;
+
+            UnsafeNativeMethods.sqlite3_vtshim_timing(
+                disposableModule, measureChildTime ? 1 : 0);
+#endif
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+
         /// <summary>
         /// This method is called by the SQLite core library when the native
         /// module associated with this object instance is being destroyed due
@@ -7170,6 +7198,129 @@ namespace System.Data.SQLite
             get { CheckDisposed(); return LogExceptionsNoThrow; }
             set { CheckDisposed(); LogExceptionsNoThrow = value; }
         }
+
+        ///////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns or sets a boolean value indicating whether the native
+        /// "vtshim" module should measure the time spent in the cursor methods
+        /// of this module, as returned by the <see cref="GetStatistics" />
+        /// method.  This reads a high resolution clock twice per call, so it
+        /// is disabled by default.  It has no effect unless the interop
+        /// assembly is in use.
+        /// </summary>
+        public virtual bool MeasureChildTime
+        {
+            get { CheckDisposed(); return measureChildTime; }
+            set { CheckDisposed(); measureChildTime = value; SetChildTiming(); }
+        }
+        #endregion
+
+        ///////////////////////////////////////////////////////////////////////
+
+        #region Public Methods
+        /// <summary>
+        /// Returns the statistics kept by the native "vtshim" module for one
+        /// of the virtual tables using this module via a dictionary of
+        /// key/value pairs.  The "OpenCursors" key is the number of cursors
+        /// currently open on the virtual table.  The "FilterCalls" and
+        /// "NextCalls" keys are the number of times the xFilter and xNext
+        /// methods have been called.  The "ChildMicroseconds" key is the
+        /// total time spent in the cursor methods of this module, in
+        /// microseconds, which is only measured while the
+        /// <see cref="MeasureChildTime" /> property is set.
+        /// </summary>
+        /// <param name="databaseName">
+        /// The name of the database containing the virtual table, e.g. "main"
+        /// or "temp".  If this is null, "main" is used.
+        /// </param>
+        /// <param name="tableName">
+        /// The name of the virtual table.
+        /// </param>
+        /// <param name="reset">
+        /// Non-zero to reset the call counts and the time after they have
+        /// been returned.
+        /// </param>
+        /// <param name="statistics">
+        /// This dictionary will be populated with the statistics.  It will be
+        /// created if necessary.
+        /// </param>
+        /// <returns>
+        /// Non-zero if the statistics were returned.  Zero if the native
+        /// module has not been created, the virtual table is not currently
+        /// connected, or the statistics are not supported by the native
+        /// library in use.
+        /// </returns>
+        public virtual bool GetStatistics(
+            string databaseName,
+            string tableName,
+            bool reset,
+            ref IDictionary<string, long> statistics
+            )
+        {
+            CheckDisposed();
+
+            if (tableName == null)
+                throw new ArgumentNullException("tableName");
+
+#if !SQLITE_STANDARD
+            if (disposableModule == IntPtr.Zero)
+                return false;
+
+            IntPtr pDatabaseName = IntPtr.Zero;
+            IntPtr pTableName = IntPtr.Zero;
+
+            try
+            {
+                if (databaseName != null)
+                {
+                    pDatabaseName = SQLiteString.Utf8IntPtrFromString(
+                        databaseName);
+                }
+
+                pTableName = SQLiteString.Utf8IntPtrFromString(tableName);
+
+                int openCursors = 0;
+                long filterCount = 0;
+                long nextCount = 0;
+                long childTime = 0;
+
+                if (UnsafeNativeMethods.sqlite3_vtshim_stats(
+                        disposableModule, pDatabaseName, pTableName,
+                        reset ? 1 : 0, ref openCursors, ref filterCount,
+                        ref nextCount, ref childTime) != SQLiteErrorCode.Ok)
+                {
+                    return false;
+                }
+
+                if (statistics == null)
+                    statistics = new Dictionary<string, long>();
+
+                statistics["OpenCursors"] = openCursors;
+                statistics["FilterCalls"] = filterCount;
+                statistics["NextCalls"] = nextCount;
+                statistics["ChildMicroseconds"] = childTime;
+
+                return true;
+            }
+            finally
+            {
+                if (pTableName != IntPtr.Zero)
+                {
+                    SQLiteMemory.Free(pTableName);
+                    pTableName = IntPtr.Zero;
+                }
+
+                if (pDatabaseName != IntPtr.Zero)
+                {
+                    SQLiteMemory.Free(pDatabaseName);
+                    pDatabaseName = IntPtr.Zero;
+                }
+            }
+#else
+            return false;
+#endif
+        }
         #endregion
 
         ///////////////////////////////////////////////////////////////////////
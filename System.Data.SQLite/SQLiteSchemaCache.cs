@@ -0,0 +1,421 @@
+/********************************************************
+ * ADO.NET 2.0 Data Provider for SQLite Version 3.X
+ * Written by Joe Mistachkin (joe@mistachkin.com)
+ *
+ * Released to the public domain, use at your own risk!
+ ********************************************************/
+
+namespace System.Data.SQLite
+{
+    using System;
+    using System.Collections.Generic;
+    using System.Globalization;
+    using System.Text;
+
+    /// <summary>
+    /// This class caches the table, column, and index metadata gathered by
+    /// <see cref="SQLiteDataReader.GetSchemaTable" /> for one connection, so
+    /// that repeated executions of the same queries do not have to query the
+    /// database schema again.  The metadata for each database is discarded
+    /// whenever its schema version (i.e. cookie) changes or a different file
+    /// has been attached using the same name.
+    /// </summary>
+    internal sealed class SQLiteSchemaCache
+    {
+        #region Private Constants
+        /// <summary>
+        /// The character used to separate the parts of the cache keys.  It
+        /// cannot appear in any database, table, or column name.
+        /// </summary>
+        private const char KeySeparator = '\0';
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Classes
+        /// <summary>
+        /// The metadata for one column, as returned by the native
+        /// sqlite3_table_column_metadata() function.
+        /// </summary>
+        public sealed class ColumnMetaData
+        {
+            public string DataType;
+            public string CollationSequence;
+            public bool NotNull;
+            public bool PrimaryKey;
+            public bool AutoIncrement;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The metadata for one index of a table.
+        /// </summary>
+        public sealed class IndexMetaData
+        {
+            public object Unique;
+            public bool PrimaryKey;
+            public List<string> ColumnNames;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The metadata for one table.  Each part is loaded the first time it
+        /// is needed.
+        /// </summary>
+        public sealed class TableMetaData
+        {
+            public Dictionary<string, object> DefaultValues;
+            public List<IndexMetaData> Indexes;
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Data
+        /// <summary>
+        /// The file name and schema version last seen for each database,
+        /// keyed by database name.
+        /// </summary>
+        private Dictionary<string, string> _schemaStamps;
+
+        /// <summary>
+        /// The cached column metadata, keyed by database, table, and column
+        /// name.
+        /// </summary>
+        private Dictionary<string, ColumnMetaData> _columns;
+
+        /// <summary>
+        /// The cached table metadata, keyed by database and table name.
+        /// </summary>
+        private Dictionary<string, TableMetaData> _tables;
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Constructors
+        /// <summary>
+        /// Constructs an empty schema metadata cache.
+        /// </summary>
+        public SQLiteSchemaCache()
+        {
+            _schemaStamps = new Dictionary<string, string>(
+                StringComparer.OrdinalIgnoreCase);
+
+            _columns = new Dictionary<string, ColumnMetaData>(
+                StringComparer.OrdinalIgnoreCase);
+
+            _tables = new Dictionary<string, TableMetaData>(
+                StringComparer.OrdinalIgnoreCase);
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Methods
+        /// <summary>
+        /// Discards all cached metadata.
+        /// </summary>
+        /// <returns>
+        /// The total number of columns and tables discarded.
+        /// </returns>
+        public int Clear()
+        {
+            int result = _columns.Count + _tables.Count;
+
+            _schemaStamps.Clear();
+            _columns.Clear();
+            _tables.Clear();
+
+            return result;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Checks the schema version of each of the specified databases and
+        /// discards the cached metadata for the ones that have changed since
+        /// they were last checked.  When the interop assembly is in use, this
+        /// only compares the in-memory schema of each database, which has
+        /// already been checked against the database file by the statement
+        /// that is reading it; otherwise, a single command is used to query
+        /// the schema versions.
+        /// </summary>
+        /// <param name="connection">
+        /// The open connection the metadata belongs to.
+        /// </param>
+        /// <param name="databaseNames">
+        /// The names of the databases to check.
+        /// </param>
+        public void Validate(
+            SQLiteConnection connection,
+            ICollection<string> databaseNames
+            )
+        {
+            if ((databaseNames == null) || (databaseNames.Count == 0))
+                return;
+
+            if (ValidateNative(connection, databaseNames))
+                return;
+
+            StringBuilder builder = new StringBuilder("PRAGMA database_list;");
+
+            foreach (string databaseName in databaseNames)
+            {
+                builder.AppendFormat(CultureInfo.InvariantCulture,
+                    "PRAGMA {0}.schema_version;",
+                    SQLiteConvert.QuoteIdentifier(databaseName));
+            }
+
+            Dictionary<string, string> fileNames = new Dictionary<string, string>(
+                StringComparer.OrdinalIgnoreCase);
+
+            using (SQLiteCommand command = new SQLiteCommand(
+                    builder.ToString(), connection))
+            using (SQLiteDataReader reader = command.ExecuteReader())
+            {
+                while (reader.Read())
+                {
+                    if (!reader.IsDBNull(1))
+                    {
+                        fileNames[reader.GetString(1)] = reader.IsDBNull(2) ?
+                            null : reader.GetString(2);
+                    }
+                }
+
+                foreach (string databaseName in databaseNames)
+                {
+                    if (!reader.NextResult() || !reader.Read())
+                        break;
+
+                    string fileName;
+
+                    fileNames.TryGetValue(databaseName, out fileName);
+
+                    UpdateStamp(databaseName, String.Format(
+                        CultureInfo.InvariantCulture, "{0}{1}{2}", fileName,
+                        KeySeparator, reader.GetValue(0)));
+                }
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Checks the in-memory schema of each of the specified databases,
+        /// without querying them, and discards the cached metadata for the
+        /// ones that have changed since they were last checked.
+        /// </summary>
+        /// <param name="connection">
+        /// The open connection the metadata belongs to.
+        /// </param>
+        /// <param name="databaseNames">
+        /// The names of the databases to check.
+        /// </param>
+        /// <returns>
+        /// Non-zero if all the databases were checked; otherwise, zero, in
+        /// which case the schema versions must be queried instead.
+        /// </returns>
+        private bool ValidateNative(
+            SQLiteConnection connection,
+            ICollection<string> databaseNames
+            )
+        {
+            SQLiteBase sql = connection._sql;
+
+            if (sql == null)
+                return false;
+
+            Dictionary<string, string> stamps = new Dictionary<string, string>(
+                StringComparer.OrdinalIgnoreCase);
+
+            foreach (string databaseName in databaseNames)
+            {
+                string stamp = null;
+
+                if (!sql.GetSchemaStamp(databaseName, ref stamp))
+                    return false;
+
+                stamps[databaseName] = stamp;
+            }
+
+            foreach (KeyValuePair<string, string> pair in stamps)
+                UpdateStamp(pair.Key, pair.Value);
+
+            return true;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Records the schema stamp of a database, discarding its cached
+        /// metadata if the stamp differs from the one last recorded.
+        /// </summary>
+        /// <param name="databaseName">The name of the database.</param>
+        /// <param name="stamp">The current schema stamp of the database.</param>
+        private void UpdateStamp(
+            string databaseName,
+            string stamp
+            )
+        {
+            string oldStamp;
+
+            if (!_schemaStamps.TryGetValue(databaseName, out oldStamp) ||
+                !String.Equals(stamp, oldStamp, StringComparison.Ordinal))
+            {
+                Remove(databaseName);
+                _schemaStamps[databaseName] = stamp;
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Looks up the cached metadata for a column.
+        /// </summary>
+        /// <param name="databaseName">The name of the database.</param>
+        /// <param name="tableName">The name of the table.</param>
+        /// <param name="columnName">The name of the column.</param>
+        /// <param name="metaData">
+        /// Upon success, receives the cached column metadata.
+        /// </param>
+        /// <returns>
+        /// Non-zero if the column metadata was found; otherwise, zero.
+        /// </returns>
+        public bool TryGetColumn(
+            string databaseName,
+            string tableName,
+            string columnName,
+            out ColumnMetaData metaData
+            )
+        {
+            return _columns.TryGetValue(
+                MakeKey(databaseName, tableName, columnName), out metaData);
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Adds or replaces the cached metadata for a column.
+        /// </summary>
+        /// <param name="databaseName">The name of the database.</param>
+        /// <param name="tableName">The name of the table.</param>
+        /// <param name="columnName">The name of the column.</param>
+        /// <param name="metaData">The column metadata.</param>
+        public void SetColumn(
+            string databaseName,
+            string tableName,
+            string columnName,
+            ColumnMetaData metaData
+            )
+        {
+            _columns[MakeKey(databaseName, tableName, columnName)] = metaData;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the cached metadata for a table, adding an empty entry if
+        /// there is none.
+        /// </summary>
+        /// <param name="databaseName">The name of the database.</param>
+        /// <param name="tableName">The name of the table.</param>
+        /// <returns>The table metadata.</returns>
+        public TableMetaData GetTable(
+            string databaseName,
+            string tableName
+            )
+        {
+            string key = MakeKey(databaseName, tableName, null);
+            TableMetaData metaData;
+
+            if (!_tables.TryGetValue(key, out metaData))
+            {
+                metaData = new TableMetaData();
+                _tables.Add(key, metaData);
+            }
+
+            return metaData;
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Methods
+        /// <summary>
+        /// Builds the key used for the cached column and table metadata.
+        /// </summary>
+        /// <param name="databaseName">The name of the database.</param>
+        /// <param name="tableName">The name of the table.</param>
+        /// <param name="columnName">
+        /// The name of the column or null for a table key.
+        /// </param>
+        /// <returns>The cache key.</returns>
+        private static string MakeKey(
+            string databaseName,
+            string tableName,
+            string columnName
+            )
+        {
+            if (columnName == null)
+                return String.Concat(databaseName, KeySeparator, tableName);
+
+            return String.Concat(
+                String.Concat(databaseName, KeySeparator, tableName),
+                KeySeparator, columnName);
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Discards the cached metadata for all the tables and columns of the
+        /// specified database.
+        /// </summary>
+        /// <param name="databaseName">The name of the database.</param>
+        private void Remove(
+            string databaseName
+            )
+        {
+            string prefix = String.Concat(databaseName, KeySeparator);
+
+            RemoveByPrefix(_columns, prefix);
+            RemoveByPrefix(_tables, prefix);
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Removes all the entries with keys starting with the specified
+        /// prefix from a dictionary.
+        /// </summary>
+        /// <typeparam name="T">The type of the dictionary values.</typeparam>
+        /// <param name="dictionary">The dictionary to modify.</param>
+        /// <param name="prefix">The key prefix to match.</param>
+        private static void RemoveByPrefix<T>(
+            Dictionary<string, T> dictionary,
+            string prefix
+            )
+        {
+            List<string> keys = null;
+
+            foreach (string key in dictionary.Keys)
+            {
+                if (!key.StartsWith(prefix, StringComparison.OrdinalIgnoreCase))
+                    continue;
+
+                if (keys == null)
+                    keys = new List<string>();
+
+                keys.Add(key);
+            }
+
+            if (keys == null)
+                return;
+
+            foreach (string key in keys)
+                dictionary.Remove(key);
+        }
+        #endregion
+    }
+}
@@ -0,0 +1,414 @@
+/********************************************************
+ * ADO.NET 2.0 Data Provider for SQLite Version 3.X
+ * Written by Joe Mistachkin (joe@mistachkin.com)
+ *
+ * Released to the public domain, use at your own risk!
+ ********************************************************/
+
+namespace System.Data.SQLite
+{
+    using System;
+    using System.Collections.Generic;
+    using System.Globalization;
+    using System.Text;
+
+    /// <summary>
+    /// This class holds the column, index, and foreign key information for
+    /// the tables of one database, as used to build the schema collections
+    /// returned by <see cref="SQLiteConnection.GetSchema(string, string[])" />.
+    /// The information is either read from the in-memory schema of the
+    /// database in a single native call or, when that is not possible, using
+    /// the equivalent PRAGMA queries for each table.
+    /// </summary>
+    internal static class SQLiteSchemaInfo
+    {
+        #region Public Classes
+        /// <summary>
+        /// One column, as returned by PRAGMA table_info, along with its
+        /// collation sequence and whether it is an AUTOINCREMENT column.
+        /// The latter two are only available from the native schema
+        /// information.
+        /// </summary>
+        public sealed class ColumnInfo
+        {
+            public int Id;
+            public string Name;
+            public string Type;
+            public bool NotNull;
+            public string DefaultValue;
+            public int PrimaryKey;
+            public string CollationSequence;
+            public bool AutoIncrement;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// One index column, as returned by PRAGMA index_info, along with its
+        /// collation sequence and sort order.
+        /// </summary>
+        public sealed class IndexColumnInfo
+        {
+            public int Id;
+            public int ColumnId;
+            public string Name;
+            public string CollationSequence;
+            public int SortMode;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// One index, as returned by PRAGMA index_list, along with its columns
+        /// and conflict resolution algorithm.
+        /// </summary>
+        public sealed class IndexInfo
+        {
+            public string Name;
+            public bool Unique;
+            public int OnError;
+            public List<IndexColumnInfo> Columns = new List<IndexColumnInfo>();
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// One foreign key column, as returned by PRAGMA foreign_key_list.
+        /// </summary>
+        public sealed class ForeignKeyInfo
+        {
+            public int Id;
+            public int Sequence;
+            public string Table;
+            public string From;
+            public string To;
+            public string OnUpdate;
+            public string OnDelete;
+            public string Match;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The columns, indexes, and foreign keys of one table.
+        /// </summary>
+        public sealed class TableInfo
+        {
+            public string Name;
+            public List<ColumnInfo> Columns = new List<ColumnInfo>();
+            public List<IndexInfo> Indexes = new List<IndexInfo>();
+            public List<ForeignKeyInfo> ForeignKeys = new List<ForeignKeyInfo>();
+
+            /////////////////////////////////////////////////////////////////////
+
+            /// <summary>
+            /// Finds an index of this table by name.
+            /// </summary>
+            /// <param name="name">The name of the index.</param>
+            /// <returns>The index or null if it cannot be found.</returns>
+            public IndexInfo FindIndex(
+                string name
+                )
+            {
+                foreach (IndexInfo index in Indexes)
+                {
+                    if (String.Compare(index.Name, name,
+                            StringComparison.OrdinalIgnoreCase) == 0)
+                    {
+                        return index;
+                    }
+                }
+
+                return null;
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Methods
+        /// <summary>
+        /// Parses the packed schema information returned by the native
+        /// sqlite3_schema_info_interop() function.  Each field consists of a
+        /// marker byte ('+' for a value or '-' for NULL), followed by its
+        /// UTF-8 text, if any, and a NUL terminator.
+        /// </summary>
+        /// <param name="info">The packed schema information.</param>
+        /// <returns>
+        /// The information for each table, keyed by table name.
+        /// </returns>
+        public static Dictionary<string, TableInfo> Parse(
+            byte[] info
+            )
+        {
+            Dictionary<string, TableInfo> result =
+                new Dictionary<string, TableInfo>(
+                    StringComparer.OrdinalIgnoreCase);
+
+            if (info == null)
+                return result;
+
+            int offset = 0;
+            TableInfo table = null;
+            IndexInfo index = null;
+
+            while (offset < info.Length)
+            {
+                string tag = NextField(info, ref offset);
+
+                switch (tag)
+                {
+                    case "T":
+                        {
+                            table = new TableInfo();
+                            table.Name = NextField(info, ref offset);
+                            NextInt32(info, ref offset); /* nCol */
+
+                            if (!result.ContainsKey(table.Name))
+                                result.Add(table.Name, table);
+
+                            index = null;
+                            break;
+                        }
+                    case "C":
+                        {
+                            ColumnInfo column = new ColumnInfo();
+
+                            column.Id = NextInt32(info, ref offset);
+                            column.Name = NextField(info, ref offset);
+                            column.Type = NextField(info, ref offset);
+                            column.NotNull = NextInt32(info, ref offset) != 0;
+                            column.DefaultValue = NextField(info, ref offset);
+                            column.PrimaryKey = NextInt32(info, ref offset);
+                            column.CollationSequence = NextField(info, ref offset);
+                            column.AutoIncrement = NextInt32(info, ref offset) != 0;
+
+                            table.Columns.Add(column);
+                            break;
+                        }
+                    case "I":
+                        {
+                            index = new IndexInfo();
+                            index.Name = NextField(info, ref offset);
+                            index.Unique = NextInt32(info, ref offset) != 0;
+                            index.OnError = NextInt32(info, ref offset);
+                            NextInt32(info, ref offset); /* nKeyCol */
+
+                            table.Indexes.Add(index);
+                            break;
+                        }
+                    case "X":
+                        {
+                            IndexColumnInfo indexColumn = new IndexColumnInfo();
+
+                            indexColumn.Id = NextInt32(info, ref offset);
+                            indexColumn.ColumnId = NextInt32(info, ref offset);
+                            indexColumn.Name = NextField(info, ref offset);
+                            indexColumn.CollationSequence = NextField(info, ref offset);
+                            indexColumn.SortMode = NextInt32(info, ref offset);
+
+                            index.Columns.Add(indexColumn);
+                            break;
+                        }
+                    case "F":
+                        {
+                            ForeignKeyInfo foreignKey = new ForeignKeyInfo();
+
+                            foreignKey.Id = NextInt32(info, ref offset);
+                            foreignKey.Sequence = NextInt32(info, ref offset);
+                            foreignKey.Table = NextField(info, ref offset);
+                            foreignKey.From = NextField(info, ref offset);
+                            foreignKey.To = NextField(info, ref offset);
+                            foreignKey.OnUpdate = NextField(info, ref offset);
+                            foreignKey.OnDelete = NextField(info, ref offset);
+                            foreignKey.Match = NextField(info, ref offset);
+
+                            table.ForeignKeys.Add(foreignKey);
+                            break;
+                        }
+                    default:
+                        {
+                            throw new SQLiteException(SQLiteErrorCode.Corrupt,
+                                "malformed schema information");
+                        }
+                }
+            }
+
+            return result;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Queries the information for one table using PRAGMA statements.
+        /// This is used for the tables not covered by the native schema
+        /// information (e.g. virtual tables) or when it is unavailable.
+        /// </summary>
+        /// <param name="connection">The connection to use.</param>
+        /// <param name="catalog">The name of the database.</param>
+        /// <param name="tableName">The name of the table.</param>
+        /// <param name="wantIndexes">
+        /// Non-zero to query the indexes of the table.
+        /// </param>
+        /// <param name="wantForeignKeys">
+        /// Non-zero to query the foreign keys of the table.
+        /// </param>
+        /// <returns>The table information.</returns>
+        public static TableInfo Query(
+            SQLiteConnection connection,
+            string catalog,
+            string tableName,
+            bool wantIndexes,
+            bool wantForeignKeys
+            )
+        {
+            TableInfo table = new TableInfo();
+
+            table.Name = tableName;
+
+            using (SQLiteCommand cmdTable = new SQLiteCommand(String.Format(
+                    CultureInfo.InvariantCulture, "PRAGMA [{0}].table_info([{1}])",
+                    catalog, tableName), connection))
+            using (SQLiteDataReader rdTable = cmdTable.ExecuteReader())
+            {
+                while (rdTable.Read())
+                {
+                    ColumnInfo column = new ColumnInfo();
+
+                    column.Id = rdTable.GetInt32(0);
+                    column.Name = rdTable.GetString(1);
+                    column.Type = rdTable.GetString(2);
+                    column.NotNull = rdTable.GetInt32(3) != 0;
+                    column.DefaultValue = rdTable.IsDBNull(4) ? null : rdTable.GetString(4);
+                    column.PrimaryKey = rdTable.GetInt32(5);
+
+                    table.Columns.Add(column);
+                }
+            }
+
+            if (wantIndexes)
+            {
+                using (SQLiteCommand cmd = new SQLiteCommand(String.Format(
+                        CultureInfo.InvariantCulture, "PRAGMA [{0}].index_list([{1}])",
+                        catalog, tableName), connection))
+                using (SQLiteDataReader rd = cmd.ExecuteReader())
+                {
+                    while (rd.Read())
+                    {
+                        IndexInfo index = new IndexInfo();
+
+                        index.Name = rd.GetString(1);
+                        index.Unique = SQLiteConvert.ToBoolean(rd.GetValue(2),
+                            CultureInfo.InvariantCulture, false);
+
+                        table.Indexes.Add(index);
+                    }
+                }
+
+                foreach (IndexInfo index in table.Indexes)
+                {
+                    using (SQLiteCommand cmdIndex = new SQLiteCommand(String.Format(
+                            CultureInfo.InvariantCulture, "PRAGMA [{0}].index_info([{1}])",
+                            catalog, index.Name), connection))
+                    using (SQLiteDataReader rdIndex = cmdIndex.ExecuteReader())
+                    {
+                        while (rdIndex.Read())
+                        {
+                            IndexColumnInfo indexColumn = new IndexColumnInfo();
+
+                            indexColumn.Id = rdIndex.GetInt32(0);
+                            indexColumn.ColumnId = rdIndex.GetInt32(1);
+                            indexColumn.Name = rdIndex.GetString(2);
+
+                            connection._sql.GetIndexColumnExtendedInfo(catalog,
+                                index.Name, indexColumn.Name, ref indexColumn.SortMode,
+                                ref index.OnError, ref indexColumn.CollationSequence);
+
+                            index.Columns.Add(indexColumn);
+                        }
+                    }
+                }
+            }
+
+            if (wantForeignKeys)
+            {
+                using (SQLiteCommand cmdKey = new SQLiteCommand(String.Format(
+                        CultureInfo.InvariantCulture, "PRAGMA [{0}].foreign_key_list([{1}])",
+                        catalog, tableName), connection))
+                using (SQLiteDataReader rdKey = cmdKey.ExecuteReader())
+                {
+                    while (rdKey.Read())
+                    {
+                        ForeignKeyInfo foreignKey = new ForeignKeyInfo();
+
+                        foreignKey.Id = rdKey.GetInt32(0);
+                        foreignKey.Sequence = rdKey.GetInt32(1);
+                        foreignKey.Table = rdKey[2].ToString();
+                        foreignKey.From = rdKey[3].ToString();
+                        foreignKey.To = rdKey[4].ToString();
+                        foreignKey.OnUpdate = (rdKey.FieldCount > 5) ? rdKey[5].ToString() : String.Empty;
+                        foreignKey.OnDelete = (rdKey.FieldCount > 6) ? rdKey[6].ToString() : String.Empty;
+                        foreignKey.Match = (rdKey.FieldCount > 7) ? rdKey[7].ToString() : String.Empty;
+
+                        table.ForeignKeys.Add(foreignKey);
+                    }
+                }
+            }
+
+            return table;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Reads the next field from the packed schema information.
+        /// </summary>
+        /// <param name="info">The packed schema information.</param>
+        /// <param name="offset">
+        /// The offset of the field, advanced past it upon return.
+        /// </param>
+        /// <returns>The value of the field or null.</returns>
+        public static string NextField(
+            byte[] info,
+            ref int offset
+            )
+        {
+            int end = Array.IndexOf(info, (byte)0, offset);
+
+            if ((end < 0) || (end == offset))
+            {
+                throw new SQLiteException(SQLiteErrorCode.Corrupt,
+                    "malformed schema information");
+            }
+
+            string result = (info[offset] == (byte)'-') ? null :
+                Encoding.UTF8.GetString(info, offset + 1, end - offset - 1);
+
+            offset = end + 1;
+            return result;
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Reads the next field from the packed schema information as an
+        /// integer.
+        /// </summary>
+        /// <param name="info">The packed schema information.</param>
+        /// <param name="offset">
+        /// The offset of the field, advanced past it upon return.
+        /// </param>
+        /// <returns>The value of the field.</returns>
+        public static int NextInt32(
+            byte[] info,
+            ref int offset
+            )
+        {
+            string value = NextField(info, ref offset);
+
+            return (value != null) ?
+                Int32.Parse(value, CultureInfo.InvariantCulture) : 0;
+        }
+        #endregion
+    }
+}
@@ -0,0 +1,465 @@
+/********************************************************
+ * ADO.NET 2.0 Data Provider for SQLite Version 3.X
+ * Written by Joe Mistachkin (joe@mistachkin.com)
+ *
+ * Released to the public domain, use at your own risk!
+ ********************************************************/
+
+namespace System.Data.SQLite
+{
+    using System;
+    using System.Collections.Generic;
+    using System.Globalization;
+    using System.Threading;
+    using System.Threading.Tasks;
+
+    /// <summary>
+    /// This class implements a <see cref="TaskScheduler" /> that runs all of
+    /// the asynchronous work for one database file on a small, bounded set of
+    /// dedicated threads.  Calls into the native sqlite3_step() API may block
+    /// for a long time (e.g. on I/O or while waiting for a lock); running them
+    /// here keeps them from tying up thread pool threads.
+    /// </summary>
+    internal sealed class SQLiteTaskScheduler : TaskScheduler
+    {
+        #region Private Constants
+        /// <summary>
+        /// The default maximum number of dedicated threads created for any
+        /// one database file.
+        /// </summary>
+        private const int DefaultMaximumThreads = 4;
+
+        /// <summary>
+        /// The number of milliseconds an idle worker thread waits for more
+        /// work before exiting.
+        /// </summary>
+        private const int IdleTimeout = 30000;
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Static Data
+        /// <summary>
+        /// This lock protects the <see cref="_schedulers" /> dictionary.
+        /// </summary>
+        private static readonly object _syncRoot = new object();
+
+        /// <summary>
+        /// The schedulers for all database files that have been used with the
+        /// asynchronous methods, keyed by the (case-insensitive) file name.
+        /// </summary>
+        private static Dictionary<string, SQLiteTaskScheduler> _schedulers;
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Data
+        /// <summary>
+        /// The database file name associated with this scheduler.
+        /// </summary>
+        private string _fileName;
+
+        /// <summary>
+        /// The queue of tasks that are waiting for a worker thread.  This
+        /// object is also used to synchronize access to the other fields.
+        /// </summary>
+        private Queue<Task> _queue;
+
+        /// <summary>
+        /// The maximum number of worker threads for this scheduler.
+        /// </summary>
+        private int _maximumConcurrency;
+
+        /// <summary>
+        /// The number of open connections that have used this scheduler.  It
+        /// is protected by the <see cref="_syncRoot" /> lock.
+        /// </summary>
+        private int _connectionCount;
+
+        /// <summary>
+        /// The number of worker threads currently alive.
+        /// </summary>
+        private int _threadCount;
+
+        /// <summary>
+        /// The number of worker threads currently waiting for work.
+        /// </summary>
+        private int _idleCount;
+
+        /// <summary>
+        /// Non-zero if this scheduler is executing a task on the current
+        /// thread.
+        /// </summary>
+        [ThreadStatic()]
+        private static bool _isWorkerThread;
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Constructors
+        /// <summary>
+        /// Constructs a scheduler for the specified database file.
+        /// </summary>
+        /// <param name="fileName">
+        /// The database file name associated with this scheduler.
+        /// </param>
+        /// <param name="maximumConcurrency">
+        /// The maximum number of worker threads for this scheduler.
+        /// </param>
+        private SQLiteTaskScheduler(
+            string fileName,
+            int maximumConcurrency
+            )
+        {
+            _fileName = fileName;
+            _queue = new Queue<Task>();
+            _maximumConcurrency = (maximumConcurrency > 0) ?
+                maximumConcurrency : 1;
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Internal Static Methods
+        /// <summary>
+        /// Returns the scheduler for the database file of the specified
+        /// connection, creating it if necessary.  In-memory and unnamed
+        /// databases share a separate scheduler.  The connection keeps a
+        /// reference to the scheduler until it is closed.
+        /// </summary>
+        /// <param name="connection">
+        /// The connection that will use the scheduler, may be null.
+        /// </param>
+        /// <returns>
+        /// The scheduler to use for asynchronous work on the database file.
+        /// </returns>
+        internal static SQLiteTaskScheduler GetScheduler(
+            SQLiteConnection connection
+            )
+        {
+            string fileName = (connection != null) ? connection.FileName : null;
+
+            if (String.IsNullOrEmpty(fileName) ||
+                String.Equals(fileName, ":memory:", StringComparison.OrdinalIgnoreCase))
+            {
+                fileName = String.Empty;
+            }
+
+            lock (_syncRoot)
+            {
+                if ((connection != null) && (connection._taskScheduler != null))
+                    return connection._taskScheduler;
+
+                if (_schedulers == null)
+                {
+                    _schedulers = new Dictionary<string, SQLiteTaskScheduler>(
+                        StringComparer.OrdinalIgnoreCase);
+                }
+
+                SQLiteTaskScheduler scheduler;
+
+                if (!_schedulers.TryGetValue(fileName, out scheduler))
+                {
+                    scheduler = new SQLiteTaskScheduler(
+                        fileName, DefaultMaximumThreads);
+
+                    _schedulers.Add(fileName, scheduler);
+                }
+
+                if (connection != null)
+                {
+                    scheduler._connectionCount++;
+                    connection._taskScheduler = scheduler;
+                }
+
+                return scheduler;
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Releases the reference of the specified connection, which is being
+        /// closed, to its scheduler.  The scheduler is forgotten once the last
+        /// connection using it has been closed; its worker threads finish any
+        /// queued tasks and then exit after the idle timeout.
+        /// </summary>
+        /// <param name="connection">
+        /// The connection being closed.
+        /// </param>
+        internal static void ReleaseScheduler(
+            SQLiteConnection connection
+            )
+        {
+            lock (_syncRoot)
+            {
+                SQLiteTaskScheduler scheduler = connection._taskScheduler;
+
+                if (scheduler == null)
+                    return;
+
+                connection._taskScheduler = null;
+
+                if ((--scheduler._connectionCount == 0) && (_schedulers != null))
+                {
+                    SQLiteTaskScheduler current;
+
+                    if (_schedulers.TryGetValue(scheduler._fileName, out current) &&
+                        Object.ReferenceEquals(current, scheduler))
+                    {
+                        _schedulers.Remove(scheduler._fileName);
+                    }
+                }
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Runs the specified function on the scheduler for the database file
+        /// associated with the specified connection.
+        /// </summary>
+        /// <typeparam name="T">
+        /// The type of the result produced by the function.
+        /// </typeparam>
+        /// <param name="connection">
+        /// The connection that the function will use.
+        /// </param>
+        /// <param name="function">
+        /// The function to run.
+        /// </param>
+        /// <param name="cancellationToken">
+        /// The token used to cancel the operation.  When it is signaled while
+        /// the function is running, the native sqlite3_interrupt() API is used
+        /// to abort the statement in progress.  When it is signaled before
+        /// then, the function is not called.
+        /// </param>
+        /// <returns>
+        /// The task representing the result of the function.
+        /// </returns>
+        internal static Task<T> Run<T>(
+            SQLiteConnection connection,
+            Func<T> function,
+            CancellationToken cancellationToken
+            )
+        {
+            if (cancellationToken.IsCancellationRequested)
+            {
+                TaskCompletionSource<T> source = new TaskCompletionSource<T>();
+                source.SetCanceled();
+                return source.Task;
+            }
+
+            SQLiteTaskScheduler scheduler = GetScheduler(connection);
+
+            return Task.Factory.StartNew<T>(delegate()
+            {
+                using (cancellationToken.Register(delegate()
+                {
+                    try
+                    {
+                        if (connection != null)
+                            connection.Cancel();
+                    }
+                    catch (Exception)
+                    {
+                        // do nothing.
+                    }
+                }, false))
+                {
+                    //
+                    // NOTE: An interrupt is forgotten by the SQLite core
+                    //       library when the next statement starts, if no
+                    //       other statement was running at the time.  Any
+                    //       cancellation signaled while this task was queued
+                    //       or before the registration above took effect must
+                    //       be honored here instead, immediately before the
+                    //       function starts.
+                    //
+                    cancellationToken.ThrowIfCancellationRequested();
+
+                    try
+                    {
+                        return function();
+                    }
+                    catch (SQLiteException e)
+                    {
+                        //
+                        // NOTE: When the statement was aborted because the
+                        //       token was signaled, report cancellation to
+                        //       the caller instead of the raw interrupt.
+                        //
+                        if (cancellationToken.IsCancellationRequested &&
+                            (e.ResultCode == SQLiteErrorCode.Interrupt))
+                        {
+                            throw new OperationCanceledException(
+                                e.Message, e, cancellationToken);
+                        }
+
+                        throw;
+                    }
+                }
+            }, cancellationToken, TaskCreationOptions.DenyChildAttach,
+            scheduler);
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region TaskScheduler Overrides
+        /// <summary>
+        /// Returns the maximum number of tasks that may run concurrently on
+        /// this scheduler.
+        /// </summary>
+        public override int MaximumConcurrencyLevel
+        {
+            get { return _maximumConcurrency; }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Queues a task for execution on one of the worker threads, starting
+        /// a new worker thread if none are idle and the limit has not been
+        /// reached.
+        /// </summary>
+        /// <param name="task">
+        /// The task to be queued.
+        /// </param>
+        protected override void QueueTask(
+            Task task
+            )
+        {
+            bool startThread = false;
+
+            lock (_queue)
+            {
+                _queue.Enqueue(task);
+
+                if (_idleCount > 0)
+                {
+                    Monitor.Pulse(_queue);
+                }
+                else if (_threadCount < _maximumConcurrency)
+                {
+                    _threadCount++;
+                    startThread = true;
+                }
+            }
+
+            if (startThread)
+            {
+                Thread thread = new Thread(WorkerThreadStart);
+
+                thread.IsBackground = true;
+                thread.Name = String.Format(
+                    CultureInfo.InvariantCulture, "SQLiteTaskScheduler: {0}",
+                    _fileName);
+                thread.Start();
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Executes a task inline only when the calling thread already belongs
+        /// to this scheduler.
+        /// </summary>
+        /// <param name="task">
+        /// The task to be executed.
+        /// </param>
+        /// <param name="taskWasPreviouslyQueued">
+        /// Non-zero if the task was previously queued.
+        /// </param>
+        /// <returns>
+        /// Non-zero if the task was executed.
+        /// </returns>
+        protected override bool TryExecuteTaskInline(
+            Task task,
+            bool taskWasPreviouslyQueued
+            )
+        {
+            if (!_isWorkerThread || taskWasPreviouslyQueued)
+                return false;
+
+            return TryExecuteTask(task);
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns a snapshot of the queued tasks, for use by debuggers.
+        /// </summary>
+        /// <returns>
+        /// The tasks currently waiting for a worker thread.
+        /// </returns>
+        protected override IEnumerable<Task> GetScheduledTasks()
+        {
+            bool locked = false;
+
+            try
+            {
+                Monitor.TryEnter(_queue, ref locked);
+
+                if (!locked)
+                    throw new NotSupportedException();
+
+                return _queue.ToArray();
+            }
+            finally
+            {
+                if (locked)
+                    Monitor.Exit(_queue);
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Methods
+        /// <summary>
+        /// The entry point for the worker threads.  Each thread executes the
+        /// queued tasks until the queue has remained empty for the idle
+        /// timeout.
+        /// </summary>
+        private void WorkerThreadStart()
+        {
+            _isWorkerThread = true;
+
+            try
+            {
+                while (true)
+                {
+                    Task task;
+
+                    lock (_queue)
+                    {
+                        while (_queue.Count == 0)
+                        {
+                            _idleCount++;
+
+                            bool signaled = Monitor.Wait(_queue, IdleTimeout);
+
+                            _idleCount--;
+
+                            if (!signaled && (_queue.Count == 0))
+                            {
+                                _threadCount--;
+                                return;
+                            }
+                        }
+
+                        task = _queue.Dequeue();
+                    }
+
+                    TryExecuteTask(task);
+                }
+            }
+            finally
+            {
+                _isWorkerThread = false;
+            }
+        }
+        #endregion
+    }
+}
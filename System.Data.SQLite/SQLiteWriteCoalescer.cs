@@ -0,0 +1,590 @@
+/********************************************************
+ * ADO.NET 2.0 Data Provider for SQLite Version 3.X
+ * Written by Joe Mistachkin (joe@mistachkin.com)
+ *
+ * Released to the public domain, use at your own risk!
+ ********************************************************/
+
+namespace System.Data.SQLite
+{
+    using System;
+    using System.Collections.Generic;
+    using System.Threading;
+
+#if NET_45 || NET_451
+    using System.Threading.Tasks;
+#endif
+
+    /// <summary>
+    /// This represents a unit of work submitted to a
+    /// <see cref="SQLiteWriteCoalescer" />.
+    /// </summary>
+    /// <param name="connection">
+    /// The writer connection.  A transaction is already active on it; the
+    /// callback must not begin, commit, or roll back a transaction itself.
+    /// </param>
+    /// <param name="clientData">
+    /// The extra data that was supplied by the caller when the work was
+    /// submitted.
+    /// </param>
+    /// <returns>
+    /// The result to be returned to the caller once the transaction that
+    /// contains this work has been committed.
+    /// </returns>
+    public delegate object SQLiteWriteCallback(
+        SQLiteConnection connection,
+        object clientData
+    );
+
+    ///////////////////////////////////////////////////////////////////////////
+
+    /// <summary>
+    /// This class coalesces small writes submitted by many threads into a
+    /// smaller number of transactions on one writer connection, which it owns.
+    /// All the work that is queued while the previous transaction commits, up
+    /// to the maximum batch size, is executed in the next transaction.  This
+    /// means one commit (and one sync) covers many callers.  Each unit of work
+    /// runs inside its own savepoint.  If it fails, only its own changes are
+    /// rolled back and only its own caller sees the error.
+    /// </summary>
+    public sealed class SQLiteWriteCoalescer : IDisposable
+    {
+        #region Private Constants
+        /// <summary>
+        /// The default maximum number of units of work in one transaction.
+        /// </summary>
+        private const int DefaultMaximumBatchSize = 1000;
+
+        /// <summary>
+        /// The name of the savepoint used around each unit of work.
+        /// </summary>
+        private const string SavepointName = "sqlite_write_coalescer";
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Data
+        /// <summary>
+        /// The connection used to execute all the units of work.
+        /// </summary>
+        private SQLiteConnection _connection;
+
+        /// <summary>
+        /// The units of work waiting for the next transaction.  This object
+        /// is also used to synchronize access to the other fields.
+        /// </summary>
+        private Queue<WorkItem> _queue;
+
+        /// <summary>
+        /// The maximum number of units of work in one transaction.
+        /// </summary>
+        private int _maximumBatchSize;
+
+        /// <summary>
+        /// The maximum number of milliseconds to wait for additional units of
+        /// work after the first one in a batch arrives.
+        /// </summary>
+        private int _maximumDelay;
+
+        /// <summary>
+        /// The thread that executes the units of work.
+        /// </summary>
+        private Thread _thread;
+
+        /// <summary>
+        /// Non-zero if no more units of work are being accepted.
+        /// </summary>
+        private bool _stopping;
+
+        /// <summary>
+        /// The number of transactions committed so far.
+        /// </summary>
+        private long _commitCount;
+
+        /// <summary>
+        /// The number of units of work completed so far.
+        /// </summary>
+        private long _workCount;
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Constructors
+        /// <summary>
+        /// Constructs a write coalescer using the default batch limits.
+        /// </summary>
+        /// <param name="connectionString">
+        /// The connection string used to open the writer connection.
+        /// </param>
+        public SQLiteWriteCoalescer(
+            string connectionString
+            )
+            : this(connectionString, DefaultMaximumBatchSize, 0)
+        {
+            // do nothing.
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Constructs a write coalescer.
+        /// </summary>
+        /// <param name="connectionString">
+        /// The connection string used to open the writer connection.
+        /// </param>
+        /// <param name="maximumBatchSize">
+        /// The maximum number of units of work in one transaction.
+        /// </param>
+        /// <param name="maximumDelay">
+        /// The maximum number of milliseconds to wait for additional units of
+        /// work after the first one in a batch arrives.  Zero means that a
+        /// batch contains only the units of work that are already queued.
+        /// </param>
+        public SQLiteWriteCoalescer(
+            string connectionString,
+            int maximumBatchSize,
+            int maximumDelay
+            )
+        {
+            if (maximumBatchSize < 1)
+                throw new ArgumentOutOfRangeException("maximumBatchSize");
+
+            if (maximumDelay < 0)
+                throw new ArgumentOutOfRangeException("maximumDelay");
+
+            _queue = new Queue<WorkItem>();
+            _maximumBatchSize = maximumBatchSize;
+            _maximumDelay = maximumDelay;
+
+            _connection = new SQLiteConnection(connectionString);
+            _connection.Open();
+
+            _thread = new Thread(ThreadStart);
+            _thread.IsBackground = true;
+#if !PLATFORM_COMPACTFRAMEWORK
+            _thread.Name = "SQLiteWriteCoalescer";
+#endif
+            _thread.Start();
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Properties
+        /// <summary>
+        /// Returns the number of transactions committed so far.
+        /// </summary>
+        public long CommitCount
+        {
+            get { CheckDisposed(); lock (_queue) { return _commitCount; } }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Returns the number of units of work completed so far, successfully
+        /// or not.
+        /// </summary>
+        public long WorkCount
+        {
+            get { CheckDisposed(); lock (_queue) { return _workCount; } }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Public Methods
+        /// <summary>
+        /// Submits a unit of work and waits until the transaction containing
+        /// it has been committed.
+        /// </summary>
+        /// <param name="callback">
+        /// The unit of work to execute.
+        /// </param>
+        /// <param name="clientData">
+        /// The extra data to pass to the callback.
+        /// </param>
+        /// <returns>
+        /// The value returned by the callback.  If the callback or the commit
+        /// failed, a <see cref="SQLiteException" /> is thrown instead, with
+        /// the original exception as its inner exception.
+        /// </returns>
+        public object Execute(
+            SQLiteWriteCallback callback,
+            object clientData
+            )
+        {
+            WorkItem item = new WorkItem(callback, clientData);
+
+            using (item.Event = new ManualResetEvent(false))
+            {
+                Enqueue(item);
+                item.Event.WaitOne();
+            }
+
+            //
+            // NOTE: The error was raised on the writer thread; wrap it so that
+            //       its original stack trace is kept.
+            //
+            if (item.Error != null)
+                throw new SQLiteException(item.Error.Message, item.Error);
+
+            return item.Result;
+        }
+
+#if NET_45 || NET_451
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Submits a unit of work without waiting for it.
+        /// </summary>
+        /// <param name="callback">
+        /// The unit of work to execute.
+        /// </param>
+        /// <param name="clientData">
+        /// The extra data to pass to the callback.
+        /// </param>
+        /// <returns>
+        /// The task that completes with the value returned by the callback,
+        /// once the transaction containing it has been committed.  If the
+        /// callback or the commit failed, the task is faulted instead.
+        /// </returns>
+        public Task<object> ExecuteAsync(
+            SQLiteWriteCallback callback,
+            object clientData
+            )
+        {
+            WorkItem item = new WorkItem(callback, clientData);
+
+            item.Source = new TaskCompletionSource<object>();
+            Enqueue(item);
+
+            return item.Source.Task;
+        }
+#endif
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private Methods
+        /// <summary>
+        /// Adds a unit of work to the queue and wakes the writer thread.
+        /// </summary>
+        /// <param name="item">
+        /// The unit of work to add.
+        /// </param>
+        private void Enqueue(
+            WorkItem item
+            )
+        {
+            CheckDisposed();
+
+            if (item.Callback == null)
+                throw new ArgumentNullException("callback");
+
+            lock (_queue)
+            {
+                if (_stopping)
+                    throw new ObjectDisposedException(typeof(SQLiteWriteCoalescer).Name);
+
+                _queue.Enqueue(item);
+                Monitor.Pulse(_queue);
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Waits for the next batch of units of work.
+        /// </summary>
+        /// <returns>
+        /// The units of work for the next transaction, or null if the writer
+        /// thread should exit.
+        /// </returns>
+        private List<WorkItem> GetBatch()
+        {
+            lock (_queue)
+            {
+                while (_queue.Count == 0)
+                {
+                    if (_stopping)
+                        return null;
+
+                    Monitor.Wait(_queue);
+                }
+
+                if ((_maximumDelay > 0) && !_stopping)
+                {
+                    //
+                    // NOTE: Give other writers a chance to join this batch,
+                    //       up to the time and size limits.
+                    //
+                    int start = Environment.TickCount;
+
+                    while (!_stopping && (_queue.Count < _maximumBatchSize))
+                    {
+                        int remaining = _maximumDelay -
+                            unchecked(Environment.TickCount - start);
+
+                        if ((remaining <= 0) ||
+                            !Monitor.Wait(_queue, remaining))
+                        {
+                            break;
+                        }
+                    }
+                }
+
+                int count = Math.Min(_queue.Count, _maximumBatchSize);
+                List<WorkItem> batch = new List<WorkItem>(count);
+
+                while (batch.Count < count)
+                    batch.Add(_queue.Dequeue());
+
+                return batch;
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Executes one batch of units of work in a single transaction and then
+        /// completes them.
+        /// </summary>
+        /// <param name="batch">
+        /// The units of work to execute.
+        /// </param>
+        private void ExecuteBatch(
+            List<WorkItem> batch
+            )
+        {
+            Exception commitError = null;
+
+            try
+            {
+                using (SQLiteTransaction transaction =
+                        _connection.BeginTransaction())
+                {
+                    foreach (WorkItem item in batch)
+                        ExecuteItem(item);
+
+                    transaction.Commit();
+                }
+            }
+            catch (Exception e)
+            {
+                commitError = e;
+            }
+
+            lock (_queue)
+            {
+                if (commitError == null)
+                    _commitCount++;
+
+                _workCount += batch.Count;
+            }
+
+            foreach (WorkItem item in batch)
+            {
+                if (commitError != null)
+                {
+                    item.Result = null;
+                    item.Error = commitError;
+                }
+
+                item.Complete();
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// Executes one unit of work inside its own savepoint, recording its
+        /// result or error.
+        /// </summary>
+        /// <param name="item">
+        /// The unit of work to execute.
+        /// </param>
+        private void ExecuteItem(
+            WorkItem item
+            )
+        {
+            using (SQLiteCommand command = _connection.CreateCommand())
+            {
+                command.CommandText = "SAVEPOINT " + SavepointName + ";";
+                command.ExecuteNonQuery();
+
+                try
+                {
+                    item.Result = item.Callback(_connection, item.ClientData);
+                }
+                catch (Exception e)
+                {
+                    item.Error = e;
+
+                    command.CommandText = "ROLLBACK TO " + SavepointName + ";";
+                    command.ExecuteNonQuery();
+                }
+
+                command.CommandText = "RELEASE " + SavepointName + ";";
+                command.ExecuteNonQuery();
+            }
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        /// <summary>
+        /// The entry point for the writer thread.
+        /// </summary>
+        private void ThreadStart()
+        {
+            while (true)
+            {
+                List<WorkItem> batch = GetBatch();
+
+                if (batch == null)
+                    break;
+
+                ExecuteBatch(batch);
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Private WorkItem Class
+        /// <summary>
+        /// This class holds the state for one unit of work.
+        /// </summary>
+        private sealed class WorkItem
+        {
+            public SQLiteWriteCallback Callback;
+            public object ClientData;
+            public object Result;
+            public Exception Error;
+            public ManualResetEvent Event;
+
+#if NET_45 || NET_451
+            public TaskCompletionSource<object> Source;
+#endif
+
+            /////////////////////////////////////////////////////////////////////
+
+            public WorkItem(
+                SQLiteWriteCallback callback,
+                object clientData
+                )
+            {
+                Callback = callback;
+                ClientData = clientData;
+            }
+
+            /////////////////////////////////////////////////////////////////////
+
+            /// <summary>
+            /// Notifies the caller that this unit of work has finished.  Tasks
+            /// are completed on a thread pool thread, because their
+            /// continuations may run synchronously on the completing thread
+            /// and must not stall or deadlock the writer thread.
+            /// </summary>
+            public void Complete()
+            {
+#if NET_45 || NET_451
+                if (Source != null)
+                {
+                    ThreadPool.QueueUserWorkItem(delegate(object state)
+                    {
+                        if (Error != null)
+                            Source.TrySetException(Error);
+                        else
+                            Source.TrySetResult(Result);
+                    });
+
+                    return;
+                }
+#endif
+
+                if (Event != null)
+                    Event.Set();
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region IDisposable Members
+        /// <summary>
+        /// Stops accepting units of work, waits for the queued ones to be
+        /// committed, and then closes the writer connection.
+        /// </summary>
+        public void Dispose()
+        {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region IDisposable "Pattern" Members
+        private bool disposed;
+        private void CheckDisposed() /* throw */
+        {
+#if THROW_ON_DISPOSED
+            if (disposed)
+                throw new ObjectDisposedException(typeof(SQLiteWriteCoalescer).Name);
+#endif
+        }
+
+        /////////////////////////////////////////////////////////////////////////
+
+        private void Dispose(bool disposing)
+        {
+            if (!disposed)
+            {
+                if (disposing)
+                {
+                    ////////////////////////////////////
+                    // dispose managed resources here...
+                    ////////////////////////////////////
+
+                    if (_queue != null)
+                    {
+                        lock (_queue)
+                        {
+                            _stopping = true;
+                            Monitor.PulseAll(_queue);
+                        }
+                    }
+
+                    if (_thread != null)
+                    {
+                        _thread.Join();
+                        _thread = null;
+                    }
+
+                    if (_connection != null)
+                    {
+                        _connection.Dispose();
+                        _connection = null;
+                    }
+                }
+
+                //////////////////////////////////////
+                // release unmanaged resources here...
+                //////////////////////////////////////
+
+                disposed = true;
+            }
+        }
+        #endregion
+
+        /////////////////////////////////////////////////////////////////////////
+
+        #region Destructor
+        ~SQLiteWriteCoalescer()
+        {
+            Dispose(false);
+        }
+        #endregion
+    }
+}
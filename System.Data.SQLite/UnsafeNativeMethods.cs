@@ -1331,6 +1331,15 @@ namespace System.Data.SQLite
 #if INTEROP_LOG
     [DllImport(SQLITE_DLL)]
     internal static extern SQLiteErrorCode sqlite3_config_log_interop();
+
+    [DllImport(SQLITE_DLL)]
+    internal static extern int sqlite3_log_read_interop(int nMax, [Out] int[] aCode, [Out] long[] aTime, [Out] byte[] aMsg, int nMsg);
+
+    [DllImport(SQLITE_DLL)]
+    internal static extern SQLiteErrorCode sqlite3_log_filter_interop(int iCode, int nLimit);
+
+    [DllImport(SQLITE_DLL)]
+    internal static extern int sqlite3_log_dropped_interop();
 #endif
 #endif
 // !SQLITE_STANDARD
@@ -1587,9 +1596,27 @@ namespace System.Data.SQLite
     [DllImport(SQLITE_DLL)]
     internal static extern SQLiteErrorCode sqlite3_cursor_rowid_interop(IntPtr stmt, int cursor, ref long rowid);
 
+    [DllImport(SQLITE_DLL)]
+    internal static extern SQLiteErrorCode sqlite3_cursor_rowids_interop(IntPtr stmt, int count, int[] cursors, [Out] long[] rowids);
+
     [DllImport(SQLITE_DLL)]
     internal static extern SQLiteErrorCode sqlite3_index_column_info_interop(IntPtr db, byte[] catalog, byte[] IndexName, byte[] ColumnName, ref int sortOrder, ref int onError, ref IntPtr Collation, ref int colllen);
 
+    [DllImport(SQLITE_DLL)]
+    internal static extern SQLiteErrorCode sqlite3_schema_info_interop(IntPtr db, byte[] catalog, byte[] tableName, ref IntPtr info, ref int infolen);
+
+    [DllImport(SQLITE_DLL)]
+    internal static extern SQLiteErrorCode sqlite3_schema_stamp_interop(IntPtr db, byte[] catalog, ref IntPtr fileName, ref IntPtr schema, ref int generation, ref int cookie);
+
+    [DllImport(SQLITE_DLL)]
+    internal static extern SQLiteErrorCode sqlite3_index_column_info_cached_interop(IntPtr db, ref IntPtr cache, byte[] catalog, byte[] IndexName, byte[] ColumnName, ref int sortOrder, ref int onError, ref IntPtr Collation, ref int colllen);
+
+    [DllImport(SQLITE_DLL)]
+    internal static extern SQLiteErrorCode sqlite3_statement_metadata_interop(IntPtr stmt, ref IntPtr cache, ref IntPtr info, ref int infolen);
+
+    [DllImport(SQLITE_DLL)]
+    internal static extern void sqlite3_metadata_cache_free_interop(IntPtr cache);
+
     [DllImport(SQLITE_DLL)]
     internal static extern void sqlite3_resetall_interop(IntPtr db);
 
@@ -2104,6 +2131,13 @@ namespace System.Data.SQLite
     [DllImport(SQLITE_DLL)]
 #endif
     internal static extern SQLiteErrorCode sqlite3_rekey(IntPtr db, byte[] key, int keylen);
+
+#if !PLATFORM_COMPACTFRAMEWORK
+    [DllImport(SQLITE_DLL, CallingConvention = CallingConvention.Cdecl)]
+#else
+    [DllImport(SQLITE_DLL)]
+#endif
+    internal static extern SQLiteErrorCode sqlite3_rekey_step(IntPtr db, byte[] key, int keylen, int nPage, out int remaining, out int pageCount);
 #endif
 
 #if !PLATFORM_COMPACTFRAMEWORK
@@ -2318,6 +2352,26 @@ namespace System.Data.SQLite
     [DllImport(SQLITE_DLL)]
 #endif
     internal static extern void sqlite3_dispose_module(IntPtr pModule);
+
+    //
+    // NOTE: These are only provided by the "vtshim" module built into the
+    //       interop assembly.
+    //
+#if !SQLITE_STANDARD
+#if !PLATFORM_COMPACTFRAMEWORK
+    [DllImport(SQLITE_DLL, CallingConvention = CallingConvention.Cdecl)]
+#else
+    [DllImport(SQLITE_DLL)]
+#endif
+    internal static extern SQLiteErrorCode sqlite3_vtshim_stats(IntPtr pModule, IntPtr database, IntPtr table, int resetFlag, ref int openCursors, ref long filterCount, ref long nextCount, ref long childTime);
+
+#if !PLATFORM_COMPACTFRAMEWORK
+    [DllImport(SQLITE_DLL, CallingConvention = CallingConvention.Cdecl)]
+#else
+    [DllImport(SQLITE_DLL)]
+#endif
+    internal static extern int sqlite3_vtshim_timing(IntPtr pModule, int onOff);
+#endif
 #endif
     #endregion
 